@@ -1,3 +1,4 @@
+#include "data_structure/flat_hash_table.h"
 #include "data_structure/tracking_hash_table.h"
 #include "util.h"
 
@@ -47,6 +48,16 @@ BENCHMARK_F(HashTableBenchmark, InsertAllCopySharedPtr)(benchmark::State& s) {
     }
 }
 
+BENCHMARK_F(HashTableBenchmark, InsertAllFlatCopySharedPtr)(benchmark::State& s) {
+    for (auto _ : s) {
+        FlatHashTable<MTSPtr> ht;
+        auto value_ptr = CreateMTSPtr(value);
+        for (const auto& key : keys) {
+            ht.Insert(key, value_ptr);
+        }
+    }
+}
+
 BENCHMARK_DEFINE_F(HashTableBenchmark, FindAllUnorderedMap)(benchmark::State& s) {
     for (auto _ : s) {
         std::unordered_map<std::string, std::string> m;
@@ -81,10 +92,29 @@ BENCHMARK_DEFINE_F(HashTableBenchmark, FindAll)(benchmark::State& s) {
     }
 }
 
+BENCHMARK_DEFINE_F(HashTableBenchmark, FindAllFlat)(benchmark::State& s) {
+    for (auto _ : s) {
+        FlatHashTable<MTSPtr> ht;
+        for (const auto& key : keys) {
+            ht.Insert(key, CreateMTSPtr(value));
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& key : keys) {
+            benchmark::DoNotOptimize(ht.Find(key));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - now;
+        s.SetIterationTime(
+          std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count());
+    }
+}
+
 BENCHMARK_REGISTER_F(HashTableBenchmark, FindAllUnorderedMap)->UseManualTime();
 
 BENCHMARK_REGISTER_F(HashTableBenchmark, FindAll)->UseManualTime();
 
+BENCHMARK_REGISTER_F(HashTableBenchmark, FindAllFlat)->UseManualTime();
+
 BENCHMARK_F(HashTableBenchmark, CreateSharedPtr)(benchmark::State& s) {
     for (auto _ : s) {
         const auto size = keys.size();
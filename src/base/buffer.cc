@@ -4,6 +4,8 @@
 
 #include <glog/logging.h>
 
+#include <cstring>
+
 namespace detail {
 
 constexpr size_t kResizeThreshold = 1024 * 1024;
@@ -36,11 +38,27 @@ char* Buffer::EnsureAvailable(size_t n, bool greedy) {
     const auto new_size = detail::MakeRoomFor(needed_size, greedy);
     assert(new_size >= needed_size);
     VLOG(1) << "Resize buffer from " << data_.size() << " to " << new_size;
-    MemoryTracker::GetInstance().Allocate<MemCategory>(new_size - data_.size());
-    data_.resize(new_size);
+    Resize(new_size);
     return original_start;
 }
 
+void Buffer::Produce(std::string_view view) {
+    assert(virtual_view_);
+    if (view_.empty()) {
+        view_ = view;
+        write_index_ = view_.size();
+        return;
+    }
+
+    assert(view_.data() == data_.data() && read_index_ == 0);
+    if (data_.size() < write_index_ + view.size()) {
+        Resize(detail::MakeRoomFor(write_index_ + view.size(), true));
+    }
+    std::memcpy(data_.data() + write_index_, view.data(), view.size());
+    write_index_ += view.size();
+    view_ = std::string_view{data_.data(), write_index_};
+}
+
 Buffer::View Buffer::Source() const {
     if (write_index_ == read_index_) {
         return {};
@@ -56,4 +74,33 @@ void Buffer::Consume(size_t n) {
     read_index_ += n;
 }
 
+void Buffer::Compact() {
+    const auto pending = Source();
+    if (pending.empty()) {
+        Reset();
+        return;
+    }
+
+    if (virtual_view_ && view_.data() != data_.data()) {
+        // Pending data lives in external memory, 'data_' can be resized safely.
+        if (data_.size() < pending.size()) {
+            Resize(detail::MakeRoomFor(pending.size(), true));
+        }
+        std::memcpy(data_.data(), pending.data(), pending.size());
+    } else if (read_index_ != 0) {
+        std::memmove(data_.data(), pending.data(), pending.size());
+    }
+    read_index_ = 0;
+    write_index_ = pending.size();
+    if (virtual_view_) {
+        view_ = std::string_view{data_.data(), write_index_};
+    }
+}
+
+void Buffer::Resize(size_t new_size) {
+    assert(new_size > data_.size());
+    MemoryTracker::GetInstance().Allocate<MemCategory>(new_size - data_.size());
+    data_.resize(new_size);
+}
+
 } // namespace rdss
@@ -44,7 +44,7 @@ public:
         if (capacity == 0) {
             virtual_view_ = true;
         } else {
-            MemoryTracker::GetInstance().Allocate<MemCategory>(data_.capacity());
+            MemoryTracker::GetInstance().Allocate<MemCategory>(data_.size());
         }
     }
 
@@ -53,7 +53,7 @@ public:
     Buffer(Buffer&&) = default;
     Buffer& operator=(Buffer&&) = default;
 
-    ~Buffer() { MemoryTracker::GetInstance().Deallocate<MemCategory>(data_.capacity()); }
+    ~Buffer() { MemoryTracker::GetInstance().Deallocate<MemCategory>(data_.size()); }
 
     bool IsVirtual() const { return virtual_view_; }
 
@@ -78,12 +78,10 @@ public:
         write_index_ += n;
     }
 
-    void Produce(std::string_view view) {
-        assert(virtual_view_);
-        assert(view_.empty());
-        view_ = view;
-        write_index_ = view_.size();
-    }
+    /// For virtual view buffer. If there is no pending data, the buffer becomes a view over 'view'.
+    /// Otherwise the pending data has been moved to the buffer's own storage by Compact(), 'view' is
+    /// copied and appended to it.
+    void Produce(std::string_view view);
 
     size_t NumWritten() const { return write_index_ - read_index_; }
 
@@ -91,6 +89,18 @@ public:
 
     void Consume(size_t n);
 
+    /// Un-consumes the last 'n' consumed bytes so that they can be read again, e.g. the start of a
+    /// partially received query.
+    void Rewind(size_t n) {
+        assert(n <= read_index_);
+        read_index_ -= n;
+    }
+
+    /// Moves the unconsumed data to the start of the buffer to reuse the space of consumed data.
+    /// For virtual view, the unconsumed data is copied to the buffer's own storage so that the
+    /// viewed memory can be released.
+    void Compact();
+
     void Reset() {
         read_index_ = 0;
         write_index_ = 0;
@@ -100,6 +110,8 @@ public:
     }
 
 private:
+    void Resize(size_t new_size);
+
     bool virtual_view_{false};
     std::vector<char> data_;
     size_t read_index_{0};
@@ -37,6 +37,53 @@ std::string MaxmemoryPolicyEnumToStr(MaxmemoryPolicy policy) {
     }
 }
 
+AppendFsync AppendFsyncStrToEnum(const std::string& str) {
+    if (str == "always") {
+        return AppendFsync::kAlways;
+    }
+    if (str == "everysec") {
+        return AppendFsync::kEverysec;
+    }
+    if (str == "no") {
+        return AppendFsync::kNo;
+    }
+    LOG(FATAL) << "Unknown appendfsync: " << str;
+}
+
+std::string AppendFsyncEnumToStr(AppendFsync fsync) {
+    switch (fsync) {
+    case AppendFsync::kAlways:
+        return "always";
+    case AppendFsync::kEverysec:
+        return "everysec";
+    case AppendFsync::kNo:
+        return "no";
+    default:
+        return "Unknown appendfsync";
+    }
+}
+
+ClientPlacementPolicy ClientPlacementPolicyStrToEnum(const std::string& str) {
+    if (str == "round-robin") {
+        return ClientPlacementPolicy::kRoundRobin;
+    }
+    if (str == "least-loaded") {
+        return ClientPlacementPolicy::kLeastLoaded;
+    }
+    LOG(FATAL) << "Unknown client_placement: " << str;
+}
+
+std::string ClientPlacementPolicyEnumToStr(ClientPlacementPolicy policy) {
+    switch (policy) {
+    case ClientPlacementPolicy::kRoundRobin:
+        return "round-robin";
+    case ClientPlacementPolicy::kLeastLoaded:
+        return "least-loaded";
+    default:
+        return "Unknown client_placement";
+    }
+}
+
 void Config::ReadFromFile(const std::string& file_name) {
     std::ifstream in(file_name);
 
@@ -66,17 +113,53 @@ void Config::ReadFromFile(const std::string& file_name) {
                                              | 10U;
     active_expire_keys_per_loop = redis_section["active_expire_keys_per_loop"] | 20U;
 
+    dir = redis_section["dir"] | dir;
+    dbfilename = redis_section["dbfilename"] | dbfilename;
+
+    appendonly = redis_section["appendonly"] | false;
+    appendfilename = redis_section["appendfilename"] | appendfilename;
+    auto appendfsync_str = redis_section["appendfsync"] | "everysec";
+    appendfsync = AppendFsyncStrToEnum(appendfsync_str);
+
+    hash_max_listpack_entries = redis_section["hash-max-listpack-entries"] | 128U;
+    hash_max_listpack_value = redis_section["hash-max-listpack-value"] | 64U;
+    list_max_listpack_size = redis_section["list-max-listpack-size"] | -2;
+    set_max_intset_entries = redis_section["set-max-intset-entries"] | 512U;
+    hll_sparse_max_bytes = redis_section["hll-sparse-max-bytes"] | 3000U;
+
     auto rdss_section = ini["rdss"];
 
     client_executors = rdss_section["client_executors"] | 2U;
+    data_shards = rdss_section["data_shards"] | 1U;
+    if (data_shards == 0U) {
+        data_shards = 1U;
+    }
     sqpoll = rdss_section["sqpoll"] | false;
     max_direct_fds_per_exr = rdss_section["max_direct_fds_per_exr"] | 4096U;
 
     use_ring_buffer = rdss_section["use_ring_buffer"] | true;
 
     wait_batch_size = rdss_section["wait_batch_size"] | 1U;
+    wait_min_timeout_us = rdss_section["wait_min_timeout_us"] | 0U;
+    busy_poll_us = rdss_section["busy_poll_us"] | 0U;
+    defer_taskrun = rdss_section["defer_taskrun"] | false;
 
     submit_batch_size = rdss_section["submit_batch_size"] | 32U;
+
+    command_batch_size = rdss_section["command_batch_size"] | 64U;
+    if (command_batch_size == 0U) {
+        command_batch_size = 64U;
+    }
+
+    zero_copy_send = rdss_section["zero_copy_send"] | false;
+    zero_copy_send_threshold = rdss_section["zero_copy_send_threshold"] | 16U * 1024U;
+
+    reuseport_listeners = rdss_section["reuseport_listeners"] | false;
+    reuseport_cpu_steering = rdss_section["reuseport_cpu_steering"] | true;
+
+    auto client_placement_str = rdss_section["client_placement"] | "least-loaded";
+    client_placement = ClientPlacementPolicyStrToEnum(client_placement_str);
+    client_migration_threshold = rdss_section["client_migration_threshold"] | 300U;
 }
 
 void Config::SanityCheck() {
@@ -87,6 +170,13 @@ void Config::SanityCheck() {
         LOG(FATAL)
           << "active_expire_acceptable_stale_percent is out of range, it should be in [0, 100]";
     }
+    if (list_max_listpack_size == 0 || list_max_listpack_size < -5) {
+        LOG(FATAL)
+          << "list-max-listpack-size is out of range, it should be positive or in [-5, -1]";
+    }
+    if (client_migration_threshold > 1000) {
+        LOG(FATAL) << "client_migration_threshold is out of range, it should be in [0, 1000]";
+    }
 }
 
 std::string Config::ToString() const {
@@ -102,12 +192,33 @@ std::string Config::ToString() const {
     stream << "active_expire_acceptable_stale_percent:" << active_expire_acceptable_stale_percent
            << ", ";
     stream << "active_expire_keys_per_loop:" << active_expire_keys_per_loop << ",";
+    stream << "dir:" << dir << ", ";
+    stream << "dbfilename:" << dbfilename << ", ";
+    stream << "appendonly:" << appendonly << ", ";
+    stream << "appendfilename:" << appendfilename << ", ";
+    stream << "appendfsync:" << AppendFsyncEnumToStr(appendfsync) << ", ";
+    stream << "hash-max-listpack-entries:" << hash_max_listpack_entries << ", ";
+    stream << "hash-max-listpack-value:" << hash_max_listpack_value << ", ";
+    stream << "list-max-listpack-size:" << list_max_listpack_size << ", ";
+    stream << "set-max-intset-entries:" << set_max_intset_entries << ", ";
+    stream << "hll-sparse-max-bytes:" << hll_sparse_max_bytes << ", ";
     stream << "client_executors:" << client_executors << ", ";
+    stream << "data_shards:" << data_shards << ", ";
     stream << "sqpoll:" << sqpoll << ", ";
     stream << "max_direct_fds_per_exr:" << max_direct_fds_per_exr << ", ";
     stream << "use_ring_buffer:" << use_ring_buffer << ", ";
     stream << "submit_batch_size:" << submit_batch_size << ", ";
-    stream << "wait_batch_size:" << wait_batch_size;
+    stream << "wait_batch_size:" << wait_batch_size << ", ";
+    stream << "wait_min_timeout_us:" << wait_min_timeout_us << ", ";
+    stream << "busy_poll_us:" << busy_poll_us << ", ";
+    stream << "defer_taskrun:" << defer_taskrun << ", ";
+    stream << "command_batch_size:" << command_batch_size << ", ";
+    stream << "zero_copy_send:" << zero_copy_send << ", ";
+    stream << "zero_copy_send_threshold:" << zero_copy_send_threshold << ", ";
+    stream << "reuseport_listeners:" << reuseport_listeners << ", ";
+    stream << "reuseport_cpu_steering:" << reuseport_cpu_steering << ", ";
+    stream << "client_placement:" << ClientPlacementPolicyEnumToStr(client_placement) << ", ";
+    stream << "client_migration_threshold:" << client_migration_threshold;
 
     stream << "].";
     return stream.str();
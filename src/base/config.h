@@ -13,6 +13,18 @@ MaxmemoryPolicy MaxmemoryPolicyStrToEnum(const std::string& str);
 
 std::string MaxmemoryPolicyEnumToStr(MaxmemoryPolicy policy);
 
+enum class AppendFsync { kAlways, kEverysec, kNo };
+
+AppendFsync AppendFsyncStrToEnum(const std::string& str);
+
+std::string AppendFsyncEnumToStr(AppendFsync fsync);
+
+enum class ClientPlacementPolicy { kRoundRobin, kLeastLoaded };
+
+ClientPlacementPolicy ClientPlacementPolicyStrToEnum(const std::string& str);
+
+std::string ClientPlacementPolicyEnumToStr(ClientPlacementPolicy policy);
+
 struct Config {
     /// Redis config
     uint16_t port = 6379U;
@@ -24,20 +36,49 @@ struct Config {
     uint32_t active_expire_cycle_time_percent = 25U;
     uint32_t active_expire_acceptable_stale_percent = 10U;
     uint32_t active_expire_keys_per_loop = 20U;
+    std::string dir = ".";
+    std::string dbfilename = "dump.rdb";
+    bool appendonly = false;
+    std::string appendfilename = "appendonly.aof";
+    AppendFsync appendfsync = AppendFsync::kEverysec;
+    uint32_t hash_max_listpack_entries = 128U;
+    uint32_t hash_max_listpack_value = 64U;
+    int32_t list_max_listpack_size = -2;
+    uint32_t set_max_intset_entries = 512U;
+    uint32_t hll_sparse_max_bytes = 3000U;
 
     /// rdss-specific config
     // TODO: sanity check
     uint32_t client_executors = 2;
+    uint32_t data_shards = 1;
     bool sqpoll = false;
     uint32_t max_direct_fds_per_exr = 4096;
     bool use_ring_buffer = true;
     uint32_t submit_batch_size = 32;
     uint32_t wait_batch_size = 1;
+    uint32_t wait_min_timeout_us = 0;
+    uint32_t busy_poll_us = 0;
+    bool defer_taskrun = false;
+    uint32_t command_batch_size = 64;
+    bool zero_copy_send = false;
+    uint32_t zero_copy_send_threshold = 16 * 1024;
+    bool reuseport_listeners = false;
+    bool reuseport_cpu_steering = true;
+    ClientPlacementPolicy client_placement = ClientPlacementPolicy::kLeastLoaded;
+    uint32_t client_migration_threshold = 300;
 
     void ReadFromFile(const std::string& file_name);
 
     void SanityCheck();
 
+    /// Returns the path of the RDB file.
+    std::string RdbPath() const { return dir + '/' + dbfilename; }
+
+    /// Returns the path of the append only file of the data shard 'shard'.
+    std::string AofPath(size_t shard) const {
+        return dir + '/' + appendfilename + '.' + std::to_string(shard);
+    }
+
     std::string ToString() const;
 
     /// Clones a config based on the given one but turns off sqpoll. Used for creating I/O
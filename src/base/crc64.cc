@@ -0,0 +1,36 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "base/crc64.h"
+
+#include <array>
+
+namespace rdss {
+
+namespace {
+
+constexpr uint64_t kPolynomial = 0x95ac9329ac4bc9b5ULL;
+
+constexpr std::array<uint64_t, 256> MakeTable() {
+    std::array<uint64_t, 256> table{};
+    for (uint64_t i = 0; i < table.size(); ++i) {
+        uint64_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr auto kTable = MakeTable();
+
+} // namespace
+
+uint64_t Crc64(uint64_t crc, std::string_view data) {
+    for (const auto c : data) {
+        crc = kTable[(crc ^ static_cast<uint8_t>(c)) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+} // namespace rdss
@@ -0,0 +1,14 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace rdss {
+
+/// CRC-64/Jones as used by the RDB file format, i.e. reflected polynomial 0x95ac9329ac4bc9b5 with
+/// zero init and xorout. Continues the checksum 'crc' of the preceding data with 'data'.
+uint64_t Crc64(uint64_t crc, std::string_view data);
+
+} // namespace rdss
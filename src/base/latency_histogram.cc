@@ -0,0 +1,47 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rdss {
+
+uint64_t LatencyHistogram::Snapshot::Percentile(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    // Rank of the value, at least the first one.
+    const auto rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count))));
+    uint64_t seen{0};
+    for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            return UpperBound(bucket);
+        }
+    }
+    return UpperBound(kNumBuckets - 1);
+}
+
+void LatencyHistogram::AddTo(Snapshot& snapshot) const {
+    // The count is summed from the buckets, which might be ahead of 'count_' when read while
+    // recording.
+    for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+        const auto count = counts_[bucket].load(std::memory_order_relaxed);
+        snapshot.counts[bucket] += count;
+        snapshot.count += count;
+    }
+    snapshot.sum_ns += sum_ns_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::UpperBound(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const auto shift = bucket / kSubBuckets - 1;
+    const auto sub_bucket = bucket % kSubBuckets + kSubBuckets;
+    return ((static_cast<uint64_t>(sub_bucket) + 1) << shift) - 1;
+}
+
+} // namespace rdss
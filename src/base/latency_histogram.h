@@ -0,0 +1,79 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace rdss {
+
+/// Adds 'n' to 'counter' that is only written by the calling thread. It's a plain load and store,
+/// without the locked read-modify-write of fetch_add, while other threads can still read it.
+inline void SingleWriterAdd(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/// Log-bucketed histogram of durations in nanoseconds, in the way of HdrHistogram: a value is
+/// bucketed by its power of two, which is split into kSubBuckets linear sub-buckets, so a bucket
+/// is within 1/kSubBuckets of its values. It's written by a single thread, see SingleWriterAdd.
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+    // Values of 2^kMaxBits nanoseconds (about 68 seconds) and longer fall into the last bucket.
+    static constexpr size_t kMaxBits = 36;
+    static constexpr size_t kNumBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+    /// Counts read from the histograms of one or more threads.
+    struct Snapshot {
+        std::array<uint64_t, kNumBuckets> counts{};
+        uint64_t count{0};
+        uint64_t sum_ns{0};
+
+        /// Returns the upper bound of the bucket of the value at 'percentile' (0 to 100), or 0 if
+        /// there is no value.
+        uint64_t Percentile(double percentile) const;
+    };
+
+    void Record(uint64_t ns) {
+        SingleWriterAdd(counts_[BucketOf(ns)]);
+        SingleWriterAdd(count_);
+        SingleWriterAdd(sum_ns_, ns);
+    }
+
+    void Record(std::chrono::steady_clock::duration duration) {
+        Record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t SumNs() const { return sum_ns_.load(std::memory_order_relaxed); }
+
+    /// Adds the counts to 'snapshot', which merges the histograms of threads.
+    void AddTo(Snapshot& snapshot) const;
+
+    static size_t BucketOf(uint64_t ns) {
+        ns = std::min(ns, (uint64_t{1} << kMaxBits) - 1);
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        const auto shift = static_cast<size_t>(std::bit_width(ns)) - 1 - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<size_t>(ns >> shift) - kSubBuckets;
+    }
+
+    /// Returns the largest value of 'bucket'.
+    static uint64_t UpperBound(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, kNumBuckets> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+} // namespace rdss
@@ -0,0 +1,53 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "base/lzf.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace rdss {
+
+size_t LzfDecompress(std::string_view in, char* out, size_t out_size) {
+    const auto* ip = reinterpret_cast<const uint8_t*>(in.data());
+    const auto* const in_end = ip + in.size();
+    size_t op{0};
+
+    while (ip < in_end) {
+        size_t ctrl = *ip++;
+        if (ctrl < (1 << 5)) {
+            // Literal run of 'ctrl' + 1 bytes.
+            ++ctrl;
+            if (op + ctrl > out_size || ip + ctrl > in_end) {
+                return 0;
+            }
+            std::memcpy(out + op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+            continue;
+        }
+
+        // Back reference of 'len' + 2 bytes at 'distance' + 1 bytes before.
+        size_t len = ctrl >> 5;
+        if (len == 7) {
+            if (ip >= in_end) {
+                return 0;
+            }
+            len += *ip++;
+        }
+        if (ip >= in_end) {
+            return 0;
+        }
+        const size_t distance = ((ctrl & 0x1f) << 8) + *ip++;
+        len += 2;
+        if (op + len > out_size || distance + 1 > op) {
+            return 0;
+        }
+        // The referenced bytes may overlap with the output, so copy byte by byte.
+        for (size_t ref = op - distance - 1; len > 0; --len) {
+            out[op++] = out[ref++];
+        }
+    }
+    return op;
+}
+
+} // namespace rdss
@@ -0,0 +1,14 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace rdss {
+
+/// Decompresses LZF compressed 'in' into 'out', which is used by RDB files for long strings.
+/// Returns the number of bytes written, or 0 if 'in' is corrupted or 'out' is too small.
+size_t LzfDecompress(std::string_view in, char* out, size_t out_size);
+
+} // namespace rdss
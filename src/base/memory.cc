@@ -5,6 +5,17 @@
 namespace rdss {
 
 MemoryTracker* MemoryTracker::instance_ = nullptr;
+thread_local MemoryTracker::Slot* MemoryTracker::tls_slot_ = nullptr;
+
+namespace {
+
+void UpdatePeak(std::atomic<size_t>& peak, size_t value) {
+    auto current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value)) {
+    }
+}
+
+} // namespace
 
 MemoryTracker& MemoryTracker::GetInstance() {
     if (instance_ == nullptr) {
@@ -13,6 +24,44 @@ MemoryTracker& MemoryTracker::GetInstance() {
     return *instance_;
 }
 
+MemoryTracker::Slot* MemoryTracker::RegisterSlot() {
+    tls_slot_ = new Slot();
+    tls_slot_->next = slots_.load(std::memory_order_relaxed);
+    while (!slots_.compare_exchange_weak(
+      tls_slot_->next, tls_slot_, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return tls_slot_;
+}
+
+void MemoryTracker::Publish(Slot& slot) {
+    const auto published
+      = published_.fetch_add(slot.unpublished, std::memory_order_relaxed) + slot.unpublished;
+    slot.unpublished = 0;
+    if (published > 0) {
+        UpdatePeak(peak_, static_cast<size_t>(published));
+    }
+}
+
+size_t MemoryTracker::Sum(size_t category) const {
+    int64_t sum{0};
+    for (const auto* slot = slots_.load(std::memory_order_acquire); slot != nullptr;
+         slot = slot->next) {
+        for (size_t i = 0; i < kNumCategories; ++i) {
+            if (category == i || category == kNumCategories) {
+                sum += slot->allocated[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    // Frees may be seen before the allocations they pair with.
+    return sum > 0 ? static_cast<size_t>(sum) : 0;
+}
+
+size_t MemoryTracker::GetPeakAllocated() const {
+    // The exact sum may be above the published one, which lags behind.
+    UpdatePeak(peak_, Sum(kNumCategories));
+    return peak_.load(std::memory_order_relaxed);
+}
+
 std::ostream& operator<<(std::ostream& os, MemTrackingCategory c) {
     switch (c) {
     case MemTrackingCategory::kMallocator:
@@ -2,9 +2,12 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include "base/slab.h"
+
 #include <glog/logging.h>
 
 #include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -17,10 +20,19 @@ namespace rdss {
 enum class MemTrackingCategory : uint8_t { kMallocator = 0, kQueryBuffer, kAll };
 std::ostream& operator<<(std::ostream& os, MemTrackingCategory c);
 
+/// Tracks the memory allocated by each category. Every thread, i.e. every executor, updates the
+/// counters of its own slot with plain owner-only stores, so that allocations don't bounce a shared
+/// cache line between threads. Readers sum the slots of all threads on demand, which is exact up to
+/// the updates in flight. The peak is maintained from a shared total that every thread publishes to
+/// once its own change since the last publish reaches kPublishThreshold, so it lags behind by less
+/// than kPublishThreshold bytes per thread.
 class MemoryTracker {
 public:
     using Category = MemTrackingCategory;
 
+    static constexpr size_t kNumCategories = static_cast<size_t>(Category::kAll);
+    static constexpr int64_t kPublishThreshold = 64 * 1024;
+
 public:
     MemoryTracker(MemoryTracker&) = delete;
 
@@ -32,49 +44,100 @@ public:
     template<Category C>
     void Allocate(size_t n) {
         static_assert(C != Category::kAll);
-        counter_[static_cast<size_t>(C)].fetch_add(n, std::memory_order_relaxed);
-
-        const auto sum = counter_[0].load(std::memory_order_relaxed)
-                         + counter_[1].load(std::memory_order_relaxed);
-        auto peak = peak_.load(std::memory_order_relaxed);
-        while (sum > peak && !peak_.compare_exchange_weak(peak, sum)) {
-        }
-
-        VLOG(1) << '[' << C << "] Allocate [" << n << " | " << counter_[static_cast<size_t>(C)]
-                << "].";
+        Update(static_cast<size_t>(C), static_cast<int64_t>(n));
+        VLOG(1) << '[' << C << "] Allocate [" << n << "].";
     }
 
     template<Category C>
     void Deallocate(size_t n) {
         static_assert(C != Category::kAll);
-        counter_[static_cast<size_t>(C)].fetch_sub(n, std::memory_order_relaxed);
-        VLOG(1) << '[' << C << "] Deallocate [" << n << " | " << counter_[static_cast<size_t>(C)]
-                << "].";
+        Update(static_cast<size_t>(C), -static_cast<int64_t>(n));
+        VLOG(1) << '[' << C << "] Deallocate [" << n << "].";
     }
 
+    /// Sums the counters of all threads. Called by INFO, not on the allocation path.
     template<Category C>
     size_t GetAllocated() const {
         if constexpr (C == Category::kAll) {
-            return counter_[0] + counter_[1];
+            return Sum(kNumCategories);
+        }
+        return Sum(static_cast<size_t>(C));
+    }
+
+    /// Returns the counter of the calling thread, which goes down by what the thread frees even if
+    /// another thread allocated it, e.g. to measure what a piece of code frees without reading the
+    /// counters of other threads.
+    template<Category C>
+    int64_t GetThreadAllocated() const {
+        static_assert(C != Category::kAll);
+        const auto* slot = tls_slot_;
+        if (slot == nullptr) {
+            return 0;
         }
-        return counter_[static_cast<size_t>(C)];
+        return slot->allocated[static_cast<size_t>(C)].load(std::memory_order_relaxed);
     }
 
-    size_t GetPeakAllocated() const { return peak_.load(std::memory_order_relaxed); }
+    /// Returns the total of all categories published by the threads, which lags behind the exact
+    /// sum by less than kPublishThreshold bytes per thread. It's one load, so unlike
+    /// GetAllocated() it can be called on every write command, e.g. to check maxmemory.
+    size_t GetPublishedAllocated() const {
+        const auto published = published_.load(std::memory_order_relaxed);
+        return published > 0 ? static_cast<size_t>(published) : 0;
+    }
+
+    size_t GetPeakAllocated() const;
 
 protected:
     MemoryTracker() = default;
     static MemoryTracker* instance_;
 
 private:
-    std::atomic<size_t> counter_[2] = {};
-    std::atomic<size_t> peak_{0};
+    // Counters of one thread, aligned so that slots of different threads don't share a cache line.
+    struct alignas(64) Slot {
+        // Written by the owner only, and read by other threads. A counter goes negative if the
+        // thread frees more than it allocates, e.g. strings released after their replies are sent.
+        std::atomic<int64_t> allocated[kNumCategories] = {};
+        // Owner-only part of 'allocated' not yet added to 'published_'.
+        int64_t unpublished{0};
+        Slot* next{nullptr};
+    };
+
+    void Update(size_t category, int64_t n) {
+        auto* slot = tls_slot_;
+        if (slot == nullptr) [[unlikely]] {
+            slot = RegisterSlot();
+        }
+        auto& counter = slot->allocated[category];
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        slot->unpublished += n;
+        if (std::abs(slot->unpublished) >= kPublishThreshold) [[unlikely]] {
+            Publish(*slot);
+        }
+    }
+
+    Slot* RegisterSlot();
+
+    void Publish(Slot& slot);
+
+    // Sums 'category' of all slots, or all categories if it's kNumCategories.
+    size_t Sum(size_t category) const;
+
+    // Slots are never destroyed, so the memory allocated by exited threads is still counted.
+    std::atomic<Slot*> slots_{nullptr};
+    static thread_local Slot* tls_slot_;
+
+    // Sum of the published changes of all threads, which is what the peak is updated from.
+    std::atomic<int64_t> published_{0};
+    mutable std::atomic<size_t> peak_{0};
 };
 
+/// Memory tracked allocator. Small allocations are served by the SlabArena of the calling thread,
+/// and the size of the slab block is accounted.
 template<class T>
 struct Mallocator {
     using value_type = T;
     static constexpr auto MemCategory = MemoryTracker::Category::kMallocator;
+    static_assert(alignof(T) <= alignof(std::max_align_t));
 
     Mallocator() = default;
 
@@ -85,7 +148,7 @@ struct Mallocator {
         if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
             throw std::bad_array_new_length();
 
-        if (auto p = static_cast<T*>(std::malloc(n * sizeof(T)))) {
+        if (auto p = static_cast<T*>(SlabArena::Allocate(n * sizeof(T)))) {
             report<true>(p, n);
             return p;
         }
@@ -95,13 +158,13 @@ struct Mallocator {
 
     void deallocate(T* p, std::size_t n) noexcept {
         report<false>(p, n);
-        std::free(p);
+        SlabArena::Deallocate(p, n * sizeof(T));
     }
 
 private:
     template<bool IsAlloc>
     void report([[maybe_unused]] T* p, std::size_t n) const {
-        const auto bytes = sizeof(T) * n;
+        const auto bytes = SlabArena::AllocationSize(sizeof(T) * n);
         if constexpr (IsAlloc) {
             MemoryTracker::GetInstance().Allocate<MemCategory>(bytes);
         } else {
@@ -0,0 +1,153 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "base/slab.h"
+
+#include <glog/logging.h>
+
+#include <cassert>
+#include <cstdlib>
+
+namespace rdss {
+
+std::mutex SlabArena::arenas_mutex_;
+std::vector<SlabArena*> SlabArena::arenas_;
+
+namespace {
+
+thread_local SlabArena* tls_arena = nullptr;
+
+// Owner-only update of counters that are read by other threads.
+void Add(std::atomic<size_t>& counter, size_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void Sub(std::atomic<size_t>& counter, size_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+}
+
+} // namespace
+
+SlabArena& SlabArena::Local() {
+    if (tls_arena == nullptr) {
+        // Arenas are never destroyed, since their blocks may outlive the thread.
+        tls_arena = new SlabArena();
+        std::lock_guard lock(arenas_mutex_);
+        arenas_.push_back(tls_arena);
+    }
+    return *tls_arena;
+}
+
+void* SlabArena::Allocate(size_t size) {
+    if (size == 0 || size > kMaxBlockSize) {
+        return std::malloc(size);
+    }
+    return Local().AllocateBlock(SizeClass(size));
+}
+
+void SlabArena::Deallocate(void* p, size_t size) {
+    if (size == 0 || size > kMaxBlockSize) {
+        std::free(p);
+        return;
+    }
+    const auto* page = reinterpret_cast<PageHeader*>(
+      reinterpret_cast<uintptr_t>(p) & ~(uintptr_t{kPageSize} - 1));
+    assert(page->size_class == SizeClass(size));
+    if (page->owner == tls_arena) {
+        page->owner->FreeBlock(page->size_class, p);
+    } else {
+        page->owner->RemoteFreeBlock(page->size_class, p);
+    }
+}
+
+SlabArena::Stats SlabArena::GetStats() {
+    Stats stats;
+    for (size_t i = 0; i < kNumClasses; ++i) {
+        stats.classes[i].block_size = BlockSize(i);
+    }
+
+    std::lock_guard lock(arenas_mutex_);
+    for (const auto* arena : arenas_) {
+        for (size_t i = 0; i < kNumClasses; ++i) {
+            auto& class_stats = stats.classes[i];
+            class_stats.pages += arena->classes_[i].pages.load(std::memory_order_relaxed);
+            class_stats.used_blocks += arena->classes_[i].used_blocks.load(
+              std::memory_order_relaxed);
+        }
+    }
+    for (const auto& class_stats : stats.classes) {
+        stats.committed_bytes += class_stats.pages * kPageSize;
+        stats.used_bytes += class_stats.used_blocks * class_stats.block_size;
+    }
+    return stats;
+}
+
+void* SlabArena::AllocateBlock(size_t size_class) {
+    auto& state = classes_[size_class];
+    if (state.free_list == nullptr && !ReclaimRemoteFree(state)) {
+        const auto block_size = BlockSize(size_class);
+        if (static_cast<size_t>(state.bump_end - state.bump) < block_size
+            && !AddPage(size_class)) {
+            return nullptr;
+        }
+        auto* block = state.bump;
+        state.bump += block_size;
+        Add(state.used_blocks, 1);
+        return block;
+    }
+
+    auto* block = state.free_list;
+    state.free_list = block->next;
+    Add(state.used_blocks, 1);
+    return block;
+}
+
+void SlabArena::FreeBlock(size_t size_class, void* p) {
+    auto& state = classes_[size_class];
+    auto* block = static_cast<Block*>(p);
+    block->next = state.free_list;
+    state.free_list = block;
+    Sub(state.used_blocks, 1);
+}
+
+void SlabArena::RemoteFreeBlock(size_t size_class, void* p) {
+    auto& remote_free = classes_[size_class].remote_free;
+    auto* block = static_cast<Block*>(p);
+    block->next = remote_free.load(std::memory_order_relaxed);
+    while (!remote_free.compare_exchange_weak(
+      block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+bool SlabArena::ReclaimRemoteFree(SizeClassState& state) {
+    // The owner takes the whole list at once, so there is no ABA problem with the pushes.
+    auto* head = state.remote_free.exchange(nullptr, std::memory_order_acquire);
+    if (head == nullptr) {
+        return false;
+    }
+    size_t reclaimed{1};
+    auto* tail = head;
+    while (tail->next != nullptr) {
+        tail = tail->next;
+        ++reclaimed;
+    }
+    tail->next = state.free_list;
+    state.free_list = head;
+    Sub(state.used_blocks, reclaimed);
+    return true;
+}
+
+bool SlabArena::AddPage(size_t size_class) {
+    auto* page = static_cast<char*>(std::aligned_alloc(kPageSize, kPageSize));
+    if (page == nullptr) {
+        return false;
+    }
+    VLOG(1) << "Adding slab page for block size " << BlockSize(size_class);
+    new (page) PageHeader{.owner = this, .size_class = size_class};
+    auto& state = classes_[size_class];
+    state.bump = page + kPageHeaderSize;
+    state.bump_end = page + kPageSize;
+    Add(state.pages, 1);
+    return true;
+}
+
+} // namespace rdss
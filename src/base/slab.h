@@ -0,0 +1,120 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rdss {
+
+/// Size-class slab allocator for small objects like table entries and short strings. Every thread,
+/// i.e. every executor, allocates from its own arena without locking. Blocks are carved from
+/// kPageSize-aligned pages, whose header records the owning arena, so that a block freed by another
+/// thread (e.g. a shared string released after its reply is sent) goes back to its owner.
+class SlabArena {
+public:
+    static constexpr size_t kPageSize = 64 * 1024;
+    static constexpr size_t kPageHeaderSize = 64;
+    static constexpr size_t kMaxBlockSize = 512;
+    static constexpr size_t kNumClasses = 16;
+
+    struct ClassStats {
+        size_t block_size{0};
+        size_t pages{0};
+        size_t used_blocks{0};
+    };
+
+    struct Stats {
+        size_t committed_bytes{0};
+        size_t used_bytes{0};
+        std::array<ClassStats, kNumClasses> classes;
+    };
+
+public:
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    /// Returns the class serving 'size' bytes. 'size' should be in (0, kMaxBlockSize].
+    static constexpr size_t SizeClass(size_t size) {
+        if (size <= 128) {
+            return (size - 1) / 16;
+        }
+        if (size <= 256) {
+            return 8 + (size - 129) / 32;
+        }
+        return 12 + (size - 257) / 64;
+    }
+
+    static constexpr size_t BlockSize(size_t size_class) {
+        if (size_class < 8) {
+            return (size_class + 1) * 16;
+        }
+        if (size_class < 12) {
+            return 128 + (size_class - 7) * 32;
+        }
+        return 256 + (size_class - 11) * 64;
+    }
+
+    /// Returns the bytes actually taken by allocating 'size' bytes, which is what's accounted.
+    static constexpr size_t AllocationSize(size_t size) {
+        return (size == 0 || size > kMaxBlockSize) ? size : BlockSize(SizeClass(size));
+    }
+
+    /// Allocates 'size' bytes from the arena of the calling thread, or from malloc if it's too
+    /// large. Returns nullptr on failure.
+    static void* Allocate(size_t size);
+
+    /// Frees 'p' which was returned by Allocate('size'), from any thread.
+    static void Deallocate(void* p, size_t size);
+
+    /// Sums the stats of all arenas. Blocks freed by threads other than the owner are counted when
+    /// the owner reclaims them.
+    static Stats GetStats();
+
+private:
+    struct Block {
+        Block* next;
+    };
+
+    struct PageHeader {
+        SlabArena* owner;
+        size_t size_class;
+    };
+    static_assert(sizeof(PageHeader) <= kPageHeaderSize);
+
+    struct SizeClassState {
+        Block* free_list{nullptr};
+        char* bump{nullptr};
+        char* bump_end{nullptr};
+        // Written by the owner only, and read by GetStats from other threads.
+        std::atomic<size_t> pages{0};
+        std::atomic<size_t> used_blocks{0};
+        // Blocks freed by other threads, reclaimed by the owner when 'free_list' runs out.
+        std::atomic<Block*> remote_free{nullptr};
+    };
+
+    SlabArena() = default;
+
+    static SlabArena& Local();
+
+    void* AllocateBlock(size_t size_class);
+
+    void FreeBlock(size_t size_class, void* p);
+
+    void RemoteFreeBlock(size_t size_class, void* p);
+
+    bool ReclaimRemoteFree(SizeClassState& state);
+
+    bool AddPage(size_t size_class);
+
+    std::array<SizeClassState, kNumClasses> classes_;
+
+    static std::mutex arenas_mutex_;
+    static std::vector<SlabArena*> arenas_;
+};
+
+} // namespace rdss
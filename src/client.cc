@@ -7,33 +7,27 @@
 #include "constants.h"
 #include "resp/replier.h"
 #include "runtime/util.h"
+#include "service/aof.h"
 #include "service/data_structure_service.h"
 
 #include <glog/logging.h>
 
+#include <chrono>
+#include <climits>
 #include <tuple>
 
 namespace rdss {
 
 namespace detail {
 
-// Parses data in 'buffer' inline or multi-bulk way according to
-// 1.If mbulk parser is in progress.
-// 2.If the start of 'buffer' is '*'.
-// If necessary, creates 'mbulk_parser_'. Fills result into 'result', and updates 'result_size' to
-// reflect the number of result.
+// Parses the query at the start of 'buffer' inline or multi-bulk way according to if the start of
+// 'buffer' is '*'. If necessary, creates 'mbulk_parser_'. Fills result into 'result', and updates
+// 'result_size' to reflect the number of result.
 ParserState Parse(
   Buffer& buffer,
   std::unique_ptr<MultiBulkParser>& mbulk_parser_,
   StringViews& result,
   size_t& result_size) {
-    if (mbulk_parser_ != nullptr && mbulk_parser_->InProgress()) {
-        auto res = mbulk_parser_->Parse(result);
-        if (res == ParserState::kDone) {
-            result_size = mbulk_parser_->GetResultSize();
-        }
-        return res;
-    }
     if (buffer.Source().at(0) == '*') {
         if (mbulk_parser_ == nullptr) {
             mbulk_parser_ = std::make_unique<MultiBulkParser>(&buffer);
@@ -49,56 +43,184 @@ ParserState Parse(
 
 } // namespace detail
 
-Client::Client(Connection* conn, ClientManager* manager, DataStructureService* service)
+Client::Client(Connection* conn, ClientManager* manager, const DataShards* shards)
   : conn_(std::unique_ptr<Connection>(conn))
   , manager_(manager)
-  , service_(service)
+  , shards_(shards)
+  , sharded_batch_(shards)
   , query_buffer_(
       conn_->UseRingBuf() ? 0 /* Init with 0 will make buffer 'virtual_view' */
                           : kIOGenericBufferSize)
-  , output_buffer_(kOutputBufferSize) {}
+  , reply_writer_(kOutputBufferSize) {}
 
-Task<void> Client::Process(RingExecutor* dss_executor) {
+Task<void> Client::Process() {
+    // View of the last recv. It's returned once 'query_buffer_' no longer references it.
+    RingExecutor::BufferView buffer_view;
+    bool needs_recv{true};
     while (true) {
-        EnsureBuffer();
-        auto [err, buffer_view] = co_await conn_->Recv(&query_buffer_);
-        if (err) {
-            VLOG(1) << "recv: " << err.message();
-            break;
+        // When the batch is picked up, which is when the executor reaped the received queries.
+        std::chrono::steady_clock::time_point batch_start;
+        if (needs_recv) {
+            EnsureBuffer();
+            std::error_code err;
+            RingExecutor::BufferView view;
+            if (conn_->UseRingBuf()) {
+                std::tie(err, view) = co_await conn_->RecvMultishot(&query_buffer_);
+            } else {
+                std::tie(err, view) = co_await conn_->Recv(&query_buffer_);
+            }
+            if (err) {
+                VLOG(1) << "recv: " << err.message();
+                break;
+            }
+            const auto bytes_read = view.view.size();
+            if (bytes_read == 0) {
+                break;
+            }
+            manager_->Stats().net_input_bytes.fetch_add(bytes_read, std::memory_order_relaxed);
+            manager_->Touch(this);
+            conn_->GetExecutor()->Load().net_input_bytes.fetch_add(
+              bytes_read, std::memory_order_relaxed);
+            buffer_view = std::move(view);
+            batch_start = conn_->GetExecutor()->BatchStart();
+            manager_->RecordLatency(
+              handle_, LatencyStage::kQueue, std::chrono::steady_clock::now() - batch_start);
+        } else {
+            batch_start = std::chrono::steady_clock::now();
         }
-        const auto bytes_read = query_buffer_.Source().size();
-        if (bytes_read == 0) {
-            break;
+
+        ParseBatch();
+        // The last query's result is already set if it has protocol error.
+        const auto num_to_invoke = num_queries_ - (protocol_error_ ? 1 : 0);
+        for (size_t i = 0; i < num_to_invoke; ++i) {
+            auto& query = queries_[i];
+            assert(query.num_arguments != 0);
+            sharded_batch_.Add(
+              std::span<StringView>(query.arguments.begin(), query.num_arguments),
+              &query_results_[i]);
         }
-        manager_->Stats().net_input_bytes.fetch_add(bytes_read, std::memory_order_relaxed);
+        if (!sharded_batch_.Empty()) {
+            std::chrono::steady_clock::duration hop{0};
+            std::chrono::steady_clock::duration execute{0};
+            auto left = std::chrono::steady_clock::now();
+            if (ends_with_blocking_) {
+                // The queries pipelined after the blocking one aren't taken until it's replied,
+                // so the end of the stream isn't seen either. A peer hanging up meanwhile kills
+                // the client, so that it doesn't stay blocked, or get served, for nobody.
+                conn_->WatchHangup([this]() { Kill(); });
+            }
+            // Visits the involved shards one after another, each executes its queries in order.
+            for (const auto shard : sharded_batch_.InvolvedShards()) {
+                co_await ResumeOn((*shards_)[shard].executor);
+                const auto arrived = std::chrono::steady_clock::now();
+                hop += arrived - left;
+                sharded_batch_.Execute(shard);
+                // With appendfsync always, the writes are replied after they are on the disk.
+                auto* aof = (*shards_)[shard].service->GetAof();
+                if (aof != nullptr && aof->SyncsEveryWrite()) {
+                    co_await aof->WaitForSync();
+                }
+                co_await (*shards_)[shard].service->WaitForDeferredReplies(
+                  std::span<const Result>(query_results_.data(), num_queries_));
+                left = std::chrono::steady_clock::now();
+                execute += left - arrived;
+            }
+            if (
+              ends_with_blocking_
+              && query_results_[num_queries_ - 1].type == Result::Type::kNil) {
+                // The blocking query replied nil, the client waits on its shard until it's served
+                // there, times out, or is killed. Awaiting invokes the query again on the shard,
+                // which serves it if one of its keys became ready since it replied nil.
+                auto& query = queries_[num_queries_ - 1];
+                const Args args(query.arguments.begin(), query.num_arguments);
+                const auto shard = KeyToShard(args[1], shards_->size());
+                auto* service = (*shards_)[shard].service;
+                co_await ResumeOn((*shards_)[shard].executor);
+                // Either the client sees it's killed, or Kill() sees it's blocked and unblocks it.
+                blocked_shard_.store(shard);
+                if (!killed_.load()) {
+                    const auto reason = co_await service->WaitForKeys(
+                      args, &query_results_[num_queries_ - 1], handle_.id);
+                    auto* aof = service->GetAof();
+                    if (
+                      reason == DataStructureService::WakeReason::kReady && aof != nullptr
+                      && aof->SyncsEveryWrite()) {
+                        co_await aof->WaitForSync();
+                    }
+                }
+                blocked_shard_.store(kNotBlocked, std::memory_order_relaxed);
+                left = std::chrono::steady_clock::now();
+            }
+            co_await ResumeOn(conn_->GetExecutor());
+            conn_->StopWatchingHangup();
+            hop += std::chrono::steady_clock::now() - left;
+            manager_->RecordLatency(handle_, LatencyStage::kHop, hop);
+            manager_->RecordLatency(handle_, LatencyStage::kExecute, execute);
+        }
+        sharded_batch_.Finish();
 
-        size_t num_strings;
-        const auto parse_result = detail::Parse(
-          query_buffer_, mbulk_parser_, arguments_, num_strings);
-        switch (parse_result) {
-        case ParserState::kInit:
-        case ParserState::kParsing:
+        // If the batch is full, the rest of 'query_buffer_' might contain complete queries, serve
+        // them before receiving more. Otherwise, there is at most a partial query left.
+        needs_recv = protocol_error_ || query_buffer_.NumWritten() == 0
+                     || (num_queries_ < shards_->front().service->GetConfig()->command_batch_size
+                         && !ends_with_blocking_);
+        if (needs_recv) {
+            if (protocol_error_) {
+                query_buffer_.Reset();
+            } else {
+                query_buffer_.Compact();
+            }
+            conn_->PutBufferView(std::move(buffer_view));
+        }
+        if (num_queries_ == 0) {
             continue;
-        case ParserState::kError:
-            query_result_.SetError(Error::kProtocol);
-            break;
-        case ParserState::kDone:
-            assert(num_strings != 0);
-            co_await ResumeOn(dss_executor);
-            service_->Invoke(std::span<StringView>(arguments_.begin(), num_strings), query_result_);
-            co_await ResumeOn(conn_->GetExecutor());
-            break;
         }
-        conn_->PutBufferView(std::move(buffer_view));
 
+        const auto send_start = std::chrono::steady_clock::now();
         std::error_code error;
-        size_t bytes_written;
-        if (NeedsGather(query_result_)) {
-            ResultToIovecs(query_result_, output_buffer_, iovecs_);
-            std::tie(error, bytes_written) = co_await conn_->Writev(iovecs_);
-        } else {
-            std::tie(error, bytes_written) = co_await conn_->Send(
-              ResultToStringView(query_result_, output_buffer_));
+        size_t bytes_written{0};
+        reply_writer_.Append(std::span<Result>(query_results_.begin(), num_queries_));
+        auto pending = reply_writer_.Iovecs();
+        const auto* config = shards_->front().service->GetConfig();
+        // The written chunks and the referenced strings are held until the kernel is done with
+        // them, which might be after the replies are reset.
+        std::shared_ptr<ReplyWriter::Pinned> pinned;
+        if (
+          config->zero_copy_send
+          && reply_writer_.ReferencedBytes() >= config->zero_copy_send_threshold) {
+            pinned = reply_writer_.Pin();
+        }
+        // A send might write only a part of the replies, e.g. when the socket buffer is full, the
+        // rest is sent by the following ones.
+        while (!pending.empty()) {
+            const auto num_iovecs = std::min<size_t>(pending.size(), IOV_MAX);
+            std::error_code send_error;
+            size_t n{0};
+            if (pinned != nullptr) {
+                std::tie(send_error, n)
+                  = co_await conn_->SendZeroCopy(pending.first(num_iovecs), pinned);
+            } else if (num_iovecs == 1) {
+                std::tie(send_error, n) = co_await conn_->Send(std::string_view(
+                  static_cast<const char*>(pending[0].iov_base), pending[0].iov_len));
+            } else {
+                std::tie(send_error, n) = co_await conn_->Writev(pending.first(num_iovecs));
+            }
+            if (send_error || n == 0) {
+                error = send_error;
+                bytes_written = 0;
+                break;
+            }
+            bytes_written += n;
+
+            // Skips the fully written iovecs, and adjusts the partially written one.
+            while (n != 0 && n >= pending.front().iov_len) {
+                n -= pending.front().iov_len;
+                pending = pending.subspan(1);
+            }
+            if (n != 0) {
+                pending.front().iov_base = static_cast<char*>(pending.front().iov_base) + n;
+                pending.front().iov_len -= n;
+            }
         }
         if (error) {
             LOG(ERROR) << "writev or send:" << error.message();
@@ -107,17 +229,49 @@ Task<void> Client::Process(RingExecutor* dss_executor) {
         if (bytes_written == 0) {
             break;
         }
-        manager_->Stats().UpdateOutputBufferSize(output_buffer_.Capacity());
+        const auto sent = std::chrono::steady_clock::now();
+        manager_->RecordLatency(handle_, LatencyStage::kSend, sent - send_start);
+        manager_->RecordLatency(handle_, LatencyStage::kTotal, sent - batch_start);
+        manager_->Stats().UpdateOutputBufferSize(reply_writer_.Capacity());
         manager_->Stats().net_output_bytes.fetch_add(bytes_written, std::memory_order_relaxed);
+        conn_->GetExecutor()->Load().net_output_bytes.fetch_add(
+          bytes_written, std::memory_order_relaxed);
         ResetState();
+
+        // Between batches with nothing received pending, the client might move to a less loaded
+        // executor.
+        if (needs_recv && query_buffer_.NumWritten() == 0) {
+            auto* target = manager_->Placement().MigrationTarget(conn_->GetExecutor());
+            if (target != nullptr && co_await conn_->StopRecv()) {
+                manager_->RemoveClient(this);
+                conn_->Release();
+                co_await ResumeOn(target);
+                conn_->Setup(target, conn_->UseRingBuf());
+                manager_->AttachClient(this);
+                manager_->Stats().migrations.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
     }
-    manager_->RemoveClient(conn_.get());
+    conn_->PutBufferView(std::move(buffer_view));
+    manager_->RemoveClient(this);
     conn_->Close();
     OnConnectionClose();
 }
 
+void Client::Kill() {
+    conn_->Shutdown();
+    killed_.store(true);
+    const auto shard = blocked_shard_.load();
+    if (shard == kNotBlocked) {
+        return;
+    }
+    // The client might be woken before the unblocking runs, which then finds nothing by the id.
+    (*shards_)[shard].executor->Schedule(
+      [service = (*shards_)[shard].service, id = handle_.id]() { service->Unblock(id); });
+}
+
 void Client::Close() {
-    manager_->RemoveClient(conn_.get());
+    manager_->RemoveClient(this);
     conn_->Close();
     OnConnectionClose();
 }
@@ -127,22 +281,65 @@ void Client::EnsureBuffer() {
         return;
     }
 
-    // If 'query_buffer_' gets expanded, it's current data is moved to new memory location.
-    // If parser holds partial result view over the original memory of 'query_buffer_', it
-    // should be updated.
-    const auto data_start = query_buffer_.EnsureAvailable(
+    // Parser never holds partial result over 'query_buffer_' across recv, since a partial query
+    // is parsed again from its start, so the expansion doesn't invalidate anything.
+    query_buffer_.EnsureAvailable(
       kIOGenericBufferSize, query_buffer_.Capacity() < kIOGenericBufferSize);
-    if (data_start != nullptr && mbulk_parser_ != nullptr && mbulk_parser_->InProgress()) {
-        mbulk_parser_->BufferUpdate(data_start, query_buffer_.Start(), arguments_);
-    }
     manager_->Stats().UpdateInputBufferSize(query_buffer_.Capacity());
 }
 
+void Client::ParseBatch() {
+    const auto batch_size = shards_->front().service->GetConfig()->command_batch_size;
+    while (num_queries_ < batch_size && query_buffer_.NumWritten() != 0) {
+        if (num_queries_ == queries_.size()) {
+            queries_.emplace_back();
+            query_results_.emplace_back();
+        }
+        auto& query = queries_[num_queries_];
+        const auto pending = query_buffer_.NumWritten();
+        const bool is_mbulk = query_buffer_.Source().front() == '*';
+        const auto parse_result = detail::Parse(
+          query_buffer_, mbulk_parser_, query.arguments, query.num_arguments);
+        switch (parse_result) {
+        case ParserState::kDone: {
+            const auto* command = shards_->front().service->FindCommand(query.arguments[0]);
+            ++num_queries_;
+            if (command != nullptr && command->IsBlocking()) {
+                ends_with_blocking_ = true;
+                return;
+            }
+            continue;
+        }
+        case ParserState::kError:
+            query_results_[num_queries_++].SetError(Error::kProtocol);
+            protocol_error_ = true;
+            return;
+        case ParserState::kInit:
+        case ParserState::kParsing:
+            break;
+        }
+
+        const auto consumed = pending - query_buffer_.NumWritten();
+        if (!is_mbulk && consumed != 0) {
+            // Empty inline query is skipped.
+            continue;
+        }
+        query_buffer_.Rewind(consumed);
+        if (is_mbulk) {
+            mbulk_parser_->Reset();
+        }
+        return;
+    }
+}
+
 void Client::ResetState() {
-    query_buffer_.Reset();
-    output_buffer_.Reset();
-    query_result_.Reset();
-    iovecs_.clear();
+    reply_writer_.Reset();
+    for (size_t i = 0; i < num_queries_; ++i) {
+        query_results_[i].Reset();
+    }
+    num_queries_ = 0;
+    protocol_error_ = false;
+    ends_with_blocking_ = false;
 }
 
 } // namespace rdss
@@ -2,32 +2,54 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include "client_manager.h"
 #include "io/connection.h"
 #include "io/promise.h"
+#include "resp/replier.h"
 #include "resp/resp_parser.h"
 #include "resp/result.h"
+#include "service/sharding.h"
 
-namespace rdss {
+#include <atomic>
 
-class ClientManager;
-class DataStructureService;
-class RingExecutor;
+namespace rdss {
 
 class Client {
 public:
-    explicit Client(Connection* conn, ClientManager* manager, DataStructureService* service);
+    explicit Client(Connection* conn, ClientManager* manager, const DataShards* shards);
 
-    Task<void> Process(RingExecutor* dss_executor);
+    Task<void> Process();
 
     void Close();
 
+    /// Shuts down the connection, so that Process() finishes once it notices, and unblocks the
+    /// client if it's blocked by a command. Should be called on the connection's executor.
+    void Kill();
+
+    Connection* GetConnection() { return conn_.get(); }
+
+    ClientHandle& Handle() { return handle_; }
+
+    const ClientHandle& Handle() const { return handle_; }
+
 private:
+    // Arguments of a parsed query, viewing over 'query_buffer_'.
+    struct Query {
+        StringViews arguments;
+        size_t num_arguments{0};
+    };
+
     // If 'query_buffer_' is not virtual view, ensure it has enough space for the upcoming recv.
-    // Also, if it gets expansion that changes its location, optionally updates existing
-    // 'arguments_' to reflext the change.
     void EnsureBuffer();
 
-    // Resets state between queries.
+    // Parses complete queries in 'query_buffer_' into 'queries_' until the buffer is drained, a
+    // partial query or a blocking command is met, or 'command_batch_size' queries are parsed. A partial query is left
+    // unconsumed in 'query_buffer_' and will be parsed from its start once more data arrives. If
+    // a protocol error is met, the error is set to the result of the last query in the batch and
+    // 'protocol_error_' is set.
+    void ParseBatch();
+
+    // Resets state between batches of queries.
     void ResetState();
 
     void OnConnectionClose() { delete this; }
@@ -37,30 +59,49 @@ private:
 
     ClientManager* const manager_;
 
-    DataStructureService* const service_;
+    // Set by 'manager_' when the client is registered.
+    ClientHandle handle_;
+
+    const DataShards* const shards_;
+
+    // Routes the queries of a batch to the data shards.
+    ShardedBatch sharded_batch_;
 
     // Might expand before each call to recv() to ensure at least 'kIOGenericBufferSize'(16KB)
     // available. Should be reset after each round of serving to reclaim buffer space.
     Buffer query_buffer_;
 
-    Buffer output_buffer_;
+    // Replies of a batch are gathered into it. For a long raw string, e.g. "$100\r\n...\r\n", the
+    // header and the CRLF are copied while the value is referenced from the string in 'Result', so
+    // 'query_results_' are kept until the replies are sent.
+    ReplyWriter reply_writer_;
 
-    // View of parsed arguments over 'query_buffer_'. We don't clear it after round of serving to
-    // avoid memory gets reclaim / allocate over the turns of serving.
+    // Parsed queries of the current batch, the first 'num_queries_' are valid. We don't clear
+    // them after round of serving to avoid memory gets reclaim / allocate over the turns of
+    // serving.
     // TODO: Clear it if memory gets tight.
-    StringViews arguments_;
+    std::vector<Query> queries_;
+
+    // Results of the queries of the current batch, one for each of 'queries_'.
+    std::vector<Result> query_results_;
+
+    size_t num_queries_{0};
+
+    bool protocol_error_{false};
+
+    // If the last query of the batch is a blocking command, which is executed after the queries
+    // before it, while the ones after it wait for the next batch.
+    bool ends_with_blocking_{false};
+
+    // Index of the data shard that the client is blocked on, read by Kill() from the connection's
+    // executor.
+    static constexpr size_t kNotBlocked = static_cast<size_t>(-1);
+    std::atomic<size_t> blocked_shard_{kNotBlocked};
+    std::atomic<bool> killed_{false};
 
     // Lazily created multi-bulk parser. If it's in error/done state, it will automatically reset
     // upon new call to Parse().
     std::unique_ptr<MultiBulkParser> mbulk_parser_{nullptr};
-
-    Result query_result_;
-
-    // For output string/string array, that is, when reply is like "$6\r\nFOOBAR\r\n", there are 3
-    // iovecs_, first being view over "$6\r\n" in 'output_buffer_', second being view over value
-    // string shared_ptr in 'Result', the last being "\r\n" that references the same CRLF in the
-    // first iovec.
-    std::vector<iovec> iovecs_;
 };
 
 } // namespace rdss
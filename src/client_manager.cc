@@ -4,34 +4,213 @@
 
 #include "client.h"
 #include "io/connection.h"
+#include "runtime/ring_executor.h"
+
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cassert>
 
 namespace rdss {
 
-namespace detail {
+namespace {
+
+int64_t NowInSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns the IPv4 address and port of the peer of 'fd' packed into 48 bits, or 0 if unknown.
+uint64_t PeerOf(int fd) {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    if (
+      getpeername(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0
+      || addr.sin_family != AF_INET) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(ntohl(addr.sin_addr.s_addr)) << 16) | ntohs(addr.sin_port);
+}
+
+} // namespace
+
+std::string_view LatencyStageName(LatencyStage stage) {
+    switch (stage) {
+    case LatencyStage::kQueue:
+        return "queue";
+    case LatencyStage::kHop:
+        return "hop";
+    case LatencyStage::kExecute:
+        return "execute";
+    case LatencyStage::kSend:
+        return "send";
+    case LatencyStage::kTotal:
+        return "total";
+    }
+    return "unknown";
+}
+
+void ClientManager::Init(const std::vector<RingExecutor*>& executors, size_t capacity) {
+    capacity_ = capacity;
+    for (auto* exr : executors) {
+        auto registry = std::make_unique<Registry>();
+        registry->executor = exr;
+        registry->slots = std::make_unique<Slot[]>(capacity);
+        registry->free_slots.reserve(capacity);
+        // Slots of lower indexes are taken first, which keeps the scanned part of the array short.
+        for (size_t i = capacity; i > 0; --i) {
+            registry->free_slots.push_back(static_cast<uint32_t>(i - 1));
+        }
+        registries_.push_back(std::move(registry));
+    }
+}
+
+Client* ClientManager::AddClient(Connection* conn, const DataShards* shards) {
+    auto* client = new Client(conn, this, shards);
+    Register(client, next_id_.fetch_add(1, std::memory_order_relaxed), NowInSeconds());
+    return client;
+}
+
+void ClientManager::RemoveClient(Client* client) {
+    const auto& handle = client->Handle();
+    auto& registry = *registries_[handle.registry];
+    assert(registry.slots[handle.slot].client.load(std::memory_order_relaxed) == client);
+    registry.slots[handle.slot].client.store(nullptr, std::memory_order_release);
+    registry.free_slots.push_back(handle.slot);
+    // Only the executor's thread writes it.
+    registry.num_clients.store(
+      registry.num_clients.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+void ClientManager::AttachClient(Client* client) {
+    Register(client, client->Handle().id, client->Handle().created);
+}
+
+void ClientManager::Touch(const Client* client) {
+    const auto& handle = client->Handle();
+    registries_[handle.registry]->slots[handle.slot].last_interaction.store(
+      NowInSeconds(), std::memory_order_relaxed);
+}
+
+size_t ClientManager::ActiveClients() const {
+    size_t result{0};
+    for (const auto& registry : registries_) {
+        result += registry->num_clients.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+LatencyHistogram::Snapshot ClientManager::Latency(LatencyStage stage) const {
+    LatencyHistogram::Snapshot snapshot;
+    for (const auto& registry : registries_) {
+        registry->latency[static_cast<size_t>(stage)].AddTo(snapshot);
+    }
+    return snapshot;
+}
+
+void ClientManager::ForEachClient(const std::function<void(const ClientInfo&)>& func) const {
+    const auto now = NowInSeconds();
+    for (size_t r = 0; r < registries_.size(); ++r) {
+        const auto& registry = *registries_[r];
+        const auto num_used = registry.num_used.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < num_used; ++i) {
+            const auto& slot = registry.slots[i];
+            if (slot.client.load(std::memory_order_acquire) == nullptr) {
+                continue;
+            }
+            func(InfoOf(slot, r, now));
+        }
+    }
+}
+
+size_t ClientManager::KillClients(const std::function<bool(const ClientInfo&)>& predicate) {
+    const auto now = NowInSeconds();
+    size_t killed{0};
+    for (size_t r = 0; r < registries_.size(); ++r) {
+        auto* registry = registries_[r].get();
+        const auto num_used = registry->num_used.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < num_used; ++i) {
+            auto* slot = &registry->slots[i];
+            if (slot->client.load(std::memory_order_acquire) == nullptr) {
+                continue;
+            }
+            const auto info = InfoOf(*slot, r, now);
+            if (!predicate(info)) {
+                continue;
+            }
+            ++killed;
+            // The slot might have been taken by another client by then, which is told by the id.
+            registry->executor->Schedule([slot, id = info.id]() {
+                auto* client = slot->client.load(std::memory_order_relaxed);
+                if (client != nullptr && slot->id.load(std::memory_order_relaxed) == id) {
+                    client->Kill();
+                }
+            });
+        }
+    }
+    return killed;
+}
 
-size_t ConnectionToIndex(Connection* conn) { return static_cast<size_t>(conn->GetFD()) - 1; }
+void ClientManager::CloseAll() {
+    for (auto& registry : registries_) {
+        const auto num_used = registry->num_used.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < num_used; ++i) {
+            auto* client = registry->slots[i].client.load(std::memory_order_relaxed);
+            if (client != nullptr) {
+                client->Close();
+            }
+        }
+    }
+}
 
-} // namespace detail
+void ClientManager::Register(Client* client, uint64_t id, int64_t created) {
+    auto* conn = client->GetConnection();
+    const auto r = RegistryOf(conn->GetExecutor());
+    auto& registry = *registries_[r];
+    if (registry.free_slots.empty()) {
+        LOG(FATAL) << "Client registry is full, capacity:" << capacity_;
+    }
+    const auto index = registry.free_slots.back();
+    registry.free_slots.pop_back();
 
-Client* ClientManager::AddClient(Connection* conn, DataStructureService* service) {
-    const size_t index = detail::ConnectionToIndex(conn);
-    if (index >= clients_.size()) {
-        std::lock_guard l(mu_);
-        clients_.resize(2 * index);
+    auto& slot = registry.slots[index];
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.peer.store(PeerOf(conn->GetFD()), std::memory_order_relaxed);
+    slot.fd.store(conn->GetFD(), std::memory_order_relaxed);
+    slot.created.store(created, std::memory_order_relaxed);
+    slot.last_interaction.store(NowInSeconds(), std::memory_order_relaxed);
+    slot.client.store(client, std::memory_order_release);
+    if (index >= registry.num_used.load(std::memory_order_relaxed)) {
+        registry.num_used.store(index + 1, std::memory_order_release);
     }
-    assert(clients_[index] == nullptr);
+    registry.num_clients.store(
+      registry.num_clients.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
-    active_clients_.fetch_add(1);
-    clients_[index] = new Client(conn, this, service);
-    return clients_[index];
+    client->Handle() = ClientHandle{.id = id, .registry = r, .slot = index, .created = created};
+}
+
+size_t ClientManager::RegistryOf(RingExecutor* executor) const {
+    for (size_t i = 0; i < registries_.size(); ++i) {
+        if (registries_[i]->executor == executor) {
+            return i;
+        }
+    }
+    LOG(FATAL) << "Executor without client registry";
 }
 
-void ClientManager::RemoveClient(Connection* conn) {
-    std::lock_guard l(mu_);
-    const size_t index = detail::ConnectionToIndex(conn);
-    assert(clients_.size() > index && clients_[index] != nullptr);
-    clients_[index] = nullptr;
-    active_clients_.fetch_sub(1, std::memory_order_release);
+ClientInfo ClientManager::InfoOf(const Slot& slot, size_t registry, int64_t now) const {
+    const auto peer = slot.peer.load(std::memory_order_relaxed);
+    return ClientInfo{
+      .id = slot.id.load(std::memory_order_relaxed),
+      .ip = static_cast<uint32_t>(peer >> 16),
+      .port = static_cast<uint16_t>(peer & 0xFFFF),
+      .fd = slot.fd.load(std::memory_order_relaxed),
+      .age = std::chrono::seconds{now - slot.created.load(std::memory_order_relaxed)},
+      .idle = std::chrono::seconds{now - slot.last_interaction.load(std::memory_order_relaxed)},
+      .executor = registry};
 }
 
 void ClientStats::UpdateInputBufferSize(uint64_t s) {
@@ -2,44 +2,161 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include "base/latency_histogram.h"
+#include "client_placement.h"
+#include "service/sharding.h"
+
+#include <array>
 #include <atomic>
-#include <mutex>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 namespace rdss {
 
 class Client;
 class Connection;
-class DataStructureService;
+class RingExecutor;
 
 struct ClientStats {
     std::atomic<uint64_t> max_input_buffer{};
     std::atomic<uint64_t> max_output_buffer{};
     std::atomic<uint64_t> net_input_bytes{};
     std::atomic<uint64_t> net_output_bytes{};
+    // Clients moved to another executor by 'ClientPlacement'.
+    std::atomic<uint64_t> migrations{};
 
     void UpdateInputBufferSize(uint64_t s);
     void UpdateOutputBufferSize(uint64_t s);
 };
 
+/// Stages of serving a batch of queries, whose latencies are recorded per client executor.
+enum class LatencyStage : uint8_t {
+    kQueue,   // From the executor picking up the received queries to the client parsing them.
+    kHop,     // Moving between the client executor and the data shards.
+    kExecute, // Executing on the data shards, including waiting for the append only file sync.
+    kSend,    // Sending the replies.
+    kTotal,   // From the executor picking up the received queries to the replies sent.
+};
+
+constexpr size_t kNumLatencyStages = 5;
+
+std::string_view LatencyStageName(LatencyStage stage);
+
+/// Where a client is registered, kept by the client so that it's removed in O(1).
+struct ClientHandle {
+    uint64_t id{0};
+    size_t registry{0};
+    uint32_t slot{0};
+    // Steady clock time the client is created, in seconds.
+    int64_t created{0};
+};
+
+/// Snapshot of a client for CLIENT LIST / KILL. The fields are read without synchronizing with the
+/// client, so they might be slightly stale.
+struct ClientInfo {
+    uint64_t id;
+    // IPv4 address and port of the peer, in host byte order.
+    uint32_t ip;
+    uint16_t port;
+    int fd;
+    std::chrono::seconds age;
+    std::chrono::seconds idle;
+    // Index of the client executor serving the client.
+    size_t executor;
+};
+
+/// Keeps the clients in one registry per client executor, which is only modified by the executor's
+/// worker thread, so adding and removing a client takes neither lock nor atomic read-modify-write
+/// of shared memory. A registry is a fixed array of slots with a free list, whose slots are never
+/// freed, so that other threads can read them any time for INFO and CLIENT commands.
 class ClientManager {
 public:
-    Client* AddClient(Connection* conn, DataStructureService* service);
+    /// Creates a registry for each of 'executors', holding up to 'capacity' clients. Should be
+    /// called before any client is added.
+    void Init(const std::vector<RingExecutor*>& executors, size_t capacity);
+
+    /// Creates a client of 'conn' and registers it to the registry of the connection's executor.
+    /// Should be called on that executor.
+    Client* AddClient(Connection* conn, const DataShards* shards);
+
+    /// Unregisters 'client'. Should be called on the client's executor, or once the executors have
+    /// stopped.
+    void RemoveClient(Client* client);
+
+    /// Registers 'client' removed by RemoveClient() again, to the registry of its connection's
+    /// current executor, keeping its id and age. Used to move the client to another executor.
+    void AttachClient(Client* client);
 
-    void RemoveClient(Connection* conn);
+    /// Records the last interaction of 'client', reported as its idle time.
+    void Touch(const Client* client);
 
-    std::vector<Client*>& GetClients() { return clients_; }
+    size_t ActiveClients() const;
 
-    size_t ActiveClients() const { return active_clients_.load(); }
+    /// Calls 'func' with every registered client. Thread-safe.
+    void ForEachClient(const std::function<void(const ClientInfo&)>& func) const;
+
+    /// Closes the connections of the clients 'predicate' returns true for, on their executors.
+    /// Returns the number of them. Thread-safe.
+    size_t KillClients(const std::function<bool(const ClientInfo&)>& predicate);
+
+    /// Closes and deletes all the clients. Should be called once the executors have stopped.
+    void CloseAll();
+
+    /// Records 'duration' of 'stage' of serving the client of 'handle'. Should be called on the
+    /// client's executor.
+    void RecordLatency(
+      const ClientHandle& handle,
+      LatencyStage stage,
+      std::chrono::steady_clock::duration duration) {
+        registries_[handle.registry]->latency[static_cast<size_t>(stage)].Record(duration);
+    }
+
+    /// Returns the latencies of 'stage' on all the executors. Thread-safe.
+    LatencyHistogram::Snapshot Latency(LatencyStage stage) const;
 
     ClientStats& Stats() { return stats_; }
 
+    ClientPlacement& Placement() { return placement_; }
+
 private:
-    std::mutex mu_;
-    std::vector<Client*> clients_;
-    std::atomic<size_t> active_clients_{0};
+    struct Slot {
+        // Set last when the slot is taken, and reset when it's freed.
+        std::atomic<Client*> client{nullptr};
+        std::atomic<uint64_t> id{0};
+        std::atomic<uint64_t> peer{0};
+        std::atomic<int> fd{-1};
+        std::atomic<int64_t> created{0};
+        std::atomic<int64_t> last_interaction{0};
+    };
+
+    struct Registry {
+        RingExecutor* executor;
+        std::unique_ptr<Slot[]> slots;
+        // Slots at and after this were never taken.
+        std::atomic<uint32_t> num_used{0};
+        std::vector<uint32_t> free_slots;
+        std::atomic<size_t> num_clients{0};
+        std::array<LatencyHistogram, kNumLatencyStages> latency;
+    };
+
+    // Takes a free slot of the registry of the executor of 'client's connection for it, fills the
+    // slot and 'client's handle.
+    void Register(Client* client, uint64_t id, int64_t created);
+
+    size_t RegistryOf(RingExecutor* executor) const;
+
+    ClientInfo InfoOf(const Slot& slot, size_t registry, int64_t now) const;
+
+    std::vector<std::unique_ptr<Registry>> registries_;
+    size_t capacity_{0};
+    std::atomic<uint64_t> next_id_{1};
 
     ClientStats stats_;
+
+    ClientPlacement placement_;
 };
 
 } // namespace rdss
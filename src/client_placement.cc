@@ -0,0 +1,102 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "client_placement.h"
+
+#include "runtime/ring_executor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace rdss {
+
+void ClientPlacement::Init(
+  std::vector<RingExecutor*> executors,
+  ClientPlacementPolicy policy,
+  uint32_t migration_threshold) {
+    executors_ = std::move(executors);
+    policy_ = policy;
+    if (policy == ClientPlacementPolicy::kLeastLoaded) {
+        migration_threshold_ = migration_threshold;
+    }
+    last_migrations_ = std::make_unique<std::atomic<int64_t>[]>(executors_.size());
+}
+
+RingExecutor* ClientPlacement::Place() {
+    assert(!executors_.empty());
+    if (policy_ == ClientPlacementPolicy::kRoundRobin) {
+        return executors_[next_.fetch_add(1, std::memory_order_relaxed) % executors_.size()];
+    }
+    const auto loads = CollectLoads();
+    return executors_[LeastLoaded(loads)];
+}
+
+RingExecutor* ClientPlacement::MigrationTarget(RingExecutor* from) {
+    if (migration_threshold_ == 0) {
+        return nullptr;
+    }
+    // Most of the time the executor isn't busy enough to move anything, which is told without
+    // looking at the others.
+    const auto& from_load = from->Load();
+    if (
+      from_load.busy_permille.load(std::memory_order_relaxed) < migration_threshold_
+      || from_load.connections.load(std::memory_order_relaxed) < 2) {
+        return nullptr;
+    }
+
+    const auto loads = CollectLoads();
+    const auto to = LeastLoaded(loads);
+    const auto from_index = static_cast<size_t>(
+      std::find(executors_.begin(), executors_.end(), from) - executors_.begin());
+    assert(from_index < executors_.size());
+    if (
+      to == from_index
+      || loads[from_index].busy_permille < loads[to].busy_permille + migration_threshold_) {
+        return nullptr;
+    }
+
+    const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+    const auto window = std::chrono::nanoseconds{RingExecutor::kLoadWindow}.count();
+    auto& last = last_migrations_[from_index];
+    auto last_migration = last.load(std::memory_order_relaxed);
+    if (
+      now - last_migration < window
+      || !last.compare_exchange_strong(last_migration, now, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return executors_[to];
+}
+
+// static
+size_t ClientPlacement::LeastLoaded(std::span<const Load> loads) {
+    assert(!loads.empty());
+    uint32_t min_busy = loads[0].busy_permille;
+    for (const auto& load : loads) {
+        min_busy = std::min(min_busy, load.busy_permille);
+    }
+    size_t result = loads.size();
+    for (size_t i = 0; i < loads.size(); ++i) {
+        if (loads[i].busy_permille > min_busy + kBusyTolerance) {
+            continue;
+        }
+        if (result == loads.size() || loads[i].connections < loads[result].connections) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+std::vector<ClientPlacement::Load> ClientPlacement::CollectLoads() const {
+    std::vector<Load> loads;
+    loads.reserve(executors_.size());
+    for (const auto* exr : executors_) {
+        loads.push_back(
+          {.busy_permille = exr->Load().busy_permille.load(std::memory_order_relaxed),
+           .connections = exr->Load().connections.load(std::memory_order_relaxed)});
+    }
+    return loads;
+}
+
+} // namespace rdss
@@ -0,0 +1,64 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "base/config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace rdss {
+
+class RingExecutor;
+
+/// Chooses the client executor serving a connection, by the load the executors publish in
+/// 'RingExecutor::LoadStats'. With kLeastLoaded, a new connection goes to the least loaded
+/// executor, and a connection of an executor that is much busier than the least loaded one is
+/// moved there between its batches, one connection per executor every 'kLoadWindow'.
+class ClientPlacement {
+public:
+    struct Load {
+        uint32_t busy_permille;
+        uint32_t connections;
+    };
+
+    /// Busy times within this many per mille are considered equal, so that the connections are
+    /// spread evenly over the executors that are equally idle.
+    static constexpr uint32_t kBusyTolerance = 50;
+
+    /// Should be called before any connection is placed. 'migration_threshold' of 0 disables the
+    /// migration.
+    void Init(
+      std::vector<RingExecutor*> executors,
+      ClientPlacementPolicy policy,
+      uint32_t migration_threshold);
+
+    /// Returns the executor to serve a new connection. Thread-safe.
+    RingExecutor* Place();
+
+    /// Returns the executor that a connection served by 'from' should move to, or nullptr if it
+    /// should stay. A non-null result is returned at most once per 'kLoadWindow' for each 'from'.
+    /// Thread-safe.
+    RingExecutor* MigrationTarget(RingExecutor* from);
+
+    const std::vector<RingExecutor*>& Executors() const { return executors_; }
+
+    /// Returns the index of the least loaded of 'loads': the least busy one, or the one with the
+    /// fewest connections among those within 'kBusyTolerance' of it. 'loads' shouldn't be empty.
+    static size_t LeastLoaded(std::span<const Load> loads);
+
+private:
+    std::vector<Load> CollectLoads() const;
+
+    std::vector<RingExecutor*> executors_;
+    ClientPlacementPolicy policy_{ClientPlacementPolicy::kRoundRobin};
+    uint32_t migration_threshold_{0};
+    std::atomic<size_t> next_{0};
+    // Steady clock time of the last migration from each executor, in nanoseconds.
+    std::unique_ptr<std::atomic<int64_t>[]> last_migrations_;
+};
+
+} // namespace rdss
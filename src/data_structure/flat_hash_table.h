@@ -0,0 +1,565 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "base/memory.h"
+#include "data_structure/hash_table.h"
+
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <xxhash.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace rdss::detail {
+
+// Control bytes of the slots. A full slot stores the low 7 bits of its key's hash, so the high bit
+// is clear; an empty or deleted slot has the high bit set.
+constexpr int8_t kCtrlEmpty = static_cast<int8_t>(0b10000000);
+constexpr int8_t kCtrlDeleted = static_cast<int8_t>(0b11111110);
+constexpr size_t kGroupWidth = 16;
+
+// A group of 'kGroupWidth' control bytes that are matched at once. The match results are bitmasks
+// whose i-th bit is set if the i-th slot matches.
+class CtrlGroup {
+public:
+#ifdef __SSE2__
+    explicit CtrlGroup(const int8_t* ctrl)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+    uint32_t Match(int8_t h2) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+    }
+
+    uint32_t MatchEmpty() const { return Match(kCtrlEmpty); }
+
+    uint32_t MatchEmptyOrDeleted() const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl_));
+    }
+
+private:
+    __m128i ctrl_;
+#else
+    explicit CtrlGroup(const int8_t* ctrl) { std::memcpy(ctrl_, ctrl, kGroupWidth); }
+
+    uint32_t Match(int8_t h2) const {
+        uint32_t mask{0};
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32_t MatchEmpty() const { return Match(kCtrlEmpty); }
+
+    uint32_t MatchEmptyOrDeleted() const {
+        uint32_t mask{0};
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+        }
+        return mask;
+    }
+
+private:
+    int8_t ctrl_[kGroupWidth];
+#endif
+};
+
+} // namespace rdss::detail
+
+namespace rdss {
+
+/// Entry of FlatHashTable. The key bytes are stored right after the entry in the same allocation,
+/// so that comparing the key doesn't need another pointer chasing.
+template<typename ValueType, typename Allocator>
+class FlatHashTableEntry {
+public:
+    using Pointer = FlatHashTableEntry*;
+    using LastAccessTimeDuration = std::chrono::duration<uint32_t, std::milli>;
+    using LastAccessTimePoint
+      = std::chrono::time_point<std::chrono::steady_clock, LastAccessTimeDuration>;
+    using CharAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<char>;
+
+public:
+    static Pointer Create(std::string_view key) {
+        auto* mem = CharAllocator().allocate(AllocationSize(key.size()));
+        auto* entry = new (mem) FlatHashTableEntry(key);
+        std::memcpy(entry->KeyData(), key.data(), key.size());
+        return entry;
+    }
+
+    static void Destroy(Pointer entry) {
+        const auto size = AllocationSize(entry->key_size_);
+        entry->~FlatHashTableEntry();
+        CharAllocator().deallocate(reinterpret_cast<char*>(entry), size);
+    }
+
+    std::string_view Key() const { return {KeyData(), key_size_}; }
+
+    bool KeyEquals(std::string_view key) const {
+        return key.size() == key_size_ && std::memcmp(KeyData(), key.data(), key_size_) == 0;
+    }
+
+    void SetLRU(LastAccessTimePoint lru) { lru_ = lru; }
+
+    LastAccessTimePoint GetLRU() const { return lru_; }
+
+    ValueType value{};
+
+private:
+    explicit FlatHashTableEntry(std::string_view key)
+      : key_size_(static_cast<uint32_t>(key.size())) {}
+
+    ~FlatHashTableEntry() = default;
+
+    static size_t AllocationSize(size_t key_size) { return sizeof(FlatHashTableEntry) + key_size; }
+
+    char* KeyData() { return reinterpret_cast<char*>(this + 1); }
+
+    const char* KeyData() const { return reinterpret_cast<const char*>(this + 1); }
+
+    LastAccessTimePoint lru_;
+    uint32_t key_size_;
+};
+
+/// Open-addressing hash table in the Swiss table layout. Slots are divided into groups of 16, each
+/// slot has a control byte telling if it's empty, deleted, or full with 7 bits of the key's hash.
+/// A lookup probes the groups quadratically, matching the control bytes of a group with SIMD, and
+/// only compares the keys of the slots whose hash bits match. Entries are allocated separately so
+/// that they are not moved upon growth, and pointers to them stay valid until erased.
+/// The table grows with incremental rehashing like HashTable: a larger table is created, and groups
+/// of the old table are migrated over the following operations, or by RehashSome().
+template<typename ValueType, typename Allocator = Mallocator<ValueType>>
+class FlatHashTable {
+public:
+    using EntryType = FlatHashTableEntry<ValueType, Allocator>;
+    using EntryPointer = EntryType::Pointer;
+
+private:
+    using CtrlAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<int8_t>;
+    using SlotAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<EntryPointer>;
+
+    struct Table {
+        std::vector<int8_t, CtrlAllocator> ctrl;
+        std::vector<EntryPointer, SlotAllocator> slots;
+        size_t size{0};
+        // Number of empty slots that can be filled before reaching the max load factor.
+        size_t growth_left{0};
+
+        size_t Capacity() const { return ctrl.size(); }
+
+        size_t NumGroups() const { return ctrl.size() / detail::kGroupWidth; }
+
+        void Resize(size_t capacity) {
+            assert(capacity % detail::kGroupWidth == 0);
+            ctrl.assign(capacity, detail::kCtrlEmpty);
+            slots.assign(capacity, nullptr);
+            size = 0;
+            growth_left = capacity - capacity / 8;
+        }
+
+        void Release() {
+            decltype(ctrl)().swap(ctrl);
+            decltype(slots)().swap(slots);
+            size = 0;
+            growth_left = 0;
+        }
+    };
+
+    static constexpr size_t kInitCapacity = detail::kGroupWidth;
+
+public:
+    FlatHashTable() = default;
+
+    FlatHashTable(const FlatHashTable&) = delete;
+    FlatHashTable& operator=(const FlatHashTable&) = delete;
+
+    ~FlatHashTable() { Clear(); }
+
+    /// Searches for entry with 'key' in the table, and if 'create_on_missing' is set, creates entry
+    /// if no such entry is found. Returns {entry of 'key', if entry already exists}.
+    std::pair<EntryPointer, bool> FindOrCreate(std::string_view key, bool create_on_missing) {
+        if (Count() == 0 && !create_on_missing) {
+            return {nullptr, false};
+        }
+        if (IsRehashing()) {
+            RehashSome(1);
+        }
+
+        const auto hash = Hash(key);
+        if (IsRehashing()) {
+            if (auto* entry = FindInTable(tables_[0], hash, key); entry != nullptr) {
+                return {entry, true};
+            }
+        }
+        auto& table = ActiveTable();
+        if (auto* entry = FindInTable(table, hash, key); entry != nullptr) {
+            return {entry, true};
+        }
+        if (!create_on_missing) {
+            return {nullptr, false};
+        }
+
+        Expand();
+        auto* entry = EntryType::Create(key);
+        InsertToTable(ActiveTable(), hash, entry);
+        ++entries_;
+        return {entry, false};
+    }
+
+    /// Insert if 'key' not exists. Returns {entry of 'key', inserted}.
+    std::pair<EntryPointer, bool> Insert(std::string_view key, ValueType value) {
+        auto [entry, exists] = FindOrCreate(key, true);
+        if (!exists) {
+            entry->value = std::move(value);
+        }
+        return {entry, !exists};
+    }
+
+    /// Insert if 'key' not exists, overwrite if exists. Returns {entry of 'key', overwritten}.
+    std::pair<EntryPointer, bool> Upsert(std::string_view key, ValueType value) {
+        auto [entry, exists] = FindOrCreate(key, true);
+        entry->value = std::move(value);
+        return {entry, exists};
+    }
+
+    EntryPointer Find(std::string_view key) {
+        auto [entry, _] = FindOrCreate(key, false);
+        return entry;
+    }
+
+    bool Erase(std::string_view key) {
+        if (Count() == 0) {
+            return false;
+        }
+        if (IsRehashing()) {
+            RehashSome(1);
+        }
+
+        const auto hash = Hash(key);
+        for (size_t i = 0; i < 2; ++i) {
+            auto& table = tables_[i];
+            if (table.size == 0) {
+                continue;
+            }
+            const auto slot = FindSlot(table, hash, key);
+            if (slot == table.Capacity()) {
+                continue;
+            }
+            auto* entry = table.slots[slot];
+            EraseSlot(table, slot);
+            EntryType::Destroy(entry);
+            --entries_;
+            return true;
+        }
+        return false;
+    }
+
+    /// Returns a random entry, nullptr if the table is empty. The entries next to empty slots are
+    /// more likely to be returned.
+    EntryPointer GetRandomEntry() {
+        if (Count() == 0) {
+            return nullptr;
+        }
+
+        const auto rand = detail::Random();
+        auto* table = &tables_[0];
+        if (IsRehashing() && rand % Count() >= tables_[0].size) {
+            table = &tables_[1];
+        }
+        const auto capacity = table->Capacity();
+        const auto start = detail::Random() % capacity;
+        for (size_t i = 0; i < capacity; ++i) {
+            const auto slot = (start + i) % capacity;
+            if (table->ctrl[slot] >= 0) {
+                return table->slots[slot];
+            }
+        }
+        assert(false);
+        return nullptr;
+    }
+
+    size_t Count() const { return entries_; }
+
+    /// Returns the number of groups, which is the range of the cursor of TraverseBucket().
+    size_t BucketCount() const { return tables_[0].NumGroups(); }
+
+    size_t Capacity() const { return tables_[0].Capacity() + tables_[1].Capacity(); }
+
+    double LoadFactor() const {
+        if (Capacity() == 0) {
+            return 0;
+        }
+        return static_cast<double>(Count()) / static_cast<double>(Capacity());
+    }
+
+    void Clear() {
+        for (auto& table : tables_) {
+            for (size_t slot = 0; slot < table.Capacity(); ++slot) {
+                if (table.ctrl[slot] >= 0) {
+                    EntryType::Destroy(table.slots[slot]);
+                }
+            }
+            table.Release();
+        }
+        entries_ = 0;
+        rehash_index_ = -1;
+        rehash_paused_ = false;
+    }
+
+    bool IsRehashing() const { return (rehash_index_ >= 0); }
+
+    /// Calls 'func' on every entry of the group 'bucket_index', and returns the cursor of the next
+    /// group to traverse in the reverse binary order, which is 0 if all the groups have been
+    /// traversed. 'func' may erase the visited entry. Unlike HashTable, entries are not bound to
+    /// the group of their hash, so they are kept in place instead: a traversal starting at 0
+    /// finishes the rehashing in progress, and pauses rehashing until 0 is returned. The entries
+    /// inserted meanwhile go to a new table, which isn't traversed and grows on its own. So a
+    /// traversal visits every entry that exists all along exactly once. Starting a traversal ends
+    /// the one in progress, an abandoned one keeps rehashing paused until then.
+    size_t TraverseBucket(size_t bucket_index, auto func) {
+        if (bucket_index == 0) {
+            rehash_paused_ = false;
+            if (IsRehashing()) {
+                while (!RehashSome(tables_[0].NumGroups())) {
+                }
+            }
+            rehash_paused_ = true;
+        }
+        const auto num_groups = tables_[0].NumGroups();
+        if (num_groups == 0) {
+            rehash_paused_ = false;
+            return 0;
+        }
+        assert(bucket_index < num_groups);
+
+        TraverseGroup(tables_[0], bucket_index, func);
+        const auto next = detail::NextIndex(bucket_index, num_groups);
+        if (next == 0) {
+            rehash_paused_ = false;
+        }
+        return next;
+    }
+
+    /// Migrates 'groups_to_rehash' non-empty groups, or 10 * 'groups_to_rehash' groups of the old
+    /// table. Returns if rehashing has finished. If all the groups have been migrated, the new table
+    /// becomes the only table. Does nothing while a traversal pauses rehashing.
+    bool RehashSome(size_t groups_to_rehash) {
+        assert(IsRehashing());
+        assert(groups_to_rehash != 0);
+        if (rehash_paused_) {
+            return false;
+        }
+
+        auto& old_table = tables_[0];
+        auto empty_groups_allowed = groups_to_rehash * 10;
+        while (true) {
+            const auto moved = RehashGroup(static_cast<size_t>(rehash_index_));
+
+            if (++rehash_index_ == static_cast<int32_t>(old_table.NumGroups())) {
+                assert(old_table.size == 0);
+                rehash_index_ = -1;
+                old_table = std::move(tables_[1]);
+                tables_[1].Release();
+                return true;
+            }
+
+            if (moved == 0) {
+                if (--empty_groups_allowed == 0) {
+                    return false;
+                }
+            } else {
+                if (--groups_to_rehash == 0) {
+                    return false;
+                }
+            }
+        }
+    }
+
+private:
+    static uint64_t Hash(std::string_view key) { return XXH64(key.data(), key.size(), 0); }
+
+    static size_t H1(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+
+    static int8_t H2(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+    // New entries are inserted into the new table while rehashing.
+    Table& ActiveTable() { return IsRehashing() ? tables_[1] : tables_[0]; }
+
+    // Calls 'func(group)' on the groups of the probe sequence of 'hash' until it returns true.
+    template<typename Func>
+    static void Probe(const Table& table, uint64_t hash, Func func) {
+        const auto mask = table.NumGroups() - 1;
+        auto group = H1(hash) & mask;
+        for (size_t i = 1; i <= table.NumGroups(); ++i) {
+            if (func(group)) {
+                return;
+            }
+            group = (group + i) & mask;
+        }
+    }
+
+    // Returns the slot of 'key' in 'table', or the capacity of 'table' if not found.
+    static size_t FindSlot(const Table& table, uint64_t hash, std::string_view key) {
+        size_t result = table.Capacity();
+        if (table.Capacity() == 0) {
+            return result;
+        }
+        const auto h2 = H2(hash);
+        Probe(table, hash, [&](size_t group) {
+            const auto* ctrl = table.ctrl.data() + group * detail::kGroupWidth;
+            const detail::CtrlGroup g(ctrl);
+            for (auto match = g.Match(h2); match != 0; match &= match - 1) {
+                const auto slot = group * detail::kGroupWidth
+                                  + static_cast<size_t>(std::countr_zero(match));
+                if (table.slots[slot]->KeyEquals(key)) {
+                    result = slot;
+                    return true;
+                }
+            }
+            // A group having empty slot has never been full, so the probing stops here.
+            return g.MatchEmpty() != 0;
+        });
+        return result;
+    }
+
+    static EntryPointer FindInTable(const Table& table, uint64_t hash, std::string_view key) {
+        const auto slot = FindSlot(table, hash, key);
+        return (slot == table.Capacity()) ? nullptr : table.slots[slot];
+    }
+
+    // Inserts 'entry' which doesn't exist in 'table' to the first empty or deleted slot of its probe
+    // sequence.
+    static void InsertToTable(Table& table, uint64_t hash, EntryPointer entry) {
+        Probe(table, hash, [&](size_t group) {
+            auto* ctrl = table.ctrl.data() + group * detail::kGroupWidth;
+            const auto match = detail::CtrlGroup(ctrl).MatchEmptyOrDeleted();
+            if (match == 0) {
+                return false;
+            }
+            const auto index = static_cast<size_t>(std::countr_zero(match));
+            if (ctrl[index] == detail::kCtrlEmpty) {
+                assert(table.growth_left != 0);
+                --table.growth_left;
+            }
+            ctrl[index] = H2(hash);
+            table.slots[group * detail::kGroupWidth + index] = entry;
+            ++table.size;
+            return true;
+        });
+    }
+
+    // Marks 'slot' as empty if its group has an empty slot, i.e. no probing has passed the group,
+    // otherwise marks it as deleted so that the probe sequences passing it are not broken.
+    static void EraseSlot(Table& table, size_t slot) {
+        const auto group = slot / detail::kGroupWidth;
+        const auto* ctrl = table.ctrl.data() + group * detail::kGroupWidth;
+        if (detail::CtrlGroup(ctrl).MatchEmpty() != 0) {
+            table.ctrl[slot] = detail::kCtrlEmpty;
+            ++table.growth_left;
+        } else {
+            table.ctrl[slot] = detail::kCtrlDeleted;
+        }
+        table.slots[slot] = nullptr;
+        --table.size;
+    }
+
+    static void TraverseGroup(Table& table, size_t group, auto& func) {
+        const auto begin = group * detail::kGroupWidth;
+        for (auto slot = begin; slot < begin + detail::kGroupWidth; ++slot) {
+            if (table.ctrl[slot] >= 0) {
+                func(table.slots[slot]);
+            }
+        }
+    }
+
+    // Starts rehashing if the table is out of room. If there are mostly deleted slots, the new table
+    // has the same capacity, so the rehashing only cleans up the deleted slots. Otherwise, it's
+    // twice as large.
+    void Expand() {
+        if (tables_[0].Capacity() == 0) {
+            tables_[0].Resize(kInitCapacity);
+            return;
+        }
+        if (IsRehashing()) {
+            // The new table is at least as large as the old one, and a group is migrated upon each
+            // insertion, so it's full only if it's as large as the old one and has seen many
+            // insertions. Finishes the rehashing and starts a new one.
+            if (tables_[1].growth_left != 0) {
+                return;
+            }
+            if (rehash_paused_) {
+                // The new table only has the entries inserted during the traversal.
+                GrowNewTable();
+                return;
+            }
+            while (!RehashSome(tables_[0].NumGroups())) {
+            }
+        }
+        if (tables_[0].growth_left != 0) {
+            return;
+        }
+
+        const auto capacity = tables_[0].Capacity();
+        const auto new_capacity = (tables_[0].size * 2 <= capacity / 2) ? capacity : capacity * 2;
+        tables_[1].Resize(new_capacity);
+        rehash_index_ = 0;
+        RehashSome(1);
+    }
+
+    // Moves the entries of the new table to a larger one at once, which has room for the entries
+    // of the old table as well, for the rehashing after the traversal pausing it.
+    void GrowNewTable() {
+        auto& table = tables_[1];
+        auto capacity = table.Capacity() * 2;
+        while (capacity - capacity / 8 < 2 * (table.size + tables_[0].size)) {
+            capacity *= 2;
+        }
+        Table larger;
+        larger.Resize(capacity);
+        for (size_t slot = 0; slot < table.Capacity(); ++slot) {
+            if (table.ctrl[slot] >= 0) {
+                InsertToTable(larger, Hash(table.slots[slot]->Key()), table.slots[slot]);
+            }
+        }
+        table = std::move(larger);
+    }
+
+    size_t RehashGroup(size_t group) {
+        auto& old_table = tables_[0];
+        auto& new_table = tables_[1];
+        size_t moved{0};
+        const auto begin = group * detail::kGroupWidth;
+        for (auto slot = begin; slot < begin + detail::kGroupWidth; ++slot) {
+            if (old_table.ctrl[slot] < 0) {
+                continue;
+            }
+            auto* entry = old_table.slots[slot];
+            InsertToTable(new_table, Hash(entry->Key()), entry);
+            // Migrated slots are marked as deleted to keep the probe sequences of the rest.
+            old_table.ctrl[slot] = detail::kCtrlDeleted;
+            old_table.slots[slot] = nullptr;
+            --old_table.size;
+            ++moved;
+        }
+        return moved;
+    }
+
+    // While rehashing, 'tables_[0]' is the old table, whose groups before 'rehash_index_' have been
+    // migrated to 'tables_[1]'.
+    Table tables_[2];
+    size_t entries_{0};
+    int32_t rehash_index_{-1};
+    // Set while a traversal is in progress, see TraverseBucket().
+    bool rehash_paused_{false};
+};
+
+} // namespace rdss
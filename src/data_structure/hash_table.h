@@ -6,11 +6,12 @@
 
 #include <cassert>
 #include <chrono>
-#include <cstdlib>
-#include <ctime>
+#include <cstring>
 #include <functional>
 #include <limits.h>
 #include <memory>
+#include <random>
+#include <string_view>
 #include <vector>
 #include <xxhash.h>
 
@@ -42,102 +43,155 @@ static size_t NextIndex(size_t index, size_t size) {
     return index;
 }
 
+// Picks the random entries, e.g. for eviction. A table is only accessed by the thread of its
+// shard, so each thread seeds its own generator once.
+inline size_t Random() {
+    thread_local std::minstd_rand engine(std::random_device{}());
+    return static_cast<size_t>(engine());
+}
+
 } // namespace rdss::detail
 
 namespace rdss {
 
-template<typename Allocator>
-class HashTableKey {
+/// Entry of HashTable. The entry is a single variable-length allocation, the key bytes are stored
+/// right after the fixed part, so that creating an entry takes one allocation and comparing the key
+/// doesn't chase another pointer.
+template<typename ValueType, typename Allocator>
+class HashTableEntry {
 public:
-    using String = std::basic_string<char, std::char_traits<char>, Allocator>;
+    using Pointer = HashTableEntry*;
     using LastAccessTimeDuration = std::chrono::duration<uint32_t, std::milli>;
     using LastAccessTimePoint
       = std::chrono::time_point<std::chrono::steady_clock, LastAccessTimeDuration>;
+    using ExpireTimePoint
+      = std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds>;
+    using CharAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<char>;
+
+public:
+    static Pointer Create(std::string_view key) {
+        VLOG(1) << "Creating new TableEntry with key:" << key;
+        auto* mem = CharAllocator().allocate(AllocationSize(key.size()));
+        auto* entry = new (mem) HashTableEntry(key.size());
+        std::memcpy(entry->KeyData(), key.data(), key.size());
+        return entry;
+    }
 
-    explicit HashTableKey(std::string_view sv)
-      : data_(sv) {}
+    static void Destroy(Pointer entry) {
+        const auto size = AllocationSize(entry->key_size_);
+        entry->~HashTableEntry();
+        CharAllocator().deallocate(reinterpret_cast<char*>(entry), size);
+    }
 
-    std::string_view StringView() const { return std::string_view(data_); }
+    std::string_view Key() const { return {KeyData(), key_size_}; }
 
-    bool Equals(std::string_view rhs) const { return !data_.compare(rhs); }
+    bool KeyEquals(std::string_view key) const {
+        return key.size() == key_size_ && std::memcmp(KeyData(), key.data(), key_size_) == 0;
+    }
 
     void SetLRU(LastAccessTimePoint lru) { lru_ = lru; }
 
     LastAccessTimePoint GetLRU() const { return lru_; }
 
+    /// The expire time is kept in the entry so that looking up a key needs no second table. The
+    /// epoch is reserved for keys without expire time.
+    bool HasExpire() const { return expire_ != ExpireTimePoint{}; }
+
+    ExpireTimePoint GetExpire() const { return expire_; }
+
+    void SetExpire(ExpireTimePoint expire) {
+        assert(expire != ExpireTimePoint{});
+        expire_ = expire;
+    }
+
+    void ClearExpire() { expire_ = {}; }
+
+    ValueType value{};
+    Pointer next = nullptr;
+
 private:
+    explicit HashTableEntry(size_t key_size)
+      : key_size_(static_cast<uint32_t>(key_size)) {}
+
+    ~HashTableEntry() = default;
+
+    static size_t AllocationSize(size_t key_size) { return sizeof(HashTableEntry) + key_size; }
+
+    char* KeyData() { return reinterpret_cast<char*>(this + 1); }
+
+    const char* KeyData() const { return reinterpret_cast<const char*>(this + 1); }
+
+    ExpireTimePoint expire_{};
     // TODO: Give it a more reasonable name.
     LastAccessTimePoint lru_;
-    const String data_;
+    uint32_t key_size_;
 };
 
-template<typename ValueType, typename Allocator>
-class HashTableEntry {
+/// Entry of a HashTable indexing a subset of the keys of another HashTable, e.g. the keys with
+/// expiration. Instead of holding a copy of the key, it references the entry of the other table
+/// which owns the key. The referenced entry must outlive this entry, i.e. this entry should be
+/// erased before the referenced one.
+template<typename ValueType, typename Allocator, typename KeyEntryType>
+class HashTableRefEntry {
 public:
-    using Pointer = HashTableEntry*;
-
-    using ThisType = HashTableEntry<ValueType, Allocator>;
-    // TODO: Revisit this.
+    using Pointer = HashTableRefEntry*;
+    using KeyEntryPointer = KeyEntryType*;
     using EntryAllocator =
-      typename std::allocator_traits<Allocator>::template rebind_alloc<ThisType>;
-
-    using CharAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<char>;
-    using KeyType = HashTableKey<CharAllocator>;
-    using KeyPointer = std::shared_ptr<KeyType>;
-    using KeyAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<KeyType>;
+      typename std::allocator_traits<Allocator>::template rebind_alloc<HashTableRefEntry>;
 
 public:
-    static HashTableEntry* Create() {
-        VLOG(1) << "Creating new TableEntry.";
+    static Pointer Create(std::string_view key, KeyEntryPointer key_entry) {
+        assert(key_entry->KeyEquals(key));
         auto* mem = EntryAllocator().allocate(1);
-        auto entry = new (mem) ThisType();
-        return entry;
+        return new (mem) HashTableRefEntry(key_entry);
     }
 
     static void Destroy(Pointer entry) {
-        entry->~HashTableEntry();
+        entry->~HashTableRefEntry();
         EntryAllocator().deallocate(entry, 1);
     }
 
-    void SetKey(std::string_view sv) {
-        VLOG(1) << "Setting key in TableEntry with value:" << sv;
-        key = std::allocate_shared<KeyType>(KeyAllocator(), sv);
-    }
+    std::string_view Key() const { return key_entry_->Key(); }
 
-    KeyType* GetKey() { return key.get(); }
+    bool KeyEquals(std::string_view key) const { return key_entry_->KeyEquals(key); }
 
-    KeyPointer CopyKey() { return key; }
+    KeyEntryPointer KeyEntry() const { return key_entry_; }
 
-    KeyPointer key = nullptr;
-    // TODO: value can be shared string, or inlined int, and needs to be extented to data structure
-    // like set and list.
-    ValueType value;
+    [[no_unique_address]] ValueType value{};
     Pointer next = nullptr;
 
 private:
-    HashTableEntry() = default;
-    ~HashTableEntry() = default;
+    explicit HashTableRefEntry(KeyEntryPointer key_entry)
+      : key_entry_(key_entry) {}
+
+    ~HashTableRefEntry() = default;
+
+    KeyEntryPointer key_entry_;
 };
 
-template<typename ValueType, typename Allocator = Mallocator<ValueType>>
+template<
+  typename ValueType,
+  typename Allocator = Mallocator<ValueType>,
+  typename Entry = HashTableEntry<ValueType, Allocator>>
 class HashTable {
 public:
-    using EntryType = HashTableEntry<ValueType, Allocator>;
+    using EntryType = Entry;
     using EntryPointer = EntryType::Pointer;
     using EntryPointerAllocator =
       typename std::allocator_traits<Allocator>::template rebind_alloc<EntryPointer>;
     using BucketVector = std::vector<EntryPointer, EntryPointerAllocator>;
 
 public:
-    HashTable() { std::srand(static_cast<unsigned int>(time(nullptr))); }
+    HashTable() = default;
     ~HashTable() { Clear(); }
 
     /// Searches for entry with 'key' in the HashTable, and if 'create_on_missing' is set, creates
-    /// entry if no such entry is found.
+    /// entry with 'key' and 'create_args' if no such entry is found.
     /// If 'create_on_missing' is true, returns {entry for 'key', if entry already exists}.
     /// If 'create_on_missing' is false, returns {newly created entry for 'key', false}.
+    template<typename... CreateArgs>
     std::pair<EntryPointer, bool>
-    FindOrCreate(std::string_view key, bool create_on_missing, bool create_shared_key = true) {
+    FindOrCreate(std::string_view key, bool create_on_missing, CreateArgs... create_args) {
         if (buckets_[0].empty()) {
             if (!create_on_missing) {
                 return {nullptr, false};
@@ -154,7 +208,7 @@ public:
             if (Expand() != ExpandResult::kNoExpand) {
                 bucket = FindBucket(key);
             }
-            entry = CreateEntryInBucket(bucket, key, create_shared_key);
+            entry = CreateEntryInBucket(bucket, key, create_args...);
             ++entries_;
         }
         return {entry, false};
@@ -169,30 +223,28 @@ public:
         return {entry, !exists};
     }
 
-    /// Insert if 'key' not exists, overwrite if exists. Returns {entry of 'key', overwritten}. The
-    /// actual key is a shared_ptr constructed with string_view 'key'.
+    /// Insert if 'key' not exists, overwrite if exists. Returns {entry of 'key', overwritten}.
     std::pair<EntryPointer, bool> Upsert(std::string_view key, ValueType value) {
         auto [entry, exists] = FindOrCreate(key, true);
         entry->value = std::move(value);
         return {entry, exists};
     }
 
-    /// Provides the same functionality as above, but with already constructed key shared_ptr. This
-    /// is used for a second table that shares the key object with the first table.
-    std::pair<EntryPointer, bool> Upsert(EntryType::KeyPointer key_ptr, ValueType value) {
-        auto [entry, exists] = FindOrCreate(key_ptr->StringView(), true, false);
-        if (exists) {
-            assert(entry->key.get() == key_ptr.get());
-        } else {
-            entry->key = key_ptr;
-        }
+    /// Provides the same functionality as above for the table of HashTableRefEntry, whose entry of
+    /// the key references 'key_entry' of another table.
+    template<typename E = EntryType>
+    std::pair<EntryPointer, bool> Upsert(typename E::KeyEntryPointer key_entry, ValueType value) {
+        auto [entry, exists] = FindOrCreate(key_entry->Key(), true, key_entry);
+        assert(entry->KeyEntry() == key_entry);
         entry->value = std::move(value);
         return {entry, exists};
     }
 
     EntryPointer Find(std::string_view key) {
-        auto [entry, _] = FindOrCreate(key, false);
-        return entry;
+        if (buckets_[0].empty()) {
+            return nullptr;
+        }
+        return FindEntryInBucket(FindBucket(key), key);
     }
 
     EntryPointer GetRandomEntry() {
@@ -202,7 +254,7 @@ public:
 
         EntryPointer bucket{nullptr};
         while (bucket == nullptr) {
-            const size_t rand = static_cast<size_t>(std::rand());
+            const size_t rand = detail::Random();
             const size_t bucket_index = rand % buckets_[0].size();
             if (static_cast<int32_t>(bucket_index) >= rehash_index_) {
                 bucket = buckets_[0][bucket_index];
@@ -256,22 +308,40 @@ public:
 
     bool IsRehashing() const { return (rehash_index_ >= 0); }
 
+    /// Calls 'func' on the entries of the bucket at 'bucket_index', and returns the index of the next
+    /// bucket to traverse, which is 0 after the last bucket. The buckets are visited in the order of
+    /// the reversed bits of their indexes, so that a traversal that starts at 0 and continues
+    /// until 0 is returned visits every entry that exists all along exactly once, even if the table
+    /// expands in the middle. While rehashing, an index of the old buckets stands for the bucket
+    /// and the two new buckets that its entries are rehashed to. 'func' may erase the visited entry.
     size_t TraverseBucket(size_t bucket_index, auto func) {
-        // TODO: support rehashing.
-        if (IsRehashing()) {
+        if (buckets_[0].empty()) {
             return 0;
         }
+        const auto size = buckets_[0].size();
+        // The table only expands, the index returned by an earlier call is still in range.
+        assert(bucket_index < size);
 
-        assert(bucket_index < buckets_[0].size());
-        auto entry = buckets_[0][bucket_index];
-
-        bucket_index = detail::NextIndex(bucket_index, buckets_[0].size());
+        // Erasing in 'func' doesn't move entries between the buckets being traversed.
+        ++rehash_paused_;
+        TraverseChain(buckets_[0][bucket_index], func);
+        if (IsRehashing()) {
+            TraverseChain(buckets_[1][bucket_index], func);
+            TraverseChain(buckets_[1][bucket_index + size], func);
+        }
+        --rehash_paused_;
+        return detail::NextIndex(bucket_index, size);
+    }
 
-        while (entry != nullptr) {
-            func(entry);
-            entry = entry->next;
+    /// Returns whether the bucket of 'key' has been traversed by a traversal that starts at 0 and is
+    /// continued until TraverseBucket() returns 'cursor', i.e. the reversed bits of the index of
+    /// the bucket is less than those of 'cursor'. The result stays correct if the table expands.
+    bool IsTraversed(std::string_view key, size_t cursor) const {
+        if (buckets_[0].empty()) {
+            return false;
         }
-        return bucket_index;
+        const auto index = static_cast<size_t>(Hash(key) % buckets_[0].size());
+        return detail::rev(index) < detail::rev(cursor);
     }
 
     /// Rehashes 'buckets_to_rehash' non-empty buckets, or 10 * 'buckets_to_rehash'. Returns if
@@ -308,22 +378,28 @@ public:
     // TODO: mem-related APIs
 
 private:
-    uint64_t Hash(std::string_view key) { return XXH64(key.data(), key.size(), 0); }
+    uint64_t Hash(std::string_view key) const { return XXH64(key.data(), key.size(), 0); }
 
+    template<typename... CreateArgs>
     EntryPointer CreateEntryInBucket(
-      BucketVector::iterator bucket, std::string_view key, bool create_shared_key) {
-        auto* entry = EntryType::Create();
-        if (create_shared_key) {
-            entry->SetKey(key);
-        }
+      BucketVector::iterator bucket, std::string_view key, CreateArgs... create_args) {
+        auto* entry = EntryType::Create(key, create_args...);
         entry->next = *bucket;
         *bucket = entry;
         return entry;
     }
 
+    static void TraverseChain(EntryPointer entry, auto& func) {
+        while (entry != nullptr) {
+            auto next = entry->next;
+            func(entry);
+            entry = next;
+        }
+    }
+
     // Assumes the table is not empty.
     BucketVector::iterator FindBucket(std::string_view key) {
-        if (IsRehashing()) {
+        if (IsRehashing() && rehash_paused_ == 0) {
             RehashSome(1);
         }
 
@@ -342,7 +418,7 @@ private:
         }
 
         auto entry = *bucket;
-        while (!entry->GetKey()->Equals(key)) {
+        while (!entry->KeyEquals(key)) {
             if (entry->next == nullptr) {
                 return nullptr;
             }
@@ -358,7 +434,7 @@ private:
             ++bucket_length;
             entry = entry->next;
         }
-        const size_t target_entry = static_cast<size_t>(rand()) % bucket_length;
+        const size_t target_entry = detail::Random() % bucket_length;
         entry = bucket;
         for (size_t i = 0; i < target_entry; ++i) {
             entry = entry->next;
@@ -372,7 +448,7 @@ private:
         }
         EntryPointer* prev_next = &(*bucket);
         auto entry = *bucket;
-        while (!entry->GetKey()->Equals(key)) {
+        while (!entry->KeyEquals(key)) {
             if (entry->next == nullptr) {
                 return false;
             }
@@ -433,7 +509,7 @@ private:
         size_t num_rehashed{0};
         while (entry) {
             auto* next_entry = entry->next;
-            const uint64_t hash = Hash(entry->GetKey()->StringView());
+            const uint64_t hash = Hash(entry->Key());
             auto target_bucket = buckets_[1].begin()
                                  + static_cast<int32_t>(hash % buckets_[1].size());
             entry->next = *target_bucket;
@@ -449,6 +525,15 @@ private:
     BucketVector buckets_[2];
     size_t entries_ = 0;
     int32_t rehash_index_ = -1;
+    // Greater than 0 while traversing, during which lookups don't rehash.
+    uint32_t rehash_paused_ = 0;
 };
 
+/// HashTable whose keys are a subset of the keys of 'KeyTable', see HashTableRefEntry.
+template<typename ValueType, typename KeyTable, typename Allocator = Mallocator<ValueType>>
+using RefHashTable = HashTable<
+  ValueType,
+  Allocator,
+  HashTableRefEntry<ValueType, Allocator, typename KeyTable::EntryType>>;
+
 } // namespace rdss
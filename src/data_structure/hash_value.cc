@@ -0,0 +1,139 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "data_structure/hash_value.h"
+
+#include "data_structure/listpack.h"
+
+#include <cassert>
+#include <memory>
+
+namespace rdss {
+
+namespace {
+
+using TableAllocator = Mallocator<HashValue::Table>;
+
+} // namespace
+
+HashValue::HashValue(const HashValue& other)
+  : listpack_(other.listpack_)
+  , listpack_size_(other.listpack_size_) {
+    if (other.table_ == nullptr) {
+        return;
+    }
+    auto* mem = TableAllocator().allocate(1);
+    table_ = new (mem) Table();
+    other.ForEach([this](std::string_view field, std::string_view value) {
+        table_->Upsert(field, StringValue(value));
+    });
+}
+
+HashValue::~HashValue() {
+    if (table_ != nullptr) {
+        std::destroy_at(table_);
+        TableAllocator().deallocate(table_, 1);
+    }
+}
+
+size_t HashValue::Size() const { return table_ == nullptr ? listpack_size_ : table_->Count(); }
+
+StringValue HashValue::Get(std::string_view field) const {
+    if (table_ != nullptr) {
+        auto* entry = table_->Find(field);
+        return entry == nullptr ? StringValue() : entry->value;
+    }
+    const auto span = FindInListpack(field);
+    if (!span.has_value()) {
+        return {};
+    }
+    auto pos = span->value_begin;
+    return StringValue(listpack::Next(listpack_, pos));
+}
+
+bool HashValue::Set(std::string_view field, std::string_view value, const Limits& limits) {
+    if (table_ == nullptr) {
+        const auto span = FindInListpack(field);
+        const auto size = listpack_size_ + (span.has_value() ? 0 : 1);
+        if (
+          size > limits.max_listpack_entries || field.size() > limits.max_listpack_value
+          || value.size() > limits.max_listpack_value) {
+            ConvertToTable();
+        } else if (span.has_value()) {
+            MTS entry;
+            listpack::Append(entry, value);
+            listpack_.replace(span->value_begin, span->end - span->value_begin, entry);
+            return false;
+        } else {
+            listpack::Append(listpack_, field);
+            listpack::Append(listpack_, value);
+            ++listpack_size_;
+            return true;
+        }
+    }
+    auto [entry, exists] = table_->FindOrCreate(field, true);
+    entry->value = StringValue(value);
+    return !exists;
+}
+
+bool HashValue::Erase(std::string_view field) {
+    if (table_ != nullptr) {
+        return table_->Erase(field);
+    }
+    const auto span = FindInListpack(field);
+    if (!span.has_value()) {
+        return false;
+    }
+    listpack_.erase(span->begin, span->end - span->begin);
+    --listpack_size_;
+    return true;
+}
+
+void HashValue::ForEach(
+  const std::function<void(std::string_view, std::string_view)>& func) const {
+    if (table_ != nullptr) {
+        StringValue::IntChars chars;
+        size_t cursor{0};
+        do {
+            cursor = table_->TraverseBucket(cursor, [&func, &chars](Table::EntryPointer entry) {
+                func(entry->Key(), entry->value.View(chars));
+            });
+        } while (cursor != 0);
+        return;
+    }
+    const std::string_view listpack{listpack_};
+    size_t pos{0};
+    while (pos < listpack.size()) {
+        const auto field = listpack::Next(listpack, pos);
+        const auto value = listpack::Next(listpack, pos);
+        func(field, value);
+    }
+}
+
+std::optional<HashValue::ListpackSpan> HashValue::FindInListpack(std::string_view field) const {
+    const std::string_view listpack{listpack_};
+    size_t pos{0};
+    while (pos < listpack.size()) {
+        const auto begin = pos;
+        const auto current = listpack::Next(listpack, pos);
+        const auto value_begin = pos;
+        listpack::Next(listpack, pos);
+        if (current == field) {
+            return ListpackSpan{.begin = begin, .value_begin = value_begin, .end = pos};
+        }
+    }
+    return std::nullopt;
+}
+
+void HashValue::ConvertToTable() {
+    assert(table_ == nullptr);
+    auto* mem = TableAllocator().allocate(1);
+    auto* table = new (mem) Table();
+    ForEach([table](std::string_view field, std::string_view value) {
+        table->Upsert(field, StringValue(value));
+    });
+    table_ = table;
+    MTS().swap(listpack_);
+    listpack_size_ = 0;
+}
+
+} // namespace rdss
@@ -0,0 +1,81 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/flat_hash_table.h"
+#include "data_structure/tracking_hash_table.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace rdss {
+
+/// Value of hash type, i.e. a map of fields to string values held by a single key. Like Redis, a
+/// small hash is encoded as a listpack: its fields and values are stored one after another in one
+/// buffer (see listpack.h), which takes a few bytes per field instead of a table entry and a key.
+/// Operations on it scan the buffer, so once it has more than 'max_listpack_entries' fields or a
+/// field or value longer than 'max_listpack_value', it's converted to a FlatHashTable, and it's
+/// never converted back.
+class HashValue {
+public:
+    enum class Encoding : uint8_t { kListpack, kTable };
+
+    struct Limits {
+        size_t max_listpack_entries = 128;
+        size_t max_listpack_value = 64;
+    };
+
+    using Table = FlatHashTable<StringValue>;
+
+public:
+    HashValue() = default;
+
+    HashValue(const HashValue& other);
+
+    HashValue& operator=(const HashValue&) = delete;
+
+    ~HashValue();
+
+    Encoding GetEncoding() const {
+        return table_ == nullptr ? Encoding::kListpack : Encoding::kTable;
+    }
+
+    /// Returns the number of fields.
+    size_t Size() const;
+
+    /// Returns the value of 'field', or null value if there is no such field.
+    StringValue Get(std::string_view field) const;
+
+    /// Sets 'field' to 'value', converting the listpack to a table if it would exceed 'limits'.
+    /// Returns true if the field is new.
+    bool Set(std::string_view field, std::string_view value, const Limits& limits);
+
+    /// Removes 'field', returns false if there is no such field.
+    bool Erase(std::string_view field);
+
+    /// Calls 'func' with every field and its value, which are valid during the call. The hash
+    /// shouldn't be modified meanwhile.
+    void ForEach(const std::function<void(std::string_view, std::string_view)>& func) const;
+
+private:
+    // Position of a field of the listpack and of the end of its value.
+    struct ListpackSpan {
+        size_t begin;
+        size_t value_begin;
+        size_t end;
+    };
+
+    // Finds 'field' in the listpack, returns the span of its entries if found.
+    std::optional<ListpackSpan> FindInListpack(std::string_view field) const;
+
+    void ConvertToTable();
+
+    MTS listpack_;
+    uint32_t listpack_size_{0};
+    // Allocated on conversion, so that a small hash doesn't carry an empty table.
+    Table* table_{nullptr};
+};
+
+} // namespace rdss
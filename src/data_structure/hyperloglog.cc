@@ -0,0 +1,623 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace rdss::hyperloglog {
+
+namespace {
+
+// Bits of the hash besides the register index, whose run of zeros is counted.
+constexpr size_t kQ = 64 - kPrecision;
+constexpr size_t kBits = 6;
+constexpr unsigned kRegisterMax = (1U << kBits) - 1;
+
+constexpr size_t kEncodingOffset = 4;
+constexpr size_t kCardinalityOffset = 8;
+constexpr uint8_t kDense = 0;
+constexpr uint8_t kSparse = 1;
+
+constexpr size_t kSparseValMax = 32;
+constexpr size_t kSparseValMaxLen = 4;
+constexpr size_t kSparseZeroMaxLen = 64;
+constexpr size_t kSparseXZeroMaxLen = 16384;
+// Opcodes to scan for adjacent VAL runs to merge after a run is split.
+constexpr size_t kSparseMergeScan = 5;
+
+constexpr double kAlphaInf = 0.721347520444481703680;
+
+// 2^-i for i in [0, 63].
+constexpr auto kInversePowers = [] {
+    std::array<double, 64> powers{};
+    double power{1};
+    for (auto& p : powers) {
+        p = power;
+        power /= 2;
+    }
+    return powers;
+}();
+
+uint8_t* Bytes(MTS& str) { return reinterpret_cast<uint8_t*>(str.data()); }
+
+const uint8_t* Bytes(std::string_view str) { return reinterpret_cast<const uint8_t*>(str.data()); }
+
+// MurmurHash64A with the seed of Redis, so that an element goes to the same register. Reads the
+// blocks in native byte order, which is little endian on the supported platforms.
+uint64_t Hash(std::string_view element) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ULL;
+    constexpr int r = 47;
+    constexpr uint64_t seed = 0xadc83b19ULL;
+
+    const auto* data = Bytes(element);
+    const size_t len = element.size();
+    uint64_t h = seed ^ (len * m);
+    const size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k;
+        std::memcpy(&k, data + i * 8, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    const auto* tail = data + blocks * 8;
+    switch (len & 7) {
+    case 7:
+        h ^= uint64_t{tail[6]} << 48;
+        [[fallthrough]];
+    case 6:
+        h ^= uint64_t{tail[5]} << 40;
+        [[fallthrough]];
+    case 5:
+        h ^= uint64_t{tail[4]} << 32;
+        [[fallthrough]];
+    case 4:
+        h ^= uint64_t{tail[3]} << 24;
+        [[fallthrough]];
+    case 3:
+        h ^= uint64_t{tail[2]} << 16;
+        [[fallthrough]];
+    case 2:
+        h ^= uint64_t{tail[1]} << 8;
+        [[fallthrough]];
+    case 1:
+        h ^= uint64_t{tail[0]};
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// Returns the register of 'element', and the length of the run of zeros of the rest of its hash
+// plus 1, which is the value for the register.
+std::pair<size_t, uint8_t> RegisterOf(std::string_view element) {
+    auto hash = Hash(element);
+    const size_t index = hash & (kRegisters - 1);
+    hash >>= kPrecision;
+    // Bounds the value to kQ + 1.
+    hash |= uint64_t{1} << kQ;
+    return {index, static_cast<uint8_t>(std::countr_zero(hash) + 1)};
+}
+
+void InvalidateCache(MTS& hll) {
+    auto* msb = Bytes(hll) + kCardinalityOffset + 7;
+    *msb = static_cast<uint8_t>(*msb | 0x80);
+}
+
+uint8_t GetDense(const uint8_t* registers, size_t index) {
+    const size_t byte = index * kBits / 8;
+    const size_t shift = index * kBits & 7;
+    unsigned value = unsigned{registers[byte]} >> shift;
+    if (shift > 8 - kBits) {
+        value |= unsigned{registers[byte + 1]} << (8 - shift);
+    }
+    return static_cast<uint8_t>(value & kRegisterMax);
+}
+
+void SetDense(uint8_t* registers, size_t index, uint8_t value) {
+    const size_t byte = index * kBits / 8;
+    const size_t shift = index * kBits & 7;
+    registers[byte] = static_cast<uint8_t>(
+      (registers[byte] & ~(kRegisterMax << shift)) | (unsigned{value} << shift));
+    if (shift > 8 - kBits) {
+        const size_t high_shift = 8 - shift;
+        registers[byte + 1] = static_cast<uint8_t>(
+          (registers[byte + 1] & ~(kRegisterMax >> high_shift)) | (unsigned{value} >> high_shift));
+    }
+}
+
+bool IsZero(uint8_t op) { return (op & 0xc0) == 0; }
+
+bool IsXZero(uint8_t op) { return (op & 0xc0) == 0x40; }
+
+bool IsVal(uint8_t op) { return (op & 0x80) != 0; }
+
+uint8_t ValValue(uint8_t op) { return static_cast<uint8_t>(((op >> 2) & 0x1f) + 1); }
+
+size_t ValLength(uint8_t op) { return (op & 0x3U) + 1; }
+
+uint8_t EncodeVal(uint8_t value, size_t length) {
+    return static_cast<uint8_t>(0x80 | ((value - 1) << 2) | (length - 1));
+}
+
+// Writes the opcode of 'length' zero registers, at most kSparseXZeroMaxLen, to 'out'. Returns the
+// number of bytes written.
+size_t EncodeZeros(size_t length, uint8_t* out) {
+    if (length <= kSparseZeroMaxLen) {
+        out[0] = static_cast<uint8_t>(length - 1);
+        return 1;
+    }
+    out[0] = static_cast<uint8_t>(0x40 | ((length - 1) >> 8));
+    out[1] = static_cast<uint8_t>((length - 1) & 0xff);
+    return 2;
+}
+
+// Decodes the opcode at 'pos' of the sparse registers 'ops' into 'length' and 'value'. Returns the
+// number of bytes of the opcode, or 0 if it's truncated.
+size_t DecodeRun(const uint8_t* ops, size_t size, size_t pos, size_t& length, uint8_t& value) {
+    const auto op = ops[pos];
+    value = 0;
+    if (IsZero(op)) {
+        length = (op & 0x3fU) + 1;
+        return 1;
+    }
+    if (IsXZero(op)) {
+        if (pos + 1 >= size) {
+            return 0;
+        }
+        length = (((op & 0x3fU) << 8) | ops[pos + 1]) + 1;
+        return 2;
+    }
+    value = ValValue(op);
+    length = ValLength(op);
+    return 1;
+}
+
+// Calls 'func(first, length, value)' with every run of registers of sparse 'hll'. Returns false if
+// 'hll' is corrupted, i.e. the runs don't cover exactly all the registers.
+template<typename Func>
+bool ForEachRun(std::string_view hll, Func&& func) {
+    const auto* ops = Bytes(hll) + kHeaderSize;
+    const size_t size = hll.size() - kHeaderSize;
+    size_t first{0};
+    for (size_t pos = 0; pos < size;) {
+        size_t length;
+        uint8_t value;
+        const auto op_size = DecodeRun(ops, size, pos, length, value);
+        if (op_size == 0 || first + length > kRegisters) {
+            return false;
+        }
+        func(first, length, value);
+        first += length;
+        pos += op_size;
+    }
+    return first == kRegisters;
+}
+
+// Sets registers[i] to the max of it and the i-th register of the packed dense 'dense'.
+void MergeDense(const uint8_t* dense, Registers& registers) {
+    size_t i{0};
+#ifdef __AVX2__
+    // Unpacks 32 registers from 24 bytes at a time: every 32 bits lane gets the 3 bytes of 4
+    // registers, whose groups of 6 bits are shifted into their own bytes. The high half loads 16
+    // bytes from the 12th, so the last block is left to the scalar loop instead of reading past the
+    // registers.
+    const auto shuffle = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1,
+      9, 10, 11, -1);
+    const auto mask0 = _mm256_set1_epi32(0x3f);
+    const auto mask1 = _mm256_set1_epi32(0x3f00);
+    const auto mask2 = _mm256_set1_epi32(0x3f0000);
+    const auto mask3 = _mm256_set1_epi32(0x3f000000);
+    constexpr size_t kDenseBytes = kDenseSize - kHeaderSize;
+    for (; i / 4 * 3 + 28 <= kDenseBytes; i += 32) {
+        const auto* src = dense + i / 4 * 3;
+        const auto packed = _mm256_set_m128i(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        const auto words = _mm256_shuffle_epi8(packed, shuffle);
+        const auto unpacked = _mm256_or_si256(
+          _mm256_or_si256(
+            _mm256_and_si256(words, mask0), _mm256_and_si256(_mm256_slli_epi32(words, 2), mask1)),
+          _mm256_or_si256(
+            _mm256_and_si256(_mm256_slli_epi32(words, 4), mask2),
+            _mm256_and_si256(_mm256_slli_epi32(words, 6), mask3)));
+        auto* dst = reinterpret_cast<__m256i*>(registers.data() + i);
+        _mm256_storeu_si256(dst, _mm256_max_epu8(_mm256_loadu_si256(dst), unpacked));
+    }
+#endif
+    for (; i < kRegisters; ++i) {
+        registers[i] = std::max(registers[i], GetDense(dense, i));
+    }
+}
+
+// What the estimate needs of the registers: the harmonic sum of the ones in [1, kQ], i.e. the sum
+// of 2^-register, and the numbers of the ones of 0 and of kQ + 1.
+struct RegisterSums {
+    double harmonic{0};
+    size_t zeros{0};
+    size_t saturated{0};
+};
+
+RegisterSums SumRegisters(const Registers& registers) {
+    RegisterSums sums;
+    size_t i{0};
+#ifdef __AVX2__
+    // 2^-r is made as a double of exponent -r, and masked out unless r is in [1, kQ]. Every
+    // accumulator adds 4 registers of one half of a block.
+    const auto zero = _mm256_setzero_si256();
+    const auto saturated = _mm256_set1_epi8(static_cast<char>(kQ + 1));
+    const auto bias = _mm256_set1_epi64x(1023);
+    const auto upper = _mm256_set1_epi64x(kQ + 1);
+    auto inverse_power = [&](__m128i bytes) {
+        const auto r = _mm256_cvtepu8_epi64(bytes);
+        const auto power = _mm256_slli_epi64(_mm256_sub_epi64(bias, r), 52);
+        const auto in_range =
+          _mm256_and_si256(_mm256_cmpgt_epi64(r, zero), _mm256_cmpgt_epi64(upper, r));
+        return _mm256_castsi256_pd(_mm256_and_si256(power, in_range));
+    };
+    auto low_sum = _mm256_setzero_pd();
+    auto high_sum = _mm256_setzero_pd();
+    for (; i + 32 <= kRegisters; i += 32) {
+        const auto block =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(registers.data() + i));
+        sums.zeros += static_cast<size_t>(std::popcount(
+          static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero)))));
+        sums.saturated += static_cast<size_t>(std::popcount(
+          static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, saturated)))));
+        auto low = _mm256_castsi256_si128(block);
+        auto high = _mm256_extracti128_si256(block, 1);
+        for (int j = 0; j < 4; ++j) {
+            low_sum = _mm256_add_pd(low_sum, inverse_power(low));
+            high_sum = _mm256_add_pd(high_sum, inverse_power(high));
+            low = _mm_srli_si128(low, 4);
+            high = _mm_srli_si128(high, 4);
+        }
+    }
+    alignas(32) std::array<double, 4> lanes;
+    _mm256_store_pd(lanes.data(), _mm256_add_pd(low_sum, high_sum));
+    sums.harmonic = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < kRegisters; ++i) {
+        const auto r = registers[i];
+        if (r == 0) {
+            ++sums.zeros;
+        } else if (r <= kQ) {
+            sums.harmonic += kInversePowers[r];
+        } else if (r == kQ + 1) {
+            ++sums.saturated;
+        }
+    }
+    return sums;
+}
+
+// Returns false if sparse 'hll' is corrupted.
+bool SumSparse(std::string_view hll, RegisterSums& sums) {
+    return ForEachRun(hll, [&sums](size_t, size_t length, uint8_t value) {
+        if (value == 0) {
+            sums.zeros += length;
+        } else {
+            sums.harmonic += static_cast<double>(length) * kInversePowers[value];
+        }
+    });
+}
+
+double Tau(double x) {
+    if (x == 0 || x == 1) {
+        return 0;
+    }
+    double y{1};
+    double z = 1 - x;
+    double last;
+    do {
+        x = std::sqrt(x);
+        last = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while (last != z);
+    return z / 3;
+}
+
+double Sigma(double x) {
+    if (x == 1) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double y{1};
+    double z = x;
+    double last;
+    do {
+        x *= x;
+        last = z;
+        z += x * y;
+        y += y;
+    } while (last != z);
+    return z;
+}
+
+// The improved estimator of Otmar Ertl as used by Redis, which corrects the small and the large
+// range by 'zeros' and 'saturated' rather than switching to linear counting.
+uint64_t Estimate(const RegisterSums& sums) {
+    constexpr auto m = static_cast<double>(kRegisters);
+    auto z = m * Tau((m - static_cast<double>(sums.saturated)) / m);
+    z = std::ldexp(z, -static_cast<int>(kQ)) + sums.harmonic;
+    z += m * Sigma(static_cast<double>(sums.zeros) / m);
+    return static_cast<uint64_t>(std::llround(kAlphaInf * m * m / z));
+}
+
+// Converts sparse 'hll' to dense. Returns false if it's corrupted.
+bool ToDense(MTS& hll) {
+    MTS dense(kDenseSize, '\0');
+    std::memcpy(dense.data(), hll.data(), kHeaderSize);
+    dense[kEncodingOffset] = static_cast<char>(kDense);
+    auto* registers = Bytes(dense) + kHeaderSize;
+    const bool valid = ForEachRun(hll, [registers](size_t first, size_t length, uint8_t value) {
+        if (value != 0) {
+            for (size_t i = first; i < first + length; ++i) {
+                SetDense(registers, i, value);
+            }
+        }
+    });
+    if (!valid) {
+        return false;
+    }
+    hll.swap(dense);
+    return true;
+}
+
+enum class SparseSetStatus : uint8_t { kUnchanged, kUpdated, kToDense, kCorrupted };
+
+// Sets the register 'index' of sparse 'hll' to 'value' if it's greater, by splitting the run that
+// covers it into up to 3 runs in place. Returns kToDense without changing 'hll' if the value
+// doesn't fit in VAL or 'hll' would exceed 'sparse_max_bytes'.
+SparseSetStatus SparseSet(MTS& hll, size_t index, uint8_t value, size_t sparse_max_bytes) {
+    if (value > kSparseValMax) {
+        return SparseSetStatus::kToDense;
+    }
+
+    const auto* ops = Bytes(hll) + kHeaderSize;
+    const size_t size = hll.size() - kHeaderSize;
+    size_t pos{0};
+    size_t prev{size};
+    size_t first{0};
+    size_t length{0};
+    size_t op_size{0};
+    uint8_t run_value{0};
+    while (pos < size) {
+        op_size = DecodeRun(ops, size, pos, length, run_value);
+        if (op_size == 0 || first + length > kRegisters) {
+            return SparseSetStatus::kCorrupted;
+        }
+        if (index < first + length) {
+            break;
+        }
+        first += length;
+        prev = pos;
+        pos += op_size;
+    }
+    if (pos >= size) {
+        return SparseSetStatus::kCorrupted;
+    }
+    if (run_value >= value) {
+        return SparseSetStatus::kUnchanged;
+    }
+
+    std::array<uint8_t, 5> seq;
+    size_t seq_size{0};
+    const size_t before = index - first;
+    const size_t after = first + length - 1 - index;
+    if (run_value == 0) {
+        if (before != 0) {
+            seq_size += EncodeZeros(before, seq.data() + seq_size);
+        }
+        seq[seq_size++] = EncodeVal(value, 1);
+        if (after != 0) {
+            seq_size += EncodeZeros(after, seq.data() + seq_size);
+        }
+    } else {
+        if (before != 0) {
+            seq[seq_size++] = EncodeVal(run_value, before);
+        }
+        seq[seq_size++] = EncodeVal(value, 1);
+        if (after != 0) {
+            seq[seq_size++] = EncodeVal(run_value, after);
+        }
+    }
+    if (seq_size > op_size && hll.size() + seq_size - op_size > sparse_max_bytes) {
+        return SparseSetStatus::kToDense;
+    }
+    hll.replace(
+      kHeaderSize + pos, op_size, reinterpret_cast<const char*>(seq.data()), seq_size);
+
+    // The split may leave VAL runs next to ones of the same value, merge them from the run before.
+    auto* scan_ops = Bytes(hll) + kHeaderSize;
+    size_t end = hll.size() - kHeaderSize;
+    size_t scan = (prev == size) ? pos : prev;
+    for (size_t scanned = 0; scanned < kSparseMergeScan && scan < end; ++scanned) {
+        const auto op = scan_ops[scan];
+        if (IsXZero(op)) {
+            scan += 2;
+            continue;
+        }
+        if (IsZero(op)) {
+            ++scan;
+            continue;
+        }
+        if (scan + 1 < end && IsVal(scan_ops[scan + 1])) {
+            const auto next = scan_ops[scan + 1];
+            const auto merged_length = ValLength(op) + ValLength(next);
+            if (ValValue(op) == ValValue(next) && merged_length <= kSparseValMaxLen) {
+                scan_ops[scan] = EncodeVal(ValValue(op), merged_length);
+                hll.erase(kHeaderSize + scan + 1, 1);
+                --end;
+                continue;
+            }
+        }
+        ++scan;
+    }
+    InvalidateCache(hll);
+    return SparseSetStatus::kUpdated;
+}
+
+// Appends the sparse opcodes of 'registers' to 'out'. Returns false if a register doesn't fit in
+// VAL or 'out' exceeds 'sparse_max_bytes'.
+bool EncodeSparse(const Registers& registers, MTS& out, size_t sparse_max_bytes) {
+    std::array<uint8_t, 2> zeros;
+    for (size_t i = 0; i < kRegisters;) {
+        const auto value = registers[i];
+        size_t end = i + 1;
+        while (end < kRegisters && registers[end] == value) {
+            ++end;
+        }
+        if (value > kSparseValMax) {
+            return false;
+        }
+        for (size_t left = end - i; left != 0;) {
+            if (value == 0) {
+                const auto length = std::min(left, kSparseXZeroMaxLen);
+                const auto n = EncodeZeros(length, zeros.data());
+                out.append(reinterpret_cast<const char*>(zeros.data()), n);
+                left -= length;
+            } else {
+                const auto length = std::min(left, kSparseValMaxLen);
+                out.push_back(static_cast<char>(EncodeVal(value, length)));
+                left -= length;
+            }
+        }
+        if (out.size() > sparse_max_bytes) {
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+} // namespace
+
+MTS Create() {
+    MTS hll(kHeaderSize, '\0');
+    std::memcpy(hll.data(), "HYLL", 4);
+    hll[kEncodingOffset] = static_cast<char>(kSparse);
+    std::array<uint8_t, 2> zeros;
+    const auto n = EncodeZeros(kRegisters, zeros.data());
+    hll.append(reinterpret_cast<const char*>(zeros.data()), n);
+    return hll;
+}
+
+bool IsValid(std::string_view str) {
+    if (str.size() < kHeaderSize || !str.starts_with("HYLL")) {
+        return false;
+    }
+    const auto encoding = static_cast<uint8_t>(str[kEncodingOffset]);
+    if (encoding == kDense) {
+        return str.size() == kDenseSize;
+    }
+    return encoding == kSparse;
+}
+
+bool IsSparse(std::string_view hll) {
+    return static_cast<uint8_t>(hll[kEncodingOffset]) == kSparse;
+}
+
+std::optional<bool> Add(MTS& hll, std::string_view element, size_t sparse_max_bytes) {
+    const auto [index, value] = RegisterOf(element);
+    if (IsSparse(hll)) {
+        switch (SparseSet(hll, index, value, sparse_max_bytes)) {
+        case SparseSetStatus::kUnchanged:
+            return false;
+        case SparseSetStatus::kUpdated:
+            return true;
+        case SparseSetStatus::kCorrupted:
+            return std::nullopt;
+        case SparseSetStatus::kToDense:
+            if (!ToDense(hll)) {
+                return std::nullopt;
+            }
+            break;
+        }
+    }
+    auto* registers = Bytes(hll) + kHeaderSize;
+    if (GetDense(registers, index) >= value) {
+        return false;
+    }
+    SetDense(registers, index, value);
+    InvalidateCache(hll);
+    return true;
+}
+
+std::optional<uint64_t> Count(MTS& hll) {
+    auto* cache = Bytes(hll) + kCardinalityOffset;
+    if ((cache[7] & 0x80) == 0) {
+        uint64_t cardinality{0};
+        for (size_t i = 0; i < 8; ++i) {
+            cardinality |= uint64_t{cache[i]} << (i * 8);
+        }
+        return cardinality;
+    }
+
+    RegisterSums sums;
+    if (IsSparse(hll)) {
+        if (!SumSparse(hll, sums)) {
+            return std::nullopt;
+        }
+    } else {
+        Registers registers{};
+        MergeDense(Bytes(hll) + kHeaderSize, registers);
+        sums = SumRegisters(registers);
+    }
+    const auto cardinality = Estimate(sums);
+    for (size_t i = 0; i < 8; ++i) {
+        cache[i] = static_cast<uint8_t>(cardinality >> (i * 8));
+    }
+    return cardinality;
+}
+
+bool Merge(std::string_view hll, Registers& registers) {
+    if (!IsSparse(hll)) {
+        MergeDense(Bytes(hll) + kHeaderSize, registers);
+        return true;
+    }
+    return ForEachRun(hll, [&registers](size_t first, size_t length, uint8_t value) {
+        if (value != 0) {
+            for (size_t i = first; i < first + length; ++i) {
+                registers[i] = std::max(registers[i], value);
+            }
+        }
+    });
+}
+
+uint64_t Count(const Registers& registers) { return Estimate(SumRegisters(registers)); }
+
+void Store(const Registers& registers, MTS& hll, bool sparse, size_t sparse_max_bytes) {
+    if (sparse) {
+        MTS encoded(hll.data(), kHeaderSize);
+        encoded[kEncodingOffset] = static_cast<char>(kSparse);
+        if (EncodeSparse(registers, encoded, sparse_max_bytes)) {
+            hll.swap(encoded);
+            InvalidateCache(hll);
+            return;
+        }
+    }
+    MTS dense(kDenseSize, '\0');
+    std::memcpy(dense.data(), hll.data(), kHeaderSize);
+    dense[kEncodingOffset] = static_cast<char>(kDense);
+    auto* packed = Bytes(dense) + kHeaderSize;
+    for (size_t i = 0; i < kRegisters; ++i) {
+        SetDense(packed, i, registers[i]);
+    }
+    hll.swap(dense);
+    InvalidateCache(hll);
+}
+
+} // namespace rdss::hyperloglog
@@ -0,0 +1,62 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/tracking_hash_table.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/// A HyperLogLog is a string in the layout of Redis, so that it's saved, loaded and replicated as
+/// any other string, and GET / SET of it are compatible with Redis. It's a 16 bytes header ("HYLL",
+/// the encoding, 3 unused bytes and the cached cardinality in little endian, whose MSB marks it
+/// stale) followed by 16384 registers of 6 bits in one of the encodings:
+///   Dense: the registers packed in 12288 bytes, the LSBs of a register first.
+///   Sparse: runs of registers, as ZERO (00xxxxxx, 1-64 zero registers), XZERO (01xxxxxx yyyyyyyy,
+///     1-16384 zero registers) and VAL (1vvvvvxx, 1-4 registers of value 1-32).
+/// A new HyperLogLog is sparse, and it's converted to dense once a register exceeds 32 or the
+/// sparse representation exceeds 'sparse_max_bytes', and never converted back.
+///
+/// Merging and counting many of them go through Registers, a register per byte, which the dense
+/// registers are unpacked into and maxed with in blocks of 32 with AVX2, and whose harmonic sum
+/// for the estimate is also computed with AVX2.
+namespace rdss::hyperloglog {
+
+constexpr size_t kPrecision = 14;
+constexpr size_t kRegisters = size_t{1} << kPrecision;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kDenseSize = kHeaderSize + kRegisters * 6 / 8;
+
+using Registers = std::array<uint8_t, kRegisters>;
+
+/// Returns an empty sparse HyperLogLog.
+MTS Create();
+
+/// Returns true if 'str' has a valid header, which doesn't check the sparse registers.
+bool IsValid(std::string_view str);
+
+/// Returns true if 'hll' is sparse encoded. 'hll' should be valid.
+bool IsSparse(std::string_view hll);
+
+/// Adds 'element' to valid 'hll', converting it to dense if needed. Returns whether a register is
+/// updated, or nullopt if 'hll' is corrupted.
+std::optional<bool> Add(MTS& hll, std::string_view element, size_t sparse_max_bytes);
+
+/// Returns the estimated cardinality of valid 'hll', which is cached in it, or nullopt if 'hll' is
+/// corrupted.
+std::optional<uint64_t> Count(MTS& hll);
+
+/// Sets every register in 'registers' to the max of it and the one of valid 'hll'. Returns false
+/// if 'hll' is corrupted.
+bool Merge(std::string_view hll, Registers& registers);
+
+/// Returns the estimated cardinality of the union whose registers are 'registers'.
+uint64_t Count(const Registers& registers);
+
+/// Replaces the registers of valid 'hll' with 'registers'. It's kept sparse if 'sparse' and the
+/// registers fit in 'sparse_max_bytes', otherwise it becomes dense.
+void Store(const Registers& registers, MTS& hll, bool sparse, size_t sparse_max_bytes);
+
+} // namespace rdss::hyperloglog
@@ -0,0 +1,166 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "data_structure/list_value.h"
+
+#include "data_structure/listpack.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace rdss {
+
+bool ListValue::Fits(const Chunk& chunk, std::string_view element, const Limits& limits) {
+    if (limits.max_listpack_size > 0) {
+        return chunk.size < static_cast<uint32_t>(limits.max_listpack_size);
+    }
+    const auto level = std::clamp(-limits.max_listpack_size, 1, 5);
+    const size_t max_bytes = size_t{4096} << (level - 1);
+    return chunk.entries.size() + listpack::EntrySize(element) <= max_bytes;
+}
+
+void ListValue::PushFront(std::string_view element, const Limits& limits) {
+    if (chunks_.empty() || !Fits(chunks_.front(), element, limits)) {
+        chunks_.emplace_front();
+    }
+    auto& chunk = chunks_.front();
+    listpack::Insert(chunk.entries, 0, element);
+    ++chunk.size;
+    ++size_;
+}
+
+void ListValue::PushBack(std::string_view element, const Limits& limits) {
+    if (chunks_.empty() || !Fits(chunks_.back(), element, limits)) {
+        chunks_.emplace_back();
+    }
+    auto& chunk = chunks_.back();
+    listpack::Append(chunk.entries, element);
+    ++chunk.size;
+    ++size_;
+}
+
+StringValue ListValue::PopFront() {
+    if (size_ == 0) {
+        return {};
+    }
+    auto& chunk = chunks_.front();
+    size_t pos{0};
+    StringValue value(listpack::Next(chunk.entries, pos));
+    chunk.entries.erase(0, pos);
+    if (--chunk.size == 0) {
+        chunks_.pop_front();
+    }
+    --size_;
+    return value;
+}
+
+StringValue ListValue::PopBack() {
+    if (size_ == 0) {
+        return {};
+    }
+    auto& chunk = chunks_.back();
+    auto end = chunk.entries.size();
+    StringValue value(listpack::Prev(chunk.entries, end));
+    chunk.entries.resize(end);
+    if (--chunk.size == 0) {
+        chunks_.pop_back();
+    }
+    --size_;
+    return value;
+}
+
+void ListValue::Range(
+  size_t start, size_t stop, const std::function<void(std::string_view)>& func) const {
+    if (size_ == 0) {
+        return;
+    }
+    stop = std::min(stop, size_ - 1);
+    if (start > stop) {
+        return;
+    }
+
+    // Finds the chunk of 'start' from the closer end, skipping the chunks before it as a whole.
+    auto chunk = chunks_.begin();
+    size_t first{start};
+    if (start < size_ / 2) {
+        while (first >= chunk->size) {
+            first -= chunk->size;
+            ++chunk;
+        }
+    } else {
+        chunk = chunks_.end();
+        size_t chunk_begin{size_};
+        do {
+            --chunk;
+            chunk_begin -= chunk->size;
+        } while (chunk_begin > start);
+        first = start - chunk_begin;
+    }
+
+    for (auto remaining = stop - start + 1; remaining != 0; ++chunk) {
+        const std::string_view entries{chunk->entries};
+        size_t pos{0};
+        for (size_t i = 0; i < first; ++i) {
+            listpack::Next(entries, pos);
+        }
+        for (auto i = first; i < chunk->size && remaining != 0; ++i, --remaining) {
+            func(listpack::Next(entries, pos));
+        }
+        first = 0;
+    }
+}
+
+void ListValue::Trim(size_t start, size_t stop) {
+    if (size_ == 0) {
+        return;
+    }
+    stop = std::min(stop, size_ - 1);
+    if (start > stop) {
+        chunks_.clear();
+        size_ = 0;
+        return;
+    }
+    EraseBack(size_ - 1 - stop);
+    EraseFront(start);
+}
+
+void ListValue::EraseFront(size_t n) {
+    assert(n <= size_);
+    while (n != 0 && n >= chunks_.front().size) {
+        n -= chunks_.front().size;
+        size_ -= chunks_.front().size;
+        chunks_.pop_front();
+    }
+    if (n == 0) {
+        return;
+    }
+    auto& chunk = chunks_.front();
+    size_t pos{0};
+    for (size_t i = 0; i < n; ++i) {
+        listpack::Next(chunk.entries, pos);
+    }
+    chunk.entries.erase(0, pos);
+    chunk.size -= static_cast<uint32_t>(n);
+    size_ -= n;
+}
+
+void ListValue::EraseBack(size_t n) {
+    assert(n <= size_);
+    while (n != 0 && n >= chunks_.back().size) {
+        n -= chunks_.back().size;
+        size_ -= chunks_.back().size;
+        chunks_.pop_back();
+    }
+    if (n == 0) {
+        return;
+    }
+    auto& chunk = chunks_.back();
+    auto end = chunk.entries.size();
+    for (size_t i = 0; i < n; ++i) {
+        listpack::Prev(chunk.entries, end);
+    }
+    chunk.entries.resize(end);
+    chunk.size -= static_cast<uint32_t>(n);
+    size_ -= n;
+}
+
+} // namespace rdss
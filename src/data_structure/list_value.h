@@ -0,0 +1,81 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/tracking_hash_table.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string_view>
+
+namespace rdss {
+
+/// Value of list type. Like the quicklist of Redis, it's a linked list of chunks, each of which is
+/// a listpack of consecutive elements (see listpack.h), so an element takes a couple of bytes
+/// besides itself instead of a node, and a range is read from a few contiguous buffers. Pushing and
+/// popping at the ends moves at most a chunk.
+class ListValue {
+public:
+    struct Limits {
+        /// Bound of a chunk, like list-max-listpack-size of Redis. A positive value is the max
+        /// number of elements of a chunk, and -1 to -5 bound its size to 4 KB to 64 KB. An element
+        /// that is larger than the bound is put into a chunk of its own.
+        int32_t max_listpack_size = -2;
+    };
+
+public:
+    ListValue() = default;
+
+    ListValue(const ListValue&) = default;
+
+    ListValue& operator=(const ListValue&) = delete;
+
+    /// Returns the number of elements.
+    size_t Size() const { return size_; }
+
+    size_t NumChunks() const { return chunks_.size(); }
+
+    void PushFront(std::string_view element, const Limits& limits);
+
+    void PushBack(std::string_view element, const Limits& limits);
+
+    /// Removes and returns the first element, or null value if the list is empty.
+    StringValue PopFront();
+
+    /// Removes and returns the last element, or null value if the list is empty.
+    StringValue PopBack();
+
+    /// Calls 'func' with the elements from index 'start' to 'stop' inclusively, 'stop' is clamped
+    /// to the last element. The elements are valid until the list is modified.
+    void Range(size_t start, size_t stop, const std::function<void(std::string_view)>& func) const;
+
+    /// Calls 'func' with every element, see Range().
+    void ForEach(const std::function<void(std::string_view)>& func) const {
+        if (size_ != 0) {
+            Range(0, size_ - 1, func);
+        }
+    }
+
+    /// Keeps the elements from index 'start' to 'stop' inclusively, 'stop' is clamped to the last
+    /// element. All the elements are removed if the range is empty.
+    void Trim(size_t start, size_t stop);
+
+private:
+    struct Chunk {
+        MTS entries;
+        uint32_t size{0};
+    };
+
+    // Returns if 'element' can be added to 'chunk' within 'limits'.
+    static bool Fits(const Chunk& chunk, std::string_view element, const Limits& limits);
+
+    // Removes the first / last 'n' elements, 'n' should be at most Size().
+    void EraseFront(size_t n);
+    void EraseBack(size_t n);
+
+    std::list<Chunk, Mallocator<Chunk>> chunks_;
+    size_t size_{0};
+};
+
+} // namespace rdss
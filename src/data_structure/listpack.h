@@ -0,0 +1,98 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/tracking_hash_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/// A listpack is a buffer of strings stored one after another, which is the compact encoding of
+/// small hashes and of the chunks of lists. Like the listpack of Redis, an entry is the length of
+/// the string in LEB128, the string, and the length of both in LEB128 with the bytes reversed, so
+/// that it takes 2 bytes besides a short string and can be walked from either end.
+namespace rdss::listpack {
+
+namespace detail {
+
+constexpr size_t kMaxLengthBytes = 10;
+
+// Writes 'length' in LEB128 to 'out', returns the number of bytes written.
+inline size_t EncodeLength(size_t length, uint8_t* out) {
+    size_t n{0};
+    while (length >= 0x80) {
+        out[n++] = static_cast<uint8_t>((length & 0x7f) | 0x80);
+        length >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(length);
+    return n;
+}
+
+inline size_t LengthBytes(size_t length) {
+    size_t n{1};
+    while (length >= 0x80) {
+        length >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+} // namespace detail
+
+/// Returns the number of bytes of the entry of 'str'.
+inline size_t EntrySize(std::string_view str) {
+    const auto forward = detail::LengthBytes(str.size()) + str.size();
+    return forward + detail::LengthBytes(forward);
+}
+
+/// Inserts the entry of 'str' at byte 'pos', which should be the start of an entry or the end.
+inline void Insert(MTS& listpack, size_t pos, std::string_view str) {
+    uint8_t length[detail::kMaxLengthBytes];
+    const auto length_bytes = detail::EncodeLength(str.size(), length);
+    uint8_t back[detail::kMaxLengthBytes];
+    const auto back_bytes = detail::EncodeLength(length_bytes + str.size(), back);
+
+    listpack.insert(pos, length_bytes + str.size() + back_bytes, '\0');
+    auto* out = reinterpret_cast<uint8_t*>(listpack.data() + pos);
+    std::memcpy(out, length, length_bytes);
+    std::memcpy(out + length_bytes, str.data(), str.size());
+    for (size_t i = 0; i < back_bytes; ++i) {
+        out[length_bytes + str.size() + i] = back[back_bytes - 1 - i];
+    }
+}
+
+inline void Append(MTS& listpack, std::string_view str) { Insert(listpack, listpack.size(), str); }
+
+/// Returns the string of the entry starting at 'pos', and moves 'pos' to the next entry.
+inline std::string_view Next(std::string_view listpack, size_t& pos) {
+    const auto begin = pos;
+    size_t length{0};
+    for (size_t shift = 0;; shift += 7) {
+        const auto byte = static_cast<uint8_t>(listpack[pos++]);
+        length |= static_cast<size_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    const auto str = listpack.substr(pos, length);
+    pos += length + detail::LengthBytes(pos - begin + length);
+    return str;
+}
+
+/// Returns the string of the entry ending at 'end', and moves 'end' to the start of the entry.
+inline std::string_view Prev(std::string_view listpack, size_t& end) {
+    size_t forward{0};
+    for (size_t shift = 0;; shift += 7) {
+        const auto byte = static_cast<uint8_t>(listpack[--end]);
+        forward |= static_cast<size_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    end -= forward;
+    auto pos = end;
+    return Next(listpack, pos);
+}
+
+} // namespace rdss::listpack
@@ -0,0 +1,181 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "data_structure/set_value.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <memory>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace rdss {
+
+namespace {
+
+using TableAllocator = Mallocator<SetValue::Table>;
+
+// Beyond this ratio of sizes, searching the integers of the smaller side in the larger one is
+// faster than merging.
+constexpr size_t kSearchRatio = 32;
+
+std::string_view IntToChars(int64_t i, StringValue::IntChars& chars) {
+    auto [ptr, _] = std::to_chars(chars.data(), chars.data() + chars.size(), i);
+    return {chars.data(), static_cast<size_t>(ptr - chars.data())};
+}
+
+size_t
+IntersectBySearch(std::span<const int64_t> small, std::span<const int64_t> large, int64_t* out) {
+    size_t n{0};
+    auto begin = large.begin();
+    for (const auto i : small) {
+        begin = std::lower_bound(begin, large.end(), i);
+        if (begin == large.end()) {
+            break;
+        }
+        if (*begin == i) {
+            out[n++] = i;
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+SetValue::SetValue(const SetValue& other)
+  : intset_(other.intset_) {
+    if (other.table_ == nullptr) {
+        return;
+    }
+    auto* mem = TableAllocator().allocate(1);
+    table_ = new (mem) Table();
+    other.ForEach([this](std::string_view member) { table_->Upsert(member, {}); });
+}
+
+SetValue::~SetValue() {
+    if (table_ != nullptr) {
+        std::destroy_at(table_);
+        TableAllocator().deallocate(table_, 1);
+    }
+}
+
+size_t SetValue::Size() const { return table_ == nullptr ? intset_.size() : table_->Count(); }
+
+bool SetValue::Contains(std::string_view member) const {
+    if (table_ != nullptr) {
+        return table_->Find(member) != nullptr;
+    }
+    const auto i = detail::ParseCanonicalInt(member);
+    return i.has_value() && std::binary_search(intset_.begin(), intset_.end(), i.value());
+}
+
+bool SetValue::Add(std::string_view member, const Limits& limits) {
+    if (table_ == nullptr) {
+        const auto i = detail::ParseCanonicalInt(member);
+        if (i.has_value()) {
+            const auto it = std::lower_bound(intset_.begin(), intset_.end(), i.value());
+            if (it != intset_.end() && *it == i.value()) {
+                return false;
+            }
+            if (intset_.size() < limits.max_intset_entries) {
+                intset_.insert(it, i.value());
+                return true;
+            }
+        }
+        ConvertToTable();
+    }
+    return table_->Insert(member, {}).second;
+}
+
+bool SetValue::Erase(std::string_view member) {
+    if (table_ != nullptr) {
+        return table_->Erase(member);
+    }
+    const auto i = detail::ParseCanonicalInt(member);
+    if (!i.has_value()) {
+        return false;
+    }
+    const auto it = std::lower_bound(intset_.begin(), intset_.end(), i.value());
+    if (it == intset_.end() || *it != i.value()) {
+        return false;
+    }
+    intset_.erase(it);
+    return true;
+}
+
+void SetValue::ForEach(const std::function<void(std::string_view)>& func) const {
+    if (table_ != nullptr) {
+        size_t cursor{0};
+        do {
+            cursor = table_->TraverseBucket(
+              cursor, [&func](Table::EntryPointer entry) { func(entry->Key()); });
+        } while (cursor != 0);
+        return;
+    }
+    StringValue::IntChars chars;
+    for (const auto i : intset_) {
+        func(IntToChars(i, chars));
+    }
+}
+
+void SetValue::ConvertToTable() {
+    assert(table_ == nullptr);
+    auto* mem = TableAllocator().allocate(1);
+    auto* table = new (mem) Table();
+    ForEach([table](std::string_view member) { table->Insert(member, {}); });
+    table_ = table;
+    Intset().swap(intset_);
+}
+
+size_t IntersectSorted(std::span<const int64_t> a, std::span<const int64_t> b, int64_t* out) {
+    if (a.size() > b.size()) {
+        std::swap(a, b);
+    }
+    if (a.size() * kSearchRatio < b.size()) {
+        return IntersectBySearch(a, b, out);
+    }
+
+    size_t i{0};
+    size_t j{0};
+    size_t n{0};
+#ifdef __AVX2__
+    // Compares a block of 'a' with a block of 'b' and its 3 rotations, which covers every pair of
+    // them, then moves on from the block with the smaller max, or both if they are equal. A match
+    // is found in the block of 'b' that covers its value, so it's written once.
+    while (i + 4 <= a.size() && j + 4 <= b.size()) {
+        const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.data() + i));
+        const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.data() + j));
+        const auto eq0 = _mm256_cmpeq_epi64(va, vb);
+        const auto eq1 = _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0b00111001));
+        const auto eq2 = _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0b01001110));
+        const auto eq3 = _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0b10010011));
+        const auto eq = _mm256_or_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq2, eq3));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+        while (mask != 0) {
+            out[n++] = a[i + static_cast<size_t>(std::countr_zero(mask))];
+            mask &= mask - 1;
+        }
+        const auto a_max = a[i + 3];
+        const auto b_max = b[j + 3];
+        i += (a_max <= b_max) ? 4 : 0;
+        j += (b_max <= a_max) ? 4 : 0;
+    }
+#endif
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            out[n++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    return n;
+}
+
+} // namespace rdss
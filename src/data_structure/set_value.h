@@ -0,0 +1,82 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/flat_hash_table.h"
+#include "data_structure/tracking_hash_table.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace rdss {
+
+/// Value of set type. Like the intset of Redis, a set whose members are all canonical integers is
+/// encoded as a sorted array of them, which takes 8 bytes per member, is searched by binary search,
+/// and is intersected with other ones by a vectorized merge, see IntersectSorted(). Once a member
+/// isn't an integer, or it has more than 'max_intset_entries' members, it's converted to a
+/// FlatHashTable, and it's never converted back.
+class SetValue {
+public:
+    enum class Encoding : uint8_t { kIntset, kTable };
+
+    struct Limits {
+        size_t max_intset_entries = 512;
+    };
+
+    using Table = FlatHashTable<std::monostate>;
+    using Intset = std::vector<int64_t, Mallocator<int64_t>>;
+
+public:
+    SetValue() = default;
+
+    SetValue(const SetValue& other);
+
+    SetValue& operator=(const SetValue&) = delete;
+
+    ~SetValue();
+
+    Encoding GetEncoding() const {
+        return table_ == nullptr ? Encoding::kIntset : Encoding::kTable;
+    }
+
+    /// Returns the number of members.
+    size_t Size() const;
+
+    bool Contains(std::string_view member) const;
+
+    /// Adds 'member', converting the intset to a table if it doesn't fit in 'limits'. Returns true
+    /// if the member is new.
+    bool Add(std::string_view member, const Limits& limits);
+
+    /// Removes 'member', returns false if there is no such member.
+    bool Erase(std::string_view member);
+
+    /// Calls 'func' with every member, which is valid during the call. The set shouldn't be
+    /// modified meanwhile.
+    void ForEach(const std::function<void(std::string_view)>& func) const;
+
+    /// Returns the members of the intset encoding in ascending order.
+    std::span<const int64_t> Ints() const {
+        assert(table_ == nullptr);
+        return intset_;
+    }
+
+private:
+    void ConvertToTable();
+
+    Intset intset_;
+    // Allocated on conversion, so that an intset doesn't carry an empty table.
+    Table* table_{nullptr};
+};
+
+/// Writes the integers in both 'a' and 'b', which are sorted without duplicates, to 'out' in
+/// ascending order, and returns the number of them. 'out' should have room for the smaller of 'a'
+/// and 'b'. With AVX2, blocks of 4 integers of each side are compared all against all at once;
+/// when one side is much smaller, its integers are searched in the other one instead.
+size_t IntersectSorted(std::span<const int64_t> a, std::span<const int64_t> b, int64_t* out);
+
+} // namespace rdss
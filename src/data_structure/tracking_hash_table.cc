@@ -2,8 +2,17 @@
 // Licensed under the MIT license.
 #include "data_structure/tracking_hash_table.h"
 
+#include "data_structure/hash_value.h"
+#include "data_structure/list_value.h"
+#include "data_structure/set_value.h"
+#include "data_structure/zset_value.h"
+
 #include "glog/logging.h"
 
+#include <charconv>
+#include <cstring>
+#include <optional>
+
 namespace rdss {
 
 MTSPtr CreateMTSPtr(std::string_view sv) {
@@ -11,4 +20,201 @@ MTSPtr CreateMTSPtr(std::string_view sv) {
     return std::allocate_shared<MTS>(Mallocator<MTS>(), sv);
 }
 
+namespace detail {
+
+std::optional<int64_t> ParseCanonicalInt(std::string_view sv) {
+    if (sv.empty() || sv.size() > StringValue::kMaxIntChars) {
+        return std::nullopt;
+    }
+    if ((sv[0] == '0' && sv.size() > 1) || (sv[0] == '-' && (sv.size() == 1 || sv[1] == '0'))) {
+        return std::nullopt;
+    }
+    int64_t value;
+    const auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    if (ec != std::errc{} || ptr != sv.data() + sv.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace detail
+
+StringValue::StringValue(std::string_view sv) {
+    if (auto i = detail::ParseCanonicalInt(sv); i.has_value()) {
+        int_ = i.value();
+        encoding_ = Encoding::kInt;
+    } else if (sv.size() <= kEmbeddedCapacity) {
+        sv.copy(embedded_, sv.size());
+        size_ = static_cast<uint8_t>(sv.size());
+        encoding_ = Encoding::kEmbedded;
+    } else {
+        new (&raw_) MTSPtr(CreateMTSPtr(sv));
+        encoding_ = Encoding::kRaw;
+    }
+}
+
+StringValue::StringValue(MTSPtr str) {
+    if (str == nullptr) {
+        return;
+    }
+    new (&raw_) MTSPtr(std::move(str));
+    encoding_ = Encoding::kRaw;
+}
+
+StringValue StringValue::CreateHash() {
+    StringValue value;
+    auto* mem = Mallocator<HashValue>().allocate(1);
+    value.hash_ = new (mem) HashValue();
+    value.encoding_ = Encoding::kHash;
+    return value;
+}
+
+StringValue StringValue::CreateList() {
+    StringValue value;
+    auto* mem = Mallocator<ListValue>().allocate(1);
+    value.list_ = new (mem) ListValue();
+    value.encoding_ = Encoding::kList;
+    return value;
+}
+
+StringValue StringValue::CreateSet() {
+    StringValue value;
+    auto* mem = Mallocator<SetValue>().allocate(1);
+    value.set_ = new (mem) SetValue();
+    value.encoding_ = Encoding::kSet;
+    return value;
+}
+
+StringValue StringValue::CreateZSet() {
+    StringValue value;
+    auto* mem = Mallocator<ZSetValue>().allocate(1);
+    value.zset_ = new (mem) ZSetValue();
+    value.encoding_ = Encoding::kZSet;
+    return value;
+}
+
+void StringValue::Reset() {
+    if (encoding_ == Encoding::kRaw) {
+        raw_.~MTSPtr();
+    } else if (encoding_ == Encoding::kHash) {
+        hash_->~HashValue();
+        Mallocator<HashValue>().deallocate(hash_, 1);
+    } else if (encoding_ == Encoding::kList) {
+        list_->~ListValue();
+        Mallocator<ListValue>().deallocate(list_, 1);
+    } else if (encoding_ == Encoding::kSet) {
+        set_->~SetValue();
+        Mallocator<SetValue>().deallocate(set_, 1);
+    } else if (encoding_ == Encoding::kZSet) {
+        zset_->~ZSetValue();
+        Mallocator<ZSetValue>().deallocate(zset_, 1);
+    }
+    int_ = 0;
+    size_ = 0;
+    encoding_ = Encoding::kNull;
+}
+
+size_t StringValue::Size() const {
+    switch (encoding_) {
+    case Encoding::kNull:
+        return 0;
+    case Encoding::kInt: {
+        IntChars chars;
+        return View(chars).size();
+    }
+    case Encoding::kEmbedded:
+        return size_;
+    case Encoding::kRaw:
+        return raw_->size();
+    case Encoding::kHash:
+    case Encoding::kList:
+    case Encoding::kSet:
+    case Encoding::kZSet:
+        assert(false);
+        return 0;
+    }
+    return 0;
+}
+
+std::string_view StringValue::View(IntChars& chars) const {
+    switch (encoding_) {
+    case Encoding::kNull:
+        return {};
+    case Encoding::kInt: {
+        const auto res = std::to_chars(chars.data(), chars.data() + chars.size(), int_);
+        assert(res.ec == std::errc{});
+        return {chars.data(), static_cast<size_t>(res.ptr - chars.data())};
+    }
+    case Encoding::kEmbedded:
+        return {embedded_, size_};
+    case Encoding::kRaw:
+        return {raw_->data(), raw_->size()};
+    case Encoding::kHash:
+    case Encoding::kList:
+    case Encoding::kSet:
+    case Encoding::kZSet:
+        assert(false);
+        return {};
+    }
+    return {};
+}
+
+MTS& StringValue::MakeRaw() {
+    assert(IsNull() || IsString());
+    if (encoding_ == Encoding::kRaw && raw_.use_count() == 1) {
+        return *raw_;
+    }
+    IntChars chars;
+    auto str = CreateMTSPtr(View(chars));
+    Reset();
+    new (&raw_) MTSPtr(std::move(str));
+    encoding_ = Encoding::kRaw;
+    return *raw_;
+}
+
+void StringValue::CopyFrom(const StringValue& other) {
+    if (other.encoding_ == Encoding::kRaw) {
+        new (&raw_) MTSPtr(other.raw_);
+    } else if (other.encoding_ == Encoding::kHash) {
+        auto* mem = Mallocator<HashValue>().allocate(1);
+        hash_ = new (mem) HashValue(*other.hash_);
+    } else if (other.encoding_ == Encoding::kList) {
+        auto* mem = Mallocator<ListValue>().allocate(1);
+        list_ = new (mem) ListValue(*other.list_);
+    } else if (other.encoding_ == Encoding::kSet) {
+        auto* mem = Mallocator<SetValue>().allocate(1);
+        set_ = new (mem) SetValue(*other.set_);
+    } else if (other.encoding_ == Encoding::kZSet) {
+        auto* mem = Mallocator<ZSetValue>().allocate(1);
+        zset_ = new (mem) ZSetValue(*other.zset_);
+    } else {
+        std::memcpy(embedded_, other.embedded_, kEmbeddedCapacity);
+    }
+    size_ = other.size_;
+    encoding_ = other.encoding_;
+}
+
+void StringValue::MoveFrom(StringValue&& other) {
+    if (other.encoding_ == Encoding::kRaw) {
+        new (&raw_) MTSPtr(std::move(other.raw_));
+    } else if (other.encoding_ == Encoding::kHash) {
+        hash_ = other.hash_;
+    } else if (other.encoding_ == Encoding::kList) {
+        list_ = other.list_;
+    } else if (other.encoding_ == Encoding::kSet) {
+        set_ = other.set_;
+    } else if (other.encoding_ == Encoding::kZSet) {
+        zset_ = other.zset_;
+    } else {
+        std::memcpy(embedded_, other.embedded_, kEmbeddedCapacity);
+    }
+    size_ = other.size_;
+    encoding_ = other.encoding_;
+    if (!IsString()) {
+        // The hash, list, set or sorted set is taken over, so resetting 'other' mustn't destroy it.
+        other.encoding_ = Encoding::kNull;
+    }
+    other.Reset();
+}
+
 } // namespace rdss
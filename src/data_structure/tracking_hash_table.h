@@ -5,8 +5,11 @@
 #include "base/memory.h"
 #include "data_structure/hash_table.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace rdss {
@@ -14,8 +17,205 @@ namespace rdss {
 // MTS for Memory Tracked String.
 using MTS = std::basic_string<char, std::char_traits<char>, Mallocator<char>>;
 using MTSPtr = std::shared_ptr<MTS>;
-using MTSHashTable = HashTable<MTSPtr>;
 
 MTSPtr CreateMTSPtr(std::string_view sv);
 
+namespace detail {
+
+// Returns the integer if 'sv' is the canonical form of an int64, i.e. converting it back results in
+// the same string.
+std::optional<int64_t> ParseCanonicalInt(std::string_view sv);
+
+} // namespace detail
+
+class HashValue;
+class ListValue;
+class SetValue;
+class ZSetValue;
+
+/// Value of a key, a tagged union of the types tagged by 'Encoding'. Despite the name, it holds
+/// every type, the name is kept from when only strings were supported.
+///
+/// Like the int / embstr encodings of Redis, a string that is the canonical form of an int64 is
+/// stored as integer, and other short strings are embedded, so neither of them allocates. Only long
+/// strings are stored as refcounted MTS, which can be shared with the replies and sent without
+/// copying.
+///
+/// A value of hash, list, set or sorted set type is held as an owned HashValue / ListValue /
+/// SetValue / ZSetValue pointer, so that the entries of all the types have the same size. The
+/// string accessors shouldn't be used on them, the commands check the type and reply WRONGTYPE.
+///
+/// A null value holds nothing, e.g. the value of a key just created, or the nil of a reply.
+class StringValue {
+public:
+    enum class Encoding : uint8_t { kNull, kInt, kEmbedded, kRaw, kHash, kList, kSet, kZSet };
+
+    /// Strings no longer than this are embedded, which keeps the value in 24 bytes.
+    static constexpr size_t kEmbeddedCapacity = 14;
+    /// Max number of chars of int64 in decimal, i.e. "-9223372036854775808".
+    static constexpr size_t kMaxIntChars = 20;
+    /// Max size of the string of int or embedded value.
+    static constexpr size_t kMaxInlineSize = std::max(kEmbeddedCapacity, kMaxIntChars);
+
+    /// Buffer for viewing int encoded value as string.
+    using IntChars = std::array<char, kMaxIntChars>;
+
+public:
+    StringValue() {}
+
+    StringValue(std::nullptr_t) {}
+
+    /// Creates value of 'sv' with the most compact encoding.
+    explicit StringValue(std::string_view sv);
+
+    /// Creates raw encoded value sharing 'str', or null value if 'str' is nullptr.
+    StringValue(MTSPtr str);
+
+    /// Creates value of an empty hash.
+    static StringValue CreateHash();
+
+    /// Creates value of an empty list.
+    static StringValue CreateList();
+
+    /// Creates value of an empty set.
+    static StringValue CreateSet();
+
+    /// Creates value of an empty sorted set.
+    static StringValue CreateZSet();
+
+    /// Creates int encoded value of 'i'.
+    static StringValue FromInt(int64_t i) {
+        StringValue value;
+        value.int_ = i;
+        value.encoding_ = Encoding::kInt;
+        return value;
+    }
+
+    StringValue(const StringValue& other) { CopyFrom(other); }
+
+    StringValue(StringValue&& other) noexcept { MoveFrom(std::move(other)); }
+
+    StringValue& operator=(const StringValue& other) {
+        if (this != &other) {
+            Reset();
+            CopyFrom(other);
+        }
+        return *this;
+    }
+
+    StringValue& operator=(StringValue&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(std::move(other));
+        }
+        return *this;
+    }
+
+    ~StringValue() { Reset(); }
+
+    void Reset();
+
+    Encoding GetEncoding() const { return encoding_; }
+
+    bool IsNull() const { return encoding_ == Encoding::kNull; }
+
+    /// Returns true if it's int, embedded or raw encoded. A null value isn't a string.
+    bool IsString() const {
+        return encoding_ == Encoding::kInt || encoding_ == Encoding::kEmbedded
+               || encoding_ == Encoding::kRaw;
+    }
+
+    bool IsHash() const { return encoding_ == Encoding::kHash; }
+
+    bool IsList() const { return encoding_ == Encoding::kList; }
+
+    bool IsSet() const { return encoding_ == Encoding::kSet; }
+
+    bool IsZSet() const { return encoding_ == Encoding::kZSet; }
+
+    ZSetValue& ZSet() {
+        assert(encoding_ == Encoding::kZSet);
+        return *zset_;
+    }
+
+    const ZSetValue& ZSet() const {
+        assert(encoding_ == Encoding::kZSet);
+        return *zset_;
+    }
+
+    SetValue& Set() {
+        assert(encoding_ == Encoding::kSet);
+        return *set_;
+    }
+
+    const SetValue& Set() const {
+        assert(encoding_ == Encoding::kSet);
+        return *set_;
+    }
+
+    ListValue& List() {
+        assert(encoding_ == Encoding::kList);
+        return *list_;
+    }
+
+    const ListValue& List() const {
+        assert(encoding_ == Encoding::kList);
+        return *list_;
+    }
+
+    HashValue& Hash() {
+        assert(encoding_ == Encoding::kHash);
+        return *hash_;
+    }
+
+    const HashValue& Hash() const {
+        assert(encoding_ == Encoding::kHash);
+        return *hash_;
+    }
+
+    size_t Size() const;
+
+    /// Returns view over the string. Int encoded value is converted to string in 'chars', so the
+    /// returned view is valid as long as both this value and 'chars' are.
+    std::string_view View(IntChars& chars) const;
+
+    /// Returns the integer of int encoded value.
+    int64_t Int() const {
+        assert(encoding_ == Encoding::kInt);
+        return int_;
+    }
+
+    /// Returns the shared string of raw encoded value.
+    const MTSPtr& Raw() const {
+        assert(encoding_ == Encoding::kRaw);
+        return raw_;
+    }
+
+    /// Converts this value to raw encoding with an exclusively owned string if it isn't, and
+    /// returns the string for being modified in place. Null value becomes empty string.
+    MTS& MakeRaw();
+
+private:
+    void CopyFrom(const StringValue& other);
+
+    void MoveFrom(StringValue&& other);
+
+    union {
+        int64_t int_ = 0;
+        char embedded_[kEmbeddedCapacity];
+        MTSPtr raw_;
+        HashValue* hash_;
+        ListValue* list_;
+        SetValue* set_;
+        ZSetValue* zset_;
+    };
+    // Size of embedded string.
+    uint8_t size_{0};
+    Encoding encoding_{Encoding::kNull};
+};
+
+static_assert(sizeof(StringValue) == 24);
+
+using MTSHashTable = HashTable<StringValue>;
+
 } // namespace rdss
@@ -0,0 +1,436 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "data_structure/zset_value.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <numeric>
+
+namespace rdss {
+
+namespace {
+
+// Inserts 'value' at 'pos' of the 'size' elements of 'array'.
+template<typename T>
+void InsertAt(T* array, size_t size, size_t pos, const T& value) {
+    std::copy_backward(array + pos, array + size, array + size + 1);
+    array[pos] = value;
+}
+
+// Removes the element at 'pos' of the 'size' elements of 'array'.
+template<typename T>
+void EraseAt(T* array, size_t size, size_t pos) {
+    std::copy(array + pos + 1, array + size, array + pos);
+}
+
+// Moves 'n' elements between the adjacent nodes 'left' and 'right': the last ones of 'left' to the
+// front of 'right' if 'n' is positive, or the first ones of 'right' to the back of 'left'.
+template<typename T>
+void MoveElements(T* left, size_t left_size, T* right, size_t right_size, ptrdiff_t n) {
+    if (n > 0) {
+        const auto count = static_cast<size_t>(n);
+        std::copy_backward(right, right + right_size, right + right_size + count);
+        std::copy(left + left_size - count, left + left_size, right);
+    } else {
+        const auto count = static_cast<size_t>(-n);
+        std::copy(right, right + count, left + left_size);
+        std::copy(right + count, right + right_size, right);
+    }
+}
+
+} // namespace
+
+struct ZSetValue::Node {
+    bool leaf;
+    uint16_t size{0};
+};
+
+struct ZSetValue::Leaf : ZSetValue::Node {
+    Leaf()
+      : Node{.leaf = true} {}
+
+    Leaf* prev{nullptr};
+    Leaf* next{nullptr};
+    std::array<Item, kNodeCapacity> items;
+};
+
+struct ZSetValue::Inner : ZSetValue::Node {
+    Inner()
+      : Node{.leaf = false} {}
+
+    // 'keys[i]' is the first item under 'children[i]', and 'counts[i]' is the number of items
+    // under it.
+    std::array<Item, kNodeCapacity> keys;
+    std::array<size_t, kNodeCapacity> counts;
+    std::array<Node*, kNodeCapacity> children;
+};
+
+namespace {
+
+template<typename T>
+T* NewNode() {
+    auto* mem = Mallocator<T>().allocate(1);
+    return new (mem) T();
+}
+
+template<typename T>
+void DeleteNode(T* node) {
+    node->~T();
+    Mallocator<T>().deallocate(node, 1);
+}
+
+} // namespace
+
+ZSetValue::ZSetValue(const ZSetValue& other) {
+    other.ForEach([this](std::string_view member, double score) { Set(member, score); });
+}
+
+ZSetValue::~ZSetValue() {
+    if (root_ != nullptr) {
+        Destroy(root_);
+    }
+}
+
+std::optional<double> ZSetValue::Score(std::string_view member) const {
+    auto entry = table_.Find(member);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    return entry->value;
+}
+
+bool ZSetValue::Set(std::string_view member, double score) {
+    auto [entry, exists] = table_.FindOrCreate(member, true);
+    if (exists) {
+        if (entry->value == score) {
+            return false;
+        }
+        EraseItem({entry->value, entry});
+    }
+    entry->value = score;
+    InsertItem({score, entry});
+    return !exists;
+}
+
+bool ZSetValue::Erase(std::string_view member) {
+    auto entry = table_.Find(member);
+    if (entry == nullptr) {
+        return false;
+    }
+    EraseItem({entry->value, entry});
+    table_.Erase(member);
+    return true;
+}
+
+template<typename Pred>
+size_t ZSetValue::CountWhile(Pred pred) const {
+    if (root_ == nullptr) {
+        return 0;
+    }
+    size_t count{0};
+    const Node* node = root_;
+    while (!node->leaf) {
+        // The children before the one whose first key fails 'pred' are counted as a whole, except
+        // the last of them, which might hold the boundary.
+        const auto* inner = static_cast<const Inner*>(node);
+        const auto* keys = inner->keys.data();
+        const auto j
+          = static_cast<size_t>(std::partition_point(keys, keys + inner->size, pred) - keys);
+        if (j == 0) {
+            return count;
+        }
+        count = std::accumulate(inner->counts.begin(), inner->counts.begin() + j - 1, count);
+        node = inner->children[j - 1];
+    }
+    const auto* leaf = static_cast<const Leaf*>(node);
+    const auto* items = leaf->items.data();
+    const auto* end = std::partition_point(items, items + leaf->size, pred);
+    return count + static_cast<size_t>(end - items);
+}
+
+std::optional<size_t> ZSetValue::Rank(std::string_view member) const {
+    auto entry = table_.Find(member);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    const Item item{entry->value, entry};
+    return CountWhile([&item](const Item& other) { return Less(other, item); });
+}
+
+size_t ZSetValue::CountBelow(double score, bool inclusive) const {
+    if (inclusive) {
+        return CountWhile([score](const Item& item) { return item.score <= score; });
+    }
+    return CountWhile([score](const Item& item) { return item.score < score; });
+}
+
+void ZSetValue::Range(
+  size_t start,
+  size_t stop,
+  bool reverse,
+  const std::function<void(std::string_view, double)>& func) const {
+    const auto size = Size();
+    if (size == 0) {
+        return;
+    }
+    stop = std::min(stop, size - 1);
+    if (start > stop) {
+        return;
+    }
+
+    // Descends to the leaf of the first visited rank by the counts, then walks the leaves.
+    auto pos = reverse ? stop : start;
+    const Node* node = root_;
+    while (!node->leaf) {
+        const auto* inner = static_cast<const Inner*>(node);
+        size_t i{0};
+        while (pos >= inner->counts[i]) {
+            pos -= inner->counts[i++];
+        }
+        node = inner->children[i];
+    }
+    const auto* leaf = static_cast<const Leaf*>(node);
+    for (auto remaining = stop - start + 1;;) {
+        const auto& item = leaf->items[pos];
+        func(item.entry->Key(), item.score);
+        if (--remaining == 0) {
+            return;
+        }
+        if (!reverse && ++pos == leaf->size) {
+            leaf = leaf->next;
+            pos = 0;
+        } else if (reverse && pos-- == 0) {
+            leaf = leaf->prev;
+            pos = leaf->size - 1U;
+        }
+    }
+}
+
+bool ZSetValue::Less(const Item& a, const Item& b) {
+    if (a.score != b.score) {
+        return a.score < b.score;
+    }
+    return a.entry->Key() < b.entry->Key();
+}
+
+const ZSetValue::Item& ZSetValue::First(const Node* node) {
+    if (node->leaf) {
+        return static_cast<const Leaf*>(node)->items[0];
+    }
+    return static_cast<const Inner*>(node)->keys[0];
+}
+
+size_t ZSetValue::Count(const Node* node) {
+    if (node->leaf) {
+        return node->size;
+    }
+    const auto& counts = static_cast<const Inner*>(node)->counts;
+    return std::accumulate(counts.begin(), counts.begin() + node->size, size_t{0});
+}
+
+size_t ZSetValue::ChildIndex(const Inner* inner, const Item& item) {
+    const auto* keys = inner->keys.data();
+    const auto* it = std::upper_bound(keys, keys + inner->size, item, Less);
+    // An item less than all the keys is a new first item, which goes to the first child.
+    return it == keys ? 0 : static_cast<size_t>(it - keys) - 1;
+}
+
+void ZSetValue::Destroy(Node* node) {
+    if (node->leaf) {
+        DeleteNode(static_cast<Leaf*>(node));
+        return;
+    }
+    auto* inner = static_cast<Inner*>(node);
+    for (size_t i = 0; i < inner->size; ++i) {
+        Destroy(inner->children[i]);
+    }
+    DeleteNode(inner);
+}
+
+void ZSetValue::InsertItem(const Item& item) {
+    if (root_ == nullptr) {
+        root_ = NewNode<Leaf>();
+    }
+    auto* sibling = InsertInto(root_, item);
+    if (sibling == nullptr) {
+        return;
+    }
+    auto* root = NewNode<Inner>();
+    root->keys[0] = First(root_);
+    root->counts[0] = Count(root_);
+    root->children[0] = root_;
+    root->keys[1] = First(sibling);
+    root->counts[1] = Count(sibling);
+    root->children[1] = sibling;
+    root->size = 2;
+    root_ = root;
+}
+
+ZSetValue::Node* ZSetValue::InsertInto(Node* node, const Item& item) {
+    static constexpr uint16_t kHalf = kNodeCapacity / 2;
+
+    if (node->leaf) {
+        auto* leaf = static_cast<Leaf*>(node);
+        auto* items = leaf->items.data();
+        auto pos
+          = static_cast<size_t>(std::upper_bound(items, items + leaf->size, item, Less) - items);
+        Leaf* sibling{nullptr};
+        if (leaf->size == kNodeCapacity) {
+            // Splits in halves and links the new leaf after this one.
+            sibling = NewNode<Leaf>();
+            std::copy(items + kHalf, items + kNodeCapacity, sibling->items.data());
+            sibling->size = kNodeCapacity - kHalf;
+            leaf->size = kHalf;
+            sibling->prev = leaf;
+            sibling->next = leaf->next;
+            if (leaf->next != nullptr) {
+                leaf->next->prev = sibling;
+            }
+            leaf->next = sibling;
+            if (pos > kHalf) {
+                pos -= kHalf;
+                leaf = sibling;
+            }
+        }
+        InsertAt(leaf->items.data(), leaf->size, pos, item);
+        ++leaf->size;
+        return sibling;
+    }
+
+    auto* inner = static_cast<Inner*>(node);
+    const auto i = ChildIndex(inner, item);
+    auto* child = inner->children[i];
+    auto* split = InsertInto(child, item);
+    inner->keys[i] = First(child);
+    ++inner->counts[i];
+    if (split == nullptr) {
+        return nullptr;
+    }
+
+    const auto split_count = Count(split);
+    inner->counts[i] -= split_count;
+    auto pos = i + 1;
+    Inner* sibling{nullptr};
+    if (inner->size == kNodeCapacity) {
+        sibling = NewNode<Inner>();
+        std::copy(inner->keys.begin() + kHalf, inner->keys.end(), sibling->keys.begin());
+        std::copy(inner->counts.begin() + kHalf, inner->counts.end(), sibling->counts.begin());
+        std::copy(
+          inner->children.begin() + kHalf, inner->children.end(), sibling->children.begin());
+        sibling->size = kNodeCapacity - kHalf;
+        inner->size = kHalf;
+        if (pos > kHalf) {
+            pos -= kHalf;
+            inner = sibling;
+        }
+    }
+    InsertAt(inner->keys.data(), inner->size, pos, First(split));
+    InsertAt(inner->counts.data(), inner->size, pos, split_count);
+    InsertAt(inner->children.data(), inner->size, pos, split);
+    ++inner->size;
+    return sibling;
+}
+
+void ZSetValue::EraseItem(const Item& item) {
+    EraseFrom(root_, item);
+    // The tree shrinks from the root, once it's left with a single child.
+    if (!root_->leaf && root_->size == 1) {
+        auto* root = static_cast<Inner*>(root_);
+        root_ = root->children[0];
+        DeleteNode(root);
+    }
+}
+
+void ZSetValue::EraseFrom(Node* node, const Item& item) {
+    if (node->leaf) {
+        auto* leaf = static_cast<Leaf*>(node);
+        auto* items = leaf->items.data();
+        const auto pos
+          = static_cast<size_t>(std::lower_bound(items, items + leaf->size, item, Less) - items);
+        assert(pos < leaf->size && items[pos].entry == item.entry);
+        EraseAt(items, leaf->size, pos);
+        --leaf->size;
+        return;
+    }
+
+    auto* inner = static_cast<Inner*>(node);
+    const auto i = ChildIndex(inner, item);
+    auto* child = inner->children[i];
+    EraseFrom(child, item);
+    --inner->counts[i];
+    if (child->size < kNodeCapacity / 2) {
+        Rebalance(inner, i);
+    } else {
+        inner->keys[i] = First(child);
+    }
+}
+
+void ZSetValue::Rebalance(Inner* parent, size_t i) {
+    // A node other than the root has at least half of the capacity, so the parent has a sibling to
+    // pair with, the left one unless it's the first child.
+    assert(parent->size > 1);
+    const auto left = (i == 0) ? 0 : i - 1;
+    const auto right = left + 1;
+    auto* l = parent->children[left];
+    auto* r = parent->children[right];
+    const auto total = static_cast<size_t>(l->size) + r->size;
+
+    if (total <= kNodeCapacity) {
+        // Merges the right node into the left one.
+        if (l->leaf) {
+            auto* ll = static_cast<Leaf*>(l);
+            auto* rl = static_cast<Leaf*>(r);
+            std::copy(
+              rl->items.begin(), rl->items.begin() + rl->size, ll->items.begin() + ll->size);
+            ll->next = rl->next;
+            if (rl->next != nullptr) {
+                rl->next->prev = ll;
+            }
+            ll->size = static_cast<uint16_t>(total);
+            DeleteNode(rl);
+        } else {
+            auto* li = static_cast<Inner*>(l);
+            auto* ri = static_cast<Inner*>(r);
+            std::copy(ri->keys.begin(), ri->keys.begin() + ri->size, li->keys.begin() + li->size);
+            std::copy(
+              ri->counts.begin(), ri->counts.begin() + ri->size, li->counts.begin() + li->size);
+            std::copy(
+              ri->children.begin(),
+              ri->children.begin() + ri->size,
+              li->children.begin() + li->size);
+            li->size = static_cast<uint16_t>(total);
+            DeleteNode(ri);
+        }
+        parent->counts[left] += parent->counts[right];
+        EraseAt(parent->keys.data(), parent->size, right);
+        EraseAt(parent->counts.data(), parent->size, right);
+        EraseAt(parent->children.data(), parent->size, right);
+        --parent->size;
+        parent->keys[left] = First(l);
+        return;
+    }
+
+    // Evens out the two nodes.
+    const auto left_size = static_cast<uint16_t>(total / 2);
+    const auto n = static_cast<ptrdiff_t>(l->size) - left_size;
+    if (l->leaf) {
+        auto* ll = static_cast<Leaf*>(l);
+        auto* rl = static_cast<Leaf*>(r);
+        MoveElements(ll->items.data(), ll->size, rl->items.data(), rl->size, n);
+    } else {
+        auto* li = static_cast<Inner*>(l);
+        auto* ri = static_cast<Inner*>(r);
+        MoveElements(li->keys.data(), li->size, ri->keys.data(), ri->size, n);
+        MoveElements(li->counts.data(), li->size, ri->counts.data(), ri->size, n);
+        MoveElements(li->children.data(), li->size, ri->children.data(), ri->size, n);
+    }
+    l->size = left_size;
+    r->size = static_cast<uint16_t>(total - left_size);
+    parent->keys[left] = First(l);
+    parent->keys[right] = First(r);
+    parent->counts[left] = Count(l);
+    parent->counts[right] = Count(r);
+}
+
+} // namespace rdss
@@ -0,0 +1,122 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/hash_table.h"
+#include "data_structure/tracking_hash_table.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace rdss {
+
+/// Value of sorted set type. A HashTable maps each member to its score, and a B+tree orders the
+/// members by score, then by member. Instead of the skiplist of Redis, which allocates a node per
+/// member, the tree keeps up to kNodeCapacity (score, member entry) items in each leaf and links
+/// the leaves, so a range is read from a few contiguous arrays. Its inner nodes keep the number of
+/// items under each child, so finding the rank of a member or the member at a rank takes O(log n).
+/// The items reference the entries of the table for the members, so the member bytes are stored
+/// once.
+class ZSetValue {
+public:
+    using Table = HashTable<double>;
+
+    /// Max number of items of a leaf, and of children of an inner node.
+    static constexpr uint16_t kNodeCapacity = 32;
+
+public:
+    ZSetValue() = default;
+
+    ZSetValue(const ZSetValue& other);
+
+    ZSetValue& operator=(const ZSetValue&) = delete;
+
+    ~ZSetValue();
+
+    /// Returns the number of members.
+    size_t Size() const { return table_.Count(); }
+
+    /// Returns the score of 'member', or nullopt if there is no such member.
+    std::optional<double> Score(std::string_view member) const;
+
+    /// Sets the score of 'member', which shouldn't be NaN. Returns true if the member is new.
+    bool Set(std::string_view member, double score);
+
+    /// Removes 'member', returns false if there is no such member.
+    bool Erase(std::string_view member);
+
+    /// Returns the 0-based rank of 'member' in ascending order, or nullopt if there is no such
+    /// member.
+    std::optional<size_t> Rank(std::string_view member) const;
+
+    /// Returns the number of members whose score is less than 'score', or not greater than 'score'
+    /// if 'inclusive', i.e. the rank of the first member after them.
+    size_t CountBelow(double score, bool inclusive) const;
+
+    /// Calls 'func' with the members and scores from rank 'start' to 'stop' inclusively, 'stop' is
+    /// clamped to the last member. They are visited in ascending order, or from 'stop' down to
+    /// 'start' if 'reverse'. The members are valid until the sorted set is modified.
+    void Range(
+      size_t start,
+      size_t stop,
+      bool reverse,
+      const std::function<void(std::string_view, double)>& func) const;
+
+    /// Calls 'func' with every member and its score in ascending order, see Range().
+    void ForEach(const std::function<void(std::string_view, double)>& func) const {
+        if (Size() != 0) {
+            Range(0, Size() - 1, false, func);
+        }
+    }
+
+private:
+    // Item of the tree, ordered by score, then by member.
+    struct Item {
+        double score;
+        Table::EntryPointer entry;
+    };
+
+    struct Node;
+    struct Leaf;
+    struct Inner;
+
+    static bool Less(const Item& a, const Item& b);
+
+    // Returns the first item under 'node'.
+    static const Item& First(const Node* node);
+
+    // Returns the number of items under 'node'.
+    static size_t Count(const Node* node);
+
+    // Returns the index of the child of 'inner' that 'item' belongs to.
+    static size_t ChildIndex(const Inner* inner, const Item& item);
+
+    static void Destroy(Node* node);
+
+    void InsertItem(const Item& item);
+
+    // Inserts 'item' under 'node', returns the new right sibling if 'node' is split.
+    static Node* InsertInto(Node* node, const Item& item);
+
+    void EraseItem(const Item& item);
+
+    // Erases 'item' under 'node', where it must exist.
+    static void EraseFrom(Node* node, const Item& item);
+
+    // Merges the 'i'th child of 'parent', which is less than half full, with a sibling, or moves
+    // items from the sibling to it if they don't fit in one node.
+    static void Rebalance(Inner* parent, size_t i);
+
+    // Returns the number of items before the first one that 'pred' is false for, 'pred' should be
+    // true for a prefix of the items.
+    template<typename Pred>
+    size_t CountWhile(Pred pred) const;
+
+    // Lookups may rehash the table incrementally, which doesn't change its content.
+    mutable Table table_;
+    Node* root_{nullptr};
+};
+
+} // namespace rdss
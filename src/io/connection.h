@@ -3,9 +3,18 @@
 #pragma once
 
 #include "base/buffer.h"
+#include "io/promise.h"
 #include "runtime/ring_operation.h"
 #include "sys/system_error.h"
 
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+
 namespace rdss::detail {
 
 // TODO: Remove this.
@@ -66,7 +75,7 @@ struct Recv : public RingIO<Recv> {
             return {{}, v};
         }
         buffer->Produce(static_cast<size_t>(result));
-        auto output = buffer->Source();
+        auto output = std::string_view{buffer->Data() - result, static_cast<size_t>(result)};
         return {{}, RingExecutor::BufferView{.view = output}};
     }
 
@@ -78,6 +87,232 @@ struct Recv : public RingIO<Recv> {
     Buffer* buffer;
 };
 
+// Sends 'iovecs' by IORING_OP_SENDMSG_ZC, and resumes 'waiter' with the result of the send. The
+// kernel posts a second completion to the same operation once it no longer references the sent
+// memory, which is usually later than the result, so the operation lives in the frame of this
+// coroutine, which holds 'pinned' until then.
+inline Task<void> SendMsgZeroCopy(
+  RingExecutor* executor,
+  bool use_direct_fd,
+  int fd,
+  std::span<iovec> iovecs,
+  [[maybe_unused]] std::shared_ptr<void> pinned,
+  Continuation* waiter) {
+    struct RingSendMsgZc : public RingOperation<RingSendMsgZc> {
+        RingSendMsgZc(RingExecutor* executor, bool use_direct_fd, int fd, std::span<iovec> iovecs)
+          : RingOperation<RingSendMsgZc>(executor, use_direct_fd)
+          , fd(fd) {
+            msg.msg_iov = iovecs.data();
+            msg.msg_iovlen = iovecs.size();
+        }
+
+        void Prepare(io_uring_sqe* sqe) { io_uring_prep_sendmsg_zc(sqe, fd, &msg, 0); }
+
+        int fd;
+        msghdr msg{};
+    };
+
+    RingSendMsgZc send(executor, use_direct_fd, fd, iovecs);
+    co_await send;
+    const bool notifies = (send.flags & IORING_CQE_F_MORE) != 0;
+    waiter->result = send.result;
+    waiter->flags = send.flags;
+    waiter->handle.resume();
+    if (notifies) {
+        // Resumed by the notification, which is posted to 'send' as well.
+        co_await std::suspend_always{};
+    }
+}
+
+// State of the multishot recv of a connection. One recv keeps posting a completion with an entry
+// of the buffer ring whenever data arrives, until it terminates without IORING_CQE_F_MORE, e.g. at
+// EOF, on error, or when the buffer ring runs out. The completions are queued until the connection
+// takes them. The state is shared with the coroutine reaping the completions, so that it outlives
+// the connection until the recv terminates.
+struct MultishotRecv : public Continuation {
+    struct Completion {
+        int result;
+        uint32_t flags;
+    };
+
+    MultishotRecv(RingExecutor* executor, bool use_direct_fd, int fd, uint16_t buffer_group)
+      : executor(executor)
+      , use_direct_fd(use_direct_fd)
+      , fd(fd)
+      , buffer_group(buffer_group) {}
+
+    void Prepare(io_uring_sqe* sqe) {
+        io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+        sqe->buf_group = buffer_group;
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        if (use_direct_fd) {
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+    }
+
+    // Completions queued before the recv is cancelled, see 'ReapMultishotRecv()'.
+    static constexpr size_t kMaxQueued = 8;
+
+    // Queues the last completion, or returns its buffer if the connection is gone. Running out of
+    // buffers isn't queued, the recv is armed again instead. Neither is being cancelled by
+    // 'Connection::StopRecv()' or by the limit of 'kMaxQueued'.
+    void OnCompletion() {
+        if (detached) {
+            if (result > 0) {
+                executor->PutBufferView(executor->GetBufferView(
+                  flags >> IORING_CQE_BUFFER_SHIFT, static_cast<size_t>(result)));
+            }
+            return;
+        }
+        if (result == -ENOBUFS || result == -ECANCELED) {
+            return;
+        }
+        completions.push_back({.result = result, .flags = flags});
+    }
+
+    // Resumes the connection waiting for data if there is any, or if the recv has terminated. The
+    // connection stopping the recv waits for it to terminate.
+    void Wake() {
+        if (waiter && ((!stopping && !completions.empty()) || !armed)) {
+            std::exchange(waiter, nullptr).resume();
+        }
+    }
+
+    // Returns the buffers of the queued completions, called when the connection is closed. The
+    // connection is no longer resumed.
+    void Detach() {
+        detached = true;
+        waiter = nullptr;
+        for (const auto& completion : completions) {
+            if (completion.result > 0) {
+                executor->PutBufferView(executor->GetBufferView(
+                  completion.flags >> IORING_CQE_BUFFER_SHIFT,
+                  static_cast<size_t>(completion.result)));
+            }
+        }
+        completions.clear();
+    }
+
+    RingExecutor* executor;
+    bool use_direct_fd;
+    int fd;
+    uint16_t buffer_group;
+    std::deque<Completion> completions;
+    // The connection waiting for data.
+    std::coroutine_handle<> waiter;
+    bool armed{false};
+    bool detached{false};
+    bool stopping{false};
+    // Cancelled for queueing 'kMaxQueued' completions.
+    bool throttled{false};
+};
+
+// Cancels the operation 'target', e.g. a multishot recv. Only a failed cancel posts a completion,
+// e.g. when the operation has just terminated by itself, which is ignored, so one operation is
+// shared by the operations cancelled on an executor.
+struct CancelOperation : public Continuation {
+    void Prepare(io_uring_sqe* sqe) {
+        io_uring_prep_cancel64(sqe, reinterpret_cast<uint64_t>(target), 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    }
+
+    Continuation* target;
+};
+
+inline thread_local CancelOperation tls_cancel_operation;
+
+// Arms 'recv' and reaps its completions until it terminates. The buffers of the ring are shared by
+// the connections of the executor, and the queued completions hold them until the connection takes
+// them, which it doesn't while it's executing a batch on the data shards or is blocked. So the recv
+// is cancelled once 'kMaxQueued' completions are queued, and the data arriving after that wait in
+// the socket. If it runs out of buffers, or is cancelled this way, while the connection is waiting,
+// it's armed again right away. Otherwise it's armed by the connection when needed.
+inline Task<void> ReapMultishotRecv(std::shared_ptr<MultishotRecv> recv) {
+    struct NextCompletion : public std::suspend_always {
+        void await_suspend(std::coroutine_handle<> h) {
+            recv->handle = h;
+            if (arm) {
+                recv->executor->Initiate(recv);
+            }
+        }
+
+        MultishotRecv* recv;
+        bool arm;
+    };
+
+    while (true) {
+        co_await NextCompletion{{}, recv.get(), true};
+        bool more{false};
+        do {
+            more = (recv->flags & IORING_CQE_F_MORE) != 0;
+            recv->OnCompletion();
+            if (more) {
+                recv->Wake();
+                if (
+                  !recv->throttled && !recv->stopping && !recv->detached
+                  && recv->completions.size() >= MultishotRecv::kMaxQueued) {
+                    recv->throttled = true;
+                    auto& cancel = tls_cancel_operation;
+                    cancel.handle = std::noop_coroutine();
+                    cancel.target = recv.get();
+                    recv->executor->Initiate(&cancel);
+                }
+                co_await NextCompletion{{}, recv.get(), false};
+            }
+        } while (more);
+        // Cancelling fails if the recv has terminated by itself meanwhile, e.g. at EOF.
+        const bool throttled = std::exchange(recv->throttled, false) && recv->result == -ECANCELED;
+        if (
+          recv->detached || recv->stopping || (recv->result != -ENOBUFS && !throttled)
+          || !recv->waiter) {
+            break;
+        }
+    }
+    recv->armed = false;
+    recv->Wake();
+}
+
+// Poll of a connection for the peer hanging up, see 'Connection::WatchHangup()'. The state is
+// shared with the coroutine reaping the poll, so that it outlives the watch until the poll
+// completes, either by the hangup or by being cancelled.
+struct HangupPoll : public Continuation {
+    HangupPoll(bool use_direct_fd, int fd, std::function<void()> on_hangup)
+      : use_direct_fd(use_direct_fd)
+      , fd(fd)
+      , on_hangup(std::move(on_hangup)) {}
+
+    void Prepare(io_uring_sqe* sqe) {
+        io_uring_prep_poll_add(sqe, fd, POLLRDHUP | POLLHUP | POLLERR);
+        if (use_direct_fd) {
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+    }
+
+    bool use_direct_fd;
+    int fd;
+    std::function<void()> on_hangup;
+    bool completed{false};
+    bool stopped{false};
+};
+
+inline Task<void> ReapHangupPoll(RingExecutor* executor, std::shared_ptr<HangupPoll> poll) {
+    struct Completion : public std::suspend_always {
+        void await_suspend(std::coroutine_handle<> h) {
+            poll->handle = h;
+            executor->Initiate(poll);
+        }
+
+        RingExecutor* executor;
+        HangupPoll* poll;
+    };
+
+    co_await Completion{{}, executor, poll.get()};
+    poll->completed = true;
+    if (!poll->stopped && poll->result > 0) {
+        poll->on_hangup();
+    }
+}
+
 } // namespace rdss::detail
 
 namespace rdss {
@@ -93,9 +328,7 @@ public:
 
     ~Connection() {
         Close();
-        if (descripor_index_ >= 0) {
-            executor_->UnregisterFd(descripor_index_);
-        }
+        Release();
     }
 
     /// Sets the connection to use 'executor' as the executor to do I/O, and to use buffer ring if
@@ -103,12 +336,60 @@ public:
     /// Note: This function should be run inside 'executor_' to avoid data racing.
     void Setup(RingExecutor* executor, bool use_ring_buffer) {
         executor_ = executor;
+        executor_->Load().connections.fetch_add(1, std::memory_order_relaxed);
+        set_up_ = true;
         SetUseRingBuf(use_ring_buffer);
         if (!UsingDirectDescriptor()) {
             TryRegisterFD();
         }
     }
 
+    /// Unregisters the connection from 'executor_', so that it can be set up on another executor
+    /// by Setup(). Should be run inside 'executor_', with no I/O in flight, e.g. after StopRecv()
+    /// returns true.
+    void Release() {
+        if (descripor_index_ >= 0) {
+            executor_->UnregisterFd(descripor_index_);
+            descripor_index_ = -1;
+        }
+        if (set_up_) {
+            executor_->Load().connections.fetch_sub(1, std::memory_order_relaxed);
+            set_up_ = false;
+        }
+        // Recreated for the next executor. An armed recv is detached by Close() already.
+        multishot_recv_.reset();
+    }
+
+    /// Returns an awaitable that terminates the multishot recv if it's armed, and returns true if
+    /// nothing received is queued, so that the connection can be released from 'executor_'.
+    /// Otherwise, the queued data are returned by RecvMultishot() as usual, which arms the recv
+    /// again once they are taken.
+    auto StopRecv() {
+        struct RingStopRecv : public std::suspend_always {
+            bool await_ready() const { return recv == nullptr || !recv->armed; }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                recv->waiter = h;
+                recv->stopping = true;
+                auto& cancel = detail::tls_cancel_operation;
+                cancel.handle = std::noop_coroutine();
+                cancel.target = recv.get();
+                recv->executor->Initiate(&cancel);
+            }
+
+            bool await_resume() {
+                if (recv == nullptr) {
+                    return true;
+                }
+                recv->stopping = false;
+                return recv->completions.empty();
+            }
+
+            std::shared_ptr<detail::MultishotRecv> recv;
+        };
+        return RingStopRecv{{}, multishot_recv_};
+    }
+
     bool UsingDirectDescriptor() const { return descripor_index_ >= 0; }
 
     bool UseRingBuf() const { return use_ring_buf_; }
@@ -120,8 +401,9 @@ public:
     }
 
     /// Buffer ring agnostic recv. Takes 'buffer' to fill the received data, returns [error,
-    /// buffer_view]. If 'this' uses ring buffer by setting 'SetUseRingBuf', performs buffer ring
-    /// based recv: now 'buffer' should be 'virtual_view'.
+    /// buffer_view], where 'buffer_view' only covers the newly received bytes. If 'this' uses ring
+    /// buffer by setting 'SetUseRingBuf', performs buffer ring based recv: now 'buffer' should be
+    /// 'virtual_view'.
     auto Recv(Buffer* buffer) {
         return detail::Recv(
           executor_,
@@ -132,6 +414,56 @@ public:
           buffer);
     }
 
+    /// Like Recv() with buffer ring, but the recv is multishot: it's armed by the first call, and
+    /// keeps receiving into the buffers of the ring while the received data are being served. A
+    /// call returns the data received by one completion in order, and suspends only if none is
+    /// queued. 'buffer' should be 'virtual_view'.
+    auto RecvMultishot(Buffer* buffer) {
+        assert(UseRingBuf());
+        if (multishot_recv_ == nullptr) {
+            multishot_recv_ = std::make_shared<detail::MultishotRecv>(
+              executor_,
+              descripor_index_ >= 0,
+              (descripor_index_ >= 0 ? descripor_index_ : fd_),
+              static_cast<uint16_t>(buffer_group_.value()));
+        }
+
+        struct RingMultishotRecv : public std::suspend_always {
+            bool await_ready() const { return !recv->completions.empty(); }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                recv->waiter = h;
+                if (!recv->armed) {
+                    recv->armed = true;
+                    detail::ReapMultishotRecv(recv);
+                }
+            }
+
+            auto await_resume() -> std::pair<std::error_code, RingExecutor::BufferView> {
+                if (recv->completions.empty()) {
+                    return {ErrnoToErrorCode(ENOBUFS), {}};
+                }
+                const auto completion = recv->completions.front();
+                recv->completions.pop_front();
+                if (completion.result == 0) {
+                    return {};
+                }
+                if (completion.result < 0) {
+                    return {ErrnoToErrorCode(-completion.result), {}};
+                }
+                auto v = recv->executor->GetBufferView(
+                  completion.flags >> IORING_CQE_BUFFER_SHIFT,
+                  static_cast<size_t>(completion.result));
+                buffer->Produce(v.view);
+                return {{}, v};
+            }
+
+            std::shared_ptr<detail::MultishotRecv> recv;
+            Buffer* buffer;
+        };
+        return RingMultishotRecv{{}, multishot_recv_, buffer};
+    }
+
     // TODO: Remove this after echo_server can make use of Connection::Setup
     auto Recv(Buffer::SinkType buffer) {
         struct RingRecv : public detail::RingIO<RingRecv> {
@@ -229,16 +561,103 @@ public:
                                   : RingWritev(executor_, false, fd_, iovecs));
     }
 
+    /// Sends 'iovecs' with zero copy, returns [error, bytes sent] once the send completes. The sent
+    /// memory should stay valid until the kernel notifies that it's no longer referenced, which is
+    /// ensured by holding 'pinned' until then.
+    auto SendZeroCopy(std::span<iovec> iovecs, std::shared_ptr<void> pinned) {
+        struct ZeroCopySend
+          : public Continuation
+          , public std::suspend_always {
+            ZeroCopySend(
+              RingExecutor* executor,
+              bool use_direct_fd,
+              int fd,
+              std::span<iovec> iovecs,
+              std::shared_ptr<void> pinned)
+              : executor(executor)
+              , use_direct_fd(use_direct_fd)
+              , fd(fd)
+              , iovecs(iovecs)
+              , pinned(std::move(pinned)) {}
+
+            void await_suspend(std::coroutine_handle<> h) {
+                handle = std::move(h);
+                detail::SendMsgZeroCopy(
+                  executor, use_direct_fd, fd, iovecs, std::move(pinned), this);
+            }
+
+            auto await_resume() -> std::pair<std::error_code, size_t> {
+                if (result >= 0) {
+                    return {{}, static_cast<size_t>(result)};
+                }
+                return {ErrnoToErrorCode(-result), 0};
+            }
+
+            RingExecutor* executor;
+            bool use_direct_fd;
+            int fd;
+            std::span<iovec> iovecs;
+            std::shared_ptr<void> pinned;
+        };
+        return (
+          (descripor_index_ >= 0)
+            ? ZeroCopySend(executor_, true, descripor_index_, iovecs, std::move(pinned))
+            : ZeroCopySend(executor_, false, fd_, iovecs, std::move(pinned)));
+    }
+
+    /// Polls the connection for the peer hanging up, and calls 'on_hangup' on 'executor_' if it
+    /// does before StopWatchingHangup(). Used while the data received aren't taken, e.g. while the
+    /// client is blocked, when a few of them are queued by the multishot recv and the rest wait in
+    /// the socket, see 'ReapMultishotRecv()', so that the end of the stream might never be seen.
+    void WatchHangup(std::function<void()> on_hangup) {
+        assert(hangup_poll_ == nullptr);
+        hangup_poll_ = std::make_shared<detail::HangupPoll>(
+          descripor_index_ >= 0,
+          (descripor_index_ >= 0 ? descripor_index_ : fd_),
+          std::move(on_hangup));
+        detail::ReapHangupPoll(executor_, hangup_poll_);
+    }
+
+    /// Cancels the poll of WatchHangup() if there is one, 'on_hangup' is no longer called.
+    void StopWatchingHangup() {
+        if (hangup_poll_ == nullptr) {
+            return;
+        }
+        auto poll = std::exchange(hangup_poll_, nullptr);
+        poll->stopped = true;
+        if (!poll->completed) {
+            auto& cancel = detail::tls_cancel_operation;
+            cancel.handle = std::noop_coroutine();
+            cancel.target = poll.get();
+            executor_->Initiate(&cancel);
+        }
+    }
+
     void Close() {
         if (!active_) {
             return;
         }
+        if (multishot_recv_ != nullptr) {
+            multishot_recv_->Detach();
+            // The armed recv holds the socket, shutting it down terminates the recv.
+            if (multishot_recv_->armed && shutdown(fd_, SHUT_RDWR) != 0) {
+                VLOG(1) << "shutdown: " << strerror(errno);
+            }
+        }
         if (close(fd_) != 0) {
             LOG(ERROR) << "close: " << strerror(errno);
         }
         active_ = false;
     }
 
+    /// Shuts down both directions of the socket, which terminates the pending recv, while the
+    /// socket is kept open until Close().
+    void Shutdown() {
+        if (active_ && shutdown(fd_, SHUT_RDWR) != 0) {
+            VLOG(1) << "shutdown: " << strerror(errno);
+        }
+    }
+
     int GetFD() const { return fd_; }
 
     RingExecutor* GetExecutor() { return executor_; }
@@ -261,11 +680,15 @@ private:
 
     bool active_ = true;
     int fd_;
-    RingExecutor* executor_;
+    RingExecutor* executor_{nullptr};
+    // Whether the connection is counted in the load of 'executor_'.
+    bool set_up_{false};
     // Index into 'executor_'s registered fds. Equals -1 if unregistered.
     int descripor_index_ = -1;
     bool use_ring_buf_ = false;
     std::optional<int> buffer_group_;
+    std::shared_ptr<detail::MultishotRecv> multishot_recv_;
+    std::shared_ptr<detail::HangupPoll> hangup_poll_;
 };
 
 } // namespace rdss
@@ -0,0 +1,147 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "io/connection.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string_view>
+
+namespace rdss {
+
+/// Regular file whose reads and writes are done through the ring of 'executor'. Like Connection,
+/// the I/O should be initiated on the executor's thread.
+class File {
+public:
+    File(int fd, RingExecutor* executor)
+      : fd_(fd)
+      , executor_(executor) {}
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    ~File() { Close(); }
+
+    /// Writes 'data' at 'offset', returns [error, bytes written].
+    auto Write(std::string_view data, uint64_t offset) {
+        struct RingWrite : public detail::RingIO<RingWrite> {
+            RingWrite(RingExecutor* executor, int fd, std::string_view data, uint64_t offset)
+              : RingIO<RingWrite>(executor, false)
+              , fd(fd)
+              , data(data)
+              , offset(offset) {}
+
+            void Prepare(io_uring_sqe* sqe) {
+                io_uring_prep_write(
+                  sqe, fd, data.data(), static_cast<uint32_t>(data.size()), offset);
+            }
+
+            int fd;
+            std::string_view data;
+            uint64_t offset;
+        };
+        return RingWrite(executor_, fd_, data, offset);
+    }
+
+    /// Flushes the file to the disk, returns [error, 0].
+    auto Fsync(bool data_only = false) {
+        struct RingFsync : public detail::RingIO<RingFsync> {
+            RingFsync(RingExecutor* executor, int fd, bool data_only)
+              : RingIO<RingFsync>(executor, false)
+              , fd(fd)
+              , data_only(data_only) {}
+
+            void Prepare(io_uring_sqe* sqe) {
+                io_uring_prep_fsync(sqe, fd, data_only ? IORING_FSYNC_DATASYNC : 0);
+            }
+
+            int fd;
+            bool data_only;
+        };
+        return RingFsync(executor_, fd_, data_only);
+    }
+
+    /// Writes 'data' at 'offset' and flushes the file to the disk in one submission, the flush is
+    /// linked after the write. Returns [error, bytes written], the file is flushed only if there is
+    /// no error and all the bytes are written, since a short write cancels the flush.
+    auto WriteAndFsync(std::string_view data, uint64_t offset, bool data_only = false) {
+        struct RingWriteAndFsync
+          : public Continuation
+          , public std::suspend_always {
+            // The write doesn't resume anything, its result is only posted if it fails or is
+            // short, which is before the result of the flush.
+            struct Write : public Continuation {
+                void Prepare(io_uring_sqe* sqe) {
+                    io_uring_prep_write(
+                      sqe, fd, data.data(), static_cast<uint32_t>(data.size()), offset);
+                    sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+                }
+
+                int fd;
+                std::string_view data;
+                uint64_t offset;
+            };
+
+            RingWriteAndFsync(
+              RingExecutor* executor,
+              int fd,
+              std::string_view data,
+              uint64_t offset,
+              bool data_only)
+              : executor(executor)
+              , fd(fd)
+              , data_only(data_only) {
+                write.fd = fd;
+                write.data = data;
+                write.offset = offset;
+                write.result = static_cast<int>(data.size());
+                write.handle = std::noop_coroutine();
+            }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                handle = std::move(h);
+                executor->InitiateLink(&write, this);
+            }
+
+            void Prepare(io_uring_sqe* sqe) {
+                io_uring_prep_fsync(sqe, fd, data_only ? IORING_FSYNC_DATASYNC : 0);
+            }
+
+            auto await_resume() -> std::pair<std::error_code, size_t> {
+                if (write.result < 0) {
+                    return {ErrnoToErrorCode(-write.result), 0};
+                }
+                if (result < 0 && result != -ECANCELED) {
+                    return {ErrnoToErrorCode(-result), 0};
+                }
+                return {{}, static_cast<size_t>(write.result)};
+            }
+
+            RingExecutor* executor;
+            int fd;
+            bool data_only;
+            Write write;
+        };
+        return RingWriteAndFsync(executor_, fd_, data, offset, data_only);
+    }
+
+    void Close() {
+        if (fd_ < 0) {
+            return;
+        }
+        if (close(fd_) != 0) {
+            LOG(ERROR) << "close: " << strerror(errno);
+        }
+        fd_ = -1;
+    }
+
+    int GetFD() const { return fd_; }
+
+private:
+    int fd_;
+    RingExecutor* executor_;
+};
+
+} // namespace rdss
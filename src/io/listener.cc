@@ -15,8 +15,8 @@ Listener::Listener(int listen_fd, RingExecutor* executor)
   : fd_(listen_fd)
   , executor_(executor) {}
 
-std::unique_ptr<Listener> Listener::Create(int port, RingExecutor* executor) {
-    const auto fd = CreateListeningSocket(static_cast<uint16_t>(port));
+std::unique_ptr<Listener> Listener::Create(int port, RingExecutor* executor, bool reuse_port) {
+    const auto fd = CreateListeningSocket(static_cast<uint16_t>(port), reuse_port);
     if (fd == 0) {
         LOG(FATAL) << "Unable to create listener";
     }
@@ -9,37 +9,60 @@
 
 namespace rdss {
 
-class Listener {
+/// Accepts the connections of a listening socket by a multishot accept on 'executor_', which stays
+/// armed and posts a completion for every connection accepted, so that a connection storm doesn't
+/// cost a submission per connection. Accept() should be awaited by only one coroutine running on
+/// 'executor_', which shouldn't suspend on anything else, since the completions are delivered to it
+/// as they arrive.
+class Listener : public Continuation {
 public:
-    static std::unique_ptr<Listener> Create(int port, RingExecutor* executor);
+    /// Creates a listener on 'port' whose connections are accepted on 'executor'. If 'reuse_port'
+    /// is true, the socket is created with SO_REUSEPORT so that each executor can have its own
+    /// listener on the same port.
+    static std::unique_ptr<Listener>
+    Create(int port, RingExecutor* executor, bool reuse_port = false);
 
+    /// Returns an awaitable of the next accepted connection. The accept is armed by the first call,
+    /// and again by the call following its termination, e.g. on error.
     auto Accept() {
-        struct RingAccept : public RingOperation<RingAccept> {
-            RingAccept(RingExecutor* executor, int fd)
-              : RingOperation<RingAccept>(executor)
-              , executor(executor)
-              , fd(fd) {}
-
-            void Prepare(io_uring_sqe* sqe) { io_uring_prep_accept(sqe, fd, nullptr, nullptr, 0); }
+        struct MultishotAccept : public std::suspend_always {
+            void await_suspend(std::coroutine_handle<> h) {
+                listener->handle = h;
+                if (!listener->armed_) {
+                    listener->armed_ = true;
+                    listener->executor_->Initiate(listener);
+                }
+            }
 
             auto await_resume() -> std::pair<std::error_code, Connection*> {
-                if (result > 0) {
-                    return {{}, new Connection(result)};
+                if (!(listener->flags & IORING_CQE_F_MORE)) {
+                    listener->armed_ = false;
+                }
+                if (listener->result > 0) {
+                    return {{}, new Connection(listener->result)};
                 }
-                return {ErrnoToErrorCode(-result), nullptr};
+                return {ErrnoToErrorCode(-listener->result), nullptr};
             }
 
-            RingExecutor* executor;
-            int fd;
+            Listener* listener;
         };
-        return RingAccept(executor_, fd_);
+        return MultishotAccept{{}, this};
     }
 
+    void Prepare(io_uring_sqe* sqe) {
+        io_uring_prep_multishot_accept(sqe, fd_, nullptr, nullptr, 0);
+    }
+
+    int GetFD() const { return fd_; }
+
+    RingExecutor* GetExecutor() { return executor_; }
+
 private:
     Listener(int listen_fd, RingExecutor* executor);
 
     int fd_;
     RingExecutor* executor_;
+    bool armed_{false};
 };
 
 } // namespace rdss
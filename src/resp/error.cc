@@ -14,6 +14,20 @@ static const std::array<const std::string, 20> kErrorStr = {
   "-ERR wrong number of arguments.\r\n",
   "-ERR syntax error\r\n",
   "-ERR value is not an integer or out of range\r\n",
+  "-CROSSSLOT Keys in request don't hash to the same slot\r\n",
+  "-ERR Background save already in progress\r\n",
+  "-ERR Failed to save the RDB file\r\n",
+  "-MISCONF Errors writing to the AOF file\r\n",
+  "-ERR Background append only file rewriting already in progress\r\n",
+  "-ERR Append only file is disabled\r\n",
+  "-ERR No such client\r\n",
+  "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n",
+  "-ERR timeout is not a float or out of range\r\n",
+  "-ERR value is not a valid float\r\n",
+  "-ERR min or max is not a float\r\n",
+  "-ERR resulting score is not a number (NaN)\r\n",
+  "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n",
+  "-INVALIDOBJ Corrupted HLL object detected\r\n",
 };
 
 std::string_view ErrorToStringView(Error error) { return kErrorStr[static_cast<size_t>(error)]; }
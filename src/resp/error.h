@@ -14,6 +14,20 @@ enum class Error : uint8_t {
     kWrongArgNum,
     kSyntaxError,
     kNotAnInt,
+    kCrossShard,
+    kSaveInProgress,
+    kSaveFailed,
+    kAofWriteFailed,
+    kAofRewriteInProgress,
+    kAofDisabled,
+    kNoSuchClient,
+    kWrongType,
+    kInvalidTimeout,
+    kNotAFloat,
+    kMinMaxNotAFloat,
+    kScoreIsNaN,
+    kNotAnHll,
+    kCorruptedHll,
 };
 
 std::string_view ErrorToStringView(Error error);
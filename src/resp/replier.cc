@@ -2,10 +2,13 @@
 // Licensed under the MIT license.
 #include "replier.h"
 
-#include "base/buffer.h"
 #include "resp/result.h"
 
+#include <glog/logging.h>
+
+#include <algorithm>
 #include <charconv>
+#include <cstring>
 
 namespace rdss {
 
@@ -14,85 +17,165 @@ using Type = Result::Type;
 static const std::string kOkStr = "+OK\r\n";
 static const std::string kNilStr = "$-1\r\n"; // TODO: This is for RESP2, complement for RESP3.
 
-namespace detail {
-
-size_t IntToChars(auto val, Buffer::SinkType sink) {
-    assert(sink.size() >= 13); // 13 is the most digits of int32_t + 2 (for CRLF).
+// Type prefix, the most digits of int64_t with sign, and CRLF.
+static constexpr size_t kMaxIntReply = 1 + 20 + 2;
 
-    auto res = std::to_chars(sink.data(), sink.data() + sink.size(), val);
-    assert(res.ec == std::errc{});
-    assert(res.ptr - sink.data() + 2 <= static_cast<int32_t>(sink.size()));
-    *(res.ptr) = '\r';
-    *(res.ptr + 1) = '\n';
-    return static_cast<size_t>(res.ptr + 2 - sink.data());
+ReplyWriter::ReplyWriter(size_t first_chunk_size)
+  : first_chunk_size_(first_chunk_size) {
+    assert(first_chunk_size >= kMaxIntReply + StringValue::kMaxInlineSize + 2);
+    chunks_.emplace_back(first_chunk_size);
+    capacity_ = first_chunk_size;
 }
 
-size_t StrToIovecs(MTSPtr& str, Buffer::SinkType sink, std::vector<iovec>& iovecs) {
-    if (str == nullptr) {
-        iovecs.emplace_back(
-          iovec{.iov_base = const_cast<char*>(kNilStr.data()), .iov_len = kNilStr.size()});
-        return 0;
+void ReplyWriter::Append(std::span<Result> results) {
+    for (auto& result : results) {
+        Append(result);
     }
-    sink[0] = '$';
-    auto offset = IntToChars(static_cast<int32_t>(str->size()), sink.subspan(1));
-    ++offset;
-    iovecs.emplace_back(iovec{.iov_base = sink.data(), .iov_len = offset});
-    iovecs.emplace_back(iovec{.iov_base = str->data(), .iov_len = str->size()});
-    iovecs.emplace_back(iovec{.iov_base = sink.data() + offset - 2, .iov_len = 2});
-    return offset;
-}
-
-} // namespace detail
-
-bool NeedsGather(Result& result) {
-    return result.type == Result::Type::kString || result.type == Result::Type::kStrings;
 }
 
-std::string_view ResultToStringView(Result& result, Buffer& buffer) {
+void ReplyWriter::Append(Result& result) {
     switch (result.type) {
     case Type::kOk:
-        return kOkStr;
+        AppendCopy(kOkStr);
+        break;
     case Type::kNil:
-        return kNilStr;
+        AppendCopy(kNilStr);
+        break;
     case Type::kError:
-        return ErrorToStringView(result.error);
-    case Type::kInt: {
-        buffer.EnsureAvailable(32, false);
-        auto sink = buffer.Sink();
-        sink[0] = ':';
-        const auto offset = detail::IntToChars(
-          result.int_value, Buffer::SinkType(sink.data() + 1, sink.size() - 1));
-        buffer.Produce(offset + 1);
-        return buffer.Source();
+        AppendCopy(ErrorToStringView(result.error));
+        break;
+    case Type::kInt:
+        AppendInt(':', result.int_value);
+        break;
+    case Type::kString:
+        AppendString(result.string_value);
+        break;
+    case Type::kStrings:
+        AppendInt('*', static_cast<int64_t>(result.strings.size()));
+        for (auto& str : result.strings) {
+            AppendString(str);
+        }
+        break;
+    }
+}
+
+std::shared_ptr<ReplyWriter::Pinned> ReplyWriter::Pin() {
+    auto pinned = std::make_shared<Pinned>();
+    const auto end = chunks_.begin() + static_cast<std::ptrdiff_t>(current_chunk_ + 1);
+    for (auto it = chunks_.begin(); it != end; ++it) {
+        capacity_ -= it->Capacity();
+        pinned->chunks.push_back(std::move(*it));
     }
-    default:
-        LOG(FATAL) << "Unsupported type";
+    chunks_.erase(chunks_.begin(), end);
+    if (chunks_.empty()) {
+        chunks_.emplace_back(first_chunk_size_);
+        capacity_ += first_chunk_size_;
     }
+    current_chunk_ = 0;
+    pinned->strings = std::move(strings_);
+    strings_.clear();
+    return pinned;
 }
 
-void ResultToIovecs(Result& result, Buffer& buffer, std::vector<iovec>& iovecs) {
-    if (result.type == Type::kString) {
-        buffer.EnsureAvailable(64, false);
-        detail::StrToIovecs(result.string_ptr, buffer.Sink(), iovecs);
-        return;
+void ReplyWriter::Reset() {
+    iovecs_.clear();
+    strings_.clear();
+    referenced_bytes_ = 0;
+    for (auto& chunk : chunks_) {
+        chunk.Reset();
+    }
+    current_chunk_ = 0;
+    while (chunks_.size() > 1 && capacity_ > kMaxRetainedSize) {
+        capacity_ -= chunks_.back().Capacity();
+        chunks_.pop_back();
+    }
+}
+
+Buffer::SinkType ReplyWriter::Reserve(size_t n) {
+    assert(n <= chunks_.front().Capacity());
+    while (chunks_[current_chunk_].Available() < n) {
+        ++current_chunk_;
+        if (current_chunk_ == chunks_.size()) {
+            const auto size = std::min(chunks_.back().Capacity() * 2, kMaxChunkSize);
+            chunks_.emplace_back(size);
+            capacity_ += size;
+        }
     }
+    return chunks_[current_chunk_].Sink();
+}
 
-    assert(result.type = Type::kStrings);
+void ReplyWriter::Commit(size_t n) {
+    auto& chunk = chunks_[current_chunk_];
+    auto* data = chunk.Data();
+    chunk.Produce(n);
+    // Replies written one after another in the chunk form one run.
+    if (!iovecs_.empty()) {
+        auto& last = iovecs_.back();
+        if (static_cast<char*>(last.iov_base) + last.iov_len == data) {
+            last.iov_len += n;
+            return;
+        }
+    }
+    iovecs_.emplace_back(iovec{.iov_base = data, .iov_len = n});
+}
 
-    buffer.EnsureAvailable(result.strings.size() * 32, false);
-    iovecs.reserve(1 + result.strings.size() * 3);
+void ReplyWriter::AppendCopy(std::string_view data) {
+    while (!data.empty()) {
+        auto sink = Reserve(1);
+        const auto n = std::min(sink.size(), data.size());
+        std::memcpy(sink.data(), data.data(), n);
+        Commit(n);
+        data.remove_prefix(n);
+    }
+}
 
-    auto sink = buffer.Sink();
+void ReplyWriter::AppendRef(std::string_view data) {
+    iovecs_.emplace_back(
+      iovec{.iov_base = const_cast<char*>(data.data()), .iov_len = data.size()});
+}
 
-    sink[0] = '*';
-    auto cursor = detail::IntToChars(
-      result.strings.size(), Buffer::SinkType(sink.data() + 1, sink.size() - 1));
-    ++cursor;
-    iovecs.emplace_back(iovec{.iov_base = sink.data(), .iov_len = cursor});
+void ReplyWriter::AppendInt(char type, int64_t val) {
+    auto sink = Reserve(kMaxIntReply);
+    sink[0] = type;
+    auto [ptr, ec] = std::to_chars(sink.data() + 1, sink.data() + sink.size(), val);
+    assert(ec == std::errc{});
+    ptr[0] = '\r';
+    ptr[1] = '\n';
+    Commit(static_cast<size_t>(ptr + 2 - sink.data()));
+}
 
-    for (auto& str : result.strings) {
-        cursor += detail::StrToIovecs(str, sink.subspan(cursor), iovecs);
+void ReplyWriter::AppendString(StringValue& str) {
+    if (str.IsNull()) {
+        AppendCopy(kNilStr);
+        return;
+    }
+    StringValue::IntChars chars;
+    const auto view = str.View(chars);
+    if (view.size() <= StringValue::kMaxInlineSize) {
+        // The whole reply is written at once.
+        auto sink = Reserve(kMaxIntReply + view.size() + 2);
+        sink[0] = '$';
+        auto [ptr, ec] = std::to_chars(sink.data() + 1, sink.data() + sink.size(), view.size());
+        assert(ec == std::errc{});
+        ptr[0] = '\r';
+        ptr[1] = '\n';
+        ptr += 2;
+        std::memcpy(ptr, view.data(), view.size());
+        ptr += view.size();
+        ptr[0] = '\r';
+        ptr[1] = '\n';
+        Commit(static_cast<size_t>(ptr + 2 - sink.data()));
+        return;
+    }
+    AppendInt('$', static_cast<int64_t>(view.size()));
+    if (view.size() <= kCopyThreshold) {
+        AppendCopy(view);
+    } else {
+        AppendRef(view);
+        strings_.push_back(str.Raw());
+        referenced_bytes_ += view.size();
     }
+    AppendCopy("\r\n");
 }
 
 } // namespace rdss
@@ -2,21 +2,88 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include "base/buffer.h"
+#include "data_structure/tracking_hash_table.h"
+
 #include <sys/uio.h>
 
+#include <memory>
 #include <span>
 #include <string_view>
 #include <vector>
 
 namespace rdss {
 
-class Buffer;
 struct Result;
 
-bool NeedsGather(Result& result);
+/// Assembles the replies of pipelined queries into iovecs, so that the replies of a batch are sent
+/// by as few writes as possible. The replies are copied into a chunked output arena, where the
+/// replies that follow each other form one contiguous run, except that raw strings longer than
+/// 'kCopyThreshold' are referenced by their own iovecs without copying. The chunks never move, so
+/// the iovecs stay valid until Reset(), and the referenced strings should be kept alive by the
+/// results until then.
+class ReplyWriter {
+public:
+    // Raw strings no longer than this are copied, since an iovec costs more than copying them.
+    static constexpr size_t kCopyThreshold = 512;
+    // Chunks after the first one double in size up to this.
+    static constexpr size_t kMaxChunkSize = 64 * 1024;
+    // Chunks beyond this size in total are released by Reset().
+    static constexpr size_t kMaxRetainedSize = 64 * 1024;
+
+    /// Memory referenced by the iovecs, see Pin().
+    struct Pinned {
+        std::vector<Buffer> chunks;
+        std::vector<MTSPtr> strings;
+    };
+
+    explicit ReplyWriter(size_t first_chunk_size);
+
+    /// Appends the replies of 'results' in order.
+    void Append(std::span<Result> results);
+
+    void Append(Result& result);
+
+    std::span<iovec> Iovecs() { return iovecs_; }
+
+    /// Bytes of the raw strings referenced by the iovecs instead of being copied.
+    size_t ReferencedBytes() const { return referenced_bytes_; }
+
+    /// Hands over the chunks written and the referenced strings, so that the iovecs stay valid
+    /// after Reset() as long as the returned object lives. Used by zero copy send, where the kernel
+    /// keeps referencing the sent memory after the send completes.
+    std::shared_ptr<Pinned> Pin();
+
+    /// Bytes of the chunks allocated.
+    size_t Capacity() const { return capacity_; }
+
+    /// Clears the replies, and keeps the chunks for the next batch unless they are too large.
+    void Reset();
+
+private:
+    // Returns the sink of at least 'n' bytes in the current chunk, moves to the next chunk if the
+    // current one doesn't have enough. 'n' should be no more than the size of the first chunk.
+    Buffer::SinkType Reserve(size_t n);
+
+    // Appends the 'n' bytes written to the sink returned by Reserve().
+    void Commit(size_t n);
+
+    void AppendCopy(std::string_view data);
+
+    void AppendRef(std::string_view data);
+
+    void AppendInt(char type, int64_t val);
 
-std::string_view ResultToStringView(Result& result, Buffer& buffer);
+    void AppendString(StringValue& str);
 
-void ResultToIovecs(Result& result, Buffer& buffer, std::vector<iovec>& iovecs);
+    const size_t first_chunk_size_;
+    std::vector<Buffer> chunks_;
+    size_t current_chunk_{0};
+    size_t capacity_{0};
+    std::vector<iovec> iovecs_;
+    // Raw strings referenced by 'iovecs_'.
+    std::vector<MTSPtr> strings_;
+    size_t referenced_bytes_{0};
+};
 
 } // namespace rdss
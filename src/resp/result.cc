@@ -9,9 +9,9 @@ void Result::SetError(Error err) {
     error = err;
 }
 
-void Result::SetString(MTSPtr str) {
+void Result::SetString(StringValue str) {
     type = Type::kString;
-    string_ptr = std::move(str);
+    string_value = std::move(str);
 }
 
 void Result::SetInt(int64_t val) {
@@ -19,14 +19,14 @@ void Result::SetInt(int64_t val) {
     int_value = val;
 }
 
-void Result::AddString(MTSPtr str) {
+void Result::AddString(StringValue str) {
     type = Type::kStrings;
     strings.push_back(std::move(str));
 }
 
 void Result::Reset() {
     type = Type::kOk;
-    string_ptr.reset();
+    string_value.Reset();
     strings.clear();
 }
 
@@ -11,7 +11,8 @@ namespace rdss {
 
 /// For OK, Error, Nil, returns string_view over static string.
 /// For Int, convert int to string at internal buffer, returns string_view over it.
-/// For String, Strings, construct the number part at internal buffer, return span<iovecs>.
+/// For String, Strings, construct the number part at internal buffer, return span<iovecs>. Int and
+/// embedded strings are copied to the buffer, and only raw strings are referenced by the iovecs.
 struct Result {
     enum class Type { kOk, kError, kNil, kInt, kString, kStrings };
 
@@ -21,9 +22,9 @@ struct Result {
 
     void SetNil() { type = Type::kNil; }
 
-    void SetString(MTSPtr str);
-    
-    void AddString(MTSPtr str);
+    void SetString(StringValue str);
+
+    void AddString(StringValue str);
 
     void SetInt(int64_t val);
 
@@ -32,8 +33,8 @@ struct Result {
     Type type = Type::kOk;
     Error error;
     int64_t int_value = 0;
-    MTSPtr string_ptr = nullptr;
-    std::vector<MTSPtr> strings;
+    StringValue string_value;
+    std::vector<StringValue> strings;
 };
 
 } // namespace rdss
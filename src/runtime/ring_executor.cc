@@ -9,11 +9,19 @@
 #include <future>
 #include <thread>
 
+// io_uring_submit_and_wait_min_timeout() is available since liburing 2.8.
+#ifdef IO_URING_CHECK_VERSION
+#if !IO_URING_CHECK_VERSION(2, 8)
+#define RDSS_HAS_MIN_TIMEOUT
+#endif
+#endif
+
 namespace rdss {
 
 RingExecutor::RingExecutor(std::string name, RingConfig config, std::optional<size_t> id)
   : name_(std::move(name))
-  , config_(std::move(config)) {
+  , config_(std::move(config))
+  , cpu_(id) {
     std::promise<void> promise;
     auto future = promise.get_future();
 
@@ -40,7 +48,11 @@ RingExecutor::RingExecutor(std::string name, RingConfig config, std::optional<si
             params.flags |= IORING_SETUP_SQPOLL;
         } else {
             params.flags |= IORING_SETUP_TASKRUN_FLAG;
-            params.flags |= IORING_SETUP_COOP_TASKRUN;
+            if (config_.defer_taskrun) {
+                params.flags |= IORING_SETUP_DEFER_TASKRUN;
+            } else {
+                params.flags |= IORING_SETUP_COOP_TASKRUN;
+            }
         }
 
         if ((ret = io_uring_queue_init_params(config_.sq_entries, &ring_, &params)) != 0) {
@@ -52,6 +64,14 @@ RingExecutor::RingExecutor(std::string name, RingConfig config, std::optional<si
         if (!(params.features & IORING_FEAT_FAST_POLL)) {
             LOG(WARNING) << "io_uring: No IORING_FEAT_FAST_POLL";
         }
+        if (config_.wait_min_timeout_us != 0) {
+#ifdef RDSS_HAS_MIN_TIMEOUT
+            min_wait_supported_ = (params.features & IORING_FEAT_MIN_TIMEOUT) != 0;
+#endif
+            if (!min_wait_supported_) {
+                LOG(WARNING) << "io_uring: No IORING_FEAT_MIN_TIMEOUT, wait_min_timeout_us ignored";
+            }
+        }
 
         if (config_.max_direct_descriptors) {
             ret = io_uring_register_files_sparse(&ring_, config_.max_direct_descriptors);
@@ -99,16 +119,21 @@ RingExecutor::Create(size_t id, std::string name, const Config& config) {
       .sqpoll = config.sqpoll,
       .submit_batch_size = config.submit_batch_size,
       .wait_batch_size = config.wait_batch_size,
+      .wait_min_timeout_us = config.wait_min_timeout_us,
+      .busy_poll_us = config.busy_poll_us,
+      .defer_taskrun = config.defer_taskrun,
+      .max_direct_descriptors = config.max_direct_fds_per_exr,
     };
     return std::make_unique<RingExecutor>(std::move(name), std::move(rc), id);
 }
 
 // static
 std::vector<std::unique_ptr<RingExecutor>>
-RingExecutor::Create(size_t n, size_t start_id, std::string name_prefix, const Config& config) {
+RingExecutor::Create(
+  size_t n, size_t start_id, std::string name_prefix, const Config& config, size_t id_step) {
     std::vector<std::unique_ptr<RingExecutor>> result;
     result.reserve(n);
-    for (size_t i = start_id; i < start_id + n; ++i) {
+    for (size_t i = start_id; i < start_id + n * id_step; i += id_step) {
         result.emplace_back(RingExecutor::Create(i, name_prefix + std::to_string(i), config));
     }
     return result;
@@ -148,14 +173,52 @@ void RingExecutor::Deactivate(io_uring* ring) {
     }
 }
 
-void RingExecutor::EventLoop() {
+void RingExecutor::WaitForCompletions(bool spin) {
+    io_uring_cqe* cqe;
+    if (spin) {
+        const auto deadline = std::chrono::steady_clock::now()
+                              + std::chrono::microseconds{config_.busy_poll_us};
+        do {
+            if (io_uring_sq_ready(Ring()) != 0) {
+                io_uring_submit(Ring());
+            }
+            // Also runs the deferred completion work if the kernel flags any.
+            if (io_uring_peek_batch_cqe(Ring(), &cqe, 1) != 0) {
+                return;
+            }
+        } while (std::chrono::steady_clock::now() < deadline);
+    }
+
     __kernel_timespec ts = {.tv_sec = 0, .tv_nsec = std::chrono::nanoseconds{25'000'000}.count()};
     const auto wait_batch = std::max(1U, config_.wait_batch_size);
+    int ret;
+#ifdef RDSS_HAS_MIN_TIMEOUT
+    if (min_wait_supported_) {
+        ret = io_uring_submit_and_wait_min_timeout(
+          Ring(), &cqe, wait_batch, &ts, config_.wait_min_timeout_us, nullptr);
+    } else {
+        ret = io_uring_submit_and_wait_timeout(Ring(), &cqe, wait_batch, &ts, nullptr);
+    }
+#else
+    ret = io_uring_submit_and_wait_timeout(Ring(), &cqe, wait_batch, &ts, nullptr);
+#endif
+    if (ret < 0 && ret != -ETIME) {
+        LOG(FATAL) << "io_uring_submit_and_wait_timeout:" << strerror(-ret);
+    }
+}
+
+void RingExecutor::EventLoop() {
     const auto submit_batch = std::max(1U, config_.submit_batch_size);
 
     io_uring_cqe* cqe;
+    auto window_start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration window_busy{0};
+    // Spins only while there is work, an idle executor blocks in waiting.
+    bool spin{false};
     while (active_.load(std::memory_order_relaxed)) {
-        auto ret = io_uring_submit_and_wait_timeout(Ring(), &cqe, wait_batch, &ts, nullptr);
+        WaitForCompletions(spin);
+        const auto busy_start = std::chrono::steady_clock::now();
+        batch_start_ = busy_start;
 
         if (io_uring_cq_has_overflow(Ring())) {
             LOG(WARNING) << name_ << " CQ has overflow.";
@@ -164,10 +227,6 @@ void RingExecutor::EventLoop() {
             LOG(WARNING) << name_ << " saw overflow.";
         }
 
-        if (ret < 0 && ret != -ETIME) {
-            LOG(FATAL) << "io_uring_submit_and_wait_timeout:" << strerror(-ret);
-        }
-
         unsigned head;
         size_t processed{0};
         io_uring_for_each_cqe(Ring(), head, cqe) {
@@ -176,9 +235,14 @@ void RingExecutor::EventLoop() {
                 break;
             }
             auto awaitable = reinterpret_cast<Continuation*>(cqe->user_data);
-            awaitable->result = cqe->res;
-            awaitable->flags = cqe->flags;
-            awaitable->handle();
+            if (awaitable == &doorbell_) {
+                load_.doorbells.fetch_add(1, std::memory_order_relaxed);
+                DrainTransfers();
+            } else {
+                awaitable->result = cqe->res;
+                awaitable->flags = cqe->flags;
+                awaitable->handle();
+            }
 
             if (processed % submit_batch == 0) {
                 io_uring_submit(Ring());
@@ -188,7 +252,80 @@ void RingExecutor::EventLoop() {
         if (processed % submit_batch) {
             io_uring_cq_advance(Ring(), processed % submit_batch);
         }
+        // Takes the transfers queued meanwhile as well, their ring message finds the queue empty.
+        if (transfers_.load(std::memory_order_relaxed) != nullptr) {
+            DrainTransfers();
+        }
+
+        // Deferred calls might defer more.
+        while (!deferred_.empty()) {
+            running_deferred_.swap(deferred_);
+            for (auto& func : running_deferred_) {
+                func();
+            }
+            running_deferred_.clear();
+        }
         VLOG(1) << "Processed " << processed << " events.";
+        spin = (config_.busy_poll_us != 0 && processed != 0);
+
+        const auto now = std::chrono::steady_clock::now();
+        load_.cqes_processed.fetch_add(processed, std::memory_order_relaxed);
+        load_.busy_ns.fetch_add(
+          static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - busy_start).count()),
+          std::memory_order_relaxed);
+        window_busy += now - busy_start;
+        if (now - window_start >= kLoadWindow) {
+            load_.busy_permille.store(
+              static_cast<uint32_t>(window_busy * 1000 / (now - window_start)),
+              std::memory_order_relaxed);
+            window_start = now;
+            window_busy = std::chrono::steady_clock::duration{0};
+        }
+    }
+}
+
+void RingExecutor::Transfer(detail::RingTransfer* transfer, io_uring* src_ring, bool submit) {
+    auto* last = transfers_.load(std::memory_order_relaxed);
+    do {
+        transfer->next = last;
+    } while (!transfers_.compare_exchange_weak(
+      last, transfer, std::memory_order_release, std::memory_order_relaxed));
+    // 'transfer' might be resumed from now on, it shouldn't be touched anymore.
+    if (last != nullptr) {
+        return;
+    }
+
+    // TODO: GetSqe()
+    io_uring_sqe* sqe;
+    while ((sqe = io_uring_get_sqe(src_ring)) == nullptr) {
+        io_uring_submit(src_ring);
+    }
+    io_uring_prep_msg_ring(sqe, RingFD(), 0, reinterpret_cast<uint64_t>(&doorbell_), 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
+    if (submit) {
+        auto ret = io_uring_submit(src_ring);
+        if (ret < 0) {
+            LOG(FATAL) << "io_uring_submit:" << strerror(-ret);
+        }
+    }
+}
+
+void RingExecutor::DrainTransfers() {
+    auto* transfer = transfers_.exchange(nullptr, std::memory_order_acquire);
+    detail::RingTransfer* first{nullptr};
+    while (transfer != nullptr) {
+        auto* next = transfer->next;
+        transfer->next = first;
+        first = transfer;
+        transfer = next;
+    }
+    while (first != nullptr) {
+        // The transfer is gone once resumed.
+        auto* next = first->next;
+        load_.transfers.fetch_add(1, std::memory_order_relaxed);
+        first->handle.resume();
+        first = next;
     }
 }
 
@@ -207,6 +344,18 @@ int RingExecutor::RegisterFd(int fd) {
 
 void RingExecutor::UnregisterFd(int fd_slot_index) {
     assert(fd_slot_index >= 0);
+    // Drops the ring's reference to the file, otherwise the socket stays open until the slot is
+    // taken again, e.g. after the connection moves to another executor. Only the worker thread
+    // can update the ring, which is single issuer, others are releasing the connections after it
+    // exits, the ring is torn down anyway.
+    if (tls_exr == this) {
+        int fd = -1;
+        auto ret = io_uring_register_files_update(
+          Ring(), static_cast<unsigned>(fd_slot_index), &fd, 1);
+        if (ret != 1) {
+            LOG(ERROR) << "io_uring_register_files_update:" << strerror(-ret);
+        }
+    }
     fd_slot_indices_.push_back(static_cast<uint32_t>(fd_slot_index));
 }
 
@@ -255,51 +404,28 @@ void RingExecutor::InitBufRing() {
 
 RingExecutor::BufferView RingExecutor::GetBufferView(uint32_t entry_id, size_t length) {
     assert(entry_id < buf_entries_);
-    const auto num_entries = length / buf_entry_size + ((length % buf_entry_size == 0) ? 0 : 1);
-    if (num_entries + entry_id <= buf_entries_) {
-        return RingExecutor::BufferView{
-          .view = std::string_view{buf_ + entry_id * buf_entry_size, length},
-          .separated_entry_id = std::nullopt};
-    }
-
-    // TODO: We assume only one separated result at the same time.
-    assert(concat_str_.empty());
-
-    const auto first_part_length = (buf_entries_ - entry_id) * buf_entry_size;
-    assert(first_part_length < length);
-    concat_str_.resize(length);
-    std::memcpy(concat_str_.data(), buf_ + entry_id * buf_entry_size, first_part_length);
-    std::memcpy(concat_str_.data() + first_part_length, buf_, length - first_part_length);
-    return RingExecutor::BufferView{.view = concat_str_, .separated_entry_id = entry_id};
+    assert(length <= buf_entry_size);
+    return RingExecutor::BufferView{
+      .view = std::string_view{buf_ + entry_id * buf_entry_size, length}};
 }
 
 void RingExecutor::PutBufferView(RingExecutor::BufferView&& buffer_view) {
-    uint32_t start_entry_id;
-    if (buffer_view.separated_entry_id.has_value()) {
-        start_entry_id = buffer_view.separated_entry_id.value();
-    } else {
-        assert(buffer_view.view.data() >= buf_);
-        auto offset = buffer_view.view.data() - buf_;
-        assert(offset % buf_entry_size == 0);
-        start_entry_id = static_cast<uint32_t>(offset) / buf_entry_size;
-    }
-
-    auto remaining_length = buffer_view.view.length();
-    uint16_t entry_id = static_cast<uint16_t>(start_entry_id);
-    int32_t offset{0};
-    const int32_t mask = static_cast<int32_t>(buf_entries_) - 1;
-    while (remaining_length) {
-        io_uring_buf_ring_add(
-          buf_ring_, buf_ + entry_id * buf_entry_size, buf_entry_size, entry_id, mask, offset);
-        remaining_length -= (remaining_length < buf_entry_size) ? remaining_length : buf_entry_size;
-        entry_id = (entry_id + 1) & (buf_entries_ - 1);
-        ++offset;
-    }
-    io_uring_buf_ring_advance(buf_ring_, offset);
-
-    if (buffer_view.separated_entry_id.has_value()) {
-        concat_str_.clear();
+    if (buffer_view.view.empty()) {
+        return;
     }
+    assert(buffer_view.view.data() >= buf_);
+    const auto offset = buffer_view.view.data() - buf_;
+    assert(offset % buf_entry_size == 0);
+    const auto entry_id = static_cast<uint16_t>(static_cast<uint32_t>(offset) / buf_entry_size);
+    io_uring_buf_ring_add(
+      buf_ring_,
+      buf_ + entry_id * buf_entry_size,
+      buf_entry_size,
+      entry_id,
+      static_cast<int32_t>(buf_entries_) - 1,
+      0);
+    io_uring_buf_ring_advance(buf_ring_, 1);
+    buffer_view.view = {};
 }
 
 } // namespace rdss
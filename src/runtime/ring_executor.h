@@ -12,47 +12,41 @@
 #include <cassert>
 #include <chrono>
 #include <cstring>
+#include <functional>
 #include <liburing.h>
 #include <optional>
 #include <thread>
 
+namespace rdss {
+
+// Forward declaration for 'RingTransfer'.
+class RingExecutor;
+
+} // namespace rdss
+
 namespace rdss::detail {
 
+// Resumes the awaiting coroutine on 'target'. The transfer is queued to 'target', which is told by
+// a ring message sent via 'ring' only if its queue was empty, see 'RingExecutor::Transfer()'.
 struct RingTransfer
   : public Continuation
   , public std::suspend_always {
     bool await_ready() const { return no_transfer; }
 
-    void await_suspend(std::coroutine_handle<> h) {
-        handle = std::move(h);
-        // TODO: GetSqe()
-        io_uring_sqe* sqe;
-        while ((sqe = io_uring_get_sqe(ring)) == nullptr) {
-        }
-
-        io_uring_prep_msg_ring(sqe, target_fd, 0, reinterpret_cast<uint64_t>(this), 0);
-        io_uring_sqe_set_flags(sqe, IOSQE_CQE_SKIP_SUCCESS);
-        if (submit) {
-            auto ret = io_uring_submit(ring);
-            if (ret < 0) {
-                LOG(FATAL) << "io_uring_submit:" << strerror(-ret);
-            }
-        }
-    }
+    void await_suspend(std::coroutine_handle<> h);
 
     io_uring* ring;
-    int target_fd;
+    RingExecutor* target;
     bool submit;
     bool no_transfer{false};
+    // The transfer queued to 'target' before this one.
+    RingTransfer* next{nullptr};
 };
 
 } // namespace rdss::detail
 
 namespace rdss {
 
-// Forward declaration for 'tls_exr'.
-class RingExecutor;
-
 /// Thread-local ring for sending ring message to other executors.
 /// - For RingExecutor's worker thread, this is set to RingExecutor's ring.
 /// - For main thread, this is set to Server's 'ring_'.
@@ -69,6 +63,12 @@ struct RingConfig {
     bool sqpoll = false;
     uint32_t submit_batch_size = 32;
     uint32_t wait_batch_size = 1;
+    // Waits this long for 'wait_batch_size' completions before taking fewer, 0 to disable.
+    uint32_t wait_min_timeout_us = 0;
+    // Spins on the completion queue this long before waiting, if the last wakeup processed any.
+    uint32_t busy_poll_us = 0;
+    // Ignored with sqpoll.
+    bool defer_taskrun = false;
     uint32_t max_direct_descriptors = 4096U;
     bool register_ring_fd = true;
 };
@@ -80,7 +80,9 @@ struct RingConfig {
 /// the executor, one typically employs the `Schedule()` function. This function requires the
 /// pointer to an io_uring, referred to as `src_ring`, along with a callable representing the task.
 /// `Schedule()` utilizes io_uring's ring message mechanism to communicate between rings, and
-/// 'src_ring' is used to send ring message. Often, communication occurs between executors, with the
+/// 'src_ring' is used to send ring message. The callables sent to an executor are queued, and one
+/// ring message wakes the executor to run all of them, see `Transfer()`. Often, communication
+/// occurs between executors, with the
 /// caller of `Schedule()` being another executor. In such cases, a variant of `Schedule()` is
 /// utilized, accepting only the callable as a parameter. This variant utilizes a thread-local
 /// `tls_ring`, set as the caller executor's ring during its construction, for ring message
@@ -127,15 +129,48 @@ public:
     /// Factory method to create an executor with Server's config.
     static std::unique_ptr<RingExecutor> Create(size_t id, std::string name, const Config& config);
 
-    /// Factory method to create 'n' RingExecutors, with an increasing 'id' starting at 'start_id'.
-    /// The name of executors will be 'name_prefix' + 'id'.
-    static std::vector<std::unique_ptr<RingExecutor>>
-    Create(size_t n, size_t start_id, std::string name_prefix, const Config& config);
+    /// Factory method to create 'n' RingExecutors, with 'id' starting at 'start_id' and increasing
+    /// by 'id_step'. The name of executors will be 'name_prefix' + 'id'.
+    static std::vector<std::unique_ptr<RingExecutor>> Create(
+      size_t n,
+      size_t start_id,
+      std::string name_prefix,
+      const Config& config,
+      size_t id_step = 1);
 
     io_uring* Ring() { return &ring_; }
 
     int RingFD() const { return fd_; }
 
+    /// Returns the CPU the worker thread is pinned to, which is the 'id' of the constructor.
+    std::optional<size_t> Cpu() const { return cpu_; }
+
+    /// Load of the executor. The counters of the event loop are written by the worker thread, the
+    /// others by whoever runs on it, and all of them might be read by any thread.
+    struct LoadStats {
+        std::atomic<uint64_t> cqes_processed{};
+        // Time spent on processing the completions and the deferred calls, excluding waiting.
+        std::atomic<uint64_t> busy_ns{};
+        // Share of busy time in the last 'kLoadWindow', in per mille.
+        std::atomic<uint32_t> busy_permille{};
+        std::atomic<uint64_t> net_input_bytes{};
+        std::atomic<uint64_t> net_output_bytes{};
+        std::atomic<uint32_t> connections{};
+        // Transfers resumed, and the ring messages that woke the worker thread for them.
+        std::atomic<uint64_t> transfers{};
+        std::atomic<uint64_t> doorbells{};
+    };
+
+    static constexpr std::chrono::milliseconds kLoadWindow{100};
+
+    LoadStats& Load() { return load_; }
+
+    const LoadStats& Load() const { return load_; }
+
+    /// Time the worker thread started processing the current batch of completions. Should be
+    /// called on the executor.
+    std::chrono::steady_clock::time_point BatchStart() const { return batch_start_; }
+
     // TODO
     /// To stop the executor, one needs to first call 'Deactivate()', which sets 'active_' flag of
     /// executor to false and then sends a ring msg with user_data set as 0 to wake the worker
@@ -151,6 +186,17 @@ public:
     template<typename Operation>
     void Initiate(Operation* operation);
 
+    /// Like Initiate(), but initiates 'first' and 'second' as a link of io_uring, that is,
+    /// 'second' starts after 'first' completes, and is cancelled if 'first' fails.
+    template<typename First, typename Second>
+    void InitiateLink(First* first, Second* second);
+
+    /// Runs 'func' on the worker thread after the completions reaped by the current iteration of
+    /// the event loop are processed, and before the ring is submitted and waited for the next
+    /// iteration. Calls deferred during one iteration run in order, so that the work caused by all
+    /// the completions of an iteration can be batched. Should be called on the worker thread.
+    void Defer(std::function<void()> func) { deferred_.push_back(std::move(func)); }
+
     /// Schedules the execution of 'func' on this executor.
     /// - If 'src_ring' is the ring of 'this', 'func' will be executed inline.
     /// - Otherwise, 'func' will be captured as coroutine_handle and sent to 'this' via ring message
@@ -164,48 +210,69 @@ public:
         return Schedule(tls_ring, std::move(func));
     }
 
+    /// Queues 'transfer' to be resumed by the worker thread. The queue is lock-free and drained as
+    /// a whole by the worker thread, so only the transfer that finds it empty sends a ring message
+    /// via 'src_ring' to wake the worker thread, and submits 'src_ring' if 'submit' is set. Others
+    /// are resumed by the same wakeup. Can be called by any thread owning 'src_ring'.
+    void Transfer(detail::RingTransfer* transfer, io_uring* src_ring, bool submit);
+
     // Registers 'fd' with the executor's ring. Returns the index into the registered fd if
     // successful, returns -1 otherwise.
     int RegisterFd(int fd);
 
+    // Clears the registered fd at 'fd_slot_index' and makes the slot available again.
     void UnregisterFd(int fd_slot_index);
 
     void InitBufRing();
 
-    // BufferView is the view of the recv result stored in the ring buffer. If the referenced buffer
-    // is consecutive, 'view' is simply the string_view over that buffer. If the referenced buffer
-    // is non-consecutive, 'RingExecutor' creates a temporary string to and copies the two parts
-    // into the string, then 'view' is string_view over the temporary string.
+    // BufferView is the view of the recv result stored in an entry of the buffer ring. A recv
+    // never fills more than one entry, so the view is always over consecutive memory, and any
+    // number of views can be outstanding at the same time, e.g. those queued by multishot recvs.
     struct BufferView {
         std::string_view view;
-
-        // If the referenced buffer are non-adjacent, i.e. one at the last and one at the first,
-        // then 'separated_entry_id' is the first entry id of the entry at the last part of the
-        // buffer. nullopt otherwise.:w
-        std::optional<uint32_t> separated_entry_id = std::nullopt;
     };
 
     BufferView GetBufferView(uint32_t entry_id, size_t length);
 
+    // Returns the entry of 'buffer_view' to the buffer ring, does nothing if the view is empty.
     void PutBufferView(BufferView&& buffer_view);
 
 private:
     void EventLoop();
 
+    // Waits for the next completions, by spinning on the completion queue first if 'spin' is set,
+    // see 'RingConfig::busy_poll_us'. Submits the pending SQEs.
+    void WaitForCompletions(bool spin);
+
+    // Resumes the queued transfers in the order they are queued.
+    void DrainTransfers();
+
     const std::string name_;
     const RingConfig config_;
+    const std::optional<size_t> cpu_;
+    // Whether 'wait_min_timeout_us' is supported by both liburing and the kernel.
+    bool min_wait_supported_{false};
     std::atomic<bool> active_ = true;
     io_uring ring_;
     int fd_;
     std::thread thread_;
     std::vector<uint32_t> fd_slot_indices_;
+    std::vector<std::function<void()>> deferred_;
+    std::vector<std::function<void()>> running_deferred_;
 
     io_uring_buf_ring* buf_ring_{nullptr};
     char* buf_{nullptr};
     // TODO: 1. move somewhere 2. rename to kXXX
     static constexpr uint32_t buf_entry_size = 2048 * 2;
     uint32_t buf_entries_{0U};
-    std::string concat_str_;
+
+    LoadStats load_;
+    std::chrono::steady_clock::time_point batch_start_;
+
+    // The last queued transfer, linked to the earlier ones by 'RingTransfer::next'.
+    std::atomic<detail::RingTransfer*> transfers_{nullptr};
+    // User data of the ring message telling the worker thread that 'transfers_' isn't empty.
+    Continuation doorbell_{};
 };
 
 template<typename Operation>
@@ -227,13 +294,45 @@ void RingExecutor::Initiate(Operation* operation) {
     io_uring_sqe_set_data64(sqe, reinterpret_cast<uint64_t>(operation));
 }
 
+template<typename First, typename Second>
+void RingExecutor::InitiateLink(First* first, Second* second) {
+    // Both SQEs should be in one submission, otherwise the link is broken.
+    while (io_uring_sq_space_left(Ring()) < 2) {
+        if (config_.sqpoll) {
+            auto ret = io_uring_sqring_wait(Ring());
+            if (ret < 0) {
+                LOG(FATAL) << "io_uring_sqring_wait:" << strerror(-ret);
+            }
+        } else {
+            io_uring_submit(Ring());
+        }
+    }
+
+    auto* sqe = io_uring_get_sqe(Ring());
+    first->Prepare(sqe);
+    io_uring_sqe_set_data64(sqe, reinterpret_cast<uint64_t>(first));
+    sqe->flags |= IOSQE_IO_LINK;
+    sqe = io_uring_get_sqe(Ring());
+    second->Prepare(sqe);
+    io_uring_sqe_set_data64(sqe, reinterpret_cast<uint64_t>(second));
+}
+
 template<typename FuncType>
 Task<void> RingExecutor::Schedule(io_uring* src_ring, FuncType func) {
     assert(src_ring != nullptr);
     if (src_ring != Ring()) {
-        co_await detail::RingTransfer{.ring = src_ring, .target_fd = RingFD(), .submit = true};
+        co_await detail::RingTransfer{.ring = src_ring, .target = this, .submit = true};
     }
     func();
 }
 
 } // namespace rdss
+
+namespace rdss::detail {
+
+inline void RingTransfer::await_suspend(std::coroutine_handle<> h) {
+    handle = std::move(h);
+    target->Transfer(this, ring, submit);
+}
+
+} // namespace rdss::detail
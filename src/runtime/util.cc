@@ -14,7 +14,7 @@ detail::RingTransfer ResumeOn(RingExecutor* exr, bool submit) {
     auto src_ring = tls_ring != nullptr ? tls_ring
                                         : (tls_exr != nullptr ? tls_exr->Ring() : nullptr);
     assert(src_ring != nullptr);
-    return detail::RingTransfer{.ring = src_ring, .target_fd = exr->RingFD(), .submit = submit};
+    return detail::RingTransfer{.ring = src_ring, .target = exr, .submit = submit};
 }
 
 void SetupInitBufRing(std::vector<std::unique_ptr<RingExecutor>>& exrs) {
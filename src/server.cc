@@ -4,28 +4,77 @@
 
 #include "client.h"
 #include "runtime/util.h"
+#include "service/aof.h"
 #include "service/command_registry.h"
 #include "sys/util.h"
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
+#include <unistd.h>
 
 namespace rdss {
 
+namespace {
+
+// Sets 'promise' after the last of 'num_not_finished' files is flushed.
+Task<void> WaitForAof(
+  AppendOnlyFile* aof, std::atomic<size_t>* num_not_finished, std::promise<void>* promise) {
+    co_await aof->WaitForSync();
+    if (num_not_finished->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        promise->set_value();
+    }
+}
+
+} // namespace
+
 Server::Server(Config config)
   : config_(std::move(config))
-  , dss_executor_(RingExecutor::Create(0, "dss_exr", config_))
+  // With sqpoll, each data shard executor takes two CPUs for itself and its sq thread.
+  , dss_executors_(RingExecutor::Create(
+      config_.data_shards, 0, "dss_exr_", config_, (config_.sqpoll ? 2 : 1)))
   , client_executors_(RingExecutor::Create(
-      config.client_executors,
-      (config_.sqpoll ? 2 : 1),
+      config_.client_executors,
+      config_.data_shards * (config_.sqpoll ? 2 : 1),
       "cli_exr_",
       Config::DisableSqpoll(config_)))
-  , listener_(Listener::Create(config_.port, client_executors_[0].get()))
-  , service_(&config_, this, nullptr)
-  , shutdown_future_(service_.GetShutdownFuture()) {}
+  , persistence_executor_(std::make_unique<RingExecutor>(
+      "persist_exr",
+      RingConfig{.sq_entries = 64U, .cq_entries = 256U, .max_direct_descriptors = 0U})) {
+    CreateListeners();
+    std::vector<RingExecutor*> client_executors;
+    for (auto& exr : client_executors_) {
+        client_executors.push_back(exr.get());
+    }
+    // The accepting threads check 'maxclients' racing with each other, and the clients moving
+    // between executors aren't counted for a moment, either lets an executor exceed the limit by
+    // one.
+    client_manager_.Init(client_executors, config_.maxclients + 2 * client_executors.size());
+    // The connections accepted by the executors' own listeners stay where their packets arrive.
+    client_manager_.Placement().Init(
+      std::move(client_executors),
+      config_.client_placement,
+      (config_.reuseport_listeners ? 0 : config_.client_migration_threshold));
+    for (auto& exr : dss_executors_) {
+        services_.push_back(std::make_unique<DataStructureService>(&config_, this, nullptr));
+        if (config_.appendonly) {
+            services_.back()->SetAof(std::make_unique<AppendOnlyFile>(
+              services_.back().get(),
+              exr.get(),
+              config_.AofPath(services_.size() - 1),
+              config_.appendfsync));
+        }
+        data_shards_.push_back(DataShard{.executor = exr.get(), .service = services_.back().get()});
+    }
+    snapshotter_ = std::make_unique<Snapshotter>(
+      &data_shards_, persistence_executor_.get(), config_.RdbPath());
+    shutdown_future_ = services_.front()->GetShutdownFuture();
+}
 
 void Server::Setup() {
-    RegisterCommands(&service_);
+    for (auto& service : services_) {
+        RegisterCommands(service.get());
+    }
     SetNofileLimit(std::numeric_limits<uint16_t>::max());
     stats_.start_time = Clock(true).Now();
 
@@ -40,19 +89,97 @@ void Server::Setup() {
     if (config_.use_ring_buffer) {
         SetupInitBufRing(client_executors_);
     }
+
+    if (!config_.appendonly) {
+        if (!snapshotter_->Load()) {
+            LOG(FATAL) << "Failed to load RDB file " << config_.RdbPath();
+        }
+        return;
+    }
+
+    // The keys are sharded by the number of data shards, so the files of a different number of
+    // shards can't be loaded.
+    size_t aof_files{0};
+    while (access(config_.AofPath(aof_files).c_str(), F_OK) == 0) {
+        ++aof_files;
+    }
+    if (aof_files != 0 && aof_files != data_shards_.size()) {
+        LOG(FATAL) << "Found " << aof_files << " append only files for " << data_shards_.size()
+                   << " data shards.";
+    }
+    if (aof_files == 0) {
+        // Like Redis, the RDB file is loaded when the append only file is enabled for the first
+        // time, and is then rewritten into the append only files.
+        if (!snapshotter_->Load()) {
+            LOG(FATAL) << "Failed to load RDB file " << config_.RdbPath();
+        }
+        rewrite_aof_ = snapshotter_->Stats().loaded_keys.load(std::memory_order_relaxed) != 0;
+    }
+    if (!RunOnDataShards([aof_files](DataShard& shard) {
+            auto* aof = shard.service->GetAof();
+            return (aof_files == 0 || aof->Load()) && aof->Open();
+        })) {
+        LOG(FATAL) << "Failed to load append only files.";
+    }
+}
+
+void Server::CreateListeners() {
+    if (!config_.reuseport_listeners) {
+        listeners_.push_back(Listener::Create(config_.port, client_executors_[0].get()));
+        return;
+    }
+    // The sockets join the SO_REUSEPORT group in the order they listen, the steering program picks
+    // the one of index 'cpu % n', so the listener of each executor is created at the index of its
+    // CPU. The executors are pinned to consecutive CPUs, which makes the indices distinct.
+    std::vector<RingExecutor*> executors;
+    for (auto& exr : client_executors_) {
+        executors.push_back(exr.get());
+    }
+    const auto n = executors.size();
+    std::sort(executors.begin(), executors.end(), [n](RingExecutor* a, RingExecutor* b) {
+        return a->Cpu().value_or(0) % n < b->Cpu().value_or(0) % n;
+    });
+    for (auto* exr : executors) {
+        listeners_.push_back(Listener::Create(config_.port, exr, true));
+    }
+    if (
+      config_.reuseport_cpu_steering
+      && !AttachReuseportCpuSteering(listeners_.front()->GetFD(), static_cast<uint32_t>(n))) {
+        LOG(WARNING) << "Connections are distributed among the listeners by hash.";
+    }
 }
 
-Task<void> Server::AcceptLoop() {
-    size_t ce_index{0};
+bool Server::RunOnDataShards(const std::function<bool(DataShard&)>& func) {
+    std::atomic<size_t> num_not_finished{data_shards_.size()};
+    std::atomic<bool> ok{true};
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    for (auto& shard : data_shards_) {
+        shard.executor->Schedule([&func, &shard, &num_not_finished, &ok, &promise]() {
+            if (!func(shard)) {
+                ok.store(false, std::memory_order_relaxed);
+            }
+            if (num_not_finished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                promise.set_value();
+            }
+        });
+    }
+    future.wait();
+    return ok.load(std::memory_order_relaxed);
+}
+
+Task<void> Server::AcceptLoop(Listener* listener) {
     while (active_) {
-        auto [error, conn] = co_await listener_->Accept();
+        auto [error, conn] = co_await listener->Accept();
         if (error) {
             LOG(ERROR) << "accept:" << error.message();
             continue;
         }
 
         stats_.connections_received.fetch_add(1, std::memory_order_relaxed);
-        if (client_manager_.ActiveClients() == config_.maxclients) {
+        // Listeners of the executors accept at the same time, each might see the others' clients
+        // not yet added.
+        if (client_manager_.ActiveClients() >= config_.maxclients) {
             stats_.rejected_connections.fetch_add(1, std::memory_order_relaxed);
             // TODO: dtor will close
             conn->Close();
@@ -60,23 +187,37 @@ Task<void> Server::AcceptLoop() {
             continue;
         }
 
-        auto cli_exr = client_executors_[ce_index].get();
-        ce_index = (ce_index + 1) % client_executors_.size();
+        // A connection accepted by an executor's own listener stays there, the steering makes it
+        // the executor running on the CPU that receives the connection's packets.
+        auto cli_exr = listener->GetExecutor();
+        if (!config_.reuseport_listeners) {
+            cli_exr = client_manager_.Placement().Place();
+        }
 
         cli_exr->Schedule([this, conn, cli_exr]() {
             // Connection::Setup should be invoked before using the connection to create the client
             // since client's query_buffer depends on connection's 'use_ring_buf_'.
             conn->Setup(cli_exr, config_.use_ring_buffer);
-            auto* client = client_manager_.AddClient(conn, &service_);
-            client->Process(dss_executor_.get());
+            auto* client = client_manager_.AddClient(conn, &data_shards_);
+            client->Process();
         });
     }
     LOG(INFO) << "Exiting accept loop.";
 }
 
 void Server::Run() {
-    dss_executor_->Schedule([dss = &service_]() { dss->Cron(); });
-    client_executors_[0]->Schedule([this]() { this->AcceptLoop(); });
+    for (auto& shard : data_shards_) {
+        shard.executor->Schedule([dss = shard.service]() { dss->Cron(); });
+    }
+    if (rewrite_aof_) {
+        for (auto& shard : data_shards_) {
+            shard.service->GetAof()->RequestRewrite();
+        }
+    }
+    for (auto& listener : listeners_) {
+        listener->GetExecutor()->Schedule(
+          [this, listener = listener.get()]() { this->AcceptLoop(listener); });
+    }
 
     shutdown_future_.wait();
     Shutdown();
@@ -89,20 +230,34 @@ void Server::Shutdown() {
     for (auto& e : client_executors_) {
         e->Deactivate(&ring_);
     }
-    dss_executor_->Deactivate(&ring_);
+    if (config_.appendonly) {
+        LOG(INFO) << "Flushing append only files.";
+        std::atomic<size_t> num_not_finished{data_shards_.size()};
+        std::promise<void> promise;
+        auto future = promise.get_future();
+        for (auto& shard : data_shards_) {
+            auto* aof = shard.service->GetAof();
+            shard.executor->Schedule([aof, &num_not_finished, &promise]() {
+                WaitForAof(aof, &num_not_finished, &promise);
+            });
+        }
+        future.wait();
+    }
+    for (auto& e : dss_executors_) {
+        e->Deactivate(&ring_);
+    }
+    persistence_executor_->Deactivate(&ring_);
 
-    dss_executor_->Shutdown();
+    for (auto& e : dss_executors_) {
+        e->Shutdown();
+    }
     for (auto& e : client_executors_) {
         e->Shutdown();
     }
+    persistence_executor_->Shutdown();
 
     LOG(INFO) << "Closing active connections.";
-    auto clients = client_manager_.GetClients();
-    for (auto client : clients) {
-        if (client != nullptr) {
-            client->Close();
-        }
-    }
+    client_manager_.CloseAll();
     assert(client_manager_.ActiveClients() == 0);
 
     io_uring_queue_exit(&ring_);
@@ -9,8 +9,11 @@
 #include "io/promise.h"
 #include "runtime/ring_executor.h"
 #include "service/data_structure_service.h"
+#include "service/sharding.h"
+#include "service/snapshot.h"
 
 #include <atomic>
+#include <functional>
 #include <future>
 #include <memory>
 #include <vector>
@@ -27,18 +30,22 @@ class Server {
 public:
     explicit Server(Config config);
 
-    /// 1. Registers commands to 'service_'.
+    /// 1. Registers commands to 'services_'.
     /// 2. Tries to set limit of open file to 65536.
     /// 3. Update start time of 'stats_'.
     /// 4. Initialize 'ring_' that is used to send messages to executors.
     /// 5. Setup buffer ring of client executors if enabled.
+    /// 6. Loads the RDB file if it exists, or the append only files of the data shards if enabled.
+    /// If the append only files don't exist yet, the RDB file is loaded instead, and the files are
+    /// rewritten from the loaded keys once running.
     void Setup();
 
-    /// Blocking waits for 'service_' to shutdown.
+    /// Blocking waits for the service of the first data shard to shutdown.
     void Run();
 
     /// Actively shutdowns the server:
-    /// 1. Set every executor's 'active' to false.
+    /// 1. Set every executor's 'active' to false, the append only files are flushed after the
+    /// client executors are deactivated.
     /// 2. Wake every executor's worker thread by ring message so that they can realize the
     /// deactivation.
     /// 3. Call every executor's Shutdown() to blocking wait the worker threads to terminate.
@@ -47,24 +54,44 @@ public:
 
     ClientManager* GetClientManager() { return &client_manager_; }
 
+    const DataShards& GetDataShards() const { return data_shards_; }
+
     ServerStats& Stats() { return stats_; }
 
+    Snapshotter* GetSnapshotter() { return snapshotter_.get(); }
+
 private:
-    // Operates an accept loop on RingExecutor, which should be chosen from the set of
-    // 'client_executors_'. Upon the arrival of a new connection, evaluates whether the current
-    // active connections surpass the defined limit set by the 'maxclients' configuration. If the
-    // threshold is exceeded, the connection is declined. Otherwise, a new client is instantiated
-    // with the connection, and the client's processing is scheduled on one of the
-    // 'client_executors_' in a round-robin manner.
-    Task<void> AcceptLoop();
+    // Creates one listener on the first client executor, or one for each client executor with
+    // SO_REUSEPORT if 'reuseport_listeners' is set.
+    void CreateListeners();
+
+    // Operates an accept loop of 'listener' on its executor, which is one of 'client_executors_'.
+    // Upon the arrival of a new connection, evaluates whether the current active connections
+    // surpass the defined limit set by the 'maxclients' configuration. If the threshold is
+    // exceeded, the connection is declined. Otherwise, a new client is instantiated with the
+    // connection, and the client's processing is scheduled on the listener's executor if each
+    // client executor has its own listener, or on the one of 'client_executors_' chosen by the
+    // client manager's placement.
+    Task<void> AcceptLoop(Listener* listener);
+
+    // Runs 'func' on the executor of every data shard, and blocking waits until all of them
+    // finish. Returns false if any of them returns false.
+    bool RunOnDataShards(const std::function<bool(DataShard&)>& func);
 
     Config config_;
 
     std::atomic<bool> active_ = true;
-    std::unique_ptr<RingExecutor> dss_executor_;
+    // Each data shard owns one of 'services_' which runs on the corresponding 'dss_executors_'.
+    std::vector<std::unique_ptr<RingExecutor>> dss_executors_;
     std::vector<std::unique_ptr<RingExecutor>> client_executors_;
-    std::unique_ptr<Listener> listener_;
-    DataStructureService service_;
+    // Writes the files of persistence, it isn't pinned to a CPU.
+    std::unique_ptr<RingExecutor> persistence_executor_;
+    std::vector<std::unique_ptr<Listener>> listeners_;
+    std::vector<std::unique_ptr<DataStructureService>> services_;
+    DataShards data_shards_;
+    std::unique_ptr<Snapshotter> snapshotter_;
+    // Set if the append only files are created from the loaded RDB file.
+    bool rewrite_aof_{false};
     std::future<void> shutdown_future_;
     ClientManager client_manager_;
     ServerStats stats_;
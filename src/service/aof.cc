@@ -0,0 +1,672 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "aof.h"
+
+#include "base/buffer.h"
+#include "data_structure/hash_value.h"
+#include "data_structure/list_value.h"
+#include "data_structure/set_value.h"
+#include "data_structure/zset_value.h"
+#include "data_structure_service.h"
+#include "runtime/ring_executor.h"
+#include "service/commands/command_util.h"
+
+#include <glog/logging.h>
+
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace rdss::aof {
+
+namespace {
+
+constexpr size_t kReadSize = 64 * 1024;
+
+void AppendHeader(std::string& out, char type, size_t n) {
+    char chars[24];
+    auto [ptr, _] = std::to_chars(chars, chars + sizeof(chars), n);
+    out.push_back(type);
+    out.append(chars, ptr);
+    out.append("\r\n");
+}
+
+} // namespace
+
+void AppendCommand(std::string& out, Args args) {
+    AppendHeader(out, '*', args.size());
+    for (const auto arg : args) {
+        AppendHeader(out, '$', arg.size());
+        out.append(arg);
+        out.append("\r\n");
+    }
+}
+
+LoadResult Load(const std::string& path, const CommandHandler& handler) {
+    LoadResult result{.status = LoadStatus::kOk, .valid_size = 0, .commands = 0};
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            LOG(ERROR) << "open " << path << ':' << strerror(errno);
+            result.status = LoadStatus::kError;
+        }
+        return result;
+    }
+
+    Buffer buffer(kReadSize);
+    MultiBulkParser parser(&buffer);
+    StringViews args;
+    bool eof{false};
+    while (result.status == LoadStatus::kOk) {
+        while (buffer.NumWritten() != 0) {
+            const auto pending = buffer.NumWritten();
+            const auto state = parser.Parse(args);
+            const auto consumed = pending - buffer.NumWritten();
+            if (state == ParserState::kError) {
+                LOG(ERROR) << "Malformed command at offset " << result.valid_size << " of " << path;
+                result.status = LoadStatus::kError;
+                break;
+            }
+            if (state != ParserState::kDone) {
+                // The command is parsed again from its start after more data is read, since the
+                // parsed arguments are invalidated if the buffer expands.
+                buffer.Rewind(consumed);
+                parser.Reset();
+                break;
+            }
+            result.valid_size += consumed;
+            const auto num_args = parser.GetResultSize();
+            if (num_args == 0) {
+                continue;
+            }
+            ++result.commands;
+            if (!handler(Args(args.data(), num_args))) {
+                result.status = LoadStatus::kError;
+                break;
+            }
+        }
+        if (result.status != LoadStatus::kOk || eof) {
+            break;
+        }
+
+        buffer.Compact();
+        buffer.EnsureAvailable(kReadSize, false);
+        const auto n = read(fd, buffer.Data(), buffer.Available());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(ERROR) << "read " << path << ':' << strerror(errno);
+            result.status = LoadStatus::kError;
+            break;
+        }
+        if (n == 0) {
+            eof = true;
+        } else {
+            buffer.Produce(static_cast<size_t>(n));
+        }
+    }
+    close(fd);
+
+    if (result.status == LoadStatus::kOk && buffer.NumWritten() != 0) {
+        result.status = LoadStatus::kTruncated;
+    }
+    return result;
+}
+
+} // namespace rdss::aof
+
+namespace rdss {
+
+namespace {
+
+int64_t UnixTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+AppendOnlyFile::AppendOnlyFile(
+  DataStructureService* service, RingExecutor* executor, std::string path, AppendFsync fsync)
+  : service_(service)
+  , executor_(executor)
+  , path_(std::move(path))
+  , temp_path_(path_ + ".rewrite")
+  , fsync_(fsync)
+  , last_fsync_(std::chrono::steady_clock::now())
+  , last_check_(last_fsync_) {}
+
+bool AppendOnlyFile::Load() {
+    Result result;
+    // Files written by Redis select the db, and might have transactions.
+    int64_t db{0};
+    service_->SetLoading(true);
+    const auto load_result = aof::Load(path_, [this, &result, &db](Args args) {
+        if (EqualsIgnoreCase(args[0], "SELECT")) {
+            if (
+              args.size() != 2
+              || std::from_chars(args[1].data(), args[1].data() + args[1].size(), db).ec
+                   != std::errc{}) {
+                LOG(ERROR) << "Invalid SELECT in " << path_;
+                return false;
+            }
+            return true;
+        }
+        if (db != 0 || EqualsIgnoreCase(args[0], "MULTI") || EqualsIgnoreCase(args[0], "EXEC")) {
+            return true;
+        }
+        result.Reset();
+        service_->Invoke(args, result);
+        if (result.type == Result::Type::kError) {
+            LOG(ERROR) << "Failed to replay " << args[0] << " in " << path_ << ": "
+                       << ErrorToStringView(result.error);
+            return false;
+        }
+        return true;
+    });
+    service_->SetLoading(false);
+
+    stats_.loaded_commands.store(load_result.commands, std::memory_order_relaxed);
+    switch (load_result.status) {
+    case aof::LoadStatus::kOk:
+        break;
+    case aof::LoadStatus::kTruncated:
+        // Like Redis, the last command that is partially written, e.g. the server crashed in the
+        // middle of writing, is cut off so that new commands can be appended.
+        LOG(WARNING) << "Truncating the incomplete command at the end of " << path_
+                     << " at offset " << load_result.valid_size;
+        if (truncate(path_.c_str(), static_cast<off_t>(load_result.valid_size)) != 0) {
+            LOG(ERROR) << "truncate " << path_ << ':' << strerror(errno);
+            return false;
+        }
+        break;
+    case aof::LoadStatus::kError:
+        return false;
+    }
+    LOG(INFO) << "Loaded " << load_result.commands << " commands from " << path_;
+    return true;
+}
+
+bool AppendOnlyFile::Open() {
+    const auto fd = open(path_.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG(ERROR) << "open " << path_ << ':' << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LOG(ERROR) << "fstat " << path_ << ':' << strerror(errno);
+        close(fd);
+        return false;
+    }
+    file_ = std::make_unique<File>(fd, executor_);
+    size_ = static_cast<uint64_t>(st.st_size);
+    stats_.current_size.store(size_, std::memory_order_relaxed);
+    stats_.base_size.store(size_, std::memory_order_relaxed);
+    return true;
+}
+
+void AppendOnlyFile::Feed(const Command& command, Args args) {
+    const auto size = buffer_.size();
+    if (command.HasRelativeExpire()) {
+        AppendWithAbsoluteExpire(buffer_, args);
+    } else {
+        aof::AppendCommand(buffer_, args);
+    }
+    if (buffer_.size() == size) {
+        return;
+    }
+    ++fed_;
+
+    if (rewrite_ != nullptr) {
+        auto& rewrite = *rewrite_;
+        const auto& spec = command.GetKeySpec();
+        const auto num_args = static_cast<int32_t>(args.size());
+        if (spec.first == 0 || spec.first >= num_args) {
+            aof::AppendCommand(rewrite.buffer, args);
+        } else {
+            const auto last = spec.Last(args);
+            for (auto i = spec.first; i <= last; i += spec.step) {
+                const auto key = args[static_cast<size_t>(i)];
+                if (rewrite.traversed || service_->DataTable()->IsTraversed(key, rewrite.cursor)) {
+                    AppendKeyState(rewrite.buffer, key);
+                }
+            }
+        }
+    }
+    DeferFlush();
+}
+
+bool AppendOnlyFile::RequestRewrite() {
+    bool expected{false};
+    if (!stats_.rewrite_in_progress.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    stats_.current_rewrite_start_time.store(UnixTime(), std::memory_order_relaxed);
+    executor_->Schedule([this]() { StartRewrite(); });
+    return true;
+}
+
+void AppendOnlyFile::Cron() {
+    if (rewrite_ != nullptr && !rewrite_->traversed) {
+        RewriteSome();
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_check_ < kFsyncInterval) {
+        return;
+    }
+    last_check_ = now;
+    if (!write_ok_) {
+        write_ok_ = true;
+        DeferFlush();
+    } else if (fsync_ == AppendFsync::kEverysec && synced_ < written_) {
+        DeferFlush();
+    }
+}
+
+void AppendOnlyFile::DeferFlush() {
+    // A flush in progress checks for new data before it finishes.
+    if (flush_deferred_ || writing_) {
+        return;
+    }
+    flush_deferred_ = true;
+    executor_->Defer([this]() {
+        flush_deferred_ = false;
+        Flush();
+    });
+}
+
+Task<void> AppendOnlyFile::Flush() {
+    if (writing_ || file_ == nullptr) {
+        co_return;
+    }
+    writing_ = true;
+    while (write_ok_) {
+        if (rewrite_ != nullptr && rewrite_->ready) {
+            SwitchToRewrite();
+        }
+        const auto fsync = fsync_ == AppendFsync::kAlways || !sync_waiters_.empty()
+                           || (fsync_ == AppendFsync::kEverysec
+                               && std::chrono::steady_clock::now() - last_fsync_ >= kFsyncInterval);
+        if (buffer_.empty() && !(fsync && synced_ < written_)) {
+            break;
+        }
+
+        const auto target = fed_;
+        writing_buffer_.swap(buffer_);
+        std::string_view data{writing_buffer_};
+        std::error_code error;
+        while (!error) {
+            size_t written{0};
+            if (!fsync) {
+                std::tie(error, written) = co_await file_->Write(data, size_);
+                if (!error && written == 0) {
+                    error = std::make_error_code(std::errc::no_space_on_device);
+                }
+            } else if (data.empty()) {
+                std::tie(error, written) = co_await file_->Fsync(true);
+            } else {
+                std::tie(error, written) = co_await file_->WriteAndFsync(data, size_, true);
+            }
+            data.remove_prefix(written);
+            size_ += written;
+            // A short write cancels the linked fsync, which is retried with the rest.
+            if (data.empty()) {
+                break;
+            }
+        }
+        stats_.current_size.store(size_, std::memory_order_relaxed);
+        stats_.writes.fetch_add(1, std::memory_order_relaxed);
+
+        if (error) {
+            LOG(ERROR) << "write " << path_ << ':' << error.message();
+            if (fsync_ == AppendFsync::kAlways) {
+                // Like Redis, since the written commands are replied only after they are flushed,
+                // the server can't go on.
+                LOG(FATAL) << "Can't persist the append only file with appendfsync always.";
+            }
+            // Keeps the data not written for the retry.
+            buffer_.insert(0, data);
+            writing_buffer_.clear();
+            write_ok_ = false;
+            stats_.last_write_ok.store(false, std::memory_order_relaxed);
+            break;
+        }
+        writing_buffer_.clear();
+        written_ = target;
+        stats_.last_write_ok.store(true, std::memory_order_relaxed);
+        if (fsync) {
+            synced_ = target;
+            last_fsync_ = std::chrono::steady_clock::now();
+            stats_.fsyncs.fetch_add(1, std::memory_order_relaxed);
+            ResumeSyncWaiters();
+        }
+    }
+    writing_ = false;
+}
+
+void AppendOnlyFile::ResumeSyncWaiters() {
+    while (!sync_waiters_.empty() && sync_waiters_.front().target <= synced_) {
+        auto handle = sync_waiters_.front().handle;
+        sync_waiters_.pop_front();
+        handle.resume();
+    }
+}
+
+void AppendOnlyFile::StartRewrite() {
+    if (file_ == nullptr) {
+        EndRewrite(false);
+        return;
+    }
+    const auto fd = open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG(ERROR) << "open " << temp_path_ << ':' << strerror(errno);
+        EndRewrite(false);
+        return;
+    }
+    LOG(INFO) << "Rewriting " << path_;
+    rewrite_ = std::make_unique<Rewrite>();
+    rewrite_->file = std::make_unique<File>(fd, executor_);
+    rewrite_->buffer.reserve(kRewriteChunkSize);
+    rewrite_->start_time = std::chrono::steady_clock::now();
+}
+
+void AppendOnlyFile::RewriteSome() {
+    auto& rewrite = *rewrite_;
+    if (rewrite.buffer.size() >= kMaxRewriteBuffer) {
+        return;
+    }
+
+    const auto save_entry = [this, &rewrite](MTSHashTable::EntryPointer entry) {
+        if (service_->IsExpired(entry)) {
+            return;
+        }
+        AppendKeyState(rewrite.buffer, entry->Key());
+        ++rewrite.keys;
+    };
+
+    auto* table = service_->DataTable();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t buckets = 1;; ++buckets) {
+        rewrite.cursor = table->TraverseBucket(rewrite.cursor, save_entry);
+        if (rewrite.cursor == 0) {
+            rewrite.traversed = true;
+            break;
+        }
+        if (
+          buckets % kBucketsPerCheck == 0
+          && (rewrite.buffer.size() >= kMaxRewriteBuffer
+              || std::chrono::steady_clock::now() - start >= kRewriteTimeLimit)) {
+            break;
+        }
+    }
+
+    if (!rewrite.writing && (rewrite.traversed || rewrite.buffer.size() >= kRewriteChunkSize)) {
+        WriteRewrite();
+    }
+}
+
+Task<void> AppendOnlyFile::WriteRewrite() {
+    auto& rewrite = *rewrite_;
+    rewrite.writing = true;
+    while (rewrite.traversed || rewrite.buffer.size() >= kRewriteChunkSize) {
+        // The data after the traversal are flushed with the file.
+        const auto last = rewrite.traversed;
+        rewrite.writing_buffer.swap(rewrite.buffer);
+        std::string_view data{rewrite.writing_buffer};
+        std::error_code error;
+        while (!error) {
+            size_t written{0};
+            if (!last) {
+                std::tie(error, written) = co_await rewrite.file->Write(data, rewrite.size);
+                if (!error && written == 0) {
+                    error = std::make_error_code(std::errc::no_space_on_device);
+                }
+            } else if (data.empty()) {
+                std::tie(error, written) = co_await rewrite.file->Fsync();
+            } else {
+                std::tie(error, written) = co_await rewrite.file->WriteAndFsync(data, rewrite.size);
+            }
+            data.remove_prefix(written);
+            rewrite.size += written;
+            if (data.empty()) {
+                break;
+            }
+        }
+        rewrite.writing_buffer.clear();
+        if (error) {
+            LOG(ERROR) << "write " << temp_path_ << ':' << error.message();
+            EndRewrite(false);
+            co_return;
+        }
+        if (last) {
+            rewrite.ready = true;
+            DeferFlush();
+            break;
+        }
+    }
+    rewrite.writing = false;
+}
+
+void AppendOnlyFile::SwitchToRewrite() {
+    auto& rewrite = *rewrite_;
+    assert(rewrite.ready && !rewrite.writing);
+    if (rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        LOG(ERROR) << "rename " << temp_path_ << ':' << strerror(errno);
+        EndRewrite(false);
+        return;
+    }
+
+    // The commands fed so far are covered by the rewritten file and the data appended to it since
+    // it was flushed, which replace the commands pending to write to the old file.
+    file_ = std::move(rewrite.file);
+    size_ = rewrite.size;
+    buffer_ = std::move(rewrite.buffer);
+    if (buffer_.empty()) {
+        written_ = fed_;
+        synced_ = fed_;
+        ResumeSyncWaiters();
+    }
+    stats_.current_size.store(size_, std::memory_order_relaxed);
+    stats_.base_size.store(size_, std::memory_order_relaxed);
+    LOG(INFO) << "Rewrote " << path_ << " with " << rewrite.keys << " keys, " << size_
+              << " bytes.";
+    EndRewrite(true);
+}
+
+void AppendOnlyFile::EndRewrite(bool ok) {
+    if (rewrite_ != nullptr) {
+        const auto duration = std::chrono::steady_clock::now() - rewrite_->start_time;
+        stats_.last_rewrite_duration_us.store(
+          static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count()),
+          std::memory_order_relaxed);
+        rewrite_.reset();
+    }
+    if (!ok) {
+        LOG(ERROR) << "Failed to rewrite " << path_;
+        unlink(temp_path_.c_str());
+    } else {
+        stats_.rewrites.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats_.last_rewrite_ok.store(ok, std::memory_order_relaxed);
+    stats_.rewrite_in_progress.store(false, std::memory_order_release);
+}
+
+void AppendOnlyFile::AppendWithAbsoluteExpire(std::string& out, Args args) {
+    assert(args.size() >= 2);
+    auto entry = service_->DataTable()->Find(args[1]);
+    if (entry == nullptr) {
+        // E.g. GETEX of a missing key, which changes nothing.
+        return;
+    }
+    if (!entry->HasExpire()) {
+        aof::AppendCommand(out, args);
+        return;
+    }
+
+    expire_time_ = std::to_string(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+        entry->GetExpire().time_since_epoch())
+        .count());
+    args_.clear();
+    if (EqualsIgnoreCase(args[0], "SETEX") || EqualsIgnoreCase(args[0], "PSETEX")) {
+        // SETEX key seconds value
+        args_.assign({"SET", args[1], args[3], "PXAT", expire_time_});
+    } else {
+        // SET key value [options], GETEX key [options]
+        const size_t first_option = EqualsIgnoreCase(args[0], "SET") ? 3 : 2;
+        args_.assign(args.begin(), args.end());
+        for (auto i = first_option; i + 1 < args_.size(); ++i) {
+            if (args_[i] == "EX" || args_[i] == "PX") {
+                args_[i] = "PXAT";
+                args_[i + 1] = expire_time_;
+                break;
+            }
+        }
+    }
+    aof::AppendCommand(out, Args(args_));
+}
+
+void AppendOnlyFile::AppendKeyState(std::string& out, std::string_view key) {
+    auto entry = service_->DataTable()->Find(key);
+    if (entry == nullptr || service_->IsExpired(entry)) {
+        args_.assign({"DEL", key});
+        aof::AppendCommand(out, Args(args_));
+        return;
+    }
+
+    if (entry->HasExpire()) {
+        expire_time_ = std::to_string(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            entry->GetExpire().time_since_epoch())
+            .count());
+    }
+    if (!entry->value.IsString()) {
+        if (entry->value.IsHash()) {
+            AppendHashState(out, key, entry->value.Hash());
+        } else if (entry->value.IsList()) {
+            AppendListState(out, key, entry->value.List());
+        } else if (entry->value.IsSet()) {
+            AppendSetState(out, key, entry->value.Set());
+        } else {
+            AppendZSetState(out, key, entry->value.ZSet());
+        }
+        if (entry->HasExpire()) {
+            args_.assign({"PEXPIREAT", key, expire_time_});
+            aof::AppendCommand(out, Args(args_));
+        }
+        return;
+    }
+
+    StringValue::IntChars chars;
+    args_.assign({"SET", key, entry->value.View(chars)});
+    if (entry->HasExpire()) {
+        args_.push_back("PXAT");
+        args_.push_back(expire_time_);
+    }
+    aof::AppendCommand(out, Args(args_));
+}
+
+void AppendOnlyFile::AppendHashState(
+  std::string& out, std::string_view key, const HashValue& hash) {
+    // Like Redis, the fields are set in chunks so that a big hash doesn't make a huge command.
+    static constexpr size_t kFieldsPerCommand = 64;
+
+    args_.assign({"DEL", key});
+    aof::AppendCommand(out, Args(args_));
+    const auto append_hset = [this, &out, key]() {
+        args_.assign({"HSET", key});
+        args_.insert(args_.end(), value_args_.begin(), value_args_.end());
+        aof::AppendCommand(out, Args(args_));
+        value_args_.clear();
+    };
+    value_args_.clear();
+    hash.ForEach([this, &append_hset](std::string_view field, std::string_view value) {
+        value_args_.emplace_back(field);
+        value_args_.emplace_back(value);
+        if (value_args_.size() == kFieldsPerCommand * 2) {
+            append_hset();
+        }
+    });
+    if (!value_args_.empty()) {
+        append_hset();
+    }
+}
+
+void AppendOnlyFile::AppendListState(
+  std::string& out, std::string_view key, const ListValue& list) {
+    static constexpr size_t kElementsPerCommand = 64;
+
+    args_.assign({"DEL", key});
+    aof::AppendCommand(out, Args(args_));
+    // The elements stay valid during the traversal, so they are referenced directly.
+    args_.assign({"RPUSH", key});
+    list.ForEach([this, &out, key](std::string_view element) {
+        args_.push_back(element);
+        if (args_.size() == kElementsPerCommand + 2) {
+            aof::AppendCommand(out, Args(args_));
+            args_.assign({"RPUSH", key});
+        }
+    });
+    if (args_.size() > 2) {
+        aof::AppendCommand(out, Args(args_));
+    }
+}
+
+void AppendOnlyFile::AppendSetState(std::string& out, std::string_view key, const SetValue& set) {
+    static constexpr size_t kMembersPerCommand = 64;
+
+    args_.assign({"DEL", key});
+    aof::AppendCommand(out, Args(args_));
+    const auto append_sadd = [this, &out, key]() {
+        args_.assign({"SADD", key});
+        args_.insert(args_.end(), value_args_.begin(), value_args_.end());
+        aof::AppendCommand(out, Args(args_));
+        value_args_.clear();
+    };
+    value_args_.clear();
+    set.ForEach([this, &append_sadd](std::string_view member) {
+        value_args_.emplace_back(member);
+        if (value_args_.size() == kMembersPerCommand) {
+            append_sadd();
+        }
+    });
+    if (!value_args_.empty()) {
+        append_sadd();
+    }
+}
+
+void AppendOnlyFile::AppendZSetState(
+  std::string& out, std::string_view key, const ZSetValue& zset) {
+    static constexpr size_t kMembersPerCommand = 64;
+
+    args_.assign({"DEL", key});
+    aof::AppendCommand(out, Args(args_));
+    const auto append_zadd = [this, &out, key]() {
+        args_.assign({"ZADD", key});
+        args_.insert(args_.end(), value_args_.begin(), value_args_.end());
+        aof::AppendCommand(out, Args(args_));
+        value_args_.clear();
+    };
+    value_args_.clear();
+    zset.ForEach([this, &append_zadd](std::string_view member, double score) {
+        // The shortest representation that converts back to the same score.
+        std::array<char, 32> chars;
+        auto [ptr, _] = std::to_chars(chars.data(), chars.data() + chars.size(), score);
+        value_args_.emplace_back(chars.data(), ptr);
+        value_args_.emplace_back(member);
+        if (value_args_.size() == kMembersPerCommand * 2) {
+            append_zadd();
+        }
+    });
+    if (!value_args_.empty()) {
+        append_zadd();
+    }
+}
+
+} // namespace rdss
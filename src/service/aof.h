@@ -0,0 +1,251 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "base/config.h"
+#include "io/file.h"
+#include "io/promise.h"
+#include "resp/resp_parser.h"
+#include "resp/result.h"
+#include "service/command.h"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Encoding and decoding of the append only file, which is a sequence of commands in the multi bulk
+/// format of RESP, the same as the append only file of Redis.
+namespace rdss::aof {
+
+/// Appends the command of 'args' to 'out'.
+void AppendCommand(std::string& out, Args args);
+
+enum class LoadStatus {
+    kOk,
+    kTruncated, // The last command is cut off at the end of the file.
+    kError,     // The file can't be read, has malformed data, or the handler fails.
+};
+
+struct LoadResult {
+    LoadStatus status;
+    // Size of the complete commands at the start of the file.
+    uint64_t valid_size;
+    uint64_t commands;
+};
+
+/// Called with every command read, returns false to stop the loading with error.
+using CommandHandler = std::function<bool(Args args)>;
+
+/// Reads the commands in the file at 'path' one chunk at a time, and calls 'handler' with each of
+/// them. A missing file is loaded as an empty one.
+LoadResult Load(const std::string& path, const CommandHandler& handler);
+
+} // namespace rdss::aof
+
+namespace rdss {
+
+class DataStructureService;
+class HashValue;
+class ListValue;
+class SetValue;
+class ZSetValue;
+class RingExecutor;
+
+struct AofStats {
+    std::atomic<bool> rewrite_in_progress{false};
+    std::atomic<bool> last_rewrite_ok{true};
+    std::atomic<bool> last_write_ok{true};
+    std::atomic<uint64_t> rewrites{0};
+    std::atomic<uint64_t> last_rewrite_duration_us{0};
+    // Unix time in seconds.
+    std::atomic<int64_t> current_rewrite_start_time{0};
+    std::atomic<uint64_t> current_size{0};
+    // Size of the file after the last rewrite or loading.
+    std::atomic<uint64_t> base_size{0};
+    // Writes issued, each carries the commands fed during an iteration of the event loop or during
+    // the last write.
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> fsyncs{0};
+    std::atomic<uint64_t> loaded_commands{0};
+};
+
+/// Append only file of a data shard. The executed write commands are appended to a buffer by
+/// Feed(), which is written to the file at the end of the current iteration of the shard's event
+/// loop, so that the commands of all the clients served in one iteration are written by one
+/// submission, linked with a fsync if it's due (group commit). Only one write is in flight at a
+/// time, the commands fed in the meanwhile are written after it completes.
+///
+/// Rewriting compacts the file without forking. Like Snapshotter, the shard traverses its data
+/// table at cron for a limited time each, and writes the commands that recreate each key, e.g. a SET
+/// or a DEL followed by RPUSHes, to a new file. A write command executed in the middle is logged to
+/// the old file as usual, and for each of its keys that has been traversed, the current state of
+/// the key is appended to the new file. The keys yet to be
+/// traversed are saved with their latest values by the traversal. Once the traversal finishes and
+/// the new file is flushed, it replaces the old one.
+///
+/// Everything but Stats() and RequestRewrite() should be called on the shard's executor.
+class AppendOnlyFile {
+public:
+    // Rewritten data are written in chunks of this size.
+    static constexpr size_t kRewriteChunkSize = 256 * 1024;
+    // The traversal of rewriting pauses if more rewritten data are pending to write.
+    static constexpr size_t kMaxRewriteBuffer = 64 * 1024 * 1024;
+    // Buckets to traverse between checks of the time limit.
+    static constexpr size_t kBucketsPerCheck = 64;
+    // Time spent on the traversal of rewriting at every tick of cron.
+    static constexpr auto kRewriteTimeLimit = std::chrono::microseconds{250};
+    // Interval of fsync for everysec, and of retrying after failed writes.
+    static constexpr auto kFsyncInterval = std::chrono::seconds{1};
+
+    AppendOnlyFile(
+      DataStructureService* service, RingExecutor* executor, std::string path, AppendFsync fsync);
+
+    AppendOnlyFile(const AppendOnlyFile&) = delete;
+    AppendOnlyFile& operator=(const AppendOnlyFile&) = delete;
+
+    /// Replays the commands in the file on the service, and cuts off an incomplete command at the
+    /// end of the file. Returns false if the file can't be read, is corrupted, or has commands that
+    /// fail. It should be called before Open().
+    bool Load();
+
+    /// Opens the file for appending, creates it if missing.
+    bool Open();
+
+    /// Logs the write command of 'args' that has been executed successfully.
+    void Feed(const Command& command, Args args);
+
+    /// Returns false if the last write failed, then the write commands are rejected until a retry
+    /// succeeds at cron.
+    bool WriteOk() const { return write_ok_; }
+
+    /// Returns if every write command should be flushed to the disk before it's replied.
+    bool SyncsEveryWrite() const { return fsync_ == AppendFsync::kAlways; }
+
+    /// Returns an awaitable that suspends until the commands fed so far are written and flushed to
+    /// the disk. It doesn't suspend if they already are.
+    auto WaitForSync() {
+        struct SyncAwaiter {
+            bool await_ready() const { return aof->synced_ >= target; }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                aof->sync_waiters_.push_back({.target = target, .handle = handle});
+                aof->DeferFlush();
+            }
+
+            void await_resume() const {}
+
+            AppendOnlyFile* aof;
+            uint64_t target;
+        };
+        return SyncAwaiter{.aof = this, .target = fed_};
+    }
+
+    /// Marks a rewrite as in progress and schedules it on the shard's executor. Returns false if a
+    /// rewrite is already in progress. Rewrites are only requested by data shard 0 or before
+    /// serving, so checking the rewrites of all the shards before requesting is free of race.
+    bool RequestRewrite();
+
+    /// Called at every tick of cron: traverses a part of the table if rewriting, and flushes the
+    /// file if it's due for everysec, or retries the failed writes.
+    void Cron();
+
+    const AofStats& Stats() const { return stats_; }
+
+private:
+    struct SyncWaiter {
+        // Waits until 'synced_' reaches 'target'.
+        uint64_t target;
+        std::coroutine_handle<> handle;
+    };
+
+    struct Rewrite {
+        std::unique_ptr<File> file;
+        uint64_t size{0};
+        size_t cursor{0};
+        bool traversed{false};
+        // Set after the file is written and flushed following the traversal, it then replaces the
+        // old file at the next flush. Data appended to 'buffer' since then become the first data
+        // written to the replaced file.
+        bool ready{false};
+        bool writing{false};
+        std::string buffer;
+        std::string writing_buffer;
+        uint64_t keys{0};
+        std::chrono::steady_clock::time_point start_time;
+    };
+
+    void DeferFlush();
+
+    // Writes 'buffer_' until it's drained, with fsync if it's due or waited for.
+    Task<void> Flush();
+
+    // Writes the rewritten data by chunk, and the rest with fsync after the traversal.
+    Task<void> WriteRewrite();
+
+    void StartRewrite();
+
+    void RewriteSome();
+
+    // Replaces the file with the rewritten one, should only be called when no write is in flight.
+    void SwitchToRewrite();
+
+    void EndRewrite(bool ok);
+
+    void ResumeSyncWaiters();
+
+    // Appends 'args' of a command that has relative expire time, with the expire time replaced by
+    // the absolute one.
+    void AppendWithAbsoluteExpire(std::string& out, Args args);
+
+    // Appends a command that sets 'key' to its current state.
+    void AppendKeyState(std::string& out, std::string_view key);
+
+    // Appends the commands that replace 'key' with 'hash'.
+    void AppendHashState(std::string& out, std::string_view key, const HashValue& hash);
+
+    // Appends the commands that replace 'key' with 'list'.
+    void AppendListState(std::string& out, std::string_view key, const ListValue& list);
+
+    // Appends the commands that replace 'key' with 'set'.
+    void AppendSetState(std::string& out, std::string_view key, const SetValue& set);
+
+    // Appends the commands that replace 'key' with 'zset'.
+    void AppendZSetState(std::string& out, std::string_view key, const ZSetValue& zset);
+
+    DataStructureService* service_;
+    RingExecutor* executor_;
+    const std::string path_;
+    const std::string temp_path_;
+    const AppendFsync fsync_;
+    std::unique_ptr<File> file_;
+    uint64_t size_{0};
+
+    std::string buffer_;
+    std::string writing_buffer_;
+    bool flush_deferred_{false};
+    bool writing_{false};
+    bool write_ok_{true};
+    // Sequence numbers of the commands fed, written, and flushed to the disk.
+    uint64_t fed_{0};
+    uint64_t written_{0};
+    uint64_t synced_{0};
+    std::chrono::steady_clock::time_point last_fsync_;
+    std::chrono::steady_clock::time_point last_check_;
+    std::deque<SyncWaiter> sync_waiters_;
+
+    std::unique_ptr<Rewrite> rewrite_;
+    // Scratch space of the translated commands.
+    StringViews args_;
+    std::string expire_time_;
+    // Copies of the fields and values of a hash, the members of a set, or the scores and members
+    // of a sorted set, as the views passed by their ForEach are only valid during the call.
+    std::vector<std::string> value_args_;
+    AofStats stats_;
+};
+
+} // namespace rdss
@@ -4,9 +4,11 @@
 
 #include "resp/result.h"
 
-#include <functional>
+#include <algorithm>
+#include <charconv>
 #include <memory>
 #include <span>
+#include <string>
 
 namespace rdss {
 
@@ -16,17 +18,58 @@ class Command {
 public:
     using CommandString = std::string_view;
     using CommandStrings = std::span<CommandString>;
-    using HandlerType = std::function<void(DataStructureService&, CommandStrings, Result&)>;
+    // Handlers are plain functions, called without the indirection of std::function.
+    using HandlerType = void (*)(DataStructureService&, CommandStrings, Result&);
+
+    /// Positions of the keys in the command strings: the first key, the last key, and the step
+    /// between keys. Negative 'last' counts from the end, e.g. -1 means the last string. 'first'
+    /// equals 0 means the command has no key. If 'num_keys_index' isn't 0, the number of keys is
+    /// given by the string at that index instead of 'last', e.g. SINTERCARD numkeys key [key ...].
+    struct KeySpec {
+        int32_t first = 0;
+        int32_t last = 0;
+        int32_t step = 1;
+        int32_t num_keys_index = 0;
+
+        /// Returns the index of the last key in 'command_strings', which might be less than
+        /// 'first' if there is no key. An invalid number of keys counts as one key, so that the
+        /// command is routed by its first key and its handler replies the error.
+        int32_t Last(CommandStrings command_strings) const {
+            const auto num_strings = static_cast<int32_t>(command_strings.size());
+            if (num_keys_index == 0) {
+                return (last < 0) ? num_strings + last : std::min(last, num_strings - 1);
+            }
+            int32_t num_keys{1};
+            if (num_keys_index < num_strings) {
+                const auto str = command_strings[static_cast<size_t>(num_keys_index)];
+                std::from_chars(str.data(), str.data() + str.size(), num_keys);
+            }
+            num_keys = std::clamp(num_keys, 1, num_strings);
+            return std::min(first + (num_keys - 1) * step, num_strings - 1);
+        }
+    };
+
+    /// How the command is executed when its keys belong to different data shards.
+    enum class ShardPolicy : uint8_t {
+        kSingle,       // All the keys should belong to one shard, otherwise replies error.
+        kSplitConcat,  // Split by shard, concatenates the replied strings in the order of keys.
+        kSplitSum,     // Split by shard, sums the replied integers.
+        kSplitOk,      // Split by shard, replies OK if every part succeeds.
+        kBroadcastSum, // Keyless, executed on every shard, sums the replied integers.
+    };
 
     Command(std::string name)
       : name_(std::move(name)) {}
 
-    void operator()(DataStructureService& service, CommandStrings command_strings, Result& result) {
-        handler_(service, std::move(command_strings), result);
+    void operator()(
+      DataStructureService& service, CommandStrings command_strings, Result& result) const {
+        handler_(service, command_strings, result);
     }
 
+    const std::string& Name() const { return name_; }
+
     Command& SetHandler(HandlerType handler) {
-        handler_ = std::move(handler);
+        handler_ = handler;
         return *this;
     }
 
@@ -37,10 +80,55 @@ public:
 
     bool IsWriteCommand() const { return is_write_command_; }
 
+    /// The command may set an expire time relative to the command time, e.g. SET key value EX 10.
+    /// It's logged to the append only file with the absolute expire time instead, so that it
+    /// yields the same expire time when replayed.
+    Command& SetHasRelativeExpire() {
+        has_relative_expire_ = true;
+        return *this;
+    }
+
+    bool HasRelativeExpire() const { return has_relative_expire_; }
+
+    /// The command may block the client until one of its keys is ready, e.g. BLPOP. It replies nil
+    /// when it would block, then the client waits on the data shard of its keys, which invokes it
+    /// again once a key is ready, see DataStructureService::WaitForKeys(). Its keys are all its
+    /// strings but the name and the last one, which is the timeout in seconds.
+    Command& SetIsBlocking() {
+        is_blocking_ = true;
+        return *this;
+    }
+
+    bool IsBlocking() const { return is_blocking_; }
+
+    Command& SetKeySpec(int32_t first, int32_t last, int32_t step = 1) {
+        key_spec_ = KeySpec{.first = first, .last = last, .step = step};
+        return *this;
+    }
+
+    /// The keys start at 'first', and their number is given by the string at 'num_keys_index'.
+    Command& SetKeySpecWithNumKeys(int32_t num_keys_index, int32_t first) {
+        key_spec_ = KeySpec{.first = first, .last = 0, .step = 1, .num_keys_index = num_keys_index};
+        return *this;
+    }
+
+    const KeySpec& GetKeySpec() const { return key_spec_; }
+
+    Command& SetShardPolicy(ShardPolicy policy) {
+        shard_policy_ = policy;
+        return *this;
+    }
+
+    ShardPolicy GetShardPolicy() const { return shard_policy_; }
+
 private:
     const std::string name_;
     bool is_write_command_ = false;
-    HandlerType handler_;
+    bool has_relative_expire_ = false;
+    bool is_blocking_ = false;
+    KeySpec key_spec_;
+    ShardPolicy shard_policy_ = ShardPolicy::kSingle;
+    HandlerType handler_{nullptr};
 };
 
 using Args = Command::CommandStrings;
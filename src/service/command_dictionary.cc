@@ -0,0 +1,72 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "command_dictionary.h"
+
+#include <glog/logging.h>
+
+#include <bit>
+#include <cstring>
+
+namespace rdss {
+
+namespace {
+
+// Seeds tried for a table size before it's doubled.
+constexpr size_t kSeedsPerSize = 64;
+
+} // namespace
+
+CommandDictionary::FoldedName CommandDictionary::Fold(std::string_view name) {
+    assert(name.size() <= kMaxNameLength);
+    FoldedName folded{};
+    std::memcpy(folded.data(), name.data(), name.size());
+    reinterpret_cast<uint8_t*>(folded.data())[kMaxNameLength] = static_cast<uint8_t>(name.size());
+    folded[0] = ToLower(folded[0]);
+    folded[1] = ToLower(folded[1]);
+    return folded;
+}
+
+CommandId CommandDictionary::Add(std::string_view name, Command command) {
+    if (name.empty() || name.size() > kMaxNameLength) {
+        LOG(FATAL) << "Invalid command name '" << name << "'.";
+    }
+    if (Find(name) != kNoCommand) {
+        LOG(FATAL) << "Command '" << name << "' is registered twice.";
+    }
+    const auto id = static_cast<CommandId>(commands_.size());
+    commands_.push_back(std::move(command));
+    names_.push_back(Fold(name));
+    stats_.emplace_back();
+    Rebuild();
+    return id;
+}
+
+void CommandDictionary::Rebuild() {
+    // Doubles the table until a seed maps the names apart, which ends at a few times the number of
+    // names. It's a few KB for the registered commands.
+    auto size = std::bit_ceil(names_.size() * 2);
+    std::vector<Slot> slots;
+    while (true) {
+        for (uint64_t seed = 0; seed < kSeedsPerSize; ++seed) {
+            slots.assign(size, Slot{});
+            bool perfect{true};
+            for (CommandId id = 0; id < names_.size(); ++id) {
+                auto& slot = slots[Hash(names_[id], seed) & (size - 1)];
+                if (slot.id != kNoCommand) {
+                    perfect = false;
+                    break;
+                }
+                slot = Slot{.folded = names_[id], .id = id};
+            }
+            if (perfect) {
+                slots_ = std::move(slots);
+                mask_ = size - 1;
+                seed_ = seed;
+                return;
+            }
+        }
+        size *= 2;
+    }
+}
+
+} // namespace rdss
@@ -2,24 +2,109 @@
 // Licensed under the MIT license.
 #pragma once
 
+#include "base/latency_histogram.h"
+#include "command.h"
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <limits>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
 
 namespace rdss {
 
-class Command;
+using CommandName = std::string;
 
-struct string_hash {
-    using hash_type = std::hash<std::string_view>;
-    using is_transparent = void;
+/// Dense index of a command in the dictionary it's registered to. The commands are registered in
+/// the same order to every data shard, so the id of a command is the same on every shard.
+using CommandId = uint32_t;
 
-    std::size_t operator()(const char* str) const { return hash_type{}(str); }
-    std::size_t operator()(std::string_view str) const { return hash_type{}(str); }
-    std::size_t operator()(std::string const& str) const { return hash_type{}(str); }
+/// Written by the data shard executing the commands, see SingleWriterAdd.
+struct CommandStats {
+    // Execution time of the calls, and the number of them.
+    LatencyHistogram latency;
+    // Not executed since the server can't accept writes, e.g. maxmemory is reached.
+    std::atomic<uint64_t> rejected_calls{};
+    // Executed and replied an error.
+    std::atomic<uint64_t> failed_calls{};
 };
 
-using CommandName = std::string;
-using CommandDictionary = std::unordered_map<CommandName, Command, string_hash, std::equal_to<>>;
+/// Commands stored in a flat array indexed by their ids, and a table mapping the case-insensitive
+/// names to the ids. The table is rebuilt on every registration with a seed that maps the names to
+/// distinct slots, so looking up a name hashes it once and compares with a single slot.
+class CommandDictionary {
+public:
+    static constexpr CommandId kNoCommand = std::numeric_limits<CommandId>::max();
+    /// Names are folded into two 64-bit words along with their lengths, longer ones can't be
+    /// registered.
+    static constexpr size_t kMaxNameLength = 15;
+
+    /// Registers 'command' under 'name' in any case, returns its id.
+    CommandId Add(std::string_view name, Command command);
+
+    /// Returns the id of the command named 'name' ignoring case, or kNoCommand.
+    CommandId Find(std::string_view name) const {
+        if (name.size() > kMaxNameLength || name.empty()) {
+            return kNoCommand;
+        }
+        const auto folded = Fold(name);
+        const auto& slot = slots_[Hash(folded, seed_) & mask_];
+        if (slot.folded != folded) {
+            return kNoCommand;
+        }
+        return slot.id;
+    }
+
+    Command& Get(CommandId id) { return commands_[id]; }
+
+    const Command& Get(CommandId id) const { return commands_[id]; }
+
+    CommandStats& Stats(CommandId id) { return stats_[id]; }
+
+    const CommandStats& Stats(CommandId id) const { return stats_[id]; }
+
+    size_t Size() const { return commands_.size(); }
+
+private:
+    // Lower-cased name padded with zero bytes, and its length in the last byte.
+    using FoldedName = std::array<uint64_t, 2>;
+
+    struct Slot {
+        FoldedName folded{};
+        CommandId id{kNoCommand};
+    };
+
+    // Lower-cases the ASCII letters of 8 bytes at once.
+    static uint64_t ToLower(uint64_t word) {
+        constexpr uint64_t kOnes = 0x0101010101010101ULL;
+        const auto heptets = word & (0x7F * kOnes);
+        // The high bit of a byte is set if it's at least 'A', and if it's greater than 'Z'.
+        const auto ge_a = heptets + (0x80 - 'A') * kOnes;
+        const auto gt_z = heptets + (0x7F - 'Z') * kOnes;
+        const auto is_upper = ~word & (ge_a ^ gt_z) & (0x80 * kOnes);
+        return word | (is_upper >> 2);
+    }
+
+    static FoldedName Fold(std::string_view name);
+
+    static uint64_t Hash(const FoldedName& folded, uint64_t seed) {
+        auto h = (folded[0] ^ seed) * 0x9E3779B97F4A7C15ULL;
+        h = (h ^ (h >> 29) ^ folded[1]) * 0xBF58476D1CE4E5B9ULL;
+        return h ^ (h >> 32);
+    }
+
+    // Finds a seed and a table size that map the names of 'commands_' to distinct slots.
+    void Rebuild();
+
+    std::vector<Command> commands_;
+    std::vector<FoldedName> names_;
+    // Counters don't move, since they are read by other threads for INFO.
+    std::deque<CommandStats> stats_;
+    std::vector<Slot> slots_{1};
+    uint64_t mask_{0};
+    uint64_t seed_{0};
+};
 
 }; // namespace rdss
@@ -3,17 +3,27 @@
 #include "command_registry.h"
 
 #include "commands/client_commands.h"
+#include "commands/hash_commands.h"
+#include "commands/hyperloglog_commands.h"
 #include "commands/key_commands.h"
+#include "commands/list_commands.h"
 #include "commands/misc_commands.h"
+#include "commands/set_commands.h"
 #include "commands/string_commands.h"
+#include "commands/zset_commands.h"
 
 namespace rdss {
 
 void RegisterCommands(DataStructureService* service) {
     RegisterClientCommands(service);
+    RegisterHashCommands(service);
+    RegisterHyperLogLogCommands(service);
     RegisterKeyCommands(service);
+    RegisterListCommands(service);
     RegisterMiscCommands(service);
+    RegisterSetCommands(service);
     RegisterStringCommands(service);
+    RegisterZSetCommands(service);
 }
 
 } // namespace rdss
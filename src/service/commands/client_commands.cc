@@ -2,11 +2,91 @@
 // Licensed under the MIT license.
 #include "client_commands.h"
 
+#include "client_manager.h"
+#include "server.h"
 #include "service/command.h"
+#include "service/commands/command_util.h"
 #include "service/data_structure_service.h"
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <charconv>
+#include <optional>
+#include <sstream>
+
 namespace rdss {
 
+namespace {
+
+std::string AddrToString(const ClientInfo& info) {
+    in_addr addr{.s_addr = htonl(info.ip)};
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+    return std::string(ip) + ':' + std::to_string(info.port);
+}
+
+void ClientListFunction(ClientManager& manager, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    std::stringstream stream;
+    manager.ForEachClient([&stream](const ClientInfo& info) {
+        stream << "id=" << info.id << " addr=" << AddrToString(info) << " fd=" << info.fd
+               << " age=" << info.age.count() << " idle=" << info.idle.count()
+               << " flags=N db=0\n";
+    });
+    result.SetString(CreateMTSPtr(stream.str()));
+}
+
+// CLIENT KILL ip:port replies OK if the client exists. CLIENT KILL [ID id] [ADDR ip:port] replies
+// the number of the clients matching all the filters.
+void ClientKillFunction(ClientManager& manager, Args args, Result& result) {
+    if (args.size() == 3) {
+        const auto addr = args[2];
+        const auto killed = manager.KillClients(
+          [addr](const ClientInfo& info) { return AddrToString(info) == addr; });
+        if (killed == 0) {
+            result.SetError(Error::kNoSuchClient);
+        } else {
+            result.SetOk();
+        }
+        return;
+    }
+    if (args.size() < 4 || args.size() % 2 != 0) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+
+    std::optional<uint64_t> id;
+    std::optional<std::string_view> addr;
+    for (size_t i = 2; i < args.size(); i += 2) {
+        if (EqualsIgnoreCase(args[i], "ID")) {
+            uint64_t value{0};
+            const auto [ptr, ec] = std::from_chars(
+              args[i + 1].data(), args[i + 1].data() + args[i + 1].size(), value);
+            if (ec != std::errc{} || ptr != args[i + 1].data() + args[i + 1].size()) {
+                result.SetError(Error::kNotAnInt);
+                return;
+            }
+            id = value;
+        } else if (EqualsIgnoreCase(args[i], "ADDR")) {
+            addr = args[i + 1];
+        } else {
+            result.SetError(Error::kSyntaxError);
+            return;
+        }
+    }
+    const auto killed = manager.KillClients([&id, &addr](const ClientInfo& info) {
+        return (!id.has_value() || info.id == *id)
+               && (!addr.has_value() || AddrToString(info) == *addr);
+    });
+    result.SetInt(static_cast<int64_t>(killed));
+}
+
+} // namespace
+
 // TODO: This needs more work.
 void HelloFunction(DataStructureService&, Args command_strings, Result& result) {
     if (command_strings.size() == 2 && !command_strings[1].compare("3")) {
@@ -16,8 +96,24 @@ void HelloFunction(DataStructureService&, Args command_strings, Result& result)
     }
 }
 
+void ClientFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto& manager = *service.GetServer()->GetClientManager();
+    if (EqualsIgnoreCase(args[1], "LIST")) {
+        ClientListFunction(manager, args, result);
+    } else if (EqualsIgnoreCase(args[1], "KILL")) {
+        ClientKillFunction(manager, args, result);
+    } else {
+        result.SetError(Error::kSyntaxError);
+    }
+}
+
 void RegisterClientCommands(DataStructureService* service) {
     service->RegisterCommand("HELLO", Command("HELLO").SetHandler(HelloFunction));
+    service->RegisterCommand("CLIENT", Command("CLIENT").SetHandler(ClientFunction));
 }
 
 } // namespace rdss
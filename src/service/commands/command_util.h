@@ -0,0 +1,84 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "service/command.h"
+#include "service/data_structure_service.h"
+
+#include <strings.h>
+
+#include <charconv>
+#include <optional>
+#include <string_view>
+
+namespace rdss {
+
+/// Parses the whole 'str' as an integer, returns nullopt if it isn't one or if it's out of range.
+template<typename Rep = int64_t>
+std::optional<Rep> ParseInt(std::string_view str) {
+    Rep i;
+    auto [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), i);
+    if (err != std::errc{} || ptr != str.data() + str.size()) {
+        return std::nullopt;
+    }
+    return i;
+}
+
+inline bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+/// Returns true if 'value' is of the type checked by 'IsType', otherwise sets WRONGTYPE error. It's
+/// the check of FindTyped() and FindOrCreateTyped() for the types that have no other error.
+template<bool (StringValue::*IsType)() const>
+bool CheckType(const StringValue& value, Result& result) {
+    if (!(value.*IsType)()) {
+        result.SetError(Error::kWrongType);
+        return false;
+    }
+    return true;
+}
+
+/// Finds the value of 'key' for reading. Returns nullptr if the key doesn't exist, or if
+/// 'check(value, result)' returns false, which sets the error, e.g. by CheckType().
+template<typename Check>
+MTSHashTable::EntryPointer
+FindTyped(DataStructureService& service, std::string_view key, Result& result, Check check) {
+    auto entry = service.FindOrExpire(key);
+    if (entry == nullptr || !check(entry->value, result)) {
+        return nullptr;
+    }
+    entry->SetLRU(service.GetLRUClock());
+    return entry;
+}
+
+/// Finds the value of 'key' for writing, replacing a missing or expired one by 'create()' and
+/// setting 'created' if it's given. Returns nullptr if the existing value fails 'check' like
+/// FindTyped().
+template<typename Check, typename Create>
+MTSHashTable::EntryPointer FindOrCreateTyped(
+  DataStructureService& service,
+  std::string_view key,
+  Result& result,
+  Check check,
+  Create create,
+  bool* created = nullptr) {
+    auto [entry, exists] = service.DataTable()->FindOrCreate(key, true);
+    if (exists && service.IsExpired(entry)) {
+        entry->value.Reset();
+        service.Persist(entry);
+    }
+    const bool is_new = entry->value.IsNull();
+    if (is_new) {
+        entry->value = create();
+    } else if (!check(entry->value, result)) {
+        return nullptr;
+    }
+    if (created != nullptr) {
+        *created = is_new;
+    }
+    entry->SetLRU(service.GetLRUClock());
+    return entry;
+}
+
+} // namespace rdss
@@ -0,0 +1,227 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "hash_commands.h"
+
+#include "data_structure/hash_value.h"
+#include "service/command.h"
+#include "service/commands/command_util.h"
+#include "service/data_structure_service.h"
+
+#include <limits>
+#include <optional>
+
+namespace rdss {
+
+namespace {
+
+HashValue::Limits GetLimits(const DataStructureService& service) {
+    const auto* config = service.GetConfig();
+    return {
+      .max_listpack_entries = config->hash_max_listpack_entries,
+      .max_listpack_value = config->hash_max_listpack_value};
+}
+
+MTSHashTable::EntryPointer
+FindHash(DataStructureService& service, std::string_view key, Result& result) {
+    return FindTyped(service, key, result, CheckType<&StringValue::IsHash>);
+}
+
+MTSHashTable::EntryPointer
+FindOrCreateHash(DataStructureService& service, std::string_view key, Result& result) {
+    return FindOrCreateTyped(
+      service, key, result, CheckType<&StringValue::IsHash>, StringValue::CreateHash);
+}
+
+// Sets the field-value pairs of 'args' from the third one, returns the number of new fields, or
+// nullopt if WRONGTYPE error is set.
+std::optional<int64_t> SetFields(DataStructureService& service, Args args, Result& result) {
+    auto entry = FindOrCreateHash(service, args[1], result);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    const auto limits = GetLimits(service);
+    auto& hash = entry->value.Hash();
+    int64_t added{0};
+    for (size_t i = 2; i < args.size(); i += 2) {
+        added += hash.Set(args[i], args[i + 1], limits) ? 1 : 0;
+    }
+    return added;
+}
+
+} // namespace
+
+void HSetFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 4 || args.size() % 2 != 0) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto added = SetFields(service, args, result);
+    if (added.has_value()) {
+        result.SetInt(added.value());
+    }
+}
+
+void HMSetFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 4 || args.size() % 2 != 0) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    if (SetFields(service, args, result).has_value()) {
+        result.SetOk();
+    }
+}
+
+void HGetFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetNil();
+    auto entry = FindHash(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    auto value = entry->value.Hash().Get(args[2]);
+    if (!value.IsNull()) {
+        result.SetString(std::move(value));
+    }
+}
+
+void HMGetFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindHash(service, args[1], result);
+    if (entry == nullptr) {
+        if (result.type != Result::Type::kError) {
+            for (size_t i = 2; i < args.size(); ++i) {
+                result.AddString(nullptr);
+            }
+        }
+        return;
+    }
+    const auto& hash = entry->value.Hash();
+    for (size_t i = 2; i < args.size(); ++i) {
+        result.AddString(hash.Get(args[i]));
+    }
+}
+
+void HGetAllFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // Empty array if the key doesn't exist.
+    result.type = Result::Type::kStrings;
+    auto entry = FindHash(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto& hash = entry->value.Hash();
+    result.strings.reserve(hash.Size() * 2);
+    hash.ForEach([&result](std::string_view field, std::string_view value) {
+        result.AddString(StringValue(field));
+        result.AddString(StringValue(value));
+    });
+}
+
+void HIncrByFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto increment = ParseInt(args[3]);
+    if (!increment.has_value()) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+    auto entry = FindOrCreateHash(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    auto& hash = entry->value.Hash();
+
+    int64_t current{0};
+    const auto value = hash.Get(args[2]);
+    if (!value.IsNull()) {
+        StringValue::IntChars chars;
+        const auto parsed = ParseInt(value.View(chars));
+        if (!parsed.has_value()) {
+            result.SetError(Error::kNotAnInt);
+            return;
+        }
+        current = parsed.value();
+    }
+    const auto inc = increment.value();
+    if (
+      (inc > 0 && current > std::numeric_limits<int64_t>::max() - inc)
+      || (inc < 0 && current < std::numeric_limits<int64_t>::min() - inc)) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+
+    current += inc;
+    StringValue::IntChars chars;
+    auto [ptr, _] = std::to_chars(chars.data(), chars.data() + chars.size(), current);
+    hash.Set(
+      args[2],
+      std::string_view(chars.data(), static_cast<size_t>(ptr - chars.data())),
+      GetLimits(service));
+    result.SetInt(current);
+}
+
+void HDelFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindHash(service, args[1], result);
+    if (entry == nullptr) {
+        if (result.type != Result::Type::kError) {
+            result.SetInt(0);
+        }
+        return;
+    }
+    auto& hash = entry->value.Hash();
+    int64_t deleted{0};
+    for (size_t i = 2; i < args.size(); ++i) {
+        deleted += hash.Erase(args[i]) ? 1 : 0;
+    }
+    // Like Redis, a hash without field doesn't exist.
+    if (hash.Size() == 0) {
+        service.EraseKey(entry);
+    }
+    result.SetInt(deleted);
+}
+
+void HLenFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetInt(0);
+    auto entry = FindHash(service, args[1], result);
+    if (entry != nullptr) {
+        result.SetInt(static_cast<int64_t>(entry->value.Hash().Size()));
+    }
+}
+
+void RegisterHashCommands(DataStructureService* service) {
+    service->RegisterCommand(
+      "HSET", Command("HSET").SetHandler(HSetFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "HMSET", Command("HMSET").SetHandler(HMSetFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand("HGET", Command("HGET").SetHandler(HGetFunction).SetKeySpec(1, 1));
+    service->RegisterCommand("HMGET", Command("HMGET").SetHandler(HMGetFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "HGETALL", Command("HGETALL").SetHandler(HGetAllFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "HINCRBY",
+      Command("HINCRBY").SetHandler(HIncrByFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "HDEL", Command("HDEL").SetHandler(HDelFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand("HLEN", Command("HLEN").SetHandler(HLenFunction).SetKeySpec(1, 1));
+}
+
+} // namespace rdss
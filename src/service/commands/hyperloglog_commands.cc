@@ -0,0 +1,157 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "hyperloglog_commands.h"
+
+#include "base/config.h"
+#include "data_structure/hyperloglog.h"
+#include "service/command.h"
+#include "service/commands/command_util.h"
+#include "service/data_structure_service.h"
+
+#include <cassert>
+
+namespace rdss {
+
+namespace {
+
+// Returns true if 'value' is a valid HyperLogLog, otherwise sets WRONGTYPE error if it isn't a
+// string, or NOTANHLL error. A HyperLogLog is longer than an embedded string and isn't an
+// integer, so it's always raw encoded.
+bool IsHyperLogLog(const StringValue& value, Result& result) {
+    if (!value.IsString()) {
+        result.SetError(Error::kWrongType);
+        return false;
+    }
+    if (value.GetEncoding() != StringValue::Encoding::kRaw || !hyperloglog::IsValid(*value.Raw())) {
+        result.SetError(Error::kNotAnHll);
+        return false;
+    }
+    return true;
+}
+
+MTSHashTable::EntryPointer
+FindHyperLogLog(DataStructureService& service, std::string_view key, Result& result) {
+    return FindTyped(service, key, result, IsHyperLogLog);
+}
+
+// Like FindHyperLogLog(), but creates an empty one and sets 'created' if the key doesn't exist.
+MTSHashTable::EntryPointer FindOrCreateHyperLogLog(
+  DataStructureService& service, std::string_view key, Result& result, bool& created) {
+    return FindOrCreateTyped(
+      service,
+      key,
+      result,
+      IsHyperLogLog,
+      [] { return StringValue(CreateMTSPtr(hyperloglog::Create())); },
+      &created);
+}
+
+} // namespace
+
+void PFAddFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    bool created{false};
+    auto entry = FindOrCreateHyperLogLog(service, args[1], result, created);
+    if (entry == nullptr) {
+        return;
+    }
+    const size_t sparse_max_bytes = service.GetConfig()->hll_sparse_max_bytes;
+    // The registers are modified in place, the string isn't shared with a reply after MakeRaw().
+    auto& hll = entry->value.MakeRaw();
+    // Creating the key counts as an update even without elements.
+    bool updated = created;
+    for (size_t i = 2; i < args.size(); ++i) {
+        const auto added = hyperloglog::Add(hll, args[i], sparse_max_bytes);
+        if (!added.has_value()) {
+            result.SetError(Error::kCorruptedHll);
+            return;
+        }
+        updated = updated || added.value();
+    }
+    result.SetInt(updated ? 1 : 0);
+}
+
+void PFCountFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    if (args.size() == 2) {
+        // Like Redis, the cardinality of a single key is cached in its header until it's modified.
+        auto entry = FindHyperLogLog(service, args[1], result);
+        if (entry == nullptr) {
+            if (result.type != Result::Type::kError) {
+                result.SetInt(0);
+            }
+            return;
+        }
+        const auto count = hyperloglog::Count(entry->value.MakeRaw());
+        if (!count.has_value()) {
+            result.SetError(Error::kCorruptedHll);
+            return;
+        }
+        result.SetInt(static_cast<int64_t>(count.value()));
+        return;
+    }
+
+    // The union of multiple keys is estimated from the max of their registers.
+    hyperloglog::Registers registers{};
+    for (size_t i = 1; i < args.size(); ++i) {
+        auto entry = FindHyperLogLog(service, args[i], result);
+        if (result.type == Result::Type::kError) {
+            return;
+        }
+        if (entry != nullptr && !hyperloglog::Merge(*entry->value.Raw(), registers)) {
+            result.SetError(Error::kCorruptedHll);
+            return;
+        }
+    }
+    result.SetInt(static_cast<int64_t>(hyperloglog::Count(registers)));
+}
+
+void PFMergeFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // The destination is merged as well if it exists. The result is kept sparse only if all of
+    // them are sparse, since a dense one rarely merges into something that fits.
+    hyperloglog::Registers registers{};
+    bool sparse{true};
+    for (size_t i = 1; i < args.size(); ++i) {
+        auto entry = FindHyperLogLog(service, args[i], result);
+        if (result.type == Result::Type::kError) {
+            return;
+        }
+        if (entry == nullptr) {
+            continue;
+        }
+        const auto& hll = *entry->value.Raw();
+        sparse = sparse && hyperloglog::IsSparse(hll);
+        if (!hyperloglog::Merge(hll, registers)) {
+            result.SetError(Error::kCorruptedHll);
+            return;
+        }
+    }
+    bool created{false};
+    auto entry = FindOrCreateHyperLogLog(service, args[1], result, created);
+    assert(entry != nullptr);
+    hyperloglog::Store(
+      registers, entry->value.MakeRaw(), sparse, service.GetConfig()->hll_sparse_max_bytes);
+    result.SetOk();
+}
+
+void RegisterHyperLogLogCommands(DataStructureService* service) {
+    service->RegisterCommand(
+      "PFADD", Command("PFADD").SetHandler(PFAddFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "PFCOUNT", Command("PFCOUNT").SetHandler(PFCountFunction).SetKeySpec(1, -1));
+    service->RegisterCommand(
+      "PFMERGE",
+      Command("PFMERGE").SetHandler(PFMergeFunction).SetIsWriteCommand().SetKeySpec(1, -1));
+}
+
+} // namespace rdss
@@ -5,6 +5,7 @@
 #include "service/command.h"
 #include "service/data_structure_service.h"
 
+#include <charconv>
 #include <chrono>
 
 namespace rdss {
@@ -15,27 +16,18 @@ void TtlFunction(DataStructureService& service, Args args, Result& result) {
         return;
     }
 
-    auto key = args[1];
-    auto data_entry = service.DataTable()->Find(key);
-    if (data_entry == nullptr) {
+    auto entry = service.FindOrExpire(args[1]);
+    if (entry == nullptr) {
         result.SetInt(-2);
         return;
     }
-    auto expire_entry = service.ExpireTable()->Find(key);
-    if (expire_entry == nullptr) {
+    if (!entry->HasExpire()) {
         result.SetInt(-1);
         return;
     }
-    const auto cmd_time = service.GetCommandTimeSnapshot();
-    if (expire_entry->value <= cmd_time) {
-        service.DataTable()->Erase(key);
-        service.ExpireTable()->Erase(key);
-        result.SetInt(-2);
-        return;
-    }
 
     const auto ttl = std::chrono::duration_cast<std::chrono::seconds>(
-      expire_entry->value - cmd_time);
+      entry->GetExpire() - service.GetCommandTimeSnapshot());
     result.SetInt(ttl.count());
 }
 
@@ -47,19 +39,56 @@ void DelFunction(DataStructureService& service, Args args, Result& result) {
 
     int deleted{0};
     for (size_t i = 1; i < args.size(); ++i) {
-        auto key = args[i];
-        auto entry = service.FindOrExpire(key);
+        auto entry = service.FindOrExpire(args[i]);
         if (entry != nullptr) {
-            service.EraseKey(key);
+            service.EraseKey(entry);
             ++deleted;
         }
     }
     result.SetInt(deleted);
 }
 
+void PExpireAtFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+
+    int64_t ms;
+    const auto str = args[2];
+    auto [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), ms);
+    if (err != std::errc{} || ptr != str.data() + str.size()) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+
+    auto entry = service.FindOrExpire(args[1]);
+    if (entry == nullptr) {
+        result.SetInt(0);
+        return;
+    }
+    const DataStructureService::TimePoint expire_time{std::chrono::milliseconds{ms}};
+    if (expire_time <= service.GetCommandTimeSnapshot()) {
+        // Like Redis, the key is deleted right away if the time is in the past.
+        service.EraseKey(entry);
+    } else {
+        service.SetExpire(entry, expire_time);
+    }
+    result.SetInt(1);
+}
+
 void RegisterKeyCommands(DataStructureService* service) {
-    service->RegisterCommand("TTL", Command("TTL").SetHandler(TtlFunction));
-    service->RegisterCommand("DEL", Command("DEL").SetHandler(DelFunction).SetIsWriteCommand());
+    service->RegisterCommand("TTL", Command("TTL").SetHandler(TtlFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "DEL",
+      Command("DEL")
+        .SetHandler(DelFunction)
+        .SetIsWriteCommand()
+        .SetKeySpec(1, -1)
+        .SetShardPolicy(Command::ShardPolicy::kSplitSum));
+    service->RegisterCommand(
+      "PEXPIREAT",
+      Command("PEXPIREAT").SetHandler(PExpireAtFunction).SetIsWriteCommand().SetKeySpec(1, 1));
 }
 
 } // namespace rdss
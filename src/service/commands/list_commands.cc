@@ -0,0 +1,276 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "list_commands.h"
+
+#include "base/config.h"
+#include "data_structure/list_value.h"
+#include "service/command.h"
+#include "service/commands/command_util.h"
+#include "service/data_structure_service.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace rdss {
+
+namespace {
+
+ListValue::Limits GetLimits(const DataStructureService& service) {
+    return {.max_listpack_size = service.GetConfig()->list_max_listpack_size};
+}
+
+MTSHashTable::EntryPointer
+FindList(DataStructureService& service, std::string_view key, Result& result) {
+    return FindTyped(service, key, result, CheckType<&StringValue::IsList>);
+}
+
+MTSHashTable::EntryPointer
+FindOrCreateList(DataStructureService& service, std::string_view key, Result& result) {
+    return FindOrCreateTyped(
+      service, key, result, CheckType<&StringValue::IsList>, StringValue::CreateList);
+}
+
+// Converts the inclusive range of possibly negative indexes to the one of ListValue::Range(),
+// returns nullopt if it's empty.
+std::optional<std::pair<size_t, size_t>> NormalizeRange(int64_t start, int64_t stop, size_t size) {
+    const auto len = static_cast<int64_t>(size);
+    if (start < 0) {
+        start = std::max<int64_t>(start + len, 0);
+    }
+    if (stop < 0) {
+        stop += len;
+    }
+    if (start > stop || start >= len) {
+        return std::nullopt;
+    }
+    return std::make_pair(static_cast<size_t>(start), static_cast<size_t>(stop));
+}
+
+void Push(DataStructureService& service, Args args, Result& result, bool front) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindOrCreateList(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto limits = GetLimits(service);
+    auto& list = entry->value.List();
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (front) {
+            list.PushFront(args[i], limits);
+        } else {
+            list.PushBack(args[i], limits);
+        }
+    }
+    result.SetInt(static_cast<int64_t>(list.Size()));
+    service.SignalKeyReady(args[1]);
+}
+
+// Pops up to 'count' elements of the list of 'entry' into 'result', erasing the key if the list
+// is drained.
+void PopElements(
+  DataStructureService& service,
+  MTSHashTable::EntryPointer entry,
+  size_t count,
+  Result& result,
+  bool front) {
+    auto& list = entry->value.List();
+    count = std::min(count, list.Size());
+    result.strings.reserve(result.strings.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        result.AddString(front ? list.PopFront() : list.PopBack());
+    }
+    // Like Redis, an empty list doesn't exist.
+    if (list.Size() == 0) {
+        service.EraseKey(entry);
+    }
+}
+
+void Pop(DataStructureService& service, Args args, Result& result, bool front) {
+    if (args.size() != 2 && args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    std::optional<int64_t> count;
+    if (args.size() == 3) {
+        count = ParseInt(args[2]);
+        if (!count.has_value() || count.value() < 0) {
+            result.SetError(Error::kNotAnInt);
+            return;
+        }
+    }
+    result.SetNil();
+    auto entry = FindList(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    if (!count.has_value()) {
+        auto& list = entry->value.List();
+        result.SetString(front ? list.PopFront() : list.PopBack());
+        if (list.Size() == 0) {
+            service.EraseKey(entry);
+        }
+        return;
+    }
+    // With count, replies an array even if it's empty.
+    result.type = Result::Type::kStrings;
+    PopElements(service, entry, static_cast<size_t>(count.value()), result, front);
+}
+
+void BlockingPop(DataStructureService& service, Args args, Result& result, bool front) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    if (!ParseBlockTimeout(args.back()).has_value()) {
+        result.SetError(Error::kInvalidTimeout);
+        return;
+    }
+    // Pops from the first non-empty list. Replying nil blocks the client, see
+    // DataStructureService::WaitForKeys().
+    result.SetNil();
+    for (size_t i = 1; i + 1 < args.size(); ++i) {
+        auto entry = FindList(service, args[i], result);
+        if (result.type == Result::Type::kError) {
+            return;
+        }
+        if (entry == nullptr) {
+            continue;
+        }
+        result.type = Result::Type::kStrings;
+        result.AddString(StringValue(args[i]));
+        PopElements(service, entry, 1, result, front);
+        // Like Redis, it's logged as the pop it did, whether it blocked or not.
+        service.PropagateAs({front ? "LPOP" : "RPOP", args[i]});
+        return;
+    }
+}
+
+} // namespace
+
+void LPushFunction(DataStructureService& service, Args args, Result& result) {
+    Push(service, args, result, true);
+}
+
+void RPushFunction(DataStructureService& service, Args args, Result& result) {
+    Push(service, args, result, false);
+}
+
+void LPopFunction(DataStructureService& service, Args args, Result& result) {
+    Pop(service, args, result, true);
+}
+
+void RPopFunction(DataStructureService& service, Args args, Result& result) {
+    Pop(service, args, result, false);
+}
+
+void BLPopFunction(DataStructureService& service, Args args, Result& result) {
+    BlockingPop(service, args, result, true);
+}
+
+void BRPopFunction(DataStructureService& service, Args args, Result& result) {
+    BlockingPop(service, args, result, false);
+}
+
+void LRangeFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto start = ParseInt(args[2]);
+    const auto stop = ParseInt(args[3]);
+    if (!start.has_value() || !stop.has_value()) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+    // Empty array if the key doesn't exist.
+    result.type = Result::Type::kStrings;
+    auto entry = FindList(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto& list = entry->value.List();
+    const auto range = NormalizeRange(start.value(), stop.value(), list.Size());
+    if (!range.has_value()) {
+        return;
+    }
+    const auto [first, last] = range.value();
+    result.strings.reserve(std::min(last, list.Size() - 1) - first + 1);
+    list.Range(first, last, [&result](std::string_view element) {
+        result.AddString(StringValue(element));
+    });
+}
+
+void LLenFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetInt(0);
+    auto entry = FindList(service, args[1], result);
+    if (entry != nullptr) {
+        result.SetInt(static_cast<int64_t>(entry->value.List().Size()));
+    }
+}
+
+void LTrimFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto start = ParseInt(args[2]);
+    const auto stop = ParseInt(args[3]);
+    if (!start.has_value() || !stop.has_value()) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+    auto entry = FindList(service, args[1], result);
+    if (result.type == Result::Type::kError) {
+        return;
+    }
+    result.SetOk();
+    if (entry == nullptr) {
+        return;
+    }
+    auto& list = entry->value.List();
+    const auto range = NormalizeRange(start.value(), stop.value(), list.Size());
+    if (!range.has_value()) {
+        service.EraseKey(entry);
+        return;
+    }
+    list.Trim(range->first, range->second);
+}
+
+void RegisterListCommands(DataStructureService* service) {
+    service->RegisterCommand(
+      "LPUSH", Command("LPUSH").SetHandler(LPushFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "RPUSH", Command("RPUSH").SetHandler(RPushFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "LPOP", Command("LPOP").SetHandler(LPopFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "RPOP", Command("RPOP").SetHandler(RPopFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "BLPOP",
+      Command("BLPOP")
+        .SetHandler(BLPopFunction)
+        .SetIsWriteCommand()
+        .SetIsBlocking()
+        .SetKeySpec(1, -2));
+    service->RegisterCommand(
+      "BRPOP",
+      Command("BRPOP")
+        .SetHandler(BRPopFunction)
+        .SetIsWriteCommand()
+        .SetIsBlocking()
+        .SetKeySpec(1, -2));
+    service->RegisterCommand(
+      "LRANGE", Command("LRANGE").SetHandler(LRangeFunction).SetKeySpec(1, 1));
+    service->RegisterCommand("LLEN", Command("LLEN").SetHandler(LLenFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "LTRIM", Command("LTRIM").SetHandler(LTrimFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+}
+
+} // namespace rdss
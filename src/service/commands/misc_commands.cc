@@ -5,12 +5,17 @@
 #include "base/memory.h"
 #include "client_manager.h"
 #include "server.h"
+#include "service/aof.h"
 #include "service/command.h"
 #include "service/data_structure_service.h"
 
 #include <sys/resource.h>
 #include <sys/sysinfo.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
 #include <sstream>
 #include <unistd.h>
 
@@ -48,7 +53,23 @@ void CollectClientsInfo(DataStructureService& service, std::stringstream& stream
     stream << "client_recent_max_input_buffer:"
            << client_manager->Stats().max_input_buffer.load(std::memory_order_relaxed) << '\n';
     stream << "client_recent_max_output_buffer:"
-           << client_manager->Stats().max_output_buffer.load(std::memory_order_relaxed) << "\n\n";
+           << client_manager->Stats().max_output_buffer.load(std::memory_order_relaxed) << '\n';
+    stream << "client_migrations:"
+           << client_manager->Stats().migrations.load(std::memory_order_relaxed) << '\n';
+    const auto& executors = client_manager->Placement().Executors();
+    for (size_t i = 0; i < executors.size(); ++i) {
+        const auto& load = executors[i]->Load();
+        stream << "client_executor_" << i
+               << ":connections=" << load.connections.load(std::memory_order_relaxed)
+               << ",busy_permille=" << load.busy_permille.load(std::memory_order_relaxed)
+               << ",busy_ms=" << load.busy_ns.load(std::memory_order_relaxed) / 1'000'000
+               << ",cqes_processed=" << load.cqes_processed.load(std::memory_order_relaxed)
+               << ",net_input_bytes=" << load.net_input_bytes.load(std::memory_order_relaxed)
+               << ",net_output_bytes=" << load.net_output_bytes.load(std::memory_order_relaxed)
+               << ",transfers=" << load.transfers.load(std::memory_order_relaxed)
+               << ",doorbells=" << load.doorbells.load(std::memory_order_relaxed) << '\n';
+    }
+    stream << '\n';
 }
 
 void CollectMemoryInfo(DataStructureService&, std::stringstream& stream) {
@@ -72,19 +93,163 @@ void CollectMemoryInfo(DataStructureService&, std::stringstream& stream) {
         stream << "total_system_memory:" << info.totalram << '\n';
     }
 
+    const auto slab_stats = SlabArena::GetStats();
+    stream << "slab_committed_memory:" << slab_stats.committed_bytes << '\n';
+    stream << "slab_used_memory:" << slab_stats.used_bytes << '\n';
+    const auto fragmentation_ratio = (slab_stats.used_bytes == 0)
+                                       ? 0.0
+                                       : static_cast<double>(slab_stats.committed_bytes)
+                                           / static_cast<double>(slab_stats.used_bytes);
+    stream << "slab_fragmentation_ratio:" << std::round(fragmentation_ratio * 100) / 100 << '\n';
+    for (const auto& class_stats : slab_stats.classes) {
+        if (class_stats.pages == 0) {
+            continue;
+        }
+        stream << "slab_class_" << class_stats.block_size << ":pages=" << class_stats.pages
+               << ",used_blocks=" << class_stats.used_blocks << '\n';
+    }
+
+    stream << '\n';
+}
+
+void CollectPersistenceInfo(DataStructureService& service, std::stringstream& stream) {
+    const auto& stats = service.GetServer()->GetSnapshotter()->Stats();
+    const auto in_progress = stats.in_progress.load(std::memory_order_relaxed);
+    const auto duration_us = stats.last_save_duration_us.load(std::memory_order_relaxed);
+    const auto bytes = stats.last_save_bytes.load(std::memory_order_relaxed);
+
+    stream << "# Persistence\n";
+    bool loading = stats.loading.load(std::memory_order_relaxed);
+    for (const auto& shard : service.GetServer()->GetDataShards()) {
+        loading = loading || shard.service->IsLoading();
+    }
+    stream << "loading:" << loading << '\n';
+    stream << "rdb_bgsave_in_progress:" << in_progress << '\n';
+    stream << "rdb_last_save_time:" << stats.last_save_time.load(std::memory_order_relaxed)
+           << '\n';
+    stream << "rdb_last_bgsave_status:"
+           << (stats.last_save_ok.load(std::memory_order_relaxed) ? "ok" : "err") << '\n';
+    stream << "rdb_last_bgsave_time_sec:"
+           << (stats.saves.load(std::memory_order_relaxed) == 0
+                 ? -1
+                 : static_cast<int64_t>(duration_us / 1'000'000))
+           << '\n';
+    stream << "rdb_current_bgsave_time_sec:"
+           << (in_progress ? std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                                 .count()
+                               - stats.current_save_start_time.load(std::memory_order_relaxed)
+                           : -1)
+           << '\n';
+    stream << "rdb_saves:" << stats.saves.load(std::memory_order_relaxed) << '\n';
+    stream << "rdb_last_save_keys:" << stats.last_save_keys.load(std::memory_order_relaxed)
+           << '\n';
+    stream << "rdb_last_save_bytes:" << bytes << '\n';
+    stream << "rdb_last_save_throughput_bytes_per_sec:"
+           << (duration_us == 0 ? 0 : bytes * 1'000'000 / duration_us) << '\n';
+    stream << "rdb_last_save_dss_cpu_microseconds:"
+           << stats.last_save_dss_time_us.load(std::memory_order_relaxed) << '\n';
+    stream << "rdb_last_save_max_pause_microseconds:"
+           << stats.last_save_max_pause_us.load(std::memory_order_relaxed) << '\n';
+    stream << "rdb_last_load_keys_loaded:" << stats.loaded_keys.load(std::memory_order_relaxed)
+           << '\n';
+
+    // The append only files of the shards are summed up, a rewrite takes as long as the slowest
+    // shard.
+    bool aof_enabled{false};
+    bool aof_rewrite_in_progress{false};
+    bool aof_last_rewrite_ok{true};
+    bool aof_last_write_ok{true};
+    int64_t aof_rewrite_start_time{0};
+    uint64_t aof_last_rewrite_duration_us{0};
+    uint64_t aof_rewrites{0};
+    uint64_t aof_current_size{0};
+    uint64_t aof_base_size{0};
+    uint64_t aof_writes{0};
+    uint64_t aof_fsyncs{0};
+    uint64_t aof_loaded_commands{0};
+    for (const auto& shard : service.GetServer()->GetDataShards()) {
+        const auto* aof = shard.service->GetAof();
+        if (aof == nullptr) {
+            continue;
+        }
+        const auto& aof_stats = aof->Stats();
+        aof_enabled = true;
+        if (aof_stats.rewrite_in_progress.load(std::memory_order_relaxed)) {
+            aof_rewrite_in_progress = true;
+            aof_rewrite_start_time = std::max(
+              aof_rewrite_start_time,
+              aof_stats.current_rewrite_start_time.load(std::memory_order_relaxed));
+        }
+        aof_last_rewrite_ok &= aof_stats.last_rewrite_ok.load(std::memory_order_relaxed);
+        aof_last_write_ok &= aof_stats.last_write_ok.load(std::memory_order_relaxed);
+        aof_last_rewrite_duration_us = std::max(
+          aof_last_rewrite_duration_us,
+          aof_stats.last_rewrite_duration_us.load(std::memory_order_relaxed));
+        aof_rewrites = std::max(aof_rewrites, aof_stats.rewrites.load(std::memory_order_relaxed));
+        aof_current_size += aof_stats.current_size.load(std::memory_order_relaxed);
+        aof_base_size += aof_stats.base_size.load(std::memory_order_relaxed);
+        aof_writes += aof_stats.writes.load(std::memory_order_relaxed);
+        aof_fsyncs += aof_stats.fsyncs.load(std::memory_order_relaxed);
+        aof_loaded_commands += aof_stats.loaded_commands.load(std::memory_order_relaxed);
+    }
+    stream << "aof_enabled:" << aof_enabled << '\n';
+    stream << "aof_rewrite_in_progress:" << aof_rewrite_in_progress << '\n';
+    stream << "aof_last_rewrite_time_sec:"
+           << (aof_rewrites == 0
+                 ? -1
+                 : static_cast<int64_t>(aof_last_rewrite_duration_us / 1'000'000))
+           << '\n';
+    stream << "aof_current_rewrite_time_sec:"
+           << (aof_rewrite_in_progress ? std::chrono::duration_cast<std::chrono::seconds>(
+                                           std::chrono::system_clock::now().time_since_epoch())
+                                             .count()
+                                           - aof_rewrite_start_time
+                                       : -1)
+           << '\n';
+    stream << "aof_last_bgrewrite_status:" << (aof_last_rewrite_ok ? "ok" : "err") << '\n';
+    stream << "aof_last_write_status:" << (aof_last_write_ok ? "ok" : "err") << '\n';
+    if (aof_enabled) {
+        stream << "aof_rewrites:" << aof_rewrites << '\n';
+        stream << "aof_current_size:" << aof_current_size << '\n';
+        stream << "aof_base_size:" << aof_base_size << '\n';
+        stream << "aof_writes:" << aof_writes << '\n';
+        stream << "aof_fsyncs:" << aof_fsyncs << '\n';
+        stream << "aof_last_load_commands_loaded:" << aof_loaded_commands << '\n';
+    }
     stream << '\n';
 }
 
 void CollectStatsInfo(DataStructureService& service, std::stringstream& stream) {
     auto& server_stats = service.GetServer()->Stats();
     auto& client_stats = service.GetServer()->GetClientManager()->Stats();
-    auto& expire_stats = service.GetExpirer().GetStats();
+
+    // Sums up the stats of all the data shards.
+    uint64_t commands_processed{0};
+    uint64_t expired_keys{0};
+    double expired_stale_perc{0};
+    uint64_t expired_time_cap_reached_count{0};
+    std::chrono::steady_clock::duration expire_cycle_time{0};
+    uint64_t evicted_keys{0};
+    const auto& shards = service.GetServer()->GetDataShards();
+    for (const auto& shard : shards) {
+        auto& expire_stats = shard.service->GetExpirer().GetStats();
+        commands_processed += shard.service->Stats().commands_processed.load(
+          std::memory_order_relaxed);
+        expired_keys += expire_stats.active_expired_keys.load(std::memory_order_relaxed);
+        expired_stale_perc += static_cast<double>(
+          expire_stats.expired_stale_perc.load(std::memory_order_relaxed));
+        expired_time_cap_reached_count += expire_stats.expired_time_cap_reached_count.load(
+          std::memory_order_relaxed);
+        expire_cycle_time += std::chrono::steady_clock::duration{
+          expire_stats.elapsed_time.load(std::memory_order_relaxed)};
+        evicted_keys += shard.service->GetEvictor().GetEvictedKeys();
+    }
 
     stream << "# Stats\n";
     stream << "total_connections_received:"
            << server_stats.connections_received.load(std::memory_order_relaxed) << '\n';
-    stream << "total_commands_processed:"
-           << service.Stats().commands_processed.load(std::memory_order_relaxed) << '\n';
+    stream << "total_commands_processed:" << commands_processed << '\n';
     stream << "total_net_input_bytes:"
            << client_stats.net_input_bytes.load(std::memory_order_relaxed) << '\n';
     stream << "total_net_output_bytes:"
@@ -92,31 +257,138 @@ void CollectStatsInfo(DataStructureService& service, std::stringstream& stream)
     stream << "rejected_connections:"
            << server_stats.rejected_connections.load(std::memory_order_relaxed) << '\n';
 
-    stream << "expired_keys:" << expire_stats.active_expired_keys.load(std::memory_order_relaxed)
-           << '\n';
+    stream << "expired_keys:" << expired_keys << '\n';
     stream << "expired_stale_perc:"
-           << static_cast<double>(
-                expire_stats.expired_stale_perc.load(std::memory_order_relaxed) / 100.0)
-           << '\n';
-    stream << "expired_time_cap_reached_count:"
-           << expire_stats.expired_time_cap_reached_count.load(std::memory_order_relaxed) << '\n';
+           << expired_stale_perc / 100.0 / static_cast<double>(shards.size()) << '\n';
+    stream << "expired_time_cap_reached_count:" << expired_time_cap_reached_count << '\n';
     stream << "expire_cycle_cpu_milliseconds:"
-           << std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::duration{
-                  expire_stats.elapsed_time.load(std::memory_order_relaxed)})
-                .count()
+           << std::chrono::duration_cast<std::chrono::milliseconds>(expire_cycle_time).count()
            << '\n';
 
-    stream << "evicted_keys:" << service.GetEvictor().GetEvictedKeys() << '\n';
+    stream << "evicted_keys:" << evicted_keys << '\n';
 
     stream << '\n';
 }
 
+// Returns the lower-cased name of the command of 'id', as it's reported.
+std::string CommandNameOf(DataStructureService& service, CommandId id) {
+    std::string name = service.Commands().Get(id).Name();
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return std::tolower(c);
+    });
+    return name;
+}
+
+// Returns the execution times of the command of 'id' on all the shards. Commands are registered in
+// the same order to every shard, so they have the same ids.
+LatencyHistogram::Snapshot CommandLatency(DataStructureService& service, CommandId id) {
+    LatencyHistogram::Snapshot snapshot;
+    for (const auto& shard : service.GetServer()->GetDataShards()) {
+        shard.service->Commands().Stats(id).latency.AddTo(snapshot);
+    }
+    return snapshot;
+}
+
+// Formats 'ns' in microseconds.
+std::string Usec(uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(ns) / 1000.0);
+    return buf;
+}
+
+void WritePercentiles(const LatencyHistogram::Snapshot& snapshot, std::stringstream& stream) {
+    stream << "p50=" << Usec(snapshot.Percentile(50)) << ",p99=" << Usec(snapshot.Percentile(99))
+           << ",p99.9=" << Usec(snapshot.Percentile(99.9)) << '\n';
+}
+
+void CollectCommandStatsInfo(DataStructureService& service, std::stringstream& stream) {
+    stream << "# Commandstats\n";
+    for (CommandId id = 0; id < service.Commands().Size(); ++id) {
+        uint64_t calls{0};
+        uint64_t usec{0};
+        uint64_t rejected_calls{0};
+        uint64_t failed_calls{0};
+        for (const auto& shard : service.GetServer()->GetDataShards()) {
+            const auto& stats = shard.service->Commands().Stats(id);
+            calls += stats.latency.Count();
+            usec += stats.latency.SumNs() / 1000;
+            rejected_calls += stats.rejected_calls.load(std::memory_order_relaxed);
+            failed_calls += stats.failed_calls.load(std::memory_order_relaxed);
+        }
+        if (calls == 0 && rejected_calls == 0) {
+            continue;
+        }
+        char usec_per_call[32];
+        std::snprintf(
+          usec_per_call,
+          sizeof(usec_per_call),
+          "%.2f",
+          static_cast<double>(usec) / static_cast<double>(std::max<uint64_t>(calls, 1)));
+        stream << "cmdstat_" << CommandNameOf(service, id) << ":calls=" << calls
+               << ",usec=" << usec << ",usec_per_call=" << usec_per_call
+               << ",rejected_calls=" << rejected_calls << ",failed_calls=" << failed_calls
+               << '\n';
+    }
+    stream << '\n';
+}
+
+void CollectLatencyStatsInfo(DataStructureService& service, std::stringstream& stream) {
+    stream << "# Latencystats\n";
+    for (CommandId id = 0; id < service.Commands().Size(); ++id) {
+        const auto snapshot = CommandLatency(service, id);
+        if (snapshot.count == 0) {
+            continue;
+        }
+        stream << "latency_percentiles_usec_" << CommandNameOf(service, id) << ':';
+        WritePercentiles(snapshot, stream);
+    }
+    // End-to-end latency of the batches of queries, and its stages.
+    auto* client_manager = service.GetServer()->GetClientManager();
+    for (size_t stage = 0; stage < kNumLatencyStages; ++stage) {
+        const auto snapshot = client_manager->Latency(static_cast<LatencyStage>(stage));
+        stream << "latency_stage_percentiles_usec_"
+               << LatencyStageName(static_cast<LatencyStage>(stage)) << ':';
+        WritePercentiles(snapshot, stream);
+    }
+    stream << '\n';
+}
+
+// Writes the cumulative counts of 'snapshot' at the powers of two microseconds where they change.
+void WriteHistogram(const LatencyHistogram::Snapshot& snapshot, std::stringstream& stream) {
+    uint64_t usec{1};
+    uint64_t cumulative{0};
+    uint64_t written{0};
+    for (size_t bucket = 0; bucket < LatencyHistogram::kNumBuckets; ++bucket) {
+        if (snapshot.counts[bucket] == 0) {
+            continue;
+        }
+        const auto upper_bound = LatencyHistogram::UpperBound(bucket);
+        while (usec * 1000 <= upper_bound) {
+            if (cumulative != written) {
+                stream << (written == 0 ? "" : ",") << usec << ':' << cumulative;
+                written = cumulative;
+            }
+            usec *= 2;
+        }
+        cumulative += snapshot.counts[bucket];
+    }
+    if (cumulative != written) {
+        stream << (written == 0 ? "" : ",") << usec << ':' << cumulative;
+    }
+}
+
 void CollectKeyspaceInfo(DataStructureService& service, std::stringstream& stream) {
+    // Tables of other shards can't be accessed here, uses the sizes published at their cron.
+    uint64_t keys{0};
+    uint64_t expires{0};
+    for (const auto& shard : service.GetServer()->GetDataShards()) {
+        keys += shard.service->Stats().keys.load(std::memory_order_relaxed);
+        expires += shard.service->Stats().expires.load(std::memory_order_relaxed);
+    }
+
     stream << "# Keyspace\n";
     // TODO:  avg_ttl.
-    stream << "db0: keys=" << service.DataTable()->Count()
-           << ",expires=" << service.ExpireTable()->Count() << "\n\n";
+    stream << "db0: keys=" << keys << ",expires=" << expires << "\n\n";
 }
 
 } // namespace rdss::detail
@@ -139,6 +411,7 @@ void InfoFunction(DataStructureService& service, Args args, Result& result) {
         detail::CollectServerInfo(service, stream);
         detail::CollectClientsInfo(service, stream);
         detail::CollectMemoryInfo(service, stream);
+        detail::CollectPersistenceInfo(service, stream);
         detail::CollectStatsInfo(service, stream);
         detail::CollectKeyspaceInfo(service, stream);
     } else {
@@ -155,6 +428,10 @@ void InfoFunction(DataStructureService& service, Args args, Result& result) {
                 detail::CollectMemoryInfo(service, stream);
                 continue;
             }
+            if (!args[i].compare("PERSISTENCE") || !args[i].compare("persistence")) {
+                detail::CollectPersistenceInfo(service, stream);
+                continue;
+            }
             if (!args[i].compare("STATS") || !args[i].compare("stats")) {
                 detail::CollectStatsInfo(service, stream);
                 continue;
@@ -163,6 +440,14 @@ void InfoFunction(DataStructureService& service, Args args, Result& result) {
                 detail::CollectKeyspaceInfo(service, stream);
                 continue;
             }
+            if (!args[i].compare("COMMANDSTATS") || !args[i].compare("commandstats")) {
+                detail::CollectCommandStatsInfo(service, stream);
+                continue;
+            }
+            if (!args[i].compare("LATENCYSTATS") || !args[i].compare("latencystats")) {
+                detail::CollectLatencyStatsInfo(service, stream);
+                continue;
+            }
         }
     }
 
@@ -175,6 +460,70 @@ void CommandFunction(DataStructureService&, Args, Result& result) {
     result.SetString(std::move(str_ptr));
 }
 
+void SaveFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() > 1) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto* snapshotter = service.GetServer()->GetSnapshotter();
+    // Replies once the file is written, the client waits for it while the shard keeps serving.
+    const bool started = snapshotter->StartSave(&service, [&service, &result](bool ok) {
+        if (ok) {
+            result.SetOk();
+        } else {
+            result.SetError(Error::kSaveFailed);
+        }
+        service.CompleteDeferredReply(&result);
+    });
+    if (!started) {
+        result.SetError(Error::kSaveInProgress);
+        return;
+    }
+    service.DeferReply(&result);
+}
+
+void BgSaveFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() > 1) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    if (!service.GetServer()->GetSnapshotter()->StartBackgroundSave()) {
+        result.SetError(Error::kSaveInProgress);
+        return;
+    }
+    result.SetString(StringValue(std::string_view("Background saving started")));
+}
+
+void BgRewriteAofFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() > 1) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    if (service.GetAof() == nullptr) {
+        result.SetError(Error::kAofDisabled);
+        return;
+    }
+    // Keyless commands run on the first data shard, so no other rewrite is requested in the
+    // meanwhile.
+    const auto& shards = service.GetServer()->GetDataShards();
+    for (const auto& shard : shards) {
+        if (shard.service->GetAof()->Stats().rewrite_in_progress.load(std::memory_order_acquire)) {
+            result.SetError(Error::kAofRewriteInProgress);
+            return;
+        }
+    }
+    for (const auto& shard : shards) {
+        shard.service->GetAof()->RequestRewrite();
+    }
+    result.SetString(
+      StringValue(std::string_view("Background append only file rewriting started")));
+}
+
+void LastSaveFunction(DataStructureService& service, Args, Result& result) {
+    result.SetInt(service.GetServer()->GetSnapshotter()->Stats().last_save_time.load(
+      std::memory_order_relaxed));
+}
+
 void ShutdownFunction(DataStructureService& service, Args args, Result& result) {
     if (args.size() > 1) {
         result.SetError(Error::kWrongArgNum);
@@ -185,11 +534,55 @@ void ShutdownFunction(DataStructureService& service, Args args, Result& result)
     result.SetNil();
 }
 
+// LATENCY HISTOGRAM [command ...] replies a line for each of the commands, or each called command
+// if none is given, in the form of <command>:calls=<calls>,histogram_usec=<usec>:<count>,...
+void LatencyFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2 || (args[1].compare("HISTOGRAM") && args[1].compare("histogram"))) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    std::vector<CommandId> ids;
+    if (args.size() == 2) {
+        for (CommandId id = 0; id < service.Commands().Size(); ++id) {
+            ids.push_back(id);
+        }
+    } else {
+        for (size_t i = 2; i < args.size(); ++i) {
+            const auto id = service.Commands().Find(args[i]);
+            if (id != CommandDictionary::kNoCommand) {
+                ids.push_back(id);
+            }
+        }
+    }
+    std::stringstream stream;
+    for (const auto id : ids) {
+        const auto snapshot = detail::CommandLatency(service, id);
+        if (snapshot.count == 0) {
+            continue;
+        }
+        stream << detail::CommandNameOf(service, id) << ":calls=" << snapshot.count
+               << ",histogram_usec=";
+        detail::WriteHistogram(snapshot, stream);
+        stream << '\n';
+    }
+    result.SetString(CreateMTSPtr(stream.str()));
+}
+
 void RegisterMiscCommands(DataStructureService* service) {
-    service->RegisterCommand("DBSIZE", Command("DBSIZE").SetHandler(DbSizeFunction));
+    service->RegisterCommand(
+      "DBSIZE",
+      Command("DBSIZE")
+        .SetHandler(DbSizeFunction)
+        .SetShardPolicy(Command::ShardPolicy::kBroadcastSum));
     service->RegisterCommand("INFO", Command("INFO").SetHandler(InfoFunction));
     service->RegisterCommand("COMMAND", Command("COMMAND").SetHandler(CommandFunction));
     service->RegisterCommand("SHUTDOWN", Command("SHUTDOWN").SetHandler(ShutdownFunction));
+    service->RegisterCommand("SAVE", Command("SAVE").SetHandler(SaveFunction));
+    service->RegisterCommand("BGSAVE", Command("BGSAVE").SetHandler(BgSaveFunction));
+    service->RegisterCommand(
+      "BGREWRITEAOF", Command("BGREWRITEAOF").SetHandler(BgRewriteAofFunction));
+    service->RegisterCommand("LASTSAVE", Command("LASTSAVE").SetHandler(LastSaveFunction));
+    service->RegisterCommand("LATENCY", Command("LATENCY").SetHandler(LatencyFunction));
 }
 
 } // namespace rdss
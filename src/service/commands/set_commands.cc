@@ -0,0 +1,305 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "set_commands.h"
+
+#include "base/config.h"
+#include "data_structure/set_value.h"
+#include "service/command.h"
+#include "service/commands/command_util.h"
+#include "service/data_structure_service.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rdss {
+
+namespace {
+
+SetValue::Limits GetLimits(const DataStructureService& service) {
+    return {.max_intset_entries = service.GetConfig()->set_max_intset_entries};
+}
+
+MTSHashTable::EntryPointer
+FindSet(DataStructureService& service, std::string_view key, Result& result) {
+    return FindTyped(service, key, result, CheckType<&StringValue::IsSet>);
+}
+
+MTSHashTable::EntryPointer
+FindOrCreateSet(DataStructureService& service, std::string_view key, Result& result) {
+    return FindOrCreateTyped(
+      service, key, result, CheckType<&StringValue::IsSet>, StringValue::CreateSet);
+}
+
+// Finds the sets of 'keys' into 'sets', a missing key is nullptr. Returns false if WRONGTYPE
+// error is set.
+bool FindSets(
+  DataStructureService& service,
+  Args keys,
+  std::vector<const SetValue*>& sets,
+  Result& result) {
+    sets.clear();
+    sets.reserve(keys.size());
+    for (const auto key : keys) {
+        auto entry = FindSet(service, key, result);
+        if (result.type == Result::Type::kError) {
+            return false;
+        }
+        sets.push_back(entry == nullptr ? nullptr : &entry->value.Set());
+    }
+    return true;
+}
+
+// Intersects 'sets', none of which is nullptr, calling 'func' with each common member until it
+// returns false. The members are visited in ascending order if all the sets are intsets.
+void Intersect(
+  std::vector<const SetValue*>& sets, const std::function<bool(std::string_view)>& func) {
+    // Starting from the smallest set bounds the work by its size.
+    std::sort(sets.begin(), sets.end(), [](const SetValue* a, const SetValue* b) {
+        return a->Size() < b->Size();
+    });
+    const bool all_ints = std::all_of(sets.begin(), sets.end(), [](const SetValue* set) {
+        return set->GetEncoding() == SetValue::Encoding::kIntset;
+    });
+    if (!all_ints) {
+        sets.front()->ForEach([&sets, &func, stopped = false](std::string_view member) mutable {
+            if (stopped) {
+                return;
+            }
+            for (size_t i = 1; i < sets.size(); ++i) {
+                if (!sets[i]->Contains(member)) {
+                    return;
+                }
+            }
+            stopped = !func(member);
+        });
+        return;
+    }
+
+    const auto first = sets.front()->Ints();
+    std::vector<int64_t> common(first.begin(), first.end());
+    std::vector<int64_t> next(common.size());
+    for (size_t i = 1; i < sets.size() && !common.empty(); ++i) {
+        const auto n = IntersectSorted(common, sets[i]->Ints(), next.data());
+        next.resize(n);
+        common.swap(next);
+        next.resize(common.size());
+    }
+    StringValue::IntChars chars;
+    for (const auto i : common) {
+        auto [ptr, _] = std::to_chars(chars.data(), chars.data() + chars.size(), i);
+        if (!func(std::string_view(chars.data(), static_cast<size_t>(ptr - chars.data())))) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+void SAddFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindOrCreateSet(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto limits = GetLimits(service);
+    auto& set = entry->value.Set();
+    int64_t added{0};
+    for (size_t i = 2; i < args.size(); ++i) {
+        added += set.Add(args[i], limits) ? 1 : 0;
+    }
+    result.SetInt(added);
+}
+
+void SRemFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindSet(service, args[1], result);
+    if (entry == nullptr) {
+        if (result.type != Result::Type::kError) {
+            result.SetInt(0);
+        }
+        return;
+    }
+    auto& set = entry->value.Set();
+    int64_t removed{0};
+    for (size_t i = 2; i < args.size(); ++i) {
+        removed += set.Erase(args[i]) ? 1 : 0;
+    }
+    // Like Redis, an empty set doesn't exist.
+    if (set.Size() == 0) {
+        service.EraseKey(entry);
+    }
+    result.SetInt(removed);
+}
+
+void SIsMemberFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetInt(0);
+    auto entry = FindSet(service, args[1], result);
+    if (entry != nullptr) {
+        result.SetInt(entry->value.Set().Contains(args[2]) ? 1 : 0);
+    }
+}
+
+void SMembersFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // Empty array if the key doesn't exist.
+    result.type = Result::Type::kStrings;
+    auto entry = FindSet(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto& set = entry->value.Set();
+    result.strings.reserve(set.Size());
+    set.ForEach([&result](std::string_view member) { result.AddString(StringValue(member)); });
+}
+
+void SCardFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetInt(0);
+    auto entry = FindSet(service, args[1], result);
+    if (entry != nullptr) {
+        result.SetInt(static_cast<int64_t>(entry->value.Set().Size()));
+    }
+}
+
+void SInterFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    std::vector<const SetValue*> sets;
+    if (!FindSets(service, args.subspan(1), sets, result)) {
+        return;
+    }
+    result.type = Result::Type::kStrings;
+    // A missing key is an empty set.
+    if (std::find(sets.begin(), sets.end(), nullptr) != sets.end()) {
+        return;
+    }
+    Intersect(sets, [&result](std::string_view member) {
+        result.AddString(StringValue(member));
+        return true;
+    });
+}
+
+void SInterCardFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto num_keys = ParseInt(args[1]);
+    if (!num_keys.has_value() || num_keys.value() <= 0) {
+        result.SetError(Error::kNotAnInt);
+        return;
+    }
+    // SINTERCARD numkeys key [key ...] [LIMIT limit]
+    const auto keys_end = 2 + static_cast<size_t>(num_keys.value());
+    if (keys_end > args.size() || (args.size() != keys_end && args.size() != keys_end + 2)) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    int64_t limit{0};
+    if (args.size() == keys_end + 2) {
+        const auto parsed = ParseInt(args[keys_end + 1]);
+        if (
+          !EqualsIgnoreCase(args[keys_end], "LIMIT") || !parsed.has_value()
+          || parsed.value() < 0) {
+            result.SetError(Error::kSyntaxError);
+            return;
+        }
+        limit = parsed.value();
+    }
+
+    std::vector<const SetValue*> sets;
+    if (!FindSets(service, args.subspan(2, static_cast<size_t>(num_keys.value())), sets, result)) {
+        return;
+    }
+    int64_t count{0};
+    if (std::find(sets.begin(), sets.end(), nullptr) == sets.end()) {
+        Intersect(sets, [&count, limit](std::string_view) { return ++count != limit; });
+    }
+    result.SetInt(count);
+}
+
+void SUnionFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    std::vector<const SetValue*> sets;
+    if (!FindSets(service, args.subspan(1), sets, result)) {
+        return;
+    }
+    result.type = Result::Type::kStrings;
+    SetValue merged;
+    const auto limits = GetLimits(service);
+    for (const auto* set : sets) {
+        if (set != nullptr) {
+            set->ForEach([&merged, &limits](std::string_view member) {
+                merged.Add(member, limits);
+            });
+        }
+    }
+    result.strings.reserve(merged.Size());
+    merged.ForEach([&result](std::string_view member) { result.AddString(StringValue(member)); });
+}
+
+void SDiffFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    std::vector<const SetValue*> sets;
+    if (!FindSets(service, args.subspan(1), sets, result)) {
+        return;
+    }
+    result.type = Result::Type::kStrings;
+    if (sets.front() == nullptr) {
+        return;
+    }
+    sets.front()->ForEach([&sets, &result](std::string_view member) {
+        for (size_t i = 1; i < sets.size(); ++i) {
+            if (sets[i] != nullptr && sets[i]->Contains(member)) {
+                return;
+            }
+        }
+        result.AddString(StringValue(member));
+    });
+}
+
+void RegisterSetCommands(DataStructureService* service) {
+    service->RegisterCommand(
+      "SADD", Command("SADD").SetHandler(SAddFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SREM", Command("SREM").SetHandler(SRemFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SISMEMBER", Command("SISMEMBER").SetHandler(SIsMemberFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SMEMBERS", Command("SMEMBERS").SetHandler(SMembersFunction).SetKeySpec(1, 1));
+    service->RegisterCommand("SCARD", Command("SCARD").SetHandler(SCardFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SINTER", Command("SINTER").SetHandler(SInterFunction).SetKeySpec(1, -1));
+    service->RegisterCommand(
+      "SINTERCARD",
+      Command("SINTERCARD").SetHandler(SInterCardFunction).SetKeySpecWithNumKeys(1, 2));
+    service->RegisterCommand(
+      "SUNION", Command("SUNION").SetHandler(SUnionFunction).SetKeySpec(1, -1));
+    service->RegisterCommand("SDIFF", Command("SDIFF").SetHandler(SDiffFunction).SetKeySpec(1, -1));
+}
+
+} // namespace rdss
@@ -0,0 +1,11 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+namespace rdss {
+
+class DataStructureService;
+
+void RegisterSetCommands(DataStructureService*);
+
+} // namespace rdss
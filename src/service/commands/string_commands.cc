@@ -3,6 +3,7 @@
 #include "string_commands.h"
 
 #include "service/command.h"
+#include "service/commands/command_util.h"
 #include "service/data_structure_service.h"
 
 #include <charconv>
@@ -19,15 +20,19 @@ namespace detail {
 
 // Treat the second arg in 'args' as key and search if key is valid. If valid, update its LRU and
 // add it's corresponding value to result, then return {entry of the key, result}. Otherwise, If
-// it's stale, expire it, add null to result and return {nullptr, result}.
+// it's stale, expire it, add null to result and return {nullptr, result}. If it isn't a string,
+// sets WRONGTYPE error and returns nullptr.
 MTSHashTable::EntryPointer
 GetFunctionBase(DataStructureService& service, Command::CommandString key, Result& result) {
     auto entry = service.FindOrExpire(key);
     if (entry == nullptr) {
         result.SetNil();
+    } else if (!entry->value.IsString()) {
+        result.SetError(Error::kWrongType);
+        return nullptr;
     } else {
         result.SetString(entry->value);
-        entry->GetKey()->SetLRU(service.GetLRUClock());
+        entry->SetLRU(service.GetLRUClock());
     }
     return entry;
 }
@@ -45,6 +50,16 @@ void GetFunctionBaseWithCallback(
     }
 }
 
+// Returns true if 'key' holds a value that isn't a string, in which case WRONGTYPE error is set.
+bool HoldsOtherType(DataStructureService& service, Command::CommandString key, Result& result) {
+    auto entry = service.FindOrExpire(key);
+    if (entry == nullptr || entry->value.IsString()) {
+        return false;
+    }
+    result.SetError(Error::kWrongType);
+    return true;
+}
+
 } // namespace detail
 
 static constexpr TimePoint::rep kRepMax = std::numeric_limits<TimePoint::rep>::max();
@@ -67,16 +82,6 @@ std::optional<TimePoint> IntToTimePoint(TimePoint now, TimePoint::rep i) {
     return now + Duration{i};
 }
 
-template<typename Rep>
-std::optional<Rep> ParseInt(Command::CommandString str) {
-    Rep ll;
-    auto [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), ll);
-    if (err != std::errc{} || ptr != str.data() + str.size()) {
-        return std::nullopt;
-    }
-    return ll;
-}
-
 enum class ExtractExpireResult { kDone, kNotFound, kError };
 
 ExtractExpireResult ExtractExpireOptions(
@@ -221,27 +226,27 @@ void SetFunction(DataStructureService& service, Args args, Result& result) {
         args.subspan(3), cmd_time, result, set_mode, expire_time, keep_ttl, get)) {
         return;
     }
+    // Without GET the old value is overwritten whatever its type, like Redis.
+    if (get && detail::HoldsOtherType(service, args[1], result)) {
+        return;
+    }
 
-    auto key = args[1];
-    auto* expire_ht = service.ExpireTable();
-    auto [set_status, entry, old_value] = service.SetData(key, args[2], set_mode, get);
+    auto [set_status, entry, old_value] = service.SetData(args[1], args[2], set_mode, get);
     if (set_status == SetStatus::kNoOp) {
         result.SetNil();
         return;
     }
 
     if (expire_time.has_value()) {
-        expire_ht->Upsert(entry->CopyKey(), expire_time.value());
+        service.SetExpire(entry, expire_time.value());
     } else if (set_status == SetStatus::kUpdated && !keep_ttl) {
-        // TODO: maybe we can know there is no expire_entry before this.
-        expire_ht->Erase(key);
+        service.Persist(entry);
     }
 
     if (get) {
-        if (old_value == nullptr) {
+        if (old_value.IsNull()) {
             result.SetNil();
         } else {
-            // TODO: result should take the ownership of shared_ptr.
             result.SetString(std::move(old_value));
         }
     } else {
@@ -256,8 +261,8 @@ void MSetFunction(DataStructureService& service, Args args, Result& result) {
     }
 
     for (size_t i = 1; i < args.size(); i += 2) {
-        service.SetData(args[i], args[i + 1], SetMode::kRegular, false);
-        service.ExpireTable()->Erase(args[i]);
+        auto [_, entry, __] = service.SetData(args[i], args[i + 1], SetMode::kRegular, false);
+        service.Persist(entry);
     }
 }
 
@@ -296,9 +301,9 @@ void SetEXFunctionBase(
         return;
     }
 
-    auto [entry, _] = service.DataTable()->Upsert(args[1], CreateMTSPtr(args[3]));
-    service.ExpireTable()->Upsert(entry->CopyKey(), expire_time.value());
-    entry->GetKey()->SetLRU(service.GetLRUClock());
+    auto [entry, _] = service.DataTable()->Upsert(args[1], StringValue(args[3]));
+    service.SetExpire(entry, expire_time.value());
+    entry->SetLRU(service.GetLRUClock());
 }
 
 void SetEXFunction(DataStructureService& service, Args args, Result& result) {
@@ -334,34 +339,24 @@ void SetRangeFunction(DataStructureService& service, Args args, Result& result)
     const auto start_index = start.value();
 
     auto key = args[1];
+    if (detail::HoldsOtherType(service, key, result)) {
+        return;
+    }
     auto [entry, exists] = service.DataTable()->FindOrCreate(key, true);
-    if (exists) {
-        auto expire_entry = service.ExpireTable()->Find(key);
-        if (expire_entry != nullptr && expire_entry->value <= service.GetCommandTimeSnapshot()) {
-            entry->value.reset();
-            service.ExpireTable()->Erase(key);
-            exists = false;
-        }
+    if (exists && service.IsExpired(entry)) {
+        entry->value.Reset();
+        service.Persist(entry);
     }
 
-    if (!exists || entry->value.use_count() != 1) {
-        if (start_index == 0) {
-            entry->value = CreateMTSPtr(args[3]);
-        } else {
-            std::string tmp(start_index + 1, 0);
-            tmp += args[3];
-            entry->value = CreateMTSPtr(tmp);
-        }
+    auto& str = entry->value.MakeRaw();
+    if (start_index > str.size()) {
+        str.append(start_index - str.size(), 0);
+        str.append(args[3]);
     } else {
-        if (start_index > entry->value->size()) {
-            entry->value->append(start_index - entry->value->size(), 0);
-            entry->value->append(args[3]);
-        } else {
-            entry->value->replace(start_index, entry->value->size() - start_index, args[3]);
-        }
+        str.replace(start_index, str.size() - start_index, args[3]);
     }
-    entry->GetKey()->SetLRU(service.GetLRUClock());
-    result.SetInt(static_cast<int64_t>(entry->value->size()));
+    entry->SetLRU(service.GetLRUClock());
+    result.SetInt(static_cast<int64_t>(str.size()));
 }
 
 void StrlenFunction(DataStructureService& service, Args args, Result& result) {
@@ -375,8 +370,12 @@ void StrlenFunction(DataStructureService& service, Args args, Result& result) {
         result.SetInt(0);
         return;
     }
-    result.SetInt(static_cast<int64_t>(entry->value->size()));
-    entry->GetKey()->SetLRU(service.GetLRUClock());
+    if (!entry->value.IsString()) {
+        result.SetError(Error::kWrongType);
+        return;
+    }
+    result.SetInt(static_cast<int64_t>(entry->value.Size()));
+    entry->SetLRU(service.GetLRUClock());
 }
 
 void GetFunction(DataStructureService& service, Args args, Result& result) {
@@ -395,11 +394,11 @@ void MGetFunction(DataStructureService& service, Args args, Result& result) {
     for (size_t i = 1; i < args.size(); ++i) {
         auto key = args[i];
         auto entry = service.FindOrExpire(key);
-        if (entry == nullptr) {
+        if (entry == nullptr || !entry->value.IsString()) {
             result.AddString(nullptr);
         } else {
             result.AddString(entry->value);
-            entry->GetKey()->SetLRU(service.GetLRUClock());
+            entry->SetLRU(service.GetLRUClock());
         }
     }
 }
@@ -411,7 +410,7 @@ void GetDelFunction(DataStructureService& service, Args args, Result& result) {
     }
     detail::GetFunctionBaseWithCallback(
       service, args[1], result, [&service](MTSHashTable::EntryPointer entry) {
-          service.EraseKey(entry->GetKey()->StringView());
+          service.EraseKey(entry);
       });
 }
 
@@ -455,11 +454,10 @@ void GetEXFunction(DataStructureService& service, Args args, Result& result) {
 
     detail::GetFunctionBaseWithCallback(
       service, args[1], result, [&service, persist, expire_time](MTSHashTable::EntryPointer entry) {
-          auto key = entry->GetKey()->StringView();
           if (persist) {
-              service.ExpireTable()->Erase(key);
+              service.Persist(entry);
           } else if (expire_time.has_value()) {
-              service.ExpireTable()->Upsert(key, expire_time.value());
+              service.SetExpire(entry, expire_time.value());
           }
       });
 }
@@ -470,14 +468,19 @@ void GetSetFunction(DataStructureService& service, Args args, Result& result) {
         return;
     }
 
-    auto [set_status, _, old_value] = service.SetData(args[1], args[2], SetMode::kRegular, true);
+    if (detail::HoldsOtherType(service, args[1], result)) {
+        return;
+    }
+
+    auto [set_status, entry, old_value] = service.SetData(
+      args[1], args[2], SetMode::kRegular, true);
     assert(set_status != SetStatus::kNoOp);
+    service.Persist(entry);
 
-    if (old_value == nullptr) {
+    if (old_value.IsNull()) {
         result.SetNil();
     } else {
         result.SetString(std::move(old_value));
-        service.ExpireTable()->Erase(args[1]);
     }
 }
 
@@ -500,12 +503,17 @@ void GetRangeFunction(DataStructureService& service, Args args, Result& result)
 
     auto entry = service.FindOrExpire(args[1]);
     if (entry == nullptr) {
-        result.SetString(CreateMTSPtr(""));
+        result.SetString(StringValue(std::string_view{}));
+        return;
+    }
+    if (!entry->value.IsString()) {
+        result.SetError(Error::kWrongType);
         return;
     }
 
-    auto transform_index =
-      [size = static_cast<int32_t>(entry->value->size())](int32_t index) -> size_t {
+    StringValue::IntChars chars;
+    const auto value = entry->value.View(chars);
+    auto transform_index = [size = static_cast<int32_t>(value.size())](int32_t index) -> size_t {
         if (index < 0) {
             index = std::max(0, size + index);
         }
@@ -515,13 +523,12 @@ void GetRangeFunction(DataStructureService& service, Args args, Result& result)
 
     const auto start_index = transform_index(start.value());
     const auto end_index = transform_index(end.value());
-    if (start_index == entry->value->size() || end_index <= start_index) {
-        result.SetString(CreateMTSPtr(""));
+    if (start_index == value.size() || end_index <= start_index) {
+        result.SetString(StringValue(std::string_view{}));
     } else {
-        result.SetString(CreateMTSPtr(
-          std::string_view(entry->value->data() + start_index, end_index - start_index + 1)));
+        result.SetString(StringValue(value.substr(start_index, end_index - start_index + 1)));
     }
-    entry->GetKey()->SetLRU(service.GetLRUClock());
+    entry->SetLRU(service.GetLRUClock());
 }
 
 void AppendFunction(DataStructureService& service, Args args, Result& result) {
@@ -533,18 +540,18 @@ void AppendFunction(DataStructureService& service, Args args, Result& result) {
     auto key = args[1];
     auto value = args[2];
 
+    if (detail::HoldsOtherType(service, key, result)) {
+        return;
+    }
     auto [entry, exists] = service.DataTable()->FindOrCreate(key, true);
     if (!exists) {
-        entry->value = CreateMTSPtr(value);
+        entry->value = StringValue(value);
     } else {
-        auto& original_value = entry->value;
-        if (original_value.use_count() != 1) {
-            entry->value = CreateMTSPtr(*original_value);
-        }
-        entry->value->append(value);
+        // Like Redis, appended value is kept in raw encoding as it's likely to be appended again.
+        entry->value.MakeRaw().append(value);
     }
-    entry->GetKey()->SetLRU(service.GetLRUClock());
-    result.SetInt(static_cast<int64_t>(entry->value->size()));
+    entry->SetLRU(service.GetLRUClock());
+    result.SetInt(static_cast<int64_t>(entry->value.Size()));
 }
 
 void ExistsFunction(DataStructureService& service, Args args, Result& result) {
@@ -552,7 +559,7 @@ void ExistsFunction(DataStructureService& service, Args args, Result& result) {
     for (size_t i = 1; i < args.size(); ++i) {
         auto entry = service.FindOrExpire(args[i]);
         if (entry != nullptr) {
-            entry->GetKey()->SetLRU(service.GetLRUClock());
+            entry->SetLRU(service.GetLRUClock());
             ++cnt;
         }
     }
@@ -560,28 +567,80 @@ void ExistsFunction(DataStructureService& service, Args args, Result& result) {
 }
 
 void RegisterStringCommands(DataStructureService* service) {
-    service->RegisterCommand("SET", Command("SET").SetHandler(SetFunction).SetIsWriteCommand());
+    using ShardPolicy = Command::ShardPolicy;
+
+    service->RegisterCommand(
+      "SET",
+      Command("SET")
+        .SetHandler(SetFunction)
+        .SetIsWriteCommand()
+        .SetHasRelativeExpire()
+        .SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SETEX",
+      Command("SETEX")
+        .SetHandler(SetEXFunction)
+        .SetIsWriteCommand()
+        .SetHasRelativeExpire()
+        .SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "PSETEX",
+      Command("PSETEX")
+        .SetHandler(PSetEXFunction)
+        .SetIsWriteCommand()
+        .SetHasRelativeExpire()
+        .SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SETNX", Command("SETNX").SetHandler(SetNXFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "SETRANGE",
+      Command("SETRANGE").SetHandler(SetRangeFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "MSET",
+      Command("MSET")
+        .SetHandler(MSetFunction)
+        .SetIsWriteCommand()
+        .SetKeySpec(1, -1, 2)
+        .SetShardPolicy(ShardPolicy::kSplitOk));
+    // MSETNX is all-or-nothing, so its keys should be in one shard.
+    service->RegisterCommand(
+      "MSETNX",
+      Command("MSETNX").SetHandler(MSetNXFunction).SetIsWriteCommand().SetKeySpec(1, -1, 2));
+    service->RegisterCommand("GET", Command("GET").SetHandler(GetFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "MGET",
+      Command("MGET")
+        .SetHandler(MGetFunction)
+        .SetKeySpec(1, -1)
+        .SetShardPolicy(ShardPolicy::kSplitConcat));
+    service->RegisterCommand(
+      "GETDEL",
+      Command("GETDEL").SetHandler(GetDelFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "GETEX",
+      Command("GETEX")
+        .SetHandler(GetEXFunction)
+        .SetIsWriteCommand()
+        .SetHasRelativeExpire()
+        .SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "GETSET",
+      Command("GETSET").SetHandler(GetSetFunction).SetIsWriteCommand().SetKeySpec(1, 1));
     service->RegisterCommand(
-      "SETEX", Command("SETEX").SetHandler(SetEXFunction).SetIsWriteCommand());
+      "GETRANGE", Command("GETRANGE").SetHandler(GetRangeFunction).SetKeySpec(1, 1));
     service->RegisterCommand(
-      "PSETEX", Command("PSETEX").SetHandler(PSetEXFunction).SetIsWriteCommand());
+      "SUBSTR", Command("SUBSTR").SetHandler(GetRangeFunction).SetKeySpec(1, 1));
     service->RegisterCommand(
-      "SETNX", Command("SETNX").SetHandler(SetNXFunction).SetIsWriteCommand());
+      "APPEND",
+      Command("APPEND").SetHandler(AppendFunction).SetIsWriteCommand().SetKeySpec(1, 1));
     service->RegisterCommand(
-      "SETRANGE", Command("SETRANGE").SetHandler(SetRangeFunction).SetIsWriteCommand());
-    service->RegisterCommand("MSET", Command("MSET").SetHandler(MSetFunction).SetIsWriteCommand());
+      "EXISTS",
+      Command("EXISTS")
+        .SetHandler(ExistsFunction)
+        .SetKeySpec(1, -1)
+        .SetShardPolicy(ShardPolicy::kSplitSum));
     service->RegisterCommand(
-      "MSETNX", Command("MSETNX").SetHandler(MSetNXFunction).SetIsWriteCommand());
-    service->RegisterCommand("GET", Command("GET").SetHandler(GetFunction));
-    service->RegisterCommand("MGET", Command("MGET").SetHandler(MGetFunction));
-    service->RegisterCommand("GETDEL", Command("GETDEL").SetHandler(GetDelFunction));
-    service->RegisterCommand("GETEX", Command("GETEX").SetHandler(GetEXFunction));
-    service->RegisterCommand("GETSET", Command("GETSET").SetHandler(GetSetFunction));
-    service->RegisterCommand("GETRANGE", Command("GETRANGE").SetHandler(GetRangeFunction));
-    service->RegisterCommand("SUBSTR", Command("SUBSTR").SetHandler(GetRangeFunction));
-    service->RegisterCommand("APPEND", Command("APPEND").SetHandler(AppendFunction));
-    service->RegisterCommand("EXISTS", Command("EXISTS").SetHandler(ExistsFunction));
-    service->RegisterCommand("STRLEN", Command("STRLEN").SetHandler(StrlenFunction));
+      "STRLEN", Command("STRLEN").SetHandler(StrlenFunction).SetKeySpec(1, 1));
 }
 
 } // namespace rdss
@@ -0,0 +1,514 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "zset_commands.h"
+
+#include "data_structure/zset_value.h"
+#include "service/command.h"
+#include "service/commands/command_util.h"
+#include "service/data_structure_service.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+namespace rdss {
+
+namespace {
+
+// Chars of the shortest representation of a double that converts back to it, e.g.
+// "-2.2250738585072014e-308".
+constexpr size_t kMaxScoreChars = 24;
+
+// Parses a score like strtod() as Redis does, e.g. "1.5", "+inf" or "-1e3". NaN isn't a score.
+std::optional<double> ParseScore(std::string_view str) {
+    if (str.starts_with('+') && !str.starts_with("+-")) {
+        str.remove_prefix(1);
+    }
+    double score;
+    auto [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), score);
+    if (err != std::errc{} || ptr != str.data() + str.size() || std::isnan(score)) {
+        return std::nullopt;
+    }
+    return score;
+}
+
+StringValue ScoreToValue(double score) {
+    std::array<char, kMaxScoreChars> chars;
+    auto [ptr, _] = std::to_chars(chars.data(), chars.data() + chars.size(), score);
+    return StringValue(std::string_view(chars.data(), static_cast<size_t>(ptr - chars.data())));
+}
+
+// Bound of a score range, exclusive if prefixed with '('.
+struct ScoreBound {
+    double score;
+    bool exclusive;
+};
+
+std::optional<ScoreBound> ParseScoreBound(std::string_view str) {
+    const bool exclusive = str.starts_with('(');
+    if (exclusive) {
+        str.remove_prefix(1);
+    }
+    const auto score = ParseScore(str);
+    if (!score.has_value()) {
+        return std::nullopt;
+    }
+    return ScoreBound{.score = score.value(), .exclusive = exclusive};
+}
+
+MTSHashTable::EntryPointer
+FindZSet(DataStructureService& service, std::string_view key, Result& result) {
+    return FindTyped(service, key, result, CheckType<&StringValue::IsZSet>);
+}
+
+MTSHashTable::EntryPointer
+FindOrCreateZSet(DataStructureService& service, std::string_view key, Result& result) {
+    return FindOrCreateTyped(
+      service, key, result, CheckType<&StringValue::IsZSet>, StringValue::CreateZSet);
+}
+
+// Replies the members from rank 'start' to 'stop' inclusively, which are counted from the last
+// member if 'reverse', and their scores if 'with_scores'.
+void ReplyRange(
+  const ZSetValue& zset,
+  size_t start,
+  size_t stop,
+  bool reverse,
+  bool with_scores,
+  Result& result) {
+    result.type = Result::Type::kStrings;
+    const auto size = zset.Size();
+    if (start > stop || start >= size) {
+        return;
+    }
+    stop = std::min(stop, size - 1);
+    result.strings.reserve((stop - start + 1) * (with_scores ? 2 : 1));
+    const auto func = [&result, with_scores](std::string_view member, double score) {
+        result.AddString(StringValue(member));
+        if (with_scores) {
+            result.AddString(ScoreToValue(score));
+        }
+    };
+    if (reverse) {
+        zset.Range(size - 1 - stop, size - 1 - start, true, func);
+    } else {
+        zset.Range(start, stop, false, func);
+    }
+}
+
+// Options of ZRANGE and ZRANGEBYSCORE.
+struct RangeOptions {
+    bool by_score = false;
+    bool reverse = false;
+    bool with_scores = false;
+    int64_t offset = 0;
+    // Negative means all the members from 'offset'.
+    int64_t count = -1;
+};
+
+// Parses the options of 'args' from 'first', returns false if it sets an error.
+bool ParseRangeOptions(Args args, size_t first, RangeOptions& options, Result& result) {
+    bool has_limit{false};
+    for (auto i = first; i < args.size(); ++i) {
+        if (EqualsIgnoreCase(args[i], "BYSCORE")) {
+            options.by_score = true;
+        } else if (EqualsIgnoreCase(args[i], "REV")) {
+            options.reverse = true;
+        } else if (EqualsIgnoreCase(args[i], "WITHSCORES")) {
+            options.with_scores = true;
+        } else if (EqualsIgnoreCase(args[i], "LIMIT") && i + 2 < args.size()) {
+            const auto offset = ParseInt(args[i + 1]);
+            const auto count = ParseInt(args[i + 2]);
+            if (!offset.has_value() || !count.has_value()) {
+                result.SetError(Error::kNotAnInt);
+                return false;
+            }
+            options.offset = offset.value();
+            options.count = count.value();
+            has_limit = true;
+            i += 2;
+        } else {
+            result.SetError(Error::kSyntaxError);
+            return false;
+        }
+    }
+    // Like Redis, LIMIT only applies to a range by score.
+    if (has_limit && !options.by_score) {
+        result.SetError(Error::kSyntaxError);
+        return false;
+    }
+    return true;
+}
+
+// Replies the range of 'key' by rank from 'start' to 'stop', or by score from 'min' to 'max', of
+// which the reversed range takes 'max' first.
+void Range(
+  DataStructureService& service,
+  std::string_view key,
+  std::string_view start,
+  std::string_view stop,
+  const RangeOptions& options,
+  Result& result) {
+    if (!options.by_score) {
+        const auto start_rank = ParseInt(start);
+        const auto stop_rank = ParseInt(stop);
+        if (!start_rank.has_value() || !stop_rank.has_value()) {
+            result.SetError(Error::kNotAnInt);
+            return;
+        }
+        // Empty array if the key doesn't exist.
+        result.type = Result::Type::kStrings;
+        auto entry = FindZSet(service, key, result);
+        if (entry == nullptr) {
+            return;
+        }
+        const auto& zset = entry->value.ZSet();
+        const auto size = static_cast<int64_t>(zset.Size());
+        auto first = start_rank.value();
+        auto last = stop_rank.value();
+        if (first < 0) {
+            first = std::max<int64_t>(first + size, 0);
+        }
+        if (last < 0) {
+            last += size;
+        }
+        if (first > last || last < 0) {
+            return;
+        }
+        ReplyRange(
+          zset,
+          static_cast<size_t>(first),
+          static_cast<size_t>(last),
+          options.reverse,
+          options.with_scores,
+          result);
+        return;
+    }
+
+    auto min = ParseScoreBound(options.reverse ? stop : start);
+    auto max = ParseScoreBound(options.reverse ? start : stop);
+    if (!min.has_value() || !max.has_value()) {
+        result.SetError(Error::kMinMaxNotAFloat);
+        return;
+    }
+    result.type = Result::Type::kStrings;
+    auto entry = FindZSet(service, key, result);
+    if (entry == nullptr || options.offset < 0 || options.count == 0) {
+        return;
+    }
+    // The ranks of the members in the range are ['first', 'end').
+    const auto& zset = entry->value.ZSet();
+    const auto first = zset.CountBelow(min->score, min->exclusive);
+    const auto end = zset.CountBelow(max->score, !max->exclusive);
+    const auto offset = static_cast<size_t>(options.offset);
+    if (first >= end || offset >= end - first) {
+        return;
+    }
+    auto count = end - first - offset;
+    if (options.count > 0) {
+        count = std::min(count, static_cast<size_t>(options.count));
+    }
+    // Counted from the last member, the range starts at 'zset.Size() - end'.
+    const auto range_start = options.reverse ? zset.Size() - end : first;
+    ReplyRange(
+      zset,
+      range_start + offset,
+      range_start + offset + count - 1,
+      options.reverse,
+      options.with_scores,
+      result);
+}
+
+} // namespace
+
+void ZAddFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // ZADD key [NX | XX] [GT | LT] [CH] [INCR] score member [score member ...]
+    bool nx{false};
+    bool xx{false};
+    bool gt{false};
+    bool lt{false};
+    bool ch{false};
+    bool incr{false};
+    size_t i = 2;
+    for (; i < args.size(); ++i) {
+        if (EqualsIgnoreCase(args[i], "NX")) {
+            nx = true;
+        } else if (EqualsIgnoreCase(args[i], "XX")) {
+            xx = true;
+        } else if (EqualsIgnoreCase(args[i], "GT")) {
+            gt = true;
+        } else if (EqualsIgnoreCase(args[i], "LT")) {
+            lt = true;
+        } else if (EqualsIgnoreCase(args[i], "CH")) {
+            ch = true;
+        } else if (EqualsIgnoreCase(args[i], "INCR")) {
+            incr = true;
+        } else {
+            break;
+        }
+    }
+    const auto num_pairs = (args.size() - i) / 2;
+    if (num_pairs == 0 || (args.size() - i) % 2 != 0) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    if ((nx && xx) || (gt && lt) || (nx && (gt || lt)) || (incr && num_pairs != 1)) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    // Nothing is added unless all the scores are valid.
+    std::vector<double> scores(num_pairs);
+    for (size_t p = 0; p < num_pairs; ++p) {
+        const auto score = ParseScore(args[i + p * 2]);
+        if (!score.has_value()) {
+            result.SetError(Error::kNotAFloat);
+            return;
+        }
+        scores[p] = score.value();
+    }
+
+    // XX doesn't create the key.
+    auto entry = xx ? FindZSet(service, args[1], result)
+                    : FindOrCreateZSet(service, args[1], result);
+    if (entry == nullptr) {
+        if (result.type != Result::Type::kError) {
+            if (incr) {
+                result.SetNil();
+            } else {
+                result.SetInt(0);
+            }
+        }
+        return;
+    }
+    auto& zset = entry->value.ZSet();
+    int64_t added{0};
+    int64_t updated{0};
+    std::optional<double> incr_result;
+    for (size_t p = 0; p < num_pairs; ++p) {
+        const auto member = args[i + p * 2 + 1];
+        auto score = scores[p];
+        const auto current = zset.Score(member);
+        if (current.has_value()) {
+            if (nx) {
+                continue;
+            }
+            if (incr) {
+                score += current.value();
+                if (std::isnan(score)) {
+                    result.SetError(Error::kScoreIsNaN);
+                    return;
+                }
+            }
+            if ((gt && score <= current.value()) || (lt && score >= current.value())) {
+                continue;
+            }
+            if (score != current.value()) {
+                zset.Set(member, score);
+                ++updated;
+            }
+        } else {
+            if (xx) {
+                continue;
+            }
+            zset.Set(member, score);
+            ++added;
+        }
+        incr_result = score;
+    }
+
+    if (incr) {
+        if (incr_result.has_value()) {
+            result.SetString(ScoreToValue(incr_result.value()));
+        } else {
+            result.SetNil();
+        }
+        return;
+    }
+    result.SetInt(added + (ch ? updated : 0));
+}
+
+void ZIncrByFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    const auto increment = ParseScore(args[2]);
+    if (!increment.has_value()) {
+        result.SetError(Error::kNotAFloat);
+        return;
+    }
+    auto entry = FindOrCreateZSet(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    auto& zset = entry->value.ZSet();
+    const auto score = zset.Score(args[3]).value_or(0) + increment.value();
+    // Only adding an infinity to the opposite one results in NaN, so the set isn't empty.
+    if (std::isnan(score)) {
+        result.SetError(Error::kScoreIsNaN);
+        return;
+    }
+    zset.Set(args[3], score);
+    result.SetString(ScoreToValue(score));
+}
+
+void ZRemFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    auto entry = FindZSet(service, args[1], result);
+    if (entry == nullptr) {
+        if (result.type != Result::Type::kError) {
+            result.SetInt(0);
+        }
+        return;
+    }
+    auto& zset = entry->value.ZSet();
+    int64_t removed{0};
+    for (size_t i = 2; i < args.size(); ++i) {
+        removed += zset.Erase(args[i]) ? 1 : 0;
+    }
+    // Like Redis, an empty sorted set doesn't exist.
+    if (zset.Size() == 0) {
+        service.EraseKey(entry);
+    }
+    result.SetInt(removed);
+}
+
+void ZRangeFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // ZRANGE key start stop [BYSCORE] [REV] [LIMIT offset count] [WITHSCORES]
+    RangeOptions options;
+    if (ParseRangeOptions(args, 4, options, result)) {
+        Range(service, args[1], args[2], args[3], options, result);
+    }
+}
+
+void ZRangeByScoreFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() < 4) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    // ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+    RangeOptions options{.by_score = true};
+    if (!ParseRangeOptions(args, 4, options, result)) {
+        return;
+    }
+    if (options.reverse) {
+        result.SetError(Error::kSyntaxError);
+        return;
+    }
+    Range(service, args[1], args[2], args[3], options, result);
+}
+
+void ZRankFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetNil();
+    auto entry = FindZSet(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto rank = entry->value.ZSet().Rank(args[2]);
+    if (rank.has_value()) {
+        result.SetInt(static_cast<int64_t>(rank.value()));
+    }
+}
+
+void ZScoreFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetNil();
+    auto entry = FindZSet(service, args[1], result);
+    if (entry == nullptr) {
+        return;
+    }
+    const auto score = entry->value.ZSet().Score(args[2]);
+    if (score.has_value()) {
+        result.SetString(ScoreToValue(score.value()));
+    }
+}
+
+void ZCardFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    result.SetInt(0);
+    auto entry = FindZSet(service, args[1], result);
+    if (entry != nullptr) {
+        result.SetInt(static_cast<int64_t>(entry->value.ZSet().Size()));
+    }
+}
+
+void ZPopMinFunction(DataStructureService& service, Args args, Result& result) {
+    if (args.size() != 2 && args.size() != 3) {
+        result.SetError(Error::kWrongArgNum);
+        return;
+    }
+    int64_t count{1};
+    if (args.size() == 3) {
+        const auto parsed = ParseInt(args[2]);
+        if (!parsed.has_value() || parsed.value() < 0) {
+            result.SetError(Error::kNotAnInt);
+            return;
+        }
+        count = parsed.value();
+    }
+    // Empty array if the key doesn't exist.
+    result.type = Result::Type::kStrings;
+    auto entry = FindZSet(service, args[1], result);
+    if (entry == nullptr || count == 0) {
+        return;
+    }
+    auto& zset = entry->value.ZSet();
+    const auto popped = std::min(static_cast<size_t>(count), zset.Size());
+    ReplyRange(zset, 0, popped - 1, false, true, result);
+    // The replied members are copies, the first of each pair.
+    for (size_t i = 0; i < result.strings.size(); i += 2) {
+        StringValue::IntChars chars;
+        zset.Erase(result.strings[i].View(chars));
+    }
+    if (zset.Size() == 0) {
+        service.EraseKey(entry);
+    }
+}
+
+void RegisterZSetCommands(DataStructureService* service) {
+    service->RegisterCommand(
+      "ZADD", Command("ZADD").SetHandler(ZAddFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZINCRBY",
+      Command("ZINCRBY").SetHandler(ZIncrByFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZREM", Command("ZREM").SetHandler(ZRemFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZRANGE", Command("ZRANGE").SetHandler(ZRangeFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZRANGEBYSCORE",
+      Command("ZRANGEBYSCORE").SetHandler(ZRangeByScoreFunction).SetKeySpec(1, 1));
+    service->RegisterCommand("ZRANK", Command("ZRANK").SetHandler(ZRankFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZSCORE", Command("ZSCORE").SetHandler(ZScoreFunction).SetKeySpec(1, 1));
+    service->RegisterCommand("ZCARD", Command("ZCARD").SetHandler(ZCardFunction).SetKeySpec(1, 1));
+    service->RegisterCommand(
+      "ZPOPMIN",
+      Command("ZPOPMIN").SetHandler(ZPopMinFunction).SetIsWriteCommand().SetKeySpec(1, 1));
+}
+
+} // namespace rdss
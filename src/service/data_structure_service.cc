@@ -2,17 +2,35 @@
 // Licensed under the MIT license.
 #include "data_structure_service.h"
 
+#include "aof.h"
 #include "base/config.h"
+#include "server.h"
 #include "runtime/ring_executor.h"
 #include "runtime/util.h"
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
 namespace rdss {
 
 using SetStatus = DataStructureService::SetStatus;
 using SetMode = DataStructureService::SetMode;
 
+std::optional<std::chrono::steady_clock::duration> ParseBlockTimeout(std::string_view timeout) {
+    double seconds;
+    auto [ptr, err] = std::from_chars(timeout.data(), timeout.data() + timeout.size(), seconds);
+    if (
+      err != std::errc{} || ptr != timeout.data() + timeout.size() || !std::isfinite(seconds)
+      || seconds < 0) {
+        return std::nullopt;
+    }
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
 DataStructureService::DataStructureService(Config* config, Server* server, Clock* clock)
   : config_(config)
   , server_(server)
@@ -27,6 +45,8 @@ DataStructureService::~DataStructureService() {
     }
 }
 
+void DataStructureService::SetAof(std::unique_ptr<AppendOnlyFile> aof) { aof_ = std::move(aof); }
+
 std::future<void> DataStructureService::GetShutdownFuture() {
     if (get_future_called_) {
         LOG(FATAL) << "Repetitive calls to GetShutdownFuture.";
@@ -44,6 +64,15 @@ Task<void> DataStructureService::Cron() {
     while (active_.load(std::memory_order_relaxed)) {
         co_await WaitFor(tls_exr, std::chrono::milliseconds(1));
         UpdateCommandTime();
+        stats_.keys.store(data_ht_.Count(), std::memory_order_relaxed);
+        stats_.expires.store(expire_ht_.Count(), std::memory_order_relaxed);
+        if (server_ != nullptr) {
+            server_->GetSnapshotter()->SaveSome(this, kSnapshotTimeLimit);
+        }
+        if (aof_ != nullptr) {
+            aof_->Cron();
+        }
+        WakeTimedOutClients();
         if (++cnt < interval_in_millisecond) {
             continue;
         }
@@ -55,82 +84,238 @@ Task<void> DataStructureService::Cron() {
 }
 
 void DataStructureService::RegisterCommand(CommandName name, Command command) {
-    std::transform(name.begin(), name.end(), name.begin(), [](char c) { return std::tolower(c); });
-    commands_.emplace(name, command);
-    std::transform(name.begin(), name.end(), name.begin(), [](char c) { return std::toupper(c); });
-    commands_.emplace(std::move(name), std::move(command));
+    commands_.Add(name, std::move(command));
+}
+
+const Command* DataStructureService::FindCommand(std::string_view name) const {
+    const auto id = commands_.Find(name);
+    if (id == CommandDictionary::kNoCommand) {
+        return nullptr;
+    }
+    return &commands_.Get(id);
 }
 
 void DataStructureService::Invoke(Command::CommandStrings command_strings, Result& result) {
-    auto command_itor = commands_.find(command_strings[0]);
-    if (command_itor == commands_.end()) {
+    const auto id = commands_.Find(command_strings[0]);
+    if (id == CommandDictionary::kNoCommand) {
         result.SetError(Error::kUnknownCommand);
         return;
     }
-    auto& command = command_itor->second;
+    const auto& command = commands_.Get(id);
+    auto& command_stats = commands_.Stats(id);
 
     if (command.IsWriteCommand()) {
         size_t bytes_to_free = evictor_.MaxmemoryExceeded();
         if (bytes_to_free != 0 && !evictor_.Evict(bytes_to_free)) {
             result.SetError(Error::kOOM);
+            SingleWriterAdd(command_stats.rejected_calls);
+            return;
+        }
+        if (aof_ != nullptr && !aof_->WriteOk()) {
+            result.SetError(Error::kAofWriteFailed);
+            SingleWriterAdd(command_stats.rejected_calls);
             return;
         }
     }
-    command(*this, std::move(command_strings), result);
-    stats_.commands_processed.fetch_add(1, std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    command(*this, command_strings, result);
+    command_stats.latency.Record(std::chrono::steady_clock::now() - start);
+    if (result.type == Result::Type::kError) {
+        SingleWriterAdd(command_stats.failed_calls);
+    } else if (aof_ != nullptr && command.IsWriteCommand() && !IsLoading()) {
+        FeedAof(command, command_strings);
+    }
+    propagate_as_.clear();
+    SingleWriterAdd(stats_.commands_processed);
+    if (!ready_keys_.empty() && !serving_ready_keys_) {
+        ServeReadyKeys();
+    }
 }
 
-MTSHashTable::EntryPointer DataStructureService::FindOrExpire(std::string_view key) {
-    auto entry = data_ht_.Find(key);
-    if (entry == nullptr) {
-        return nullptr;
+DataStructureService::BlockedClient
+DataStructureService::WaitForKeys(Args args, Result* result, uint64_t client_id) {
+    const auto timeout = ParseBlockTimeout(args.back());
+    assert(timeout.has_value());
+    const auto deadline = timeout.value() == std::chrono::steady_clock::duration::zero()
+                            ? std::chrono::steady_clock::time_point::max()
+                            : std::chrono::steady_clock::now() + timeout.value();
+    return BlockedClient{
+      .service = this,
+      .args = args,
+      .result = result,
+      .client_id = client_id,
+      .deadline = deadline};
+}
+
+void DataStructureService::CompleteDeferredReply(const Result* result) {
+    auto it = deferred_replies_.find(result);
+    assert(it != deferred_replies_.end());
+    auto* waiter = it->second;
+    deferred_replies_.erase(it);
+    if (waiter != nullptr && --waiter->pending == 0) {
+        waiter->handle.resume();
+    }
+}
+
+bool DataStructureService::Unblock(uint64_t client_id) {
+    auto it = blocked_clients_.find(client_id);
+    if (it == blocked_clients_.end()) {
+        return false;
     }
+    Wake(it->second, WakeReason::kUnblocked);
+    return true;
+}
 
-    // TODO: Add a FindEntryAndProceeding to save an additional Erase call on expired.
-    auto* expire_entry = expire_ht_.Find(key);
-    const auto expire_found = (expire_entry != nullptr);
-    if (!expire_found || GetCommandTimeSnapshot() < expire_entry->value) {
-        return entry;
+void DataStructureService::Block(BlockedClient* client) {
+    // The keys of blocking commands are all the strings but the command name and the timeout.
+    for (size_t i = 1; i + 1 < client->args.size(); ++i) {
+        auto& clients = blocked_keys_[std::string(client->args[i])];
+        // A key given more than once blocks the client once.
+        if (clients.empty() || clients.back() != client) {
+            clients.push_back(client);
+        }
+    }
+    if (client->deadline != std::chrono::steady_clock::time_point::max()) {
+        block_deadlines_.emplace(client->deadline, client);
+    }
+    blocked_clients_[client->client_id] = client;
+}
+
+bool DataStructureService::ServeBlocked(BlockedClient* client) {
+    const auto* command = FindCommand(client->args[0]);
+    assert(command != nullptr);
+    client->result->Reset();
+    (*command)(*this, client->args, *client->result);
+    if (client->result->type == Result::Type::kNil) {
+        return false;
+    }
+    if (client->result->type != Result::Type::kError && aof_ != nullptr && !IsLoading()) {
+        FeedAof(*command, client->args);
     }
+    propagate_as_.clear();
+    return true;
+}
 
-    data_ht_.Erase(key);
-    if (expire_found) {
-        expire_ht_.Erase(key);
+void DataStructureService::FeedAof(const Command& command, Args args) {
+    if (!propagate_as_.empty()) {
+        const auto* propagated = FindCommand(propagate_as_.front());
+        assert(propagated != nullptr);
+        aof_->Feed(*propagated, Args(propagate_as_));
+    } else if (!command.IsBlocking()) {
+        // A blocking command that replies nil changes nothing.
+        aof_->Feed(command, args);
     }
+}
+
+void DataStructureService::Wake(BlockedClient* client, WakeReason reason) {
+    for (size_t i = 1; i + 1 < client->args.size(); ++i) {
+        auto it = blocked_keys_.find(std::string(client->args[i]));
+        if (it == blocked_keys_.end()) {
+            continue;
+        }
+        auto& clients = it->second;
+        clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+        if (clients.empty()) {
+            blocked_keys_.erase(it);
+        }
+    }
+    if (client->deadline != std::chrono::steady_clock::time_point::max()) {
+        block_deadlines_.erase({client->deadline, client});
+    }
+    blocked_clients_.erase(client->client_id);
+    client->reason = reason;
+    client->handle.resume();
+}
+
+void DataStructureService::ServeReadyKeys() {
+    serving_ready_keys_ = true;
+    // Serving a client might signal more keys, which are appended and served in the same loop.
+    for (size_t i = 0; i < ready_keys_.size(); ++i) {
+        const auto key = ready_keys_[i];
+        while (true) {
+            auto it = blocked_keys_.find(key);
+            if (it == blocked_keys_.end()) {
+                break;
+            }
+            auto* client = it->second.front();
+            // The list is drained, the rest of the clients keep blocking.
+            if (!ServeBlocked(client)) {
+                break;
+            }
+            Wake(client, WakeReason::kReady);
+        }
+    }
+    ready_keys_.clear();
+    serving_ready_keys_ = false;
+}
+
+void DataStructureService::WakeTimedOutClients() {
+    if (block_deadlines_.empty()) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    while (!block_deadlines_.empty() && block_deadlines_.begin()->first <= now) {
+        Wake(block_deadlines_.begin()->second, WakeReason::kTimeout);
+    }
+}
+
+MTSHashTable::EntryPointer DataStructureService::FindOrExpire(std::string_view key) {
+    auto entry = data_ht_.Find(key);
+    if (entry == nullptr || !IsExpired(entry)) {
+        return entry;
+    }
+    EraseKey(entry);
     return nullptr;
 }
 
-void DataStructureService::EraseKey(std::string_view key) {
-    if (!data_ht_.Erase(key)) {
+void DataStructureService::SetExpire(MTSHashTable::EntryPointer entry, TimePoint expire_time) {
+    if (!entry->HasExpire()) {
+        expire_ht_.Upsert(entry, {});
+    }
+    entry->SetExpire(expire_time);
+}
+
+void DataStructureService::Persist(MTSHashTable::EntryPointer entry) {
+    if (!entry->HasExpire()) {
         return;
     }
-    expire_ht_.Erase(key);
+    expire_ht_.Erase(entry->Key());
+    entry->ClearExpire();
 }
 
-std::tuple<SetStatus, MTSHashTable::EntryPointer, MTSPtr> DataStructureService::SetData(
+void DataStructureService::EraseKey(MTSHashTable::EntryPointer entry) {
+    // The expire entry references the data entry, so it's erased first.
+    if (entry->HasExpire()) {
+        expire_ht_.Erase(entry->Key());
+    }
+    data_ht_.Erase(entry->Key());
+}
+
+std::tuple<SetStatus, MTSHashTable::EntryPointer, StringValue> DataStructureService::SetData(
   std::string_view key, std::string_view value, SetMode set_mode, bool get) {
     SetStatus set_status{SetStatus::kNoOp};
-    MTSPtr old_value{nullptr};
+    StringValue old_value;
     MTSHashTable::EntryPointer set_entry{nullptr};
 
     switch (set_mode) {
     case SetMode::kRegular: {
         bool exists{false};
         if (!get) {
-            auto upsert_result = data_ht_.Upsert(key, CreateMTSPtr(value));
+            auto upsert_result = data_ht_.Upsert(key, StringValue(value));
             set_entry = upsert_result.first;
             exists = upsert_result.second;
         } else {
-            auto [entry, exists] = data_ht_.FindOrCreate(key, true);
-            if (exists) {
-                auto expire_entry = expire_ht_.Find(key);
-                if (expire_entry == nullptr || expire_entry->value > GetCommandTimeSnapshot()) {
-                    old_value = std::move(entry->value);
-                    exists = true;
-                }
+            auto [entry, found] = data_ht_.FindOrCreate(key, true);
+            if (found && IsExpired(entry)) {
+                Persist(entry);
+                found = false;
+            }
+            if (found) {
+                old_value = std::move(entry->value);
             }
-            entry->value = CreateMTSPtr(value);
+            entry->value = StringValue(value);
             set_entry = entry;
+            exists = found;
         }
         set_status = (exists) ? SetStatus::kUpdated : SetStatus::kInserted;
         break;
@@ -138,15 +323,14 @@ std::tuple<SetStatus, MTSHashTable::EntryPointer, MTSPtr> DataStructureService::
     case SetMode::kNX: {
         auto data_entry = data_ht_.Find(key);
         if (data_entry != nullptr) {
-            auto expire_entry = expire_ht_.Find(key);
-            if (expire_entry != nullptr && expire_entry->value <= GetCommandTimeSnapshot()) {
-                data_entry->value = CreateMTSPtr(value);
-                expire_ht_.Erase(key);
+            if (IsExpired(data_entry)) {
+                data_entry->value = StringValue(value);
+                Persist(data_entry);
                 set_entry = data_entry;
                 set_status = SetStatus::kInserted;
             }
         } else {
-            auto [entry, _] = data_ht_.Insert(key, CreateMTSPtr(value));
+            auto [entry, _] = data_ht_.Insert(key, StringValue(value));
             set_entry = entry;
             set_status = SetStatus::kInserted;
         }
@@ -157,23 +341,21 @@ std::tuple<SetStatus, MTSHashTable::EntryPointer, MTSPtr> DataStructureService::
         if (data_entry == nullptr) {
             break;
         }
-        auto expire_entry = expire_ht_.Find(key);
-        if (expire_entry != nullptr && expire_entry->value <= GetCommandTimeSnapshot()) {
-            data_ht_.Erase(key);
-            expire_ht_.Erase(key);
+        if (IsExpired(data_entry)) {
+            EraseKey(data_entry);
             break;
         }
         if (get) {
             old_value = std::move(data_entry->value);
         }
-        data_entry->value = CreateMTSPtr(value);
+        data_entry->value = StringValue(value);
         set_entry = data_entry;
         set_status = SetStatus::kUpdated;
         break;
     }
     }
     if (set_entry != nullptr) {
-        set_entry->GetKey()->SetLRU(GetLRUClock());
+        set_entry->SetLRU(GetLRUClock());
     }
     return {set_status, set_entry, old_value};
 }
@@ -11,24 +11,46 @@
 #include "io/promise.h"
 
 #include <chrono>
+#include <coroutine>
+#include <deque>
 #include <future>
+#include <initializer_list>
+#include <optional>
 #include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
 namespace rdss {
 
 struct Config;
+class AppendOnlyFile;
 class Server;
 class RingExecutor;
 
 struct DSSStats {
     std::atomic<uint64_t> commands_processed;
+
+    // Sizes of the data / expire table, published at cron for being read by other shards.
+    std::atomic<uint64_t> keys;
+    std::atomic<uint64_t> expires;
 };
 
+/// Parses the timeout of a blocking command, in seconds with an optional fraction. Returns nullopt
+/// if it's not a non-negative number. Zero means blocking forever.
+std::optional<std::chrono::steady_clock::duration> ParseBlockTimeout(std::string_view timeout);
+
 class DataStructureService {
 public:
-    using TimePoint = std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds>;
-    using ExpireHashTable = HashTable<TimePoint, Mallocator<TimePoint>>;
+    using TimePoint = MTSHashTable::EntryType::ExpireTimePoint;
+    /// Index of the volatile keys, whose expire time is stored in their data entries. It's only
+    /// used to find candidates for active expiration.
+    using ExpireHashTable = RefHashTable<std::monostate, MTSHashTable>;
     static constexpr auto kIncrementalRehashingTimeLimit = std::chrono::milliseconds{1};
+    // Time spent on a save in progress at every tick of cron.
+    static constexpr auto kSnapshotTimeLimit = std::chrono::microseconds{250};
 
 public:
     explicit DataStructureService(Config* config, Server* server, Clock* clock);
@@ -45,6 +67,13 @@ public:
 
     void RegisterCommand(CommandName name, Command command);
 
+    /// Returns the command named 'name' in any case, or nullptr if there is no such command.
+    /// Commands are registered before serving, so this can be called from other threads.
+    const Command* FindCommand(std::string_view name) const;
+
+    /// Registered commands and their stats.
+    const CommandDictionary& Commands() const { return commands_; }
+
     void Invoke(Command::CommandStrings command_strings, Result& result);
 
     TimePoint GetCommandTimeSnapshot() const { return command_time_snapshot_; }
@@ -53,11 +82,26 @@ public:
 
     MTSHashTable* DataTable() { return &data_ht_; }
 
+    /// Entries of the expire table reference the entries of the data table for their keys, so the
+    /// expire entry of a key should be erased before its data entry. Use SetExpire / Persist /
+    /// EraseKey to keep both tables in sync.
     ExpireHashTable* ExpireTable() { return &expire_ht_; }
 
     /// Finds and returns the entry of 'key' if it's valid. Expire the key if it's stale.
     MTSHashTable::EntryPointer FindOrExpire(std::string_view key);
 
+    /// Keys aren't expired while loading, since the commands replayed from the append only file
+    /// should see the keys as they were when the commands were executed.
+    bool IsExpired(MTSHashTable::EntryPointer entry) const {
+        return !IsLoading() && entry->HasExpire() && entry->GetExpire() <= GetCommandTimeSnapshot();
+    }
+
+    /// Sets the expire time of 'entry', and adds it to the expire table if it has no expire time.
+    void SetExpire(MTSHashTable::EntryPointer entry, TimePoint expire_time);
+
+    /// Removes the expire time of 'entry' if it has one.
+    void Persist(MTSHashTable::EntryPointer entry);
+
     enum class SetMode {
         kRegular, /*** Update if key presents, insert otherwise ***/
         kNX,      /*** Only insert if key doesn't present ***/
@@ -69,14 +113,121 @@ public:
     /// Sets 'key' 'value' pair in data table with respect to 'set_mode'. Returns the result of the
     /// operation, the entry of 'key', and if 'get' is true and 'key' exists, returns the old value
     /// of 'key'.
-    std::tuple<SetStatus, MTSHashTable::EntryPointer, MTSPtr>
+    std::tuple<SetStatus, MTSHashTable::EntryPointer, StringValue>
     SetData(std::string_view key, std::string_view value, SetMode set_mode, bool get);
 
-    /// Erases key in both data and expire table.
-    void EraseKey(std::string_view key);
+    /// Erases the key of 'entry' in both data and expire table.
+    void EraseKey(MTSHashTable::EntryPointer entry);
 
     auto GetLRUClock() const { return evictor_.GetLRUClock(); }
 
+    /// Why a client blocked by WaitForKeys() is resumed.
+    enum class WakeReason { kReady, kTimeout, kUnblocked };
+
+    /// Awaitable of WaitForKeys(), it's registered in the blocking state by its address, which is
+    /// stable in the frame of the suspended coroutine.
+    struct BlockedClient {
+        // The command is invoked again on the shard before the client blocks, so that a key that
+        // became ready after the command replied nil, e.g. while the client visited other shards,
+        // isn't missed.
+        bool await_ready() {
+            if (service->ServeBlocked(this)) {
+                reason = WakeReason::kReady;
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            handle = h;
+            service->Block(this);
+        }
+
+        WakeReason await_resume() const { return reason; }
+
+        DataStructureService* service;
+        Args args;
+        Result* result;
+        uint64_t client_id;
+        std::chrono::steady_clock::time_point deadline;
+        std::coroutine_handle<> handle{};
+        WakeReason reason{WakeReason::kTimeout};
+    };
+
+    /// Returns an awaitable that blocks the client 'client_id' for its blocking command 'args',
+    /// which has replied nil to 'result'. The command is invoked again into 'result' when it's
+    /// awaited, and the client doesn't block if it no longer replies nil. Otherwise, once one of
+    /// the keys is signaled by SignalKeyReady(), the command is invoked again on behalf of the
+    /// client, and the client is resumed if the reply isn't nil. Clients blocked on a key are
+    /// served in the order they block. The client is also resumed when the timeout of the command
+    /// passes, which is checked at cron, or when Unblock() is called. 'args' and 'result' should
+    /// stay valid meanwhile.
+    BlockedClient WaitForKeys(Args args, Result* result, uint64_t client_id);
+
+    /// Marks 'key' as ready for the clients blocked on it, which are served after the current
+    /// command. Called by the commands that add elements to a list.
+    void SignalKeyReady(std::string_view key) {
+        if (!blocked_keys_.empty() && blocked_keys_.contains(std::string(key))) {
+            ready_keys_.emplace_back(key);
+        }
+    }
+
+    /// Makes the write command being executed logged to the append only file as 'args' instead of
+    /// itself, e.g. a blocking pop is logged as the pop of the list it popped from, so that
+    /// replaying it doesn't depend on blocking. 'args' should outlive the command.
+    void PropagateAs(std::initializer_list<std::string_view> args) { propagate_as_.assign(args); }
+
+    /// Resumes the client 'client_id' if it's blocked, with its command replying nil. Returns
+    /// false if the client isn't blocked by this shard.
+    bool Unblock(uint64_t client_id);
+
+    size_t NumBlockedClients() const { return blocked_clients_.size(); }
+
+    /// Defers the reply of the command being executed into 'result', which is set later on this
+    /// shard followed by CompleteDeferredReply(), e.g. SAVE replies once the file is written. The
+    /// client waits for it by WaitForDeferredReplies(), so that the shard keeps serving meanwhile.
+    /// Only a command that isn't split among the shards can defer its reply.
+    void DeferReply(const Result* result) { deferred_replies_.emplace(result, nullptr); }
+
+    /// Resumes the client waiting for the deferred reply of 'result', if it's waiting.
+    void CompleteDeferredReply(const Result* result);
+
+    /// Awaitable of WaitForDeferredReplies().
+    struct DeferredRepliesWaiter {
+        bool await_ready() {
+            if (service->deferred_replies_.empty()) {
+                return true;
+            }
+            for (const auto& result : results) {
+                pending += service->deferred_replies_.count(&result);
+            }
+            return pending == 0;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            handle = h;
+            for (const auto& result : results) {
+                if (auto it = service->deferred_replies_.find(&result);
+                    it != service->deferred_replies_.end()) {
+                    it->second = this;
+                }
+            }
+        }
+
+        void await_resume() const {}
+
+        DataStructureService* service;
+        std::span<const Result> results;
+        size_t pending{0};
+        std::coroutine_handle<> handle{};
+    };
+
+    /// Returns an awaitable that suspends until the deferred replies among 'results', the results
+    /// of a batch executed on this shard, are set. It doesn't suspend if there is none.
+    DeferredRepliesWaiter WaitForDeferredReplies(std::span<const Result> results) {
+        return DeferredRepliesWaiter{.service = this, .results = results};
+    }
+
     /// Tries rehash data / expiry table for 'time_limit' duration if they are rehashing. This is
     /// called at cron.
     void IncrementalRehashing(std::chrono::steady_clock::duration time_limit);
@@ -88,6 +239,18 @@ public:
 
     Clock* GetClock() { return clock_; }
 
+    /// Sets the append only file that the write commands are logged to, which is owned by 'this'.
+    void SetAof(std::unique_ptr<AppendOnlyFile> aof);
+
+    /// Returns nullptr if the append only file is disabled.
+    AppendOnlyFile* GetAof() { return aof_.get(); }
+
+    /// While loading, the executed commands aren't logged and keys aren't expired.
+    void SetLoading(bool loading) { loading_.store(loading, std::memory_order_relaxed); }
+
+    /// Can be called from other threads, e.g. by INFO.
+    bool IsLoading() const { return loading_.load(std::memory_order_relaxed); }
+
     DSSStats& Stats() { return stats_; }
 
     EvictionStrategy& GetEvictor() { return evictor_; }
@@ -97,6 +260,25 @@ public:
 private:
     size_t IsOOM() const;
 
+    void Block(BlockedClient* client);
+
+    // Invokes the command of the blocked 'client' again into its result, returns false if it
+    // still replies nil. It's part of the call that blocked, so it isn't counted in the stats.
+    bool ServeBlocked(BlockedClient* client);
+
+    // Logs the executed write command 'args' to the append only file, or the command set by
+    // PropagateAs() instead. A blocking command is only logged that way.
+    void FeedAof(const Command& command, Args args);
+
+    // Removes 'client' from the blocking state and resumes it.
+    void Wake(BlockedClient* client, WakeReason reason);
+
+    // Serves the clients blocked on the keys signaled by SignalKeyReady().
+    void ServeReadyKeys();
+
+    // Resumes the blocked clients whose timeout passes.
+    void WakeTimedOutClients();
+
     std::atomic<bool> active_{true};
     Config* config_;
     Server* server_;
@@ -111,6 +293,20 @@ private:
     ExpireStrategy expirer_;
     TimePoint command_time_snapshot_;
     DSSStats stats_;
+    std::unique_ptr<AppendOnlyFile> aof_;
+    std::atomic<bool> loading_{false};
+    std::vector<std::string_view> propagate_as_;
+
+    // Blocking state. Clients blocked on each key in the order they block, and indexes of them by
+    // their deadlines and their ids.
+    std::unordered_map<std::string, std::deque<BlockedClient*>> blocked_keys_;
+    std::set<std::pair<std::chrono::steady_clock::time_point, BlockedClient*>> block_deadlines_;
+    std::unordered_map<uint64_t, BlockedClient*> blocked_clients_;
+    std::vector<std::string> ready_keys_;
+    bool serving_ready_keys_{false};
+
+    // Deferred replies, and the clients waiting for them once they wait.
+    std::unordered_map<const Result*, DeferredRepliesWaiter*> deferred_replies_;
 };
 
 } // namespace rdss
@@ -6,8 +6,8 @@
 
 namespace rdss::detail {
 
-using LastAccessTimePoint = MTSHashTable::EntryType::KeyType::LastAccessTimePoint;
-using LastAccessTimeDuration = MTSHashTable::EntryType::KeyType::LastAccessTimeDuration;
+using LastAccessTimePoint = MTSHashTable::EntryType::LastAccessTimePoint;
+using LastAccessTimeDuration = MTSHashTable::EntryType::LastAccessTimeDuration;
 
 auto Now() {
     return std::chrono::time_point_cast<LastAccessTimeDuration>(LastAccessTimePoint::clock::now());
@@ -31,8 +31,9 @@ size_t EvictionStrategy::MaxmemoryExceeded() const {
         return 0;
     }
 
-    const auto allocated
-      = MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kAll>();
+    // Checked on every write command, so the published total is used instead of summing the
+    // counters of all threads.
+    const auto allocated = MemoryTracker::GetInstance().GetPublishedAllocated();
     if (allocated <= maxmemory_) {
         return 0;
     }
@@ -42,7 +43,6 @@ size_t EvictionStrategy::MaxmemoryExceeded() const {
 bool EvictionStrategy::Evict(size_t bytes_to_free) {
     assert(bytes_to_free != 0);
     auto* data_ht = service_->DataTable();
-    auto* expire_ht = service_->ExpireTable();
 
     VLOG(1) << "Start eviction, policy:" << MaxmemoryPolicyEnumToStr(maxmemory_policy_)
             << ", bytes_to_free:" << bytes_to_free;
@@ -62,17 +62,7 @@ bool EvictionStrategy::Evict(size_t bytes_to_free) {
             if (entry == nullptr) {
                 return false;
             }
-            auto delta
-              = MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>();
-            // TODO: dont convert to string_view
-            VLOG(1) << "Evicting key " << entry->GetKey()->StringView();
-            expire_ht->Erase(entry->GetKey()->StringView());
-            data_ht->Erase(entry->GetKey()->StringView());
-            evicted_keys_.fetch_add(1, std::memory_order_relaxed);
-            delta
-              -= MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>();
-            VLOG(1) << "Freed " << delta << " bytes.";
-            freed += delta;
+            freed += EraseKey(entry);
         }
         return true;
     }
@@ -86,23 +76,28 @@ bool EvictionStrategy::Evict(size_t bytes_to_free) {
             if (entry == nullptr) {
                 return false;
             }
-            auto delta
-              = MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>();
-            // TODO: dont convert to string_view
-            VLOG(1) << "Evicting key " << entry->GetKey()->StringView();
-            expire_ht->Erase(entry->GetKey()->StringView());
-            data_ht->Erase(entry->GetKey()->StringView());
-            evicted_keys_.fetch_add(1, std::memory_order_relaxed);
-            delta
-              -= MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>();
-            VLOG(1) << "Freed " << delta << " bytes.";
-            freed += delta;
+            freed += EraseKey(entry);
         }
         return true;
     }
     }
 }
 
+size_t EvictionStrategy::EraseKey(MTSHashTable::EntryPointer entry) {
+    // Measured by the counter of this thread, which isn't changed by other threads.
+    auto& tracker = MemoryTracker::GetInstance();
+    const auto allocated = tracker.GetThreadAllocated<MemoryTracker::Category::kMallocator>();
+    // TODO: dont convert to string_view
+    VLOG(1) << "Evicting key " << entry->Key();
+    service_->EraseKey(entry);
+    evicted_keys_.fetch_add(1, std::memory_order_relaxed);
+    const auto freed
+      = allocated - tracker.GetThreadAllocated<MemoryTracker::Category::kMallocator>();
+    VLOG(1) << "Freed " << freed << " bytes.";
+    // Nothing is freed if the value is still referenced, e.g. by a reply being sent.
+    return freed > 0 ? static_cast<size_t>(freed) : 0;
+}
+
 // TODO: Current implementation doesn't care execution time. Consider stop eviction after some
 // time or attempts.
 MTSHashTable::EntryPointer EvictionStrategy::GetSomeOldEntry(size_t samples) {
@@ -116,7 +111,7 @@ MTSHashTable::EntryPointer EvictionStrategy::GetSomeOldEntry(size_t samples) {
         for (size_t i = 0; i < std::min(samples, data_ht->Count()); ++i) {
             auto entry = data_ht->GetRandomEntry();
             assert(entry != nullptr);
-            eviction_pool_.emplace(entry->GetKey()->GetLRU(), entry->CopyKey());
+            eviction_pool_.emplace(entry->GetLRU(), MTS(entry->Key()));
         }
 
         while (eviction_pool_.size() > kEvictionPoolLimit) {
@@ -127,8 +122,8 @@ MTSHashTable::EntryPointer EvictionStrategy::GetSomeOldEntry(size_t samples) {
 
         while (!eviction_pool_.empty()) {
             auto& [lru, key] = *eviction_pool_.begin();
-            auto entry = data_ht->Find(key->StringView());
-            if (entry == nullptr || entry->GetKey()->GetLRU() != lru) {
+            auto entry = data_ht->Find(key);
+            if (entry == nullptr || entry->GetLRU() != lru) {
                 eviction_pool_.erase(eviction_pool_.begin());
                 continue;
             }
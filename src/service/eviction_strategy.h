@@ -13,7 +13,7 @@ class DataStructureService;
 
 class EvictionStrategy {
 public:
-    using LastAccessTimePoint = MTSHashTable::EntryType::KeyType::LastAccessTimePoint;
+    using LastAccessTimePoint = MTSHashTable::EntryType::LastAccessTimePoint;
 
     explicit EvictionStrategy(DataStructureService* service);
 
@@ -29,7 +29,8 @@ public:
 
 private:
     static constexpr size_t kEvictionPoolLimit = 16;
-    using LRUEntry = std::pair<LastAccessTimePoint, MTSHashTable::EntryType::KeyPointer>;
+    // The key is copied as the entry may be erased while it's in the pool.
+    using LRUEntry = std::pair<LastAccessTimePoint, MTS>;
 
     struct CompareLRUEntry {
         constexpr bool operator()(const LRUEntry& lhs, const LRUEntry& rhs) const {
@@ -39,6 +40,9 @@ private:
 
     MTSHashTable::EntryPointer GetSomeOldEntry(size_t samples);
 
+    // Erases the key of 'entry', returns the bytes freed by it.
+    size_t EraseKey(MTSHashTable::EntryPointer entry);
+
     DataStructureService* service_;
     MaxmemoryPolicy maxmemory_policy_;
     size_t maxmemory_;
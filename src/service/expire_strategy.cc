@@ -43,14 +43,12 @@ void ExpireStrategy::ActiveExpire() {
                 DataStructureService::ExpireHashTable::EntryPointer entry) {
                   assert(entry != nullptr);
                   ++sampled_this_iter;
-                  if (entry->value > now) {
+                  auto* data_entry = entry->KeyEntry();
+                  if (data_entry->GetExpire() > now) {
                       // TODO: Aggregate how long has it expired.
                       return;
                   }
-                  auto key_sv = entry->key->StringView();
-                  // TODO: Consolidate the erase method.
-                  service->DataTable()->Erase(key_sv);
-                  service->ExpireTable()->Erase(key_sv);
+                  service->EraseKey(data_entry);
                   ++expired_this_iter;
               });
 
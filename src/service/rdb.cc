@@ -0,0 +1,1131 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "rdb.h"
+
+#include "base/crc64.h"
+#include "base/lzf.h"
+#include "data_structure/hash_value.h"
+#include "data_structure/list_value.h"
+#include "data_structure/set_value.h"
+#include "data_structure/zset_value.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace rdss::rdb {
+
+namespace {
+
+constexpr std::string_view kMagic = "REDIS";
+constexpr uint32_t kMaxSupportedVersion = 12;
+// Same as the limit of Redis, which guards against allocating for corrupted lengths.
+constexpr uint64_t kMaxStringLength = 512 * 1024 * 1024;
+
+// Value types and opcodes.
+constexpr uint8_t kTypeString = 0;
+constexpr uint8_t kTypeList = 1;
+constexpr uint8_t kTypeSet = 2;
+constexpr uint8_t kTypeHash = 4;
+// Sorted set with binary scores, i.e. RDB_TYPE_ZSET_2.
+constexpr uint8_t kTypeZSet = 5;
+// Compact encodings, each stores the whole value in one string blob, or quicklists of blobs.
+constexpr uint8_t kTypeHashZipmap = 9;
+constexpr uint8_t kTypeListZiplist = 10;
+constexpr uint8_t kTypeSetIntset = 11;
+constexpr uint8_t kTypeZSetZiplist = 12;
+constexpr uint8_t kTypeHashZiplist = 13;
+constexpr uint8_t kTypeListQuicklist = 14;
+constexpr uint8_t kTypeHashListpack = 16;
+constexpr uint8_t kTypeZSetListpack = 17;
+constexpr uint8_t kTypeListQuicklist2 = 18;
+constexpr uint8_t kTypeSetListpack = 20;
+constexpr uint8_t kOpcodeFunction = 0xf5;
+constexpr uint8_t kOpcodeModuleAux = 0xf7;
+constexpr uint8_t kOpcodeIdle = 0xf8;
+constexpr uint8_t kOpcodeFreq = 0xf9;
+constexpr uint8_t kOpcodeAux = 0xfa;
+constexpr uint8_t kOpcodeResizeDb = 0xfb;
+constexpr uint8_t kOpcodeExpireTimeMs = 0xfc;
+constexpr uint8_t kOpcodeExpireTime = 0xfd;
+constexpr uint8_t kOpcodeSelectDb = 0xfe;
+constexpr uint8_t kOpcodeEof = 0xff;
+
+// The two most significant bits of the first byte of a length tell how the length is encoded. If
+// they are kEncoded, the string is specially encoded as an integer or LZF compressed.
+constexpr uint8_t k6BitLength = 0;
+constexpr uint8_t k14BitLength = 1;
+constexpr uint8_t k32BitLength = 0x80;
+constexpr uint8_t k64BitLength = 0x81;
+constexpr uint8_t kEncoded = 3;
+constexpr uint8_t kEncodingInt8 = 0;
+constexpr uint8_t kEncodingInt16 = 1;
+constexpr uint8_t kEncodingInt32 = 2;
+constexpr uint8_t kEncodingLzf = 3;
+
+// Containers of the nodes of a quicklist 2, a plain node is a single element.
+constexpr uint64_t kQuicklistNodePlain = 1;
+constexpr uint64_t kQuicklistNodePacked = 2;
+
+void AppendByte(std::string& out, uint8_t byte) { out.push_back(static_cast<char>(byte)); }
+
+template<typename T>
+void AppendLittleEndian(std::string& out, T value) {
+    auto u = static_cast<std::make_unsigned_t<T>>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        AppendByte(out, static_cast<uint8_t>(u >> (i * 8)));
+    }
+}
+
+template<typename T>
+void AppendBigEndian(std::string& out, T value) {
+    for (size_t i = sizeof(T); i > 0; --i) {
+        AppendByte(out, static_cast<uint8_t>(value >> ((i - 1) * 8)));
+    }
+}
+
+void AppendLength(std::string& out, uint64_t length) {
+    if (length < (1 << 6)) {
+        AppendByte(out, static_cast<uint8_t>((k6BitLength << 6) | length));
+    } else if (length < (1 << 14)) {
+        AppendByte(out, static_cast<uint8_t>((k14BitLength << 6) | (length >> 8)));
+        AppendByte(out, static_cast<uint8_t>(length));
+    } else if (length <= std::numeric_limits<uint32_t>::max()) {
+        AppendByte(out, k32BitLength);
+        AppendBigEndian(out, static_cast<uint32_t>(length));
+    } else {
+        AppendByte(out, k64BitLength);
+        AppendBigEndian(out, length);
+    }
+}
+
+void AppendString(std::string& out, std::string_view str) {
+    AppendLength(out, str.size());
+    out.append(str);
+}
+
+// Integers that fit in 32 bits are encoded in binary, others as their decimal strings.
+void AppendInt(std::string& out, int64_t value) {
+    const auto encoded = [&out](uint8_t encoding, auto v) {
+        AppendByte(out, static_cast<uint8_t>((kEncoded << 6) | encoding));
+        AppendLittleEndian(out, v);
+    };
+    if (value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max()) {
+        encoded(kEncodingInt8, static_cast<int8_t>(value));
+    } else if (
+      value >= std::numeric_limits<int16_t>::min()
+      && value <= std::numeric_limits<int16_t>::max()) {
+        encoded(kEncodingInt16, static_cast<int16_t>(value));
+    } else if (
+      value >= std::numeric_limits<int32_t>::min()
+      && value <= std::numeric_limits<int32_t>::max()) {
+        encoded(kEncodingInt32, static_cast<int32_t>(value));
+    } else {
+        StringValue::IntChars chars;
+        const auto res = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+        AppendString(out, {chars.data(), static_cast<size_t>(res.ptr - chars.data())});
+    }
+}
+
+template<typename T>
+T LoadLittleEndian(std::string_view bytes) {
+    std::make_unsigned_t<T> value{0};
+    for (size_t i = sizeof(T); i > 0; --i) {
+        value = static_cast<std::make_unsigned_t<T>>(
+          (value << 8) | static_cast<uint8_t>(bytes[i - 1]));
+    }
+    return static_cast<T>(value);
+}
+
+template<typename T>
+T LoadBigEndian(std::string_view bytes) {
+    T value{0};
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value = static_cast<T>((value << 8) | static_cast<uint8_t>(bytes[i]));
+    }
+    return value;
+}
+
+// Reader of the entries packed in a string blob, e.g. a listpack. Reading past the end returns
+// nullopt, so that a corrupted blob fails the load instead of reading out of bounds.
+class BlobReader {
+public:
+    explicit BlobReader(std::string_view blob)
+      : blob_(blob) {}
+
+    size_t Remaining() const { return blob_.size(); }
+
+    std::optional<uint8_t> PeekByte() const {
+        if (blob_.empty()) {
+            return std::nullopt;
+        }
+        return static_cast<uint8_t>(blob_[0]);
+    }
+
+    std::optional<std::string_view> Read(size_t n) {
+        if (blob_.size() < n) {
+            return std::nullopt;
+        }
+        const auto result = blob_.substr(0, n);
+        blob_.remove_prefix(n);
+        return result;
+    }
+
+    std::optional<uint8_t> ReadByte() {
+        const auto byte = PeekByte();
+        if (byte.has_value()) {
+            blob_.remove_prefix(1);
+        }
+        return byte;
+    }
+
+    template<typename T>
+    std::optional<T> ReadLittleEndian() {
+        const auto bytes = Read(sizeof(T));
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        return LoadLittleEndian<T>(bytes.value());
+    }
+
+    template<typename T>
+    std::optional<T> ReadBigEndian() {
+        const auto bytes = Read(sizeof(T));
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        return LoadBigEndian<T>(bytes.value());
+    }
+
+    // Reads a signed 24 bits little endian integer.
+    std::optional<int64_t> ReadInt24() {
+        const auto bytes = Read(3);
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        const auto u = static_cast<uint32_t>(LoadLittleEndian<uint16_t>(bytes.value()))
+                       | (static_cast<uint32_t>(static_cast<uint8_t>(bytes.value()[2])) << 16);
+        return static_cast<int32_t>(u << 8) >> 8;
+    }
+
+private:
+    std::string_view blob_;
+};
+
+// Reads an integer entry of 'size' bytes, which is 3 for a 24 bits one.
+std::optional<int64_t> ReadIntEntry(BlobReader& reader, size_t size) {
+    switch (size) {
+    case 1:
+        return reader.ReadLittleEndian<int8_t>();
+    case 2:
+        return reader.ReadLittleEndian<int16_t>();
+    case 3:
+        return reader.ReadInt24();
+    case 4:
+        return reader.ReadLittleEndian<int32_t>();
+    case 8:
+        return reader.ReadLittleEndian<int64_t>();
+    }
+    return std::nullopt;
+}
+
+// Appends the entries of 'ziplist', the compact list of Redis before 7.0, to 'out'. Each entry is
+// the length of the previous entry, followed by either a string or an integer, which is appended
+// as its decimal string. Returns false if it's corrupted.
+bool DecodeZiplist(std::string_view ziplist, std::vector<std::string>& out) {
+    constexpr uint8_t kEnd = 0xff;
+    constexpr uint8_t kBigPrevLength = 0xfe;
+    BlobReader reader(ziplist);
+    // Total bytes, offset of the last entry and number of entries.
+    const auto total_bytes = reader.ReadLittleEndian<uint32_t>();
+    if (!total_bytes.has_value() || total_bytes.value() != ziplist.size()
+        || !reader.Read(sizeof(uint32_t) + sizeof(uint16_t)).has_value()) {
+        return false;
+    }
+    while (true) {
+        const auto prev_length = reader.ReadByte();
+        if (!prev_length.has_value()) {
+            return false;
+        }
+        if (prev_length.value() == kEnd) {
+            return reader.Remaining() == 0;
+        }
+        if (prev_length.value() == kBigPrevLength && !reader.Read(sizeof(uint32_t)).has_value()) {
+            return false;
+        }
+        const auto encoding = reader.ReadByte();
+        if (!encoding.has_value()) {
+            return false;
+        }
+        // The two most significant bits tell the length of a string, or 11 for an integer.
+        std::optional<uint64_t> length;
+        switch (encoding.value() >> 6) {
+        case 0:
+            length = encoding.value() & 0x3fU;
+            break;
+        case 1: {
+            const auto next = reader.ReadByte();
+            if (next.has_value()) {
+                length = ((encoding.value() & 0x3fU) << 8) | next.value();
+            }
+            break;
+        }
+        case 2:
+            if (encoding.value() == 0x80) {
+                length = reader.ReadBigEndian<uint32_t>();
+            }
+            break;
+        }
+        if (length.has_value()) {
+            const auto str = reader.Read(length.value());
+            if (!str.has_value()) {
+                return false;
+            }
+            out.emplace_back(str.value());
+            continue;
+        }
+        if (encoding.value() >> 6 != 3) {
+            return false;
+        }
+
+        std::optional<int64_t> value;
+        switch (encoding.value()) {
+        case 0xc0:
+            value = ReadIntEntry(reader, 2);
+            break;
+        case 0xd0:
+            value = ReadIntEntry(reader, 4);
+            break;
+        case 0xe0:
+            value = ReadIntEntry(reader, 8);
+            break;
+        case 0xf0:
+            value = ReadIntEntry(reader, 3);
+            break;
+        case 0xfe:
+            value = ReadIntEntry(reader, 1);
+            break;
+        default:
+            // 1111xxxx is an immediate integer from 0 to 12, stored as xxxx - 1.
+            if (encoding.value() > 0xf0 && encoding.value() < 0xfe) {
+                value = (encoding.value() & 0x0f) - 1;
+            }
+        }
+        if (!value.has_value()) {
+            return false;
+        }
+        out.push_back(std::to_string(value.value()));
+    }
+}
+
+// Returns the bytes taken by the back length of a listpack entry of 'length' bytes, which stores 7
+// bits of it in each byte, the same thresholds as lpEncodeBacklen() of Redis.
+size_t ListpackBackLengthSize(size_t length) {
+    if (length <= 127) {
+        return 1;
+    }
+    if (length < 16383) {
+        return 2;
+    }
+    if (length < 2097151) {
+        return 3;
+    }
+    return length < 268435455 ? 4 : 5;
+}
+
+// Appends the entries of 'listpack', the compact list of Redis since 7.0, to 'out'. Each entry is
+// a string or an integer, followed by its length for traversing backwards. Integers are appended
+// as their decimal strings. Returns false if it's corrupted.
+bool DecodeListpack(std::string_view listpack, std::vector<std::string>& out) {
+    constexpr uint8_t kEnd = 0xff;
+    BlobReader reader(listpack);
+    // Total bytes and number of entries, which isn't needed as the end is marked.
+    const auto total_bytes = reader.ReadLittleEndian<uint32_t>();
+    if (!total_bytes.has_value() || total_bytes.value() != listpack.size()
+        || !reader.Read(sizeof(uint16_t)).has_value()) {
+        return false;
+    }
+    while (true) {
+        const auto encoding = reader.ReadByte();
+        if (!encoding.has_value()) {
+            return false;
+        }
+        if (encoding.value() == kEnd) {
+            return reader.Remaining() == 0;
+        }
+        const auto entry_begin = reader.Remaining() + 1;
+        std::optional<uint64_t> length;
+        std::optional<int64_t> value;
+        if ((encoding.value() & 0x80) == 0) {
+            // 0xxxxxxx, 7 bits unsigned integer.
+            value = encoding.value() & 0x7f;
+        } else if ((encoding.value() & 0xc0) == 0x80) {
+            // 10xxxxxx, string of 6 bits length.
+            length = encoding.value() & 0x3fU;
+        } else if ((encoding.value() & 0xe0) == 0xc0) {
+            // 110xxxxx yyyyyyyy, 13 bits signed integer.
+            const auto next = reader.ReadByte();
+            if (next.has_value()) {
+                const auto u = ((encoding.value() & 0x1fU) << 8) | next.value();
+                value = static_cast<int64_t>(u) - (u < (1U << 12) ? 0 : (1 << 13));
+            }
+        } else if ((encoding.value() & 0xf0) == 0xe0) {
+            // 1110xxxx yyyyyyyy, string of 12 bits length.
+            const auto next = reader.ReadByte();
+            if (next.has_value()) {
+                length = ((encoding.value() & 0x0fU) << 8) | next.value();
+            }
+        } else {
+            switch (encoding.value()) {
+            case 0xf0:
+                length = reader.ReadLittleEndian<uint32_t>();
+                break;
+            case 0xf1:
+                value = ReadIntEntry(reader, 2);
+                break;
+            case 0xf2:
+                value = ReadIntEntry(reader, 3);
+                break;
+            case 0xf3:
+                value = ReadIntEntry(reader, 4);
+                break;
+            case 0xf4:
+                value = ReadIntEntry(reader, 8);
+                break;
+            }
+        }
+        if (length.has_value()) {
+            const auto str = reader.Read(length.value());
+            if (!str.has_value()) {
+                return false;
+            }
+            out.emplace_back(str.value());
+        } else if (value.has_value()) {
+            out.push_back(std::to_string(value.value()));
+        } else {
+            return false;
+        }
+
+        if (!reader.Read(ListpackBackLengthSize(entry_begin - reader.Remaining())).has_value()) {
+            return false;
+        }
+    }
+}
+
+// Appends the members of 'intset', the sorted array of integers of the same size, to 'out' as
+// their decimal strings. Returns false if it's corrupted.
+bool DecodeIntset(std::string_view intset, std::vector<std::string>& out) {
+    BlobReader reader(intset);
+    const auto size = reader.ReadLittleEndian<uint32_t>();
+    const auto length = reader.ReadLittleEndian<uint32_t>();
+    if (!size.has_value() || !length.has_value()
+        || (size.value() != sizeof(int16_t) && size.value() != sizeof(int32_t)
+            && size.value() != sizeof(int64_t))
+        || reader.Remaining() != uint64_t{size.value()} * length.value()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < length.value(); ++i) {
+        out.push_back(std::to_string(ReadIntEntry(reader, size.value()).value()));
+    }
+    return true;
+}
+
+// Appends the fields and values of 'zipmap', the compact hash of Redis before 2.6, to 'out'.
+// Returns false if it's corrupted.
+bool DecodeZipmap(std::string_view zipmap, std::vector<std::string>& out) {
+    constexpr uint8_t kEnd = 0xff;
+    constexpr uint8_t kBigLength = 0xfe;
+    BlobReader reader(zipmap);
+    const auto read_length = [&reader]() -> std::optional<uint32_t> {
+        const auto length = reader.ReadByte();
+        if (!length.has_value() || length.value() < kBigLength) {
+            return length;
+        }
+        if (length.value() != kBigLength) {
+            return std::nullopt;
+        }
+        return reader.ReadLittleEndian<uint32_t>();
+    };
+    // The number of pairs, which isn't needed as the end is marked.
+    if (!reader.ReadByte().has_value()) {
+        return false;
+    }
+    while (true) {
+        const auto next = reader.PeekByte();
+        if (!next.has_value()) {
+            return false;
+        }
+        if (next.value() == kEnd) {
+            return reader.Remaining() == 1;
+        }
+        const auto field_length = read_length();
+        if (!field_length.has_value()) {
+            return false;
+        }
+        const auto field = reader.Read(field_length.value());
+        const auto value_length = read_length();
+        // The value is followed by the free bytes left by updating it in place.
+        const auto free = reader.ReadByte();
+        if (!field.has_value() || !value_length.has_value() || !free.has_value()) {
+            return false;
+        }
+        const auto value = reader.Read(value_length.value());
+        if (!value.has_value() || !reader.Read(free.value()).has_value()) {
+            return false;
+        }
+        out.emplace_back(field.value());
+        out.emplace_back(value.value());
+    }
+}
+
+// Buffered reader of the file, which also computes the checksum of the bytes read.
+class Reader {
+public:
+    explicit Reader(int fd)
+      : fd_(fd) {}
+
+    /// Returns the next 'n' bytes, which are valid until the next call, or nullopt if the file
+    /// ends before that.
+    std::optional<std::string_view> Read(size_t n) {
+        if (end_ - begin_ < n && !Fill(n)) {
+            return std::nullopt;
+        }
+        const std::string_view result{buffer_.data() + begin_, n};
+        begin_ += n;
+        crc_ = Crc64(crc_, result);
+        return result;
+    }
+
+    std::optional<uint8_t> ReadByte() {
+        auto bytes = Read(1);
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        return static_cast<uint8_t>(bytes.value()[0]);
+    }
+
+    template<typename T>
+    std::optional<T> ReadLittleEndian() {
+        auto bytes = Read(sizeof(T));
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        return LoadLittleEndian<T>(bytes.value());
+    }
+
+    template<typename T>
+    std::optional<T> ReadBigEndian() {
+        auto bytes = Read(sizeof(T));
+        if (!bytes.has_value()) {
+            return std::nullopt;
+        }
+        return LoadBigEndian<T>(bytes.value());
+    }
+
+    uint64_t Crc() const { return crc_; }
+
+private:
+    static constexpr size_t kReadSize = 1024 * 1024;
+
+    bool Fill(size_t n) {
+        buffer_.erase(0, begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (buffer_.size() < std::max(n, kReadSize)) {
+            buffer_.resize(std::max(n, kReadSize));
+        }
+        while (end_ < n) {
+            const auto bytes_read = read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+            if (bytes_read < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG(ERROR) << "read:" << strerror(errno);
+                return false;
+            }
+            if (bytes_read == 0) {
+                return false;
+            }
+            end_ += static_cast<size_t>(bytes_read);
+        }
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t begin_{0};
+    size_t end_{0};
+    uint64_t crc_{0};
+};
+
+class Loader {
+public:
+    Loader(int fd, const KeyValueHandler& handler)
+      : reader_(fd)
+      , handler_(handler) {}
+
+    bool Load() {
+        if (!LoadHeader()) {
+            return false;
+        }
+
+        uint64_t db{0};
+        std::optional<TimePoint> expire_time;
+        while (true) {
+            const auto type = reader_.ReadByte();
+            if (!type.has_value()) {
+                return Fail("Unexpected end of file");
+            }
+
+            switch (type.value()) {
+            case kOpcodeExpireTimeMs: {
+                const auto ms = reader_.ReadLittleEndian<int64_t>();
+                if (!ms.has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                expire_time = TimePoint{std::chrono::milliseconds{ms.value()}};
+                continue;
+            }
+            case kOpcodeExpireTime: {
+                const auto seconds = reader_.ReadLittleEndian<int32_t>();
+                if (!seconds.has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                expire_time = TimePoint{std::chrono::seconds{seconds.value()}};
+                continue;
+            }
+            case kOpcodeFreq:
+                if (!reader_.ReadByte().has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                continue;
+            case kOpcodeIdle:
+                if (!ReadLength().has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                continue;
+            case kOpcodeSelectDb: {
+                const auto selected = ReadLength();
+                if (!selected.has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                db = selected->first;
+                if (db != 0) {
+                    LOG(WARNING) << "Skipping the keys of db " << db;
+                }
+                continue;
+            }
+            case kOpcodeResizeDb:
+                if (!ReadLength().has_value() || !ReadLength().has_value()) {
+                    return Fail("Unexpected end of file");
+                }
+                continue;
+            case kOpcodeAux:
+                if (!ReadString(key_) || !ReadString(value_)) {
+                    return Fail("Unexpected end of file");
+                }
+                VLOG(1) << "RDB aux field " << key_ << ':' << value_;
+                continue;
+            case kOpcodeModuleAux:
+            case kOpcodeFunction:
+                return Fail("Modules and functions are not supported");
+            case kOpcodeEof:
+                return LoadChecksum();
+            case kTypeString:
+            case kTypeList:
+            case kTypeSet:
+            case kTypeHash:
+            case kTypeZSet:
+            case kTypeHashZipmap:
+            case kTypeListZiplist:
+            case kTypeSetIntset:
+            case kTypeZSetZiplist:
+            case kTypeHashZiplist:
+            case kTypeListQuicklist:
+            case kTypeHashListpack:
+            case kTypeZSetListpack:
+            case kTypeListQuicklist2:
+            case kTypeSetListpack:
+                break;
+            default:
+                return Fail("Unsupported value type " + std::to_string(type.value()));
+            }
+
+            if (!ReadString(key_)) {
+                return Fail("Unexpected end of file");
+            }
+            StringValue value;
+            if (!ReadValue(type.value(), value)) {
+                return Fail("Unexpected end of file or corrupted value of key " + key_);
+            }
+            if (db == 0) {
+                handler_(key_, std::move(value), expire_time);
+            }
+            expire_time.reset();
+        }
+    }
+
+private:
+    bool Fail(const std::string& reason) {
+        LOG(ERROR) << "Failed to load RDB file: " << reason;
+        return false;
+    }
+
+    bool LoadHeader() {
+        const auto header = reader_.Read(kMagic.size() + 4);
+        if (!header.has_value() || !header->starts_with(kMagic)) {
+            return Fail("Wrong signature");
+        }
+        uint32_t version{0};
+        const auto version_str = header->substr(kMagic.size());
+        const auto [ptr, ec] = std::from_chars(
+          version_str.data(), version_str.data() + version_str.size(), version);
+        if (ec != std::errc{} || version == 0 || version > kMaxSupportedVersion) {
+            return Fail("Unsupported version " + std::string(version_str));
+        }
+        version_ = version;
+        return true;
+    }
+
+    bool LoadChecksum() {
+        // The checksum is only there since version 5.
+        if (version_ < 5) {
+            return true;
+        }
+        const auto crc = reader_.Crc();
+        const auto expected = reader_.ReadLittleEndian<uint64_t>();
+        if (!expected.has_value()) {
+            return Fail("Unexpected end of file");
+        }
+        if (expected.value() == 0) {
+            LOG(WARNING) << "RDB file was saved with checksum disabled, no check performed.";
+            return true;
+        }
+        if (expected.value() != crc) {
+            return Fail("Wrong checksum");
+        }
+        return true;
+    }
+
+    // Returns {length, encoded}. If 'encoded' is true, 'length' is the special encoding of a string.
+    std::optional<std::pair<uint64_t, bool>> ReadLength() {
+        const auto first = reader_.ReadByte();
+        if (!first.has_value()) {
+            return std::nullopt;
+        }
+        switch (first.value() >> 6) {
+        case k6BitLength:
+            return std::make_pair(first.value() & 0x3fU, false);
+        case k14BitLength: {
+            const auto second = reader_.ReadByte();
+            if (!second.has_value()) {
+                return std::nullopt;
+            }
+            return std::make_pair(((first.value() & 0x3fU) << 8) | second.value(), false);
+        }
+        case kEncoded:
+            return std::make_pair(first.value() & 0x3fU, true);
+        }
+        if (first.value() == k32BitLength) {
+            const auto length = reader_.ReadBigEndian<uint32_t>();
+            if (!length.has_value()) {
+                return std::nullopt;
+            }
+            return std::make_pair(length.value(), false);
+        }
+        if (first.value() == k64BitLength) {
+            const auto length = reader_.ReadBigEndian<uint64_t>();
+            if (!length.has_value()) {
+                return std::nullopt;
+            }
+            return std::make_pair(length.value(), false);
+        }
+        return std::nullopt;
+    }
+
+    // Reads the value of 'type' into 'out'.
+    bool ReadValue(uint8_t type, StringValue& out) {
+        elements_.clear();
+        switch (type) {
+        case kTypeString:
+            if (!ReadString(value_)) {
+                return false;
+            }
+            out = StringValue(std::string_view(value_));
+            return true;
+        case kTypeList:
+            return ReadList(out);
+        case kTypeSet:
+            return ReadSet(out);
+        case kTypeHash:
+            return ReadHash(out);
+        case kTypeZSet:
+            return ReadZSet(out);
+        case kTypeHashZipmap:
+            return ReadBlob(DecodeZipmap) && BuildHash(out);
+        case kTypeListZiplist:
+            return ReadBlob(DecodeZiplist) && BuildList(out);
+        case kTypeSetIntset:
+            return ReadBlob(DecodeIntset) && BuildSet(out);
+        case kTypeZSetZiplist:
+            return ReadBlob(DecodeZiplist) && BuildZSet(out);
+        case kTypeHashZiplist:
+            return ReadBlob(DecodeZiplist) && BuildHash(out);
+        case kTypeListQuicklist:
+        case kTypeListQuicklist2:
+            return ReadQuicklist(type == kTypeListQuicklist2) && BuildList(out);
+        case kTypeHashListpack:
+            return ReadBlob(DecodeListpack) && BuildHash(out);
+        case kTypeZSetListpack:
+            return ReadBlob(DecodeListpack) && BuildZSet(out);
+        case kTypeSetListpack:
+            return ReadBlob(DecodeListpack) && BuildSet(out);
+        }
+        return false;
+    }
+
+    // Reads a string blob and appends its entries decoded by 'decode' to 'elements_'.
+    bool ReadBlob(bool (*decode)(std::string_view, std::vector<std::string>&)) {
+        return ReadString(blob_) && decode(blob_, elements_);
+    }
+
+    // Reads the nodes of a quicklist into 'elements_'. Each node is a ziplist, or in version 2, a
+    // listpack or a plain node of a single element, preceded by its container type.
+    bool ReadQuicklist(bool version2) {
+        const auto length = ReadLength();
+        if (!length.has_value() || length->second) {
+            return false;
+        }
+        for (uint64_t i = 0; i < length->first; ++i) {
+            if (!version2) {
+                if (!ReadBlob(DecodeZiplist)) {
+                    return false;
+                }
+                continue;
+            }
+            const auto container = ReadLength();
+            if (!container.has_value() || container->second) {
+                return false;
+            }
+            if (container->first == kQuicklistNodePlain) {
+                if (!ReadString(value_)) {
+                    return false;
+                }
+                elements_.push_back(value_);
+            } else if (container->first != kQuicklistNodePacked || !ReadBlob(DecodeListpack)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Builds the value of a compact encoding from the decoded 'elements_'. Like the other types,
+    // they're encoded with the default limits.
+    bool BuildList(StringValue& out) {
+        out = StringValue::CreateList();
+        const ListValue::Limits limits;
+        for (const auto& element : elements_) {
+            out.List().PushBack(element, limits);
+        }
+        return true;
+    }
+
+    bool BuildSet(StringValue& out) {
+        out = StringValue::CreateSet();
+        const SetValue::Limits limits;
+        for (const auto& member : elements_) {
+            out.Set().Add(member, limits);
+        }
+        return true;
+    }
+
+    // The fields and values alternate.
+    bool BuildHash(StringValue& out) {
+        if (elements_.size() % 2 != 0) {
+            return false;
+        }
+        out = StringValue::CreateHash();
+        const HashValue::Limits limits;
+        for (size_t i = 0; i < elements_.size(); i += 2) {
+            out.Hash().Set(elements_[i], elements_[i + 1], limits);
+        }
+        return true;
+    }
+
+    // The members and scores alternate, a score is the decimal string of a double.
+    bool BuildZSet(StringValue& out) {
+        if (elements_.size() % 2 != 0) {
+            return false;
+        }
+        out = StringValue::CreateZSet();
+        for (size_t i = 0; i < elements_.size(); i += 2) {
+            const auto& str = elements_[i + 1];
+            double score;
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), score);
+            if (ec != std::errc{} || ptr != str.data() + str.size() || std::isnan(score)) {
+                return false;
+            }
+            out.ZSet().Set(elements_[i], score);
+        }
+        return true;
+    }
+
+    // Reads the fields of a hash, which is the number of fields followed by the field-value pairs.
+    // It's encoded with the default limits, as the config isn't known here.
+    bool ReadHash(StringValue& out) {
+        const auto length = ReadLength();
+        if (!length.has_value() || length->second) {
+            return false;
+        }
+        out = StringValue::CreateHash();
+        auto& hash = out.Hash();
+        const HashValue::Limits limits;
+        for (uint64_t i = 0; i < length->first; ++i) {
+            if (!ReadString(field_) || !ReadString(value_)) {
+                return false;
+            }
+            hash.Set(field_, value_, limits);
+        }
+        return true;
+    }
+
+    // Reads the elements of a list, which is the number of elements followed by the elements. Like
+    // hashes, it's encoded with the default limits.
+    bool ReadList(StringValue& out) {
+        const auto length = ReadLength();
+        if (!length.has_value() || length->second) {
+            return false;
+        }
+        out = StringValue::CreateList();
+        auto& list = out.List();
+        const ListValue::Limits limits;
+        for (uint64_t i = 0; i < length->first; ++i) {
+            if (!ReadString(value_)) {
+                return false;
+            }
+            list.PushBack(value_, limits);
+        }
+        return true;
+    }
+
+    // Reads the members of a set, which is the number of members followed by the members.
+    bool ReadSet(StringValue& out) {
+        const auto length = ReadLength();
+        if (!length.has_value() || length->second) {
+            return false;
+        }
+        out = StringValue::CreateSet();
+        auto& set = out.Set();
+        const SetValue::Limits limits;
+        for (uint64_t i = 0; i < length->first; ++i) {
+            if (!ReadString(value_)) {
+                return false;
+            }
+            set.Add(value_, limits);
+        }
+        return true;
+    }
+
+    // Reads the members of a sorted set, which is the number of members followed by each member
+    // and its score as a little endian double.
+    bool ReadZSet(StringValue& out) {
+        const auto length = ReadLength();
+        if (!length.has_value() || length->second) {
+            return false;
+        }
+        out = StringValue::CreateZSet();
+        auto& zset = out.ZSet();
+        for (uint64_t i = 0; i < length->first; ++i) {
+            if (!ReadString(value_)) {
+                return false;
+            }
+            const auto bits = reader_.ReadLittleEndian<uint64_t>();
+            if (!bits.has_value()) {
+                return false;
+            }
+            const auto score = std::bit_cast<double>(bits.value());
+            if (std::isnan(score)) {
+                return false;
+            }
+            zset.Set(value_, score);
+        }
+        return true;
+    }
+
+    bool ReadString(std::string& out) {
+        const auto length = ReadLength();
+        if (!length.has_value()) {
+            return false;
+        }
+        const auto [len, encoded] = length.value();
+        if (!encoded) {
+            if (len > kMaxStringLength) {
+                return false;
+            }
+            auto bytes = reader_.Read(len);
+            if (!bytes.has_value()) {
+                return false;
+            }
+            out.assign(bytes.value());
+            return true;
+        }
+
+        std::optional<int64_t> value;
+        switch (len) {
+        case kEncodingInt8:
+            value = reader_.ReadLittleEndian<int8_t>();
+            break;
+        case kEncodingInt16:
+            value = reader_.ReadLittleEndian<int16_t>();
+            break;
+        case kEncodingInt32:
+            value = reader_.ReadLittleEndian<int32_t>();
+            break;
+        case kEncodingLzf:
+            return ReadLzfString(out);
+        default:
+            return false;
+        }
+        if (!value.has_value()) {
+            return false;
+        }
+        out.assign(std::to_string(value.value()));
+        return true;
+    }
+
+    bool ReadLzfString(std::string& out) {
+        const auto compressed_length = ReadLength();
+        const auto length = ReadLength();
+        if (!compressed_length.has_value() || !length.has_value()
+            || compressed_length->first > kMaxStringLength || length->first > kMaxStringLength) {
+            return false;
+        }
+        auto compressed = reader_.Read(compressed_length->first);
+        if (!compressed.has_value()) {
+            return false;
+        }
+        out.resize(length->first);
+        return LzfDecompress(compressed.value(), out.data(), out.size()) == out.size();
+    }
+
+    Reader reader_;
+    const KeyValueHandler& handler_;
+    uint32_t version_{0};
+    // Reused over the key value pairs.
+    std::string key_;
+    std::string field_;
+    std::string value_;
+    std::string blob_;
+    // Entries decoded from the blobs of a compact encoding.
+    std::vector<std::string> elements_;
+};
+
+} // namespace
+
+void AppendHeader(std::string& out, uint64_t keys, uint64_t expires) {
+    out.append(kMagic);
+    const auto version = std::to_string(kVersion);
+    out.append(4 - version.size(), '0');
+    out.append(version);
+
+    AppendByte(out, kOpcodeAux);
+    AppendString(out, "redis-bits");
+    AppendInt(out, sizeof(void*) * 8);
+    AppendByte(out, kOpcodeAux);
+    AppendString(out, "ctime");
+    AppendInt(
+      out,
+      std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch())
+        .count());
+
+    AppendByte(out, kOpcodeSelectDb);
+    AppendLength(out, 0);
+    AppendByte(out, kOpcodeResizeDb);
+    AppendLength(out, keys);
+    AppendLength(out, expires);
+}
+
+void AppendKeyValue(
+  std::string& out,
+  std::string_view key,
+  const StringValue& value,
+  std::optional<TimePoint> expire_time) {
+    if (expire_time.has_value()) {
+        AppendByte(out, kOpcodeExpireTimeMs);
+        AppendLittleEndian(out, static_cast<int64_t>(expire_time->time_since_epoch().count()));
+    }
+    if (value.IsHash()) {
+        const auto& hash = value.Hash();
+        AppendByte(out, kTypeHash);
+        AppendString(out, key);
+        AppendLength(out, hash.Size());
+        hash.ForEach([&out](std::string_view field, std::string_view field_value) {
+            AppendString(out, field);
+            AppendString(out, field_value);
+        });
+        return;
+    }
+    if (value.IsList()) {
+        const auto& list = value.List();
+        AppendByte(out, kTypeList);
+        AppendString(out, key);
+        AppendLength(out, list.Size());
+        list.ForEach([&out](std::string_view element) { AppendString(out, element); });
+        return;
+    }
+    if (value.IsSet()) {
+        const auto& set = value.Set();
+        AppendByte(out, kTypeSet);
+        AppendString(out, key);
+        AppendLength(out, set.Size());
+        set.ForEach([&out](std::string_view member) { AppendString(out, member); });
+        return;
+    }
+    if (value.IsZSet()) {
+        const auto& zset = value.ZSet();
+        AppendByte(out, kTypeZSet);
+        AppendString(out, key);
+        AppendLength(out, zset.Size());
+        zset.ForEach([&out](std::string_view member, double score) {
+            AppendString(out, member);
+            AppendLittleEndian(out, std::bit_cast<uint64_t>(score));
+        });
+        return;
+    }
+    AppendByte(out, kTypeString);
+    AppendString(out, key);
+    if (value.GetEncoding() == StringValue::Encoding::kInt) {
+        AppendInt(out, value.Int());
+        return;
+    }
+    StringValue::IntChars chars;
+    AppendString(out, value.View(chars));
+}
+
+std::string Footer(uint64_t crc) {
+    std::string footer;
+    AppendByte(footer, kOpcodeEof);
+    AppendLittleEndian(footer, Crc64(crc, footer));
+    return footer;
+}
+
+bool Load(const std::string& path, const KeyValueHandler& handler) {
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "open " << path << ':' << strerror(errno);
+        return false;
+    }
+    const auto loaded = Loader(fd, handler).Load();
+    close(fd);
+    return loaded;
+}
+
+} // namespace rdss::rdb
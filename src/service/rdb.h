@@ -0,0 +1,45 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "data_structure/tracking_hash_table.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/// Encoding and decoding of the RDB file format of Redis. Files are written in version 9, which
+/// Redis 5.0 and later can load. Files written by Redis can be loaded, including the compact
+/// encodings, i.e. zipmap, ziplist, intset, quicklist and listpack, as long as they contain no
+/// streams or module values.
+namespace rdss::rdb {
+
+using TimePoint = MTSHashTable::EntryType::ExpireTimePoint;
+
+inline constexpr uint32_t kVersion = 9;
+
+/// Appends the magic string, the version and the auxiliary fields, followed by the selection of db
+/// 0 whose sizes are hinted by 'keys' and 'expires'.
+void AppendHeader(std::string& out, uint64_t keys, uint64_t expires);
+
+/// Appends a string key value pair, preceded by 'expire_time' if it has value.
+void AppendKeyValue(
+  std::string& out,
+  std::string_view key,
+  const StringValue& value,
+  std::optional<TimePoint> expire_time);
+
+/// Returns the end of file mark followed by the checksum, 'crc' is the checksum of all the bytes
+/// before the mark.
+std::string Footer(uint64_t crc);
+
+using KeyValueHandler = std::function<void(
+  std::string_view key, StringValue value, std::optional<TimePoint> expire_time)>;
+
+/// Reads the RDB file at 'path' and calls 'handler' with every key value pair of db 0, keys of
+/// other dbs are skipped. Returns false and logs the reason if the file can't be read, is corrupted,
+/// or has values of unsupported types.
+bool Load(const std::string& path, const KeyValueHandler& handler);
+
+} // namespace rdss::rdb
@@ -0,0 +1,222 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "service/sharding.h"
+
+#include "service/data_structure_service.h"
+
+#include <cassert>
+#include <xxhash.h>
+
+namespace rdss {
+
+using ShardPolicy = Command::ShardPolicy;
+
+size_t KeyToShard(std::string_view key, size_t num_shards) {
+    if (num_shards == 1) {
+        return 0;
+    }
+
+    if (const auto open = key.find('{'); open != std::string_view::npos) {
+        const auto close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close != open + 1) {
+            key = key.substr(open + 1, close - open - 1);
+        }
+    }
+
+    // Uses the high 32 bits of the hash since the low bits are used by the hash tables of the
+    // shards to locate buckets.
+    const auto hash = XXH64(key.data(), key.size(), 0) >> 32;
+    return static_cast<size_t>((hash * num_shards) >> 32);
+}
+
+ShardedBatch::ShardedBatch(const DataShards* shards)
+  : shards_(shards)
+  , shard_parts_(shards->size())
+  , shard_to_part_(shards->size(), -1) {
+    assert(!shards->empty());
+}
+
+void ShardedBatch::Add(Args args, Result* result) {
+    assert(!args.empty());
+    const auto num_shards = shards_->size();
+    const auto* command = shards_->front().service->FindCommand(args[0]);
+    // Unknown command is replied by the service.
+    if (num_shards == 1 || command == nullptr) {
+        AddPart(0, args, result);
+        return;
+    }
+
+    const auto policy = command->GetShardPolicy();
+    if (policy == ShardPolicy::kBroadcastSum) {
+        splits_.push_back(Split{
+          .result = result,
+          .policy = policy,
+          .first_part = num_split_parts_,
+          .num_parts = num_shards,
+          .first_key = 0,
+          .num_keys = 0});
+        for (size_t shard = 0; shard < num_shards; ++shard) {
+            AddPart(shard, args, NewPart().second);
+        }
+        return;
+    }
+
+    const auto& spec = command->GetKeySpec();
+    const auto num_args = static_cast<int32_t>(args.size());
+    if (spec.first == 0 || spec.first >= num_args) {
+        AddPart(0, args, result);
+        return;
+    }
+
+    const auto last = spec.Last(args);
+    key_shards_.clear();
+    bool single_shard{true};
+    int32_t key = spec.first;
+    for (; key <= last; key += spec.step) {
+        key_shards_.push_back(KeyToShard(args[static_cast<size_t>(key)], num_shards));
+        single_shard = single_shard && key_shards_.back() == key_shards_.front();
+    }
+    // 'key' is now the end of the last key group. A malformed query whose last key group doesn't
+    // have enough arguments is not split, the handler will reply the error.
+    const auto keys_end = key;
+    if (single_shard || keys_end > num_args) {
+        AddPart(key_shards_.front(), args, result);
+        return;
+    }
+    if (policy == ShardPolicy::kSingle) {
+        result->SetError(Error::kCrossShard);
+        return;
+    }
+
+    // Splits the keys by shard, each part is: the command strings before the first key, the key
+    // groups of the shard, and the command strings after the last key group.
+    const auto key_args = [&](int32_t begin, int32_t end) {
+        return args.subspan(static_cast<size_t>(begin), static_cast<size_t>(end - begin));
+    };
+    Split split{
+      .result = result,
+      .policy = policy,
+      .first_part = num_split_parts_,
+      .num_parts = 0,
+      .first_key = key_parts_.size(),
+      .num_keys = key_shards_.size()};
+    key = spec.first;
+    for (const auto shard : key_shards_) {
+        auto& part = shard_to_part_[shard];
+        if (part == -1) {
+            part = static_cast<int32_t>(split.num_parts++);
+            auto* part_args = NewPart().first;
+            const auto prefix = key_args(0, spec.first);
+            part_args->assign(prefix.begin(), prefix.end());
+        }
+        const auto group = key_args(key, key + spec.step);
+        auto& part_args = split_args_[split.first_part + static_cast<size_t>(part)];
+        part_args.insert(part_args.end(), group.begin(), group.end());
+        key_parts_.push_back(static_cast<uint32_t>(part));
+        key += spec.step;
+    }
+    const auto suffix = key_args(keys_end, num_args);
+    for (size_t shard = 0; shard < num_shards; ++shard) {
+        auto& part = shard_to_part_[shard];
+        if (part == -1) {
+            continue;
+        }
+        const auto index = split.first_part + static_cast<size_t>(part);
+        auto& part_args = split_args_[index];
+        part_args.insert(part_args.end(), suffix.begin(), suffix.end());
+        AddPart(shard, Args(part_args), &split_results_[index]);
+        part = -1;
+    }
+    splits_.push_back(split);
+}
+
+const std::vector<size_t>& ShardedBatch::InvolvedShards() {
+    involved_shards_.clear();
+    for (size_t shard = 0; shard < shard_parts_.size(); ++shard) {
+        if (!shard_parts_[shard].empty()) {
+            involved_shards_.push_back(shard);
+        }
+    }
+    return involved_shards_;
+}
+
+void ShardedBatch::Execute(size_t shard) {
+    auto* service = (*shards_)[shard].service;
+    for (auto& part : shard_parts_[shard]) {
+        service->Invoke(part.args, *part.result);
+    }
+}
+
+void ShardedBatch::Finish() {
+    for (const auto& split : splits_) {
+        Merge(split);
+    }
+    splits_.clear();
+    key_parts_.clear();
+    for (auto& parts : shard_parts_) {
+        parts.clear();
+    }
+    num_parts_ = 0;
+    num_split_parts_ = 0;
+}
+
+void ShardedBatch::AddPart(size_t shard, Args args, Result* result) {
+    shard_parts_[shard].push_back(Part{.args = args, .result = result});
+    ++num_parts_;
+}
+
+std::pair<StringViews*, Result*> ShardedBatch::NewPart() {
+    if (num_split_parts_ == split_args_.size()) {
+        split_args_.emplace_back();
+        split_results_.emplace_back();
+    }
+    auto* args = &split_args_[num_split_parts_];
+    auto* result = &split_results_[num_split_parts_];
+    ++num_split_parts_;
+    args->clear();
+    result->Reset();
+    return {args, result};
+}
+
+void ShardedBatch::Merge(const Split& split) {
+    const auto part_result = [&](size_t part) -> Result& {
+        return split_results_[split.first_part + part];
+    };
+    for (size_t part = 0; part < split.num_parts; ++part) {
+        if (part_result(part).type == Result::Type::kError) {
+            split.result->SetError(part_result(part).error);
+            return;
+        }
+    }
+
+    switch (split.policy) {
+    case ShardPolicy::kSplitSum:
+    case ShardPolicy::kBroadcastSum: {
+        int64_t sum{0};
+        for (size_t part = 0; part < split.num_parts; ++part) {
+            assert(part_result(part).type == Result::Type::kInt);
+            sum += part_result(part).int_value;
+        }
+        split.result->SetInt(sum);
+        break;
+    }
+    case ShardPolicy::kSplitOk:
+        split.result->SetOk();
+        break;
+    case ShardPolicy::kSplitConcat: {
+        part_cursors_.assign(split.num_parts, 0);
+        for (size_t i = 0; i < split.num_keys; ++i) {
+            const auto part = key_parts_[split.first_key + i];
+            auto& strings = part_result(part).strings;
+            assert(part_cursors_[part] < strings.size());
+            split.result->AddString(std::move(strings[part_cursors_[part]++]));
+        }
+        break;
+    }
+    case ShardPolicy::kSingle:
+        assert(false);
+        break;
+    }
+}
+
+} // namespace rdss
@@ -0,0 +1,107 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "resp/resp_parser.h"
+#include "service/command.h"
+
+#include <deque>
+#include <string_view>
+#include <vector>
+
+namespace rdss {
+
+class DataStructureService;
+class RingExecutor;
+
+/// A shard of the keyspace. 'service' owns the data of the shard, it should only be accessed on
+/// 'executor'.
+struct DataShard {
+    RingExecutor* executor;
+    DataStructureService* service;
+};
+
+using DataShards = std::vector<DataShard>;
+
+/// Returns the index of the shard that 'key' belongs to. If 'key' contains a hash tag, that is a
+/// non-empty substring between the first '{' and the first '}' after it, only the hash tag is
+/// hashed, so that keys sharing the same hash tag belong to the same shard.
+size_t KeyToShard(std::string_view key, size_t num_shards);
+
+/// Routes a batch of queries to the shards owning their keys. A query is executed as a whole on
+/// one shard if all its keys belong to that shard, keyless queries go to shard 0. Otherwise,
+/// according to the command's 'ShardPolicy', the query is either rejected, or split into parts
+/// that each contains the keys of one shard, whose results are merged after all the parts are
+/// executed.
+/// Usage:
+///     batch.Add(args, &result); ...
+///     for (auto shard : batch.InvolvedShards()) {
+///         co_await ResumeOn(shards[shard].executor);
+///         batch.Execute(shard);
+///     }
+///     batch.Finish();
+class ShardedBatch {
+public:
+    explicit ShardedBatch(const DataShards* shards);
+
+    /// Adds a query to the batch, its reply is stored into 'result' after Finish(). 'args' and
+    /// 'result' should stay valid until Finish().
+    void Add(Args args, Result* result);
+
+    /// Returns indexes of the shards that have queries to execute, in ascending order.
+    const std::vector<size_t>& InvolvedShards();
+
+    /// Executes the queries routed to 'shard' in the order they are added. Should be called on the
+    /// shard's executor.
+    void Execute(size_t shard);
+
+    /// Merges the results of the split queries, and resets the batch for reuse.
+    void Finish();
+
+    bool Empty() const { return num_parts_ == 0; }
+
+private:
+    struct Part {
+        Args args;
+        Result* result;
+    };
+
+    struct Split {
+        Result* result;
+        Command::ShardPolicy policy;
+        // Parts of this split are 'split_results_[first_part, first_part + num_parts)'.
+        size_t first_part;
+        size_t num_parts;
+        // For kSplitConcat, 'key_parts_[first_key, first_key + num_keys)' are the parts of the
+        // keys in their original order, relative to 'first_part'.
+        size_t first_key;
+        size_t num_keys;
+    };
+
+    void AddPart(size_t shard, Args args, Result* result);
+
+    // Returns a cleared argument vector and a reset result for a new part.
+    std::pair<StringViews*, Result*> NewPart();
+
+    void Merge(const Split& split);
+
+    const DataShards* shards_;
+    std::vector<std::vector<Part>> shard_parts_;
+    std::vector<size_t> involved_shards_;
+    size_t num_parts_{0};
+
+    std::vector<Split> splits_;
+    // Storage of the parts of split queries, deque keeps the references stable while growing.
+    // They are reused over batches, the first 'num_split_parts_' are in use.
+    std::deque<StringViews> split_args_;
+    std::deque<Result> split_results_;
+    size_t num_split_parts_{0};
+    std::vector<uint32_t> key_parts_;
+
+    // Scratch space of Add() and Merge().
+    std::vector<size_t> key_shards_;
+    std::vector<int32_t> shard_to_part_;
+    std::vector<size_t> part_cursors_;
+};
+
+} // namespace rdss
@@ -0,0 +1,353 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#include "snapshot.h"
+
+#include "base/crc64.h"
+#include "data_structure_service.h"
+#include "rdb.h"
+#include "runtime/ring_executor.h"
+
+#include <glog/logging.h>
+
+#include <cassert>
+#include <cstdio>
+#include <future>
+#include <unistd.h>
+#include <utility>
+
+namespace rdss {
+
+namespace {
+
+int64_t UnixTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t ToMicroseconds(std::chrono::steady_clock::duration duration) {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+} // namespace
+
+Snapshotter::Snapshotter(const DataShards* shards, RingExecutor* executor, std::string path)
+  : shards_(shards)
+  , executor_(executor)
+  , path_(std::move(path))
+  , temp_path_(path_ + ".tmp")
+  , progress_(std::make_unique<ShardProgress[]>(shards_->size())) {}
+
+bool Snapshotter::StartBackgroundSave() { return Start(nullptr); }
+
+bool Snapshotter::StartSave(DataStructureService* service, std::function<void(bool)> on_end) {
+    RingExecutor* executor{nullptr};
+    for (const auto& shard : *shards_) {
+        if (shard.service == service) {
+            executor = shard.executor;
+        }
+    }
+    assert(executor != nullptr);
+    return Start([executor, on_end = std::move(on_end)](bool ok) {
+        executor->Schedule([on_end, ok]() { on_end(ok); });
+    });
+}
+
+void Snapshotter::SaveSome(
+  DataStructureService* service, std::chrono::steady_clock::duration time_limit) {
+    auto& progress = GetProgress(service);
+    if (!progress.saving.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    auto* table = service->DataTable();
+    const auto start = std::chrono::steady_clock::now();
+    const auto save_entry = [&progress, service](MTSHashTable::EntryPointer entry) {
+        if (service->IsExpired(entry)) {
+            return;
+        }
+        rdb::AppendKeyValue(
+          progress.chunk,
+          entry->Key(),
+          entry->value,
+          (entry->HasExpire() ? std::optional(entry->GetExpire()) : std::nullopt));
+        ++progress.keys;
+    };
+
+    bool finished{false};
+    for (size_t buckets = 1;; ++buckets) {
+        if (queued_bytes_.load(std::memory_order_relaxed) > kMaxQueuedBytes) {
+            break;
+        }
+        progress.cursor = table->TraverseBucket(progress.cursor, save_entry);
+        if (progress.cursor == 0) {
+            finished = true;
+            break;
+        }
+        if (progress.chunk.size() >= kChunkSize) {
+            SendChunk(progress, false);
+        }
+        if (
+          buckets % kBucketsPerCheck == 0
+          && std::chrono::steady_clock::now() - start >= time_limit) {
+            break;
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    progress.elapsed += elapsed;
+    progress.max_pause = std::max(progress.max_pause, elapsed);
+    if (finished) {
+        SendChunk(progress, true);
+        progress.saving.store(false, std::memory_order_release);
+    }
+}
+
+bool Snapshotter::Load() {
+    if (access(path_.c_str(), F_OK) != 0) {
+        LOG(INFO) << "No RDB file at " << path_;
+        return true;
+    }
+
+    LOG(INFO) << "Loading RDB file " << path_;
+    stats_.loading.store(true, std::memory_order_relaxed);
+    std::atomic<size_t> num_not_finished{shards_->size()};
+    std::atomic<bool> ok{true};
+    std::promise<void> load_promise;
+    auto load_future = load_promise.get_future();
+    for (size_t i = 0; i < shards_->size(); ++i) {
+        auto& shard = (*shards_)[i];
+        shard.executor->Schedule([this, i, &shard, &num_not_finished, &ok, &load_promise]() {
+            // Every shard reads the whole file, and keeps the keys belonging to it.
+            auto* service = shard.service;
+            const auto now = std::chrono::system_clock::now();
+            uint64_t keys{0};
+            const auto loaded = rdb::Load(
+              path_,
+              [&](
+                std::string_view key,
+                StringValue value,
+                std::optional<rdb::TimePoint> expire_time) {
+                  if (KeyToShard(key, shards_->size()) != i) {
+                      return;
+                  }
+                  if (expire_time.has_value() && expire_time.value() <= now) {
+                      return;
+                  }
+                  auto [entry, exists] = service->DataTable()->Upsert(key, std::move(value));
+                  if (exists) {
+                      service->Persist(entry);
+                  }
+                  if (expire_time.has_value()) {
+                      service->SetExpire(entry, expire_time.value());
+                  }
+                  entry->SetLRU(service->GetLRUClock());
+                  ++keys;
+              });
+            stats_.loaded_keys.fetch_add(keys, std::memory_order_relaxed);
+            if (!loaded) {
+                ok.store(false, std::memory_order_relaxed);
+            }
+            if (num_not_finished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                load_promise.set_value();
+            }
+        });
+    }
+    load_future.wait();
+    stats_.loading.store(false, std::memory_order_relaxed);
+    LOG(INFO) << "Loaded " << stats_.loaded_keys.load(std::memory_order_relaxed) << " keys.";
+    return ok.load(std::memory_order_relaxed);
+}
+
+bool Snapshotter::Start(std::function<void(bool)> on_end) {
+    bool expected{false};
+    if (!stats_.in_progress.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    stats_.current_save_start_time.store(UnixTime(), std::memory_order_relaxed);
+    executor_->Schedule([this, on_end = std::move(on_end)]() mutable { Begin(std::move(on_end)); });
+    return true;
+}
+
+Snapshotter::ShardProgress& Snapshotter::GetProgress(const DataStructureService* service) {
+    for (size_t i = 0; i < shards_->size(); ++i) {
+        if ((*shards_)[i].service == service) {
+            return progress_[i];
+        }
+    }
+    LOG(FATAL) << "Unknown data shard.";
+}
+
+void Snapshotter::SendChunk(ShardProgress& progress, bool last) {
+    ++progress.chunks;
+    queued_bytes_.fetch_add(progress.chunk.size(), std::memory_order_relaxed);
+    if (!last) {
+        executor_->Schedule(
+          [this, chunk = std::move(progress.chunk)]() mutable { OnChunk(std::move(chunk)); });
+        progress.chunk = std::string();
+        progress.chunk.reserve(kChunkSize);
+        return;
+    }
+    executor_->Schedule([this,
+                         chunk = std::move(progress.chunk),
+                         summary = ShardSummary{
+                           .chunks = progress.chunks,
+                           .keys = progress.keys,
+                           .elapsed = progress.elapsed,
+                           .max_pause = progress.max_pause}]() mutable {
+        OnChunk(std::move(chunk));
+        OnShardFinished(summary);
+    });
+    progress.chunk = std::string();
+}
+
+void Snapshotter::Begin(std::function<void(bool)> on_end) {
+    on_end_ = std::move(on_end);
+    const auto fd = open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG(ERROR) << "open " << temp_path_ << ':' << strerror(errno);
+        End(false);
+        return;
+    }
+    LOG(INFO) << "Saving RDB file " << path_;
+    file_ = std::make_unique<File>(fd, executor_);
+    footer_queued_ = false;
+    failed_ = false;
+    offset_ = 0;
+    crc_ = 0;
+    finished_shards_ = 0;
+    expected_chunks_ = 0;
+    received_chunks_ = 0;
+    keys_ = 0;
+    dss_time_ = {};
+    max_pause_ = {};
+    start_time_ = std::chrono::steady_clock::now();
+
+    // The sizes published at cron are only used as hints.
+    uint64_t keys{0};
+    uint64_t expires{0};
+    for (const auto& shard : *shards_) {
+        keys += shard.service->Stats().keys.load(std::memory_order_relaxed);
+        expires += shard.service->Stats().expires.load(std::memory_order_relaxed);
+    }
+    std::string header;
+    rdb::AppendHeader(header, keys, expires);
+    queued_bytes_.fetch_add(header.size(), std::memory_order_relaxed);
+    chunks_.push_back(std::move(header));
+
+    for (size_t i = 0; i < shards_->size(); ++i) {
+        auto& progress = progress_[i];
+        progress.cursor = 0;
+        progress.chunk.clear();
+        progress.chunk.reserve(kChunkSize);
+        progress.chunks = 0;
+        progress.keys = 0;
+        progress.elapsed = {};
+        progress.max_pause = {};
+        progress.saving.store(true, std::memory_order_release);
+    }
+    WriteLoop();
+}
+
+void Snapshotter::OnChunk(std::string chunk) {
+    ++received_chunks_;
+    if (!chunk.empty()) {
+        chunks_.push_back(std::move(chunk));
+    }
+    if (!writing_) {
+        WriteLoop();
+    }
+}
+
+void Snapshotter::OnShardFinished(ShardSummary summary) {
+    ++finished_shards_;
+    expected_chunks_ += summary.chunks;
+    keys_ += summary.keys;
+    dss_time_ += summary.elapsed;
+    max_pause_ = std::max(max_pause_, summary.max_pause);
+    if (!writing_) {
+        WriteLoop();
+    }
+}
+
+Task<void> Snapshotter::WriteLoop() {
+    writing_ = true;
+    while (true) {
+        while (!chunks_.empty()) {
+            auto chunk = std::move(chunks_.front());
+            chunks_.pop_front();
+            crc_ = Crc64(crc_, chunk);
+            std::string_view data{chunk};
+            while (!data.empty() && !failed_) {
+                auto [error, written] = co_await file_->Write(data, offset_);
+                if (error || written == 0) {
+                    LOG(ERROR) << "write " << temp_path_ << ':' << error.message();
+                    failed_ = true;
+                    break;
+                }
+                data.remove_prefix(written);
+                offset_ += written;
+            }
+            queued_bytes_.fetch_sub(chunk.size(), std::memory_order_relaxed);
+        }
+
+        // Chunks sent by a shard before its last one might arrive after it.
+        if (
+          footer_queued_ || finished_shards_ != shards_->size()
+          || received_chunks_ != expected_chunks_) {
+            break;
+        }
+        auto footer = rdb::Footer(crc_);
+        queued_bytes_.fetch_add(footer.size(), std::memory_order_relaxed);
+        chunks_.push_back(std::move(footer));
+        footer_queued_ = true;
+    }
+
+    if (footer_queued_ && chunks_.empty()) {
+        if (!failed_) {
+            auto [error, _] = co_await file_->Fsync();
+            if (error) {
+                LOG(ERROR) << "fsync " << temp_path_ << ':' << error.message();
+                failed_ = true;
+            }
+        }
+        file_.reset();
+        if (!failed_ && rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            LOG(ERROR) << "rename " << temp_path_ << ':' << strerror(errno);
+            failed_ = true;
+        }
+        if (failed_) {
+            unlink(temp_path_.c_str());
+        }
+        End(!failed_);
+    }
+    writing_ = false;
+}
+
+void Snapshotter::End(bool ok) {
+    const auto duration = std::chrono::steady_clock::now() - start_time_;
+    if (ok) {
+        LOG(INFO) << "Saved " << keys_ << " keys, " << offset_ << " bytes in "
+                  << ToMicroseconds(duration) << "us.";
+        stats_.last_save_time.store(UnixTime(), std::memory_order_relaxed);
+        stats_.last_save_keys.store(keys_, std::memory_order_relaxed);
+        stats_.last_save_bytes.store(offset_, std::memory_order_relaxed);
+        stats_.last_save_duration_us.store(ToMicroseconds(duration), std::memory_order_relaxed);
+        stats_.last_save_dss_time_us.store(ToMicroseconds(dss_time_), std::memory_order_relaxed);
+        stats_.last_save_max_pause_us.store(
+          ToMicroseconds(max_pause_), std::memory_order_relaxed);
+        stats_.saves.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        LOG(ERROR) << "Failed to save RDB file " << path_;
+    }
+    stats_.last_save_ok.store(ok, std::memory_order_relaxed);
+
+    auto on_end = std::exchange(on_end_, nullptr);
+    stats_.in_progress.store(false, std::memory_order_release);
+    if (on_end != nullptr) {
+        on_end(ok);
+    }
+}
+
+} // namespace rdss
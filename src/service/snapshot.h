@@ -0,0 +1,142 @@
+// Copyright (c) usurai.
+// Licensed under the MIT license.
+#pragma once
+
+#include "io/file.h"
+#include "io/promise.h"
+#include "service/sharding.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace rdss {
+
+class DataStructureService;
+class RingExecutor;
+
+struct SnapshotStats {
+    std::atomic<bool> in_progress{false};
+    std::atomic<bool> last_save_ok{true};
+    // Unix time in seconds.
+    std::atomic<int64_t> last_save_time{0};
+    std::atomic<int64_t> current_save_start_time{0};
+    std::atomic<uint64_t> saves{0};
+    std::atomic<uint64_t> last_save_keys{0};
+    std::atomic<uint64_t> last_save_bytes{0};
+    std::atomic<uint64_t> last_save_duration_us{0};
+    // Time spent by the data shards on serializing their tables in total, and the longest time of
+    // one cron, which is the longest that the save pauses the serving.
+    std::atomic<uint64_t> last_save_dss_time_us{0};
+    std::atomic<uint64_t> last_save_max_pause_us{0};
+    std::atomic<uint64_t> loaded_keys{0};
+    std::atomic<bool> loading{false};
+};
+
+/// Saves the keys of all the data shards into an RDB file without forking. Every shard traverses
+/// its data table with the reverse binary cursor of HashTable::TraverseBucket at its cron, for a
+/// limited time each, so that expanding the table in the middle doesn't make a key saved twice or
+/// missed. The serialized chunks are handed to 'executor', which writes them to a temporary file
+/// with io_uring, computes the checksum, and renames the file after all the shards finish.
+/// Since the shards keep serving during the save, the snapshot isn't point-in-time: a key is saved
+/// with its value when its bucket is traversed, and keys added or erased in the middle may or may
+/// not be saved.
+class Snapshotter {
+public:
+    // Size of the chunks handed from the shards to 'executor_'.
+    static constexpr size_t kChunkSize = 256 * 1024;
+    // The shards stop serializing until the writing catches up if more bytes are queued.
+    static constexpr size_t kMaxQueuedBytes = 64 * 1024 * 1024;
+    // Buckets to traverse between checks of the time limit.
+    static constexpr size_t kBucketsPerCheck = 64;
+
+    Snapshotter(const DataShards* shards, RingExecutor* executor, std::string path);
+
+    /// Starts to save in the background. Returns false if a save is in progress.
+    bool StartBackgroundSave();
+
+    /// Starts to save like StartBackgroundSave(), and calls 'on_end' on the executor of 'service'
+    /// with whether the file is written once the save ends. Returns false if a save is in progress.
+    bool StartSave(DataStructureService* service, std::function<void(bool)> on_end);
+
+    /// Serializes a part of the keys of 'service' for at most 'time_limit' if it's saving. This is
+    /// called at every cron of 'service'.
+    void SaveSome(DataStructureService* service, std::chrono::steady_clock::duration time_limit);
+
+    /// Loads the keys in the file into the shards that they belong to, and blocking waits until
+    /// finished. Every shard reads the file on its own executor. Returns true if there is no file.
+    /// This should be called before serving.
+    bool Load();
+
+    const SnapshotStats& Stats() const { return stats_; }
+
+private:
+    struct alignas(64) ShardProgress {
+        // Set when the file is ready, and cleared by the shard after it traverses its table.
+        std::atomic<bool> saving{false};
+        // Accessed by the shard only while 'saving'.
+        size_t cursor{0};
+        std::string chunk;
+        size_t chunks{0};
+        uint64_t keys{0};
+        std::chrono::steady_clock::duration elapsed{0};
+        std::chrono::steady_clock::duration max_pause{0};
+    };
+
+    struct ShardSummary {
+        size_t chunks;
+        uint64_t keys;
+        std::chrono::steady_clock::duration elapsed;
+        std::chrono::steady_clock::duration max_pause;
+    };
+
+    bool Start(std::function<void(bool)> on_end);
+
+    ShardProgress& GetProgress(const DataStructureService* service);
+
+    // Hands the chunk of 'progress' to 'executor_', with the summary of the shard if 'last'.
+    void SendChunk(ShardProgress& progress, bool last);
+
+    // Below are called on 'executor_'.
+
+    void Begin(std::function<void(bool)> on_end);
+
+    void OnChunk(std::string chunk);
+
+    void OnShardFinished(ShardSummary summary);
+
+    // Writes the queued chunks, and the end of the file after all the shards finish.
+    Task<void> WriteLoop();
+
+    void End(bool ok);
+
+    const DataShards* shards_;
+    RingExecutor* executor_;
+    const std::string path_;
+    const std::string temp_path_;
+    std::unique_ptr<ShardProgress[]> progress_;
+    std::atomic<size_t> queued_bytes_{0};
+    SnapshotStats stats_;
+
+    // States of the save in progress, only accessed on 'executor_'.
+    std::function<void(bool)> on_end_;
+    std::unique_ptr<File> file_;
+    std::deque<std::string> chunks_;
+    bool writing_{false};
+    bool footer_queued_{false};
+    bool failed_{false};
+    uint64_t offset_{0};
+    uint64_t crc_{0};
+    size_t finished_shards_{0};
+    size_t expected_chunks_{0};
+    size_t received_chunks_{0};
+    uint64_t keys_{0};
+    std::chrono::steady_clock::duration dss_time_{0};
+    std::chrono::steady_clock::duration max_pause_{0};
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+} // namespace rdss
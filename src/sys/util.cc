@@ -4,6 +4,7 @@
 
 #include <arpa/inet.h>
 #include <glog/logging.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
@@ -35,7 +36,7 @@ bool SetNofileLimit(uint32_t limit) {
     return (rlim.rlim_cur == limit && rlim.rlim_max == limit);
 }
 
-int CreateListeningSocket(uint16_t port) {
+int CreateListeningSocket(uint16_t port, bool reuse_port) {
     // socket
     auto sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (sock == -1) {
@@ -48,6 +49,10 @@ int CreateListeningSocket(uint16_t port) {
         LOG(ERROR) << "setsockopt" << strerror(errno);
         return 0;
     }
+    if (reuse_port && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int)) < 0) {
+        LOG(ERROR) << "setsockopt(SO_REUSEPORT): " << strerror(errno);
+        return 0;
+    }
 
     sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -71,6 +76,23 @@ int CreateListeningSocket(uint16_t port) {
     return sock;
 }
 
+bool AttachReuseportCpuSteering(int fd, uint32_t num_sockets) {
+    sock_filter code[] = {
+      // A = cpu
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      // A = A % num_sockets
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, num_sockets},
+      // return A
+      {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    sock_fprog prog{.len = sizeof(code) / sizeof(code[0]), .filter = code};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        LOG(ERROR) << "setsockopt(SO_ATTACH_REUSEPORT_CBPF): " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
 void SetThreadAffinity(std::vector<size_t> cpus) {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
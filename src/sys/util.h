@@ -9,7 +9,16 @@ namespace rdss {
 
 bool SetNofileLimit(uint32_t limit);
 
-int CreateListeningSocket(uint16_t port);
+/// Creates a non-blocking socket listening on 'port' of all the addresses, returns 0 on failure. If
+/// 'reuse_port' is true, sets SO_REUSEPORT so that more sockets can listen on the same port, and
+/// the kernel distributes the incoming connections among them.
+int CreateListeningSocket(uint16_t port, bool reuse_port = false);
+
+/// Attaches a classic BPF program to the SO_REUSEPORT group of 'fd', which has 'num_sockets'
+/// sockets, so that a connection goes to the socket of index 'cpu % num_sockets' in the group,
+/// where 'cpu' is the CPU receiving the connection's packets. The index is the order in which the
+/// sockets start listening.
+bool AttachReuseportCpuSteering(int fd, uint32_t num_sockets);
 
 void SetThreadAffinity(std::vector<size_t> cpus);
 
@@ -0,0 +1,103 @@
+#include "service/aof.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rdss::test {
+
+using Commands = std::vector<std::vector<std::string>>;
+
+std::string TempPath() { return testing::TempDir() + "aof_test.aof"; }
+
+void WriteFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+std::string Encode(const Commands& commands) {
+    std::string out;
+    for (const auto& command : commands) {
+        StringViews args(command.begin(), command.end());
+        aof::AppendCommand(out, Args(args));
+    }
+    return out;
+}
+
+aof::LoadResult LoadFile(const std::string& path, Commands& loaded) {
+    loaded.clear();
+    return aof::Load(path, [&loaded](Args args) {
+        loaded.emplace_back(args.begin(), args.end());
+        return true;
+    });
+}
+
+TEST(AofTest, appendCommand) {
+    EXPECT_EQ(
+      Encode({{"SET", "key", "value"}, {"DEL", ""}}),
+      "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n*2\r\n$3\r\nDEL\r\n$0\r\n\r\n");
+}
+
+TEST(AofTest, load) {
+    // Commands spanning the chunks of reading are parsed as a whole.
+    Commands commands;
+    for (size_t i = 0; i < 10000; ++i) {
+        commands.push_back({"SET", "key:" + std::to_string(i), std::string(i % 100, 'v')});
+    }
+    commands.push_back({"SET", "big", std::string(200 * 1024, 'b')});
+    commands.push_back({"DEL", "key:0", "key:1"});
+    const auto content = Encode(commands);
+    WriteFile(TempPath(), content);
+
+    Commands loaded;
+    const auto result = LoadFile(TempPath(), loaded);
+    EXPECT_EQ(result.status, aof::LoadStatus::kOk);
+    EXPECT_EQ(result.valid_size, content.size());
+    EXPECT_EQ(result.commands, commands.size());
+    EXPECT_EQ(loaded, commands);
+
+    // The handler stops the loading.
+    size_t handled{0};
+    const auto stopped = aof::Load(TempPath(), [&handled](Args) { return ++handled < 3; });
+    EXPECT_EQ(stopped.status, aof::LoadStatus::kError);
+    EXPECT_EQ(handled, 3);
+}
+
+TEST(AofTest, loadTruncated) {
+    const Commands commands{{"SET", "a", "1"}, {"SET", "b", "2"}};
+    const auto content = Encode(commands);
+    const auto partial = Encode({{"SET", "c", "3"}});
+
+    // Every prefix of the last command is cut off.
+    for (size_t i = 1; i < partial.size(); ++i) {
+        WriteFile(TempPath(), content + partial.substr(0, i));
+        Commands loaded;
+        const auto result = LoadFile(TempPath(), loaded);
+        EXPECT_EQ(result.status, aof::LoadStatus::kTruncated) << i;
+        EXPECT_EQ(result.valid_size, content.size()) << i;
+        EXPECT_EQ(loaded, commands) << i;
+    }
+}
+
+TEST(AofTest, loadError) {
+    Commands loaded;
+    WriteFile(TempPath(), Encode({{"SET", "a", "1"}}) + "SET b 2\r\n");
+    auto result = LoadFile(TempPath(), loaded);
+    EXPECT_EQ(result.status, aof::LoadStatus::kError);
+    EXPECT_EQ(loaded, Commands({{"SET", "a", "1"}}));
+
+    WriteFile(TempPath(), "*1\r\n$3\r\nSETX\r\n");
+    result = LoadFile(TempPath(), loaded);
+    EXPECT_EQ(result.status, aof::LoadStatus::kError);
+    EXPECT_TRUE(loaded.empty());
+
+    // A missing file is empty.
+    result = LoadFile(TempPath() + ".missing", loaded);
+    EXPECT_EQ(result.status, aof::LoadStatus::kOk);
+    EXPECT_EQ(result.valid_size, 0);
+    EXPECT_TRUE(loaded.empty());
+}
+
+} // namespace rdss::test
@@ -0,0 +1,40 @@
+#include "client_placement.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace rdss::test {
+
+using Load = ClientPlacement::Load;
+
+TEST(ClientPlacementTest, leastBusy) {
+    std::vector<Load> loads{
+      {.busy_permille = 600, .connections = 1},
+      {.busy_permille = 100, .connections = 10},
+      {.busy_permille = 300, .connections = 0}};
+    EXPECT_EQ(ClientPlacement::LeastLoaded(loads), 1U);
+}
+
+TEST(ClientPlacementTest, fewestConnectionsAmongEquallyBusy) {
+    std::vector<Load> loads{
+      {.busy_permille = 0, .connections = 3},
+      {.busy_permille = 0, .connections = 2},
+      {.busy_permille = 0, .connections = 2},
+      {.busy_permille = 0, .connections = 5}};
+    EXPECT_EQ(ClientPlacement::LeastLoaded(loads), 1U);
+
+    // Busy times within the tolerance are considered equal.
+    loads = {
+      {.busy_permille = 100, .connections = 8},
+      {.busy_permille = 100 + ClientPlacement::kBusyTolerance, .connections = 4},
+      {.busy_permille = 101 + ClientPlacement::kBusyTolerance, .connections = 1}};
+    EXPECT_EQ(ClientPlacement::LeastLoaded(loads), 1U);
+}
+
+TEST(ClientPlacementTest, single) {
+    std::vector<Load> loads{{.busy_permille = 1000, .connections = 100}};
+    EXPECT_EQ(ClientPlacement::LeastLoaded(loads), 0U);
+}
+
+} // namespace rdss::test
@@ -0,0 +1,54 @@
+#include "service/command_dictionary.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace rdss::test {
+
+namespace {
+
+void NopFunction(DataStructureService&, Args, Result&) {}
+
+} // namespace
+
+TEST(CommandDictionaryTest, findIgnoresCase) {
+    CommandDictionary commands;
+    const auto get = commands.Add("GET", Command("GET").SetHandler(NopFunction));
+    const auto getset = commands.Add("getset", Command("getset").SetHandler(NopFunction));
+    EXPECT_EQ(commands.Find("get"), get);
+    EXPECT_EQ(commands.Find("GET"), get);
+    EXPECT_EQ(commands.Find("Get"), get);
+    EXPECT_EQ(commands.Find("gEtSeT"), getset);
+    EXPECT_EQ(commands.Get(getset).Name(), "getset");
+}
+
+TEST(CommandDictionaryTest, unknownNames) {
+    CommandDictionary commands;
+    EXPECT_EQ(commands.Find("get"), CommandDictionary::kNoCommand);
+    commands.Add("get", Command("get").SetHandler(NopFunction));
+    EXPECT_EQ(commands.Find(""), CommandDictionary::kNoCommand);
+    EXPECT_EQ(commands.Find("ge"), CommandDictionary::kNoCommand);
+    EXPECT_EQ(commands.Find("gets"), CommandDictionary::kNoCommand);
+    EXPECT_EQ(commands.Find(std::string("get\0", 4)), CommandDictionary::kNoCommand);
+    // Only ASCII letters are folded.
+    EXPECT_EQ(commands.Find("g\xC5t"), CommandDictionary::kNoCommand);
+    EXPECT_EQ(commands.Find("get_with_a_very_long_name"), CommandDictionary::kNoCommand);
+}
+
+TEST(CommandDictionaryTest, denseIds) {
+    CommandDictionary commands;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 200; ++i) {
+        names.push_back("cmd" + std::to_string(i));
+        EXPECT_EQ(commands.Add(names.back(), Command(names.back()).SetHandler(NopFunction)), i);
+    }
+    EXPECT_EQ(commands.Size(), names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        EXPECT_EQ(commands.Find(names[i]), i);
+        EXPECT_EQ(commands.Get(commands.Find(names[i])).Name(), names[i]);
+    }
+}
+
+} // namespace rdss::test
@@ -3,6 +3,7 @@
 #include "base/buffer.h"
 #include "base/config.h"
 #include "resp/resp_parser.h"
+#include "service/commands/string_commands.h"
 #include "service/data_structure_service.h"
 
 #include <gtest/gtest.h>
@@ -22,6 +23,8 @@ protected:
         clock_.SetTime(std::chrono::time_point_cast<Clock::TimePoint::duration>(
           std::chrono::system_clock::now()));
         service_.UpdateCommandTime();
+        // Every test sets up strings, e.g. the keys of the wrong type.
+        RegisterStringCommands(&service_);
     }
 
     Result Invoke(std::string query) {
@@ -45,15 +48,25 @@ protected:
         if (entry == nullptr) {
             return false;
         }
-        return !value.compare(*entry->value);
+        StringValue::IntChars chars;
+        return entry->value.View(chars) == value;
+    }
+
+    // Returns the value of 'key', which is expected to exist and to be of the type checked by
+    // 'IsType'.
+    template<bool (StringValue::*IsType)() const>
+    const StringValue& GetTypedValue(std::string_view key) {
+        auto entry = service_.DataTable()->Find(key);
+        EXPECT_NE(entry, nullptr);
+        EXPECT_TRUE((entry->value.*IsType)());
+        return entry->value;
     }
 
     bool ExpectNoKey(std::string_view key) {
         auto data_entry = service_.DataTable()->Find(key);
         if (data_entry != nullptr) {
-            auto expire_entry = service_.ExpireTable()->Find(key);
-            if (expire_entry) {
-                return (expire_entry->value <= clock_.Now());
+            if (data_entry->HasExpire()) {
+                return (data_entry->GetExpire() <= clock_.Now());
             }
             return false;
         }
@@ -62,32 +75,24 @@ protected:
 
     bool ExpectTTL(std::string_view key, std::chrono::milliseconds ttl) {
         auto data_entry = service_.DataTable()->Find(key);
-        if (data_entry == nullptr) {
-            return false;
-        }
-        auto expire_entry = service_.ExpireTable()->Find(key);
-        if (expire_entry == nullptr) {
+        if (data_entry == nullptr || !data_entry->HasExpire()) {
             return false;
         }
-        return (expire_entry->value - clock_.Now() == ttl);
+        return (data_entry->GetExpire() - clock_.Now() == ttl);
     }
 
     std::chrono::milliseconds GetTTL(std::string_view key) {
         auto data_entry = service_.DataTable()->Find(key);
-        if (data_entry == nullptr) {
+        if (data_entry == nullptr || !data_entry->HasExpire()) {
             return {};
         }
-        auto expire_entry = service_.ExpireTable()->Find(key);
-        if (expire_entry == nullptr) {
-            return {};
-        }
-        return expire_entry->value - clock_.Now();
+        return data_entry->GetExpire() - clock_.Now();
     }
 
     bool ExpectNoTTL(std::string_view key) {
-        auto entry = service_.ExpireTable()->Find(key);
-        if (entry != nullptr) {
-            return (entry->value <= clock_.Now());
+        auto entry = service_.DataTable()->Find(key);
+        if (entry != nullptr && entry->HasExpire()) {
+            return (entry->GetExpire() <= clock_.Now());
         }
         return true;
     }
@@ -98,8 +103,9 @@ protected:
 
     void ExpectString(Result result, std::string_view str) {
         ASSERT_EQ(result.type, Result::Type::kString);
-        ASSERT_NE(result.string_ptr, nullptr);
-        EXPECT_EQ(*result.string_ptr, str);
+        ASSERT_FALSE(result.string_value.IsNull());
+        StringValue::IntChars chars;
+        EXPECT_EQ(result.string_value.View(chars), str);
     }
 
     void ExpectStrings(Result result, std::vector<std::string> strings) {
@@ -107,12 +113,10 @@ protected:
         ASSERT_EQ(result.strings.size(), strings.size());
         for (size_t i = 0; i < strings.size(); ++i) {
             if (strings[i].empty()) {
-                if (result.strings[i] == nullptr) {
-                    continue;
-                }
-                EXPECT_TRUE(result.strings[i]->empty());
+                EXPECT_EQ(result.strings[i].Size(), 0);
             } else {
-                EXPECT_FALSE(result.strings[i]->compare(strings[i]));
+                StringValue::IntChars chars;
+                EXPECT_EQ(result.strings[i].View(chars), strings[i]);
             }
         }
     }
@@ -122,6 +126,11 @@ protected:
         EXPECT_EQ(result.int_value, i);
     }
 
+    void ExpectError(Result result, Error error) {
+        ASSERT_EQ(result.type, Result::Type::kError);
+        EXPECT_EQ(result.error, error);
+    }
+
     void AdvanceTime(Clock::TimePoint::duration duration) {
         clock_.SetTime(clock_.Now() + duration);
         service_.UpdateCommandTime();
@@ -0,0 +1,204 @@
+#include "data_structure/flat_hash_table.h"
+#include "data_structure/tracking_hash_table.h"
+#include "util.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+
+namespace rdss::test {
+
+using MTSFlatHashTable = FlatHashTable<MTSPtr>;
+
+TEST(FlatHashTableTest, basic) {
+    MTSFlatHashTable hash_table;
+    EXPECT_EQ(hash_table.Count(), 0);
+
+    constexpr size_t key_length = 64;
+    constexpr size_t value_length = 512;
+    constexpr size_t n = 1024 * 16;
+
+    // Insert / assign / erase random key value pair against the hash table.
+    std::map<std::string, std::string> fact;
+    for (size_t i = 0; i < n; ++i) {
+        const auto r = static_cast<double>(std::rand()) / RAND_MAX;
+        if (fact.empty() || r > 0.5) {
+            auto key = GenRandomString(key_length);
+            while (fact.contains(key)) {
+                key = GenRandomString(key_length);
+            }
+            auto value = GenRandomString(value_length);
+            fact.insert({key, value});
+
+            EXPECT_EQ(hash_table.Find(key), nullptr);
+            auto [entry, inserted] = hash_table.Insert(key, CreateMTSPtr(value));
+            EXPECT_NE(entry, nullptr);
+            EXPECT_TRUE(inserted);
+
+            auto find_result = hash_table.Find(key);
+            EXPECT_NE(find_result, nullptr);
+            EXPECT_TRUE(find_result->KeyEquals(key));
+            EXPECT_FALSE(find_result->value->compare(value));
+        } else if (r > 0.2) {
+            auto it = fact.begin();
+            auto value = GenRandomString(value_length);
+
+            EXPECT_NE(hash_table.Find(it->first), nullptr);
+            it->second = value;
+            auto [entry, replaced] = hash_table.Upsert(it->first, CreateMTSPtr(value));
+            EXPECT_NE(entry, nullptr);
+            EXPECT_TRUE(replaced);
+
+            auto find_result = hash_table.Find(it->first);
+            EXPECT_NE(find_result, nullptr);
+            EXPECT_EQ(find_result->Key(), it->first);
+            EXPECT_FALSE(find_result->value->compare(it->second));
+        } else {
+            EXPECT_TRUE(hash_table.Erase(fact.begin()->first));
+            auto find_result = hash_table.Find(fact.begin()->first);
+            EXPECT_EQ(find_result, nullptr);
+            fact.erase(fact.begin());
+        }
+    }
+    EXPECT_EQ(hash_table.Count(), fact.size());
+
+    for (const auto& [key, value] : fact) {
+        auto find_result = hash_table.Find(key);
+        EXPECT_NE(find_result, nullptr);
+        EXPECT_EQ(find_result->Key(), key);
+        EXPECT_FALSE(find_result->value->compare(value));
+    }
+}
+
+TEST(FlatHashTableTest, getRandomEntry) {
+    constexpr size_t key_length = 64;
+    constexpr size_t n = 1024 * 16;
+
+    FlatHashTable<size_t> hash_table;
+    EXPECT_EQ(hash_table.GetRandomEntry(), nullptr);
+    for (size_t i = 0; i < n; ++i) {
+        hash_table.Insert(GenRandomString(key_length), i);
+    }
+
+    std::map<std::string, size_t> count;
+    for (size_t i = 0; i < n; ++i) {
+        auto entry = hash_table.GetRandomEntry();
+        EXPECT_NE(entry, nullptr);
+        ++count[std::string(entry->Key())];
+    }
+
+    size_t max_count{0};
+    for (const auto& [_, c] : count) {
+        max_count = std::max(max_count, c);
+    }
+    EXPECT_LE(max_count, 64);
+}
+
+TEST(FlatHashTableTest, traverseAndRehash) {
+    constexpr size_t n = 1024 * 4;
+
+    FlatHashTable<size_t> hash_table;
+    std::set<std::string> keys;
+    bool traversed_while_rehashing{false};
+    for (size_t i = 0; i < n; ++i) {
+        auto key = "key:" + std::to_string(i);
+        hash_table.Insert(key, i);
+        keys.insert(std::move(key));
+
+        // Full traversal visits every entry exactly once, even if the table is being rehashed.
+        if (i % 97 != 0) {
+            continue;
+        }
+        traversed_while_rehashing |= hash_table.IsRehashing();
+        std::multiset<std::string> visited;
+        size_t cursor{0};
+        do {
+            cursor = hash_table.TraverseBucket(cursor, [&](auto* entry) {
+                visited.insert(std::string(entry->Key()));
+            });
+        } while (cursor != 0);
+        ASSERT_EQ(visited.size(), keys.size());
+        ASSERT_TRUE(std::equal(visited.begin(), visited.end(), keys.begin()));
+    }
+    EXPECT_TRUE(traversed_while_rehashing);
+
+    // Erasing the visited entries while traversing.
+    while (hash_table.IsRehashing()) {
+        hash_table.RehashSome(1);
+    }
+    size_t cursor{0};
+    size_t erased{0};
+    do {
+        cursor = hash_table.TraverseBucket(cursor, [&](auto* entry) {
+            if (entry->value % 2 == 0) {
+                hash_table.Erase(std::string(entry->Key()));
+                ++erased;
+            }
+        });
+    } while (cursor != 0);
+    EXPECT_EQ(erased, n / 2);
+    EXPECT_EQ(hash_table.Count(), n / 2);
+
+    for (size_t i = 0; i < n; ++i) {
+        auto entry = hash_table.Find("key:" + std::to_string(i));
+        if (i % 2 == 0) {
+            EXPECT_EQ(entry, nullptr);
+        } else {
+            ASSERT_NE(entry, nullptr);
+            EXPECT_EQ(entry->value, i);
+        }
+    }
+    EXPECT_LE(hash_table.LoadFactor(), 7.0 / 8);
+
+    hash_table.Clear();
+    EXPECT_EQ(hash_table.Count(), 0);
+    EXPECT_EQ(hash_table.Find("key:1"), nullptr);
+}
+
+TEST(FlatHashTableTest, traverseWhileInserting) {
+    constexpr size_t n = 1000;
+
+    FlatHashTable<size_t> hash_table;
+    size_t i{0};
+    for (; i < n || !hash_table.IsRehashing(); ++i) {
+        hash_table.Insert("key:" + std::to_string(i), i);
+    }
+    const auto num_keys = i;
+
+    // The table grows several times by the insertions during the traversal, which starts in the
+    // middle of a rehashing. The keys existing all along are visited exactly once, the others at
+    // most once.
+    std::map<std::string, size_t> visited;
+    size_t inserted{0};
+    size_t cursor{0};
+    do {
+        cursor = hash_table.TraverseBucket(
+          cursor, [&](auto* entry) { ++visited[std::string(entry->Key())]; });
+        for (size_t j = 0; j < 64; ++j, ++inserted) {
+            hash_table.Insert("new:" + std::to_string(inserted), inserted);
+        }
+        hash_table.Erase("new:" + std::to_string(inserted / 2));
+    } while (cursor != 0);
+    EXPECT_GT(hash_table.Capacity(), num_keys * 4);
+    for (size_t k = 0; k < num_keys; ++k) {
+        EXPECT_EQ(visited["key:" + std::to_string(k)], 1);
+    }
+    for (const auto& [key, count] : visited) {
+        EXPECT_EQ(count, 1) << key;
+    }
+
+    // Rehashing goes on after the traversal.
+    while (hash_table.IsRehashing()) {
+        hash_table.RehashSome(1);
+    }
+    EXPECT_EQ(hash_table.Count(), num_keys + inserted - inserted / 64);
+    for (size_t k = 0; k < num_keys; ++k) {
+        ASSERT_NE(hash_table.Find("key:" + std::to_string(k)), nullptr);
+    }
+}
+
+} // namespace rdss::test
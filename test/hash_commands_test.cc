@@ -0,0 +1,112 @@
+#include "commands_test_base.h"
+#include "data_structure/hash_value.h"
+#include "service/commands/hash_commands.h"
+
+namespace rdss::test {
+
+class HashCommandsTest : public CommandsTestBase {
+protected:
+    void SetUp() override {
+        CommandsTestBase::SetUp();
+        RegisterHashCommands(&service_);
+    }
+
+    HashValue::Encoding GetEncoding(std::string_view key) {
+        return GetTypedValue<&StringValue::IsHash>(key).Hash().GetEncoding();
+    }
+};
+
+TEST_F(HashCommandsTest, SetGetTest) {
+    ExpectInt(Invoke("HSET h f0 v0 f1 v1"), 2);
+    // Updating an existing field doesn't count.
+    ExpectInt(Invoke("HSET h f1 v2 f2 v2"), 1);
+    ExpectOk(Invoke("HMSET h f3 v3"));
+    ExpectInt(Invoke("HLEN h"), 4);
+    ExpectInt(Invoke("HLEN missing"), 0);
+
+    ExpectString(Invoke("HGET h f1"), "v2");
+    ExpectNull(Invoke("HGET h f9"));
+    ExpectNull(Invoke("HGET missing f0"));
+    ExpectStrings(Invoke("HMGET h f0 f9 f3"), {"v0", "", "v3"});
+    ExpectStrings(Invoke("HMGET missing f0 f1"), {"", ""});
+    ExpectStrings(Invoke("HGETALL h"), {"f0", "v0", "f1", "v2", "f2", "v2", "f3", "v3"});
+    ExpectStrings(Invoke("HGETALL missing"), {});
+
+    ExpectError(Invoke("HSET h f0"), Error::kWrongArgNum);
+}
+
+TEST_F(HashCommandsTest, IncrByTest) {
+    ExpectInt(Invoke("HINCRBY h f0 5"), 5);
+    ExpectInt(Invoke("HINCRBY h f0 -7"), -2);
+    ExpectString(Invoke("HGET h f0"), "-2");
+
+    ExpectError(Invoke("HINCRBY h f0 x"), Error::kNotAnInt);
+    Invoke("HSET h f1 v1");
+    ExpectError(Invoke("HINCRBY h f1 1"), Error::kNotAnInt);
+    Invoke("HSET h f2 9223372036854775807");
+    ExpectError(Invoke("HINCRBY h f2 1"), Error::kNotAnInt);
+    ExpectString(Invoke("HGET h f2"), "9223372036854775807");
+}
+
+TEST_F(HashCommandsTest, DelTest) {
+    Invoke("HSET h f0 v0 f1 v1 f2 v2");
+    ExpectInt(Invoke("HDEL h f0 f9 f0"), 1);
+    ExpectStrings(Invoke("HGETALL h"), {"f1", "v1", "f2", "v2"});
+    ExpectInt(Invoke("HDEL missing f0"), 0);
+
+    // The key is removed with its last field.
+    ExpectInt(Invoke("HDEL h f1 f2"), 2);
+    EXPECT_TRUE(ExpectNoKey("h"));
+}
+
+TEST_F(HashCommandsTest, EncodingTest) {
+    config_.hash_max_listpack_entries = 4;
+    config_.hash_max_listpack_value = 8;
+
+    for (int i = 0; i < 4; ++i) {
+        Invoke("HSET h f" + std::to_string(i) + " v" + std::to_string(i));
+    }
+    EXPECT_EQ(GetEncoding("h"), HashValue::Encoding::kListpack);
+    // Too many fields.
+    Invoke("HSET h f4 v4");
+    EXPECT_EQ(GetEncoding("h"), HashValue::Encoding::kTable);
+    ExpectInt(Invoke("HLEN h"), 5);
+    for (int i = 0; i < 5; ++i) {
+        ExpectString(Invoke("HGET h f" + std::to_string(i)), "v" + std::to_string(i));
+    }
+    // It's not converted back.
+    ExpectInt(Invoke("HDEL h f0 f1 f2"), 3);
+    EXPECT_EQ(GetEncoding("h"), HashValue::Encoding::kTable);
+
+    // Too long value.
+    Invoke("HSET h2 f0 v0");
+    EXPECT_EQ(GetEncoding("h2"), HashValue::Encoding::kListpack);
+    Invoke("HSET h2 f1 123456789");
+    EXPECT_EQ(GetEncoding("h2"), HashValue::Encoding::kTable);
+    ExpectStrings(Invoke("HMGET h2 f0 f1"), {"v0", "123456789"});
+}
+
+TEST_F(HashCommandsTest, WrongTypeTest) {
+    Invoke("SET s v");
+    ExpectError(Invoke("HSET s f0 v0"), Error::kWrongType);
+    ExpectError(Invoke("HGET s f0"), Error::kWrongType);
+    ExpectError(Invoke("HGETALL s"), Error::kWrongType);
+    ExpectError(Invoke("HINCRBY s f0 1"), Error::kWrongType);
+    ExpectError(Invoke("HDEL s f0"), Error::kWrongType);
+    EXPECT_TRUE(ExpectKeyValue("s", "v"));
+
+    Invoke("HSET h f0 v0");
+    ExpectError(Invoke("GET h"), Error::kWrongType);
+    ExpectError(Invoke("GETDEL h"), Error::kWrongType);
+    ExpectError(Invoke("APPEND h v"), Error::kWrongType);
+    ExpectError(Invoke("STRLEN h"), Error::kWrongType);
+    ExpectError(Invoke("SET h v GET"), Error::kWrongType);
+    ExpectStrings(Invoke("MGET h s"), {"", "v"});
+    ExpectInt(Invoke("HLEN h"), 1);
+
+    // SET overwrites the hash.
+    ExpectOk(Invoke("SET h v"));
+    EXPECT_TRUE(ExpectKeyValue("h", "v"));
+}
+
+} // namespace rdss::test
@@ -7,6 +7,7 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <set>
 #include <string>
 #include <unordered_map>
 
@@ -44,8 +45,8 @@ TEST(HashTableTest, basic) {
 
             auto find_result = hash_table.Find(key);
             EXPECT_NE(find_result, nullptr);
-            EXPECT_TRUE(find_result->GetKey()->Equals(key));
-            EXPECT_FALSE(find_result->value->compare(value));
+            EXPECT_TRUE(find_result->KeyEquals(key));
+            EXPECT_FALSE(find_result->value.Raw()->compare(value));
         } else if (r > 0.2) {
             auto it = fact.begin();
             auto value = GenRandomString(value_length);
@@ -58,8 +59,8 @@ TEST(HashTableTest, basic) {
 
             auto find_result = hash_table.Find(it->first);
             EXPECT_NE(find_result, nullptr);
-            EXPECT_TRUE(find_result->GetKey()->Equals(it->first));
-            EXPECT_FALSE(find_result->value->compare(it->second));
+            EXPECT_TRUE(find_result->KeyEquals(it->first));
+            EXPECT_FALSE(find_result->value.Raw()->compare(it->second));
         } else {
             EXPECT_TRUE(hash_table.Erase(fact.begin()->first));
             auto find_result = hash_table.Find(fact.begin()->first);
@@ -72,8 +73,8 @@ TEST(HashTableTest, basic) {
     for (const auto& [key, value] : fact) {
         auto find_result = hash_table.Find(key);
         EXPECT_NE(find_result, nullptr);
-        EXPECT_TRUE(find_result->GetKey()->Equals(key));
-        EXPECT_FALSE(find_result->value->compare(value));
+        EXPECT_TRUE(find_result->KeyEquals(key));
+        EXPECT_FALSE(find_result->value.Raw()->compare(value));
     }
 }
 
@@ -94,7 +95,7 @@ TEST(HashTableTest, getRandomEntry) {
     for (size_t i = 0; i < n; ++i) {
         auto entry = hash_table.GetRandomEntry();
         EXPECT_NE(entry, nullptr);
-        ++count[std::string(entry->GetKey()->StringView())];
+        ++count[std::string(entry->Key())];
     }
 
     size_t max_count{0};
@@ -104,4 +105,120 @@ TEST(HashTableTest, getRandomEntry) {
     EXPECT_LE(max_count, 16);
 }
 
+TEST(HashTableTest, refEntry) {
+    constexpr size_t n = 1024 * 4;
+
+    MTSHashTable data_table;
+    RefHashTable<size_t, MTSHashTable> ref_table;
+    for (size_t i = 0; i < n; ++i) {
+        auto [entry, inserted] = data_table.Insert("key:" + std::to_string(i), nullptr);
+        EXPECT_TRUE(inserted);
+        if (i % 2 == 0) {
+            auto [ref_entry, exists] = ref_table.Upsert(entry, i);
+            EXPECT_FALSE(exists);
+            EXPECT_EQ(ref_entry->KeyEntry(), entry);
+        }
+    }
+    EXPECT_EQ(ref_table.Count(), n / 2);
+
+    for (size_t i = 0; i < n; ++i) {
+        const auto key = "key:" + std::to_string(i);
+        auto ref_entry = ref_table.Find(key);
+        if (i % 2 != 0) {
+            EXPECT_EQ(ref_entry, nullptr);
+            continue;
+        }
+        ASSERT_NE(ref_entry, nullptr);
+        EXPECT_EQ(ref_entry->Key(), key);
+        EXPECT_EQ(ref_entry->KeyEntry(), data_table.Find(key));
+        EXPECT_EQ(ref_entry->value, i);
+
+        auto [entry, exists] = ref_table.Upsert(data_table.Find(key), i + 1);
+        EXPECT_TRUE(exists);
+        EXPECT_EQ(entry, ref_entry);
+        EXPECT_EQ(entry->value, i + 1);
+    }
+
+    // Ref entry is erased before the entry it references.
+    for (size_t i = 0; i < n; i += 4) {
+        const auto key = "key:" + std::to_string(i);
+        EXPECT_TRUE(ref_table.Erase(key));
+        EXPECT_TRUE(data_table.Erase(key));
+        EXPECT_EQ(ref_table.Find(key), nullptr);
+    }
+    EXPECT_EQ(ref_table.Count(), n / 4);
+}
+
+TEST(HashTableTest, traverseWhileExpanding) {
+    constexpr size_t n = 1024;
+
+    HashTable<size_t> hash_table;
+    std::set<std::string> keys;
+    for (size_t i = 0; i < n; ++i) {
+        auto key = "key:" + std::to_string(i);
+        hash_table.Insert(key, i);
+        keys.insert(std::move(key));
+    }
+
+    // Keys existing all along are visited exactly once, while the table keeps expanding and
+    // rehashing between the steps of the traversal.
+    bool traversed_while_rehashing{false};
+    std::multiset<std::string> visited;
+    size_t cursor{0};
+    size_t inserted{n};
+    do {
+        traversed_while_rehashing |= hash_table.IsRehashing();
+        cursor = hash_table.TraverseBucket(cursor, [&](auto* entry) {
+            const auto value = entry->value;
+            if (value < n) {
+                visited.insert(std::string(entry->Key()));
+            }
+        });
+        for (size_t i = 0; i < 4; ++i, ++inserted) {
+            hash_table.Insert("key:" + std::to_string(inserted), inserted);
+        }
+    } while (cursor != 0);
+    EXPECT_TRUE(traversed_while_rehashing);
+    ASSERT_EQ(visited.size(), keys.size());
+    EXPECT_TRUE(std::equal(visited.begin(), visited.end(), keys.begin()));
+}
+
+TEST(HashTableTest, isTraversedWhileExpanding) {
+    constexpr size_t n = 128;
+    // Each step checks every kStride-th key, starting from a different one, so the check stays
+    // linear in the keys while all of them are checked over the traversal.
+    constexpr size_t kStride = 8;
+
+    HashTable<size_t> hash_table;
+    for (size_t i = 0; i < n; ++i) {
+        hash_table.Insert("key:" + std::to_string(i), i);
+    }
+
+    // A key is reported as traversed once its bucket is visited, before and after expanding.
+    std::set<std::string> visited;
+    size_t cursor{0};
+    size_t inserted{n};
+    size_t step{0};
+    do {
+        cursor = hash_table.TraverseBucket(
+          cursor, [&](auto* entry) { visited.insert(std::string(entry->Key())); });
+        for (size_t i = 0; i < 4; ++i, ++inserted) {
+            auto key = "key:" + std::to_string(inserted);
+            hash_table.Insert(key, inserted);
+            if (cursor != 0 && hash_table.IsTraversed(key, cursor)) {
+                // Keys added to the visited buckets are missed by the traversal.
+                visited.insert(std::move(key));
+            }
+        }
+        if (cursor == 0) {
+            break;
+        }
+        for (size_t i = step++ % kStride; i < inserted; i += kStride) {
+            const auto key = "key:" + std::to_string(i);
+            ASSERT_EQ(hash_table.IsTraversed(key, cursor), visited.contains(key)) << key;
+        }
+    } while (true);
+    EXPECT_FALSE(hash_table.IsTraversed("key:0", 0));
+}
+
 } // namespace rdss::test
@@ -0,0 +1,177 @@
+#include "commands_test_base.h"
+#include "data_structure/hyperloglog.h"
+#include "service/commands/hyperloglog_commands.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace rdss::test {
+
+class HyperLogLogCommandsTest : public CommandsTestBase {
+protected:
+    void SetUp() override {
+        CommandsTestBase::SetUp();
+        RegisterHyperLogLogCommands(&service_);
+    }
+
+    bool IsSparse(std::string_view key) {
+        return hyperloglog::IsSparse(*GetTypedValue<&StringValue::IsString>(key).Raw());
+    }
+
+    // Adds elements "<prefix><i>" for i in [begin, end) to 'key', 100 per PFADD.
+    void AddElements(std::string_view key, std::string_view prefix, size_t begin, size_t end) {
+        for (size_t i = begin; i < end;) {
+            std::string query = "PFADD " + std::string(key);
+            for (const auto batch_end = std::min(i + 100, end); i < batch_end; ++i) {
+                query += " " + std::string(prefix) + std::to_string(i);
+            }
+            Invoke(query);
+        }
+    }
+
+    int64_t Count(std::string query) {
+        auto result = Invoke(query);
+        EXPECT_EQ(result.type, Result::Type::kInt);
+        return result.int_value;
+    }
+
+    static void ExpectNear(int64_t count, int64_t cardinality, double error) {
+        EXPECT_LE(
+          std::abs(static_cast<double>(count - cardinality)),
+          static_cast<double>(cardinality) * error)
+          << count << " vs " << cardinality;
+    }
+};
+
+TEST_F(HyperLogLogCommandsTest, AddCountTest) {
+    ExpectInt(Invoke("PFCOUNT h"), 0);
+    ExpectInt(Invoke("PFADD h a b c d e f g"), 1);
+    ExpectInt(Invoke("PFADD h a b c"), 0);
+    ExpectInt(Invoke("PFCOUNT h"), 7);
+    ExpectInt(Invoke("PFADD h h"), 1);
+    ExpectInt(Invoke("PFCOUNT h"), 8);
+    EXPECT_TRUE(IsSparse("h"));
+
+    // Creating an empty one is an update.
+    ExpectInt(Invoke("PFADD empty"), 1);
+    ExpectInt(Invoke("PFADD empty"), 0);
+    ExpectInt(Invoke("PFCOUNT empty"), 0);
+
+    // It's a string in the layout of Redis.
+    auto result = Invoke("GET h");
+    ASSERT_EQ(result.type, Result::Type::kString);
+    StringValue::IntChars chars;
+    EXPECT_TRUE(result.string_value.View(chars).starts_with("HYLL"));
+
+    ExpectError(Invoke("PFADD"), Error::kWrongArgNum);
+    ExpectError(Invoke("PFCOUNT"), Error::kWrongArgNum);
+}
+
+TEST_F(HyperLogLogCommandsTest, TypeTest) {
+    Invoke("SET str 1234567890123456789012345");
+    ExpectError(Invoke("PFADD str a"), Error::kNotAnHll);
+    ExpectError(Invoke("PFCOUNT str"), Error::kNotAnHll);
+    ExpectError(Invoke("PFCOUNT h str"), Error::kNotAnHll);
+    ExpectError(Invoke("PFMERGE str"), Error::kNotAnHll);
+    Invoke("SET short a");
+    ExpectError(Invoke("PFADD short a"), Error::kNotAnHll);
+    EXPECT_TRUE(ExpectKeyValue("short", "a"));
+
+    // Sparse registers that don't cover all the registers, with the cached cardinality stale.
+    auto hll = hyperloglog::Create();
+    hll.pop_back();
+    hll[hyperloglog::kHeaderSize - 1] = static_cast<char>(0x80);
+    service_.DataTable()->Upsert("corrupted", StringValue(CreateMTSPtr(hll)));
+    ExpectError(Invoke("PFCOUNT corrupted"), Error::kCorruptedHll);
+    ExpectError(Invoke("PFADD corrupted a"), Error::kCorruptedHll);
+    ExpectError(Invoke("PFMERGE h corrupted"), Error::kCorruptedHll);
+    EXPECT_TRUE(ExpectNoKey("h"));
+}
+
+TEST_F(HyperLogLogCommandsTest, CacheTest) {
+    Invoke("PFADD h a b c");
+    ExpectInt(Invoke("PFCOUNT h"), 3);
+    ExpectInt(Invoke("PFCOUNT h"), 3);
+    Invoke("PFADD h d");
+    ExpectInt(Invoke("PFCOUNT h"), 4);
+
+    // A copy shares the string with the original until it's modified.
+    service_.DataTable()->Upsert("copy", GetTypedValue<&StringValue::IsString>("h"));
+    ExpectInt(Invoke("PFADD copy e f"), 1);
+    ExpectInt(Invoke("PFCOUNT copy"), 6);
+    ExpectInt(Invoke("PFCOUNT h"), 4);
+}
+
+TEST_F(HyperLogLogCommandsTest, EncodingTest) {
+    AddElements("sparse", "e", 0, 200);
+    EXPECT_TRUE(IsSparse("sparse"));
+    // It's converted to dense once it exceeds hll-sparse-max-bytes.
+    AddElements("sparse", "e", 200, 50000);
+    EXPECT_FALSE(IsSparse("sparse"));
+
+    config_.hll_sparse_max_bytes = 0;
+    AddElements("dense", "e", 0, 50000);
+    EXPECT_FALSE(IsSparse("dense"));
+    // Both have the same registers.
+    ExpectInt(Invoke("PFCOUNT dense"), Count("PFCOUNT sparse"));
+    ExpectNear(Count("PFCOUNT dense"), 50000, 0.03);
+
+    // Same for the small ones.
+    config_.hll_sparse_max_bytes = 3000;
+    AddElements("small_sparse", "e", 0, 1000);
+    EXPECT_TRUE(IsSparse("small_sparse"));
+    config_.hll_sparse_max_bytes = 0;
+    AddElements("small_dense", "e", 0, 1000);
+    EXPECT_FALSE(IsSparse("small_dense"));
+    ExpectInt(Invoke("PFCOUNT small_dense"), Count("PFCOUNT small_sparse"));
+    ExpectNear(Count("PFCOUNT small_sparse"), 1000, 0.03);
+}
+
+TEST_F(HyperLogLogCommandsTest, AccuracyTest) {
+    size_t cardinality{0};
+    for (const size_t next : {10, 100, 1000, 10000, 100000, 300000}) {
+        AddElements("h", "element:", cardinality, next);
+        cardinality = next;
+        // The standard error is 0.81%.
+        ExpectNear(Count("PFCOUNT h"), static_cast<int64_t>(cardinality), 0.03);
+    }
+}
+
+TEST_F(HyperLogLogCommandsTest, MergeTest) {
+    AddElements("a", "e", 0, 1000);
+    AddElements("b", "e", 500, 1500);
+    ExpectOk(Invoke("PFMERGE u a b missing"));
+    EXPECT_TRUE(IsSparse("u"));
+    ExpectNear(Count("PFCOUNT u"), 1500, 0.03);
+    ExpectInt(Invoke("PFCOUNT a b missing"), Count("PFCOUNT u"));
+
+    // The destination is merged as well.
+    AddElements("c", "e", 1500, 20000);
+    EXPECT_FALSE(IsSparse("c"));
+    ExpectOk(Invoke("PFMERGE u c"));
+    EXPECT_FALSE(IsSparse("u"));
+    ExpectNear(Count("PFCOUNT u"), 20000, 0.03);
+    ExpectInt(Invoke("PFCOUNT a b c"), Count("PFCOUNT u"));
+    ExpectInt(Invoke("PFCOUNT u c"), Count("PFCOUNT u"));
+
+    // Merging nothing creates an empty one.
+    ExpectOk(Invoke("PFMERGE empty"));
+    ExpectInt(Invoke("PFCOUNT empty"), 0);
+    EXPECT_TRUE(IsSparse("empty"));
+
+    ExpectError(Invoke("PFMERGE"), Error::kWrongArgNum);
+}
+
+// Many daily ones counted together, most of them dense.
+TEST_F(HyperLogLogCommandsTest, CountManyTest) {
+    std::string query = "PFCOUNT";
+    for (size_t day = 0; day < 30; ++day) {
+        const auto key = "day:" + std::to_string(day);
+        AddElements(key, "user:", day * 1000, day * 1000 + 5000);
+        query += " " + key;
+    }
+    ExpectNear(Count(query), 34000, 0.03);
+}
+
+} // namespace rdss::test
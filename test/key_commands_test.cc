@@ -1,14 +1,14 @@
 #include "commands_test_base.h"
 #include "service/commands/key_commands.h"
-#include "service/commands/string_commands.h"
 
 namespace rdss::test {
 
+using namespace std::chrono;
+
 class KeyCommandsTest : public CommandsTestBase {
 protected:
     void SetUp() override {
         CommandsTestBase::SetUp();
-        RegisterStringCommands(&service_);
         RegisterKeyCommands(&service_);
     }
 };
@@ -28,4 +28,46 @@ TEST_F(KeyCommandsTest, DelTest) {
     ExpectInt(Invoke("DEL k0"), 0);
 }
 
+TEST_F(KeyCommandsTest, TtlTest) {
+    // TTL of not existing key
+    ExpectInt(Invoke("TTL k0"), -2);
+
+    // TTL of key without expire time
+    Invoke("SET k0 v0");
+    ExpectInt(Invoke("TTL k0"), -1);
+    EXPECT_EQ(service_.ExpireTable()->Count(), 0);
+
+    // TTL of volatile key
+    Invoke("SET k0 v0 EX 10");
+    ExpectInt(Invoke("TTL k0"), 10);
+    EXPECT_EQ(service_.ExpireTable()->Count(), 1);
+
+    // SET with GET clears the expire time
+    ExpectString(Invoke("SET k0 v1 GET"), "v0");
+    ExpectInt(Invoke("TTL k0"), -1);
+    EXPECT_EQ(service_.ExpireTable()->Count(), 0);
+
+    // TTL of expired key expires it
+    Invoke("SET k0 v0 EX 1");
+    AdvanceTime(std::chrono::seconds{1});
+    ExpectInt(Invoke("TTL k0"), -2);
+    EXPECT_EQ(service_.DataTable()->Find("k0"), nullptr);
+    EXPECT_EQ(service_.ExpireTable()->Count(), 0);
+}
+
+TEST_F(KeyCommandsTest, PExpireAtTest) {
+    const auto now_ms = duration_cast<milliseconds>(clock_.Now().time_since_epoch()).count();
+
+    ExpectInt(Invoke("PEXPIREAT k0 " + std::to_string(now_ms + 10000)), 0);
+
+    Invoke("SET k0 v0");
+    ExpectInt(Invoke("PEXPIREAT k0 " + std::to_string(now_ms + 10000)), 1);
+    ExpectInt(Invoke("TTL k0"), 10);
+
+    // A time in the past deletes the key.
+    ExpectInt(Invoke("PEXPIREAT k0 " + std::to_string(now_ms - 1)), 1);
+    EXPECT_EQ(service_.DataTable()->Find("k0"), nullptr);
+    EXPECT_EQ(service_.ExpireTable()->Count(), 0);
+}
+
 } // namespace rdss::test
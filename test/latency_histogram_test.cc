@@ -0,0 +1,51 @@
+#include "base/latency_histogram.h"
+
+#include <gtest/gtest.h>
+
+namespace rdss::test {
+
+TEST(LatencyHistogramTest, bucketsCoverValues) {
+    for (size_t bucket = 1; bucket < LatencyHistogram::kNumBuckets; ++bucket) {
+        const auto lower = LatencyHistogram::UpperBound(bucket - 1) + 1;
+        const auto upper = LatencyHistogram::UpperBound(bucket);
+        ASSERT_LE(lower, upper);
+        EXPECT_EQ(LatencyHistogram::BucketOf(lower), bucket);
+        EXPECT_EQ(LatencyHistogram::BucketOf(upper), bucket);
+        // A bucket is within 1/kSubBuckets of its values.
+        EXPECT_LE(upper - lower, lower / LatencyHistogram::kSubBuckets);
+    }
+    EXPECT_EQ(LatencyHistogram::BucketOf(uint64_t{1} << 40), LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST(LatencyHistogramTest, percentiles) {
+    LatencyHistogram histogram;
+    LatencyHistogram::Snapshot empty;
+    histogram.AddTo(empty);
+    EXPECT_EQ(empty.Percentile(50), 0);
+
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        histogram.Record(i * 1000);
+    }
+    EXPECT_EQ(histogram.Count(), 1000);
+    EXPECT_EQ(histogram.SumNs(), 500500 * 1000);
+
+    LatencyHistogram::Snapshot snapshot;
+    histogram.AddTo(snapshot);
+    EXPECT_EQ(snapshot.count, 1000);
+    const auto p50 = snapshot.Percentile(50);
+    EXPECT_GE(p50, 500 * 1000);
+    EXPECT_LE(p50, 500 * 1000 + 500 * 1000 / LatencyHistogram::kSubBuckets);
+    const auto p99 = snapshot.Percentile(99);
+    EXPECT_GE(p99, 990 * 1000);
+    EXPECT_LE(p99, 990 * 1000 + 990 * 1000 / LatencyHistogram::kSubBuckets);
+    EXPECT_GE(snapshot.Percentile(100), 1000 * 1000);
+
+    // Merging another thread's histogram.
+    LatencyHistogram other;
+    other.Record(uint64_t{5});
+    other.AddTo(snapshot);
+    EXPECT_EQ(snapshot.count, 1001);
+    EXPECT_EQ(snapshot.Percentile(0), 5);
+}
+
+} // namespace rdss::test
@@ -0,0 +1,152 @@
+#include "commands_test_base.h"
+#include "data_structure/list_value.h"
+#include "io/promise.h"
+#include "service/commands/list_commands.h"
+
+namespace rdss::test {
+
+using WakeReason = DataStructureService::WakeReason;
+
+class ListCommandsTest : public CommandsTestBase {
+protected:
+    void SetUp() override {
+        CommandsTestBase::SetUp();
+        RegisterListCommands(&service_);
+    }
+
+    const ListValue& GetList(std::string_view key) {
+        return GetTypedValue<&StringValue::IsList>(key).List();
+    }
+};
+
+// Blocks like a client whose blocking command of 'args' replied nil to 'result'.
+Task<void> Block(
+  DataStructureService* service, Args args, Result* result, uint64_t id, WakeReason* reason) {
+    *reason = co_await service->WaitForKeys(args, result, id);
+}
+
+TEST_F(ListCommandsTest, PushPopTest) {
+    ExpectInt(Invoke("RPUSH l b c"), 2);
+    ExpectInt(Invoke("LPUSH l a z"), 4);
+    ExpectInt(Invoke("LLEN l"), 4);
+    ExpectInt(Invoke("LLEN missing"), 0);
+    ExpectStrings(Invoke("LRANGE l 0 -1"), {"z", "a", "b", "c"});
+
+    ExpectString(Invoke("LPOP l"), "z");
+    ExpectString(Invoke("RPOP l"), "c");
+    ExpectStrings(Invoke("LPOP l 5"), {"a", "b"});
+    // The drained list is removed.
+    EXPECT_TRUE(ExpectNoKey("l"));
+    ExpectNull(Invoke("LPOP l"));
+    ExpectNull(Invoke("RPOP l 2"));
+
+    ExpectError(Invoke("LPUSH l"), Error::kWrongArgNum);
+    ExpectError(Invoke("LPOP l -1"), Error::kNotAnInt);
+}
+
+TEST_F(ListCommandsTest, ChunkTest) {
+    config_.list_max_listpack_size = 4;
+    for (int i = 0; i < 10; ++i) {
+        Invoke("RPUSH l " + std::to_string(i));
+    }
+    EXPECT_EQ(GetList("l").NumChunks(), 3);
+    Invoke("LPUSH l x");
+    EXPECT_EQ(GetList("l").NumChunks(), 4);
+    ExpectStrings(Invoke("LRANGE l 3 6"), {"2", "3", "4", "5"});
+    ExpectStrings(Invoke("LRANGE l -3 -1"), {"7", "8", "9"});
+    ExpectStrings(Invoke("LRANGE l 9 100"), {"8", "9"});
+    ExpectStrings(Invoke("LRANGE l 5 2"), {});
+    ExpectStrings(Invoke("LRANGE l 11 12"), {});
+
+    // Bounded by size, an element larger than the bound takes a chunk of its own.
+    config_.list_max_listpack_size = -1;
+    Invoke("RPUSH big a");
+    Invoke("RPUSH big " + std::string(5000, 'b'));
+    Invoke("RPUSH big c");
+    EXPECT_EQ(GetList("big").NumChunks(), 3);
+    ExpectInt(Invoke("LLEN big"), 3);
+    ExpectString(Invoke("RPOP big"), "c");
+}
+
+TEST_F(ListCommandsTest, TrimTest) {
+    config_.list_max_listpack_size = 3;
+    for (int i = 0; i < 10; ++i) {
+        Invoke("RPUSH l " + std::to_string(i));
+    }
+    ExpectOk(Invoke("LTRIM l 2 -3"));
+    ExpectStrings(Invoke("LRANGE l 0 -1"), {"2", "3", "4", "5", "6", "7"});
+    ExpectOk(Invoke("LTRIM l 1 1"));
+    ExpectStrings(Invoke("LRANGE l 0 -1"), {"3"});
+    EXPECT_EQ(GetList("l").NumChunks(), 1);
+    ExpectOk(Invoke("LTRIM l 2 1"));
+    EXPECT_TRUE(ExpectNoKey("l"));
+    ExpectOk(Invoke("LTRIM missing 0 1"));
+}
+
+TEST_F(ListCommandsTest, WrongTypeTest) {
+    Invoke("SET s v");
+    ExpectError(Invoke("LPUSH s a"), Error::kWrongType);
+    ExpectError(Invoke("LRANGE s 0 -1"), Error::kWrongType);
+    ExpectError(Invoke("BLPOP s 0"), Error::kWrongType);
+    Invoke("RPUSH l a");
+    ExpectError(Invoke("GET l"), Error::kWrongType);
+    ExpectError(Invoke("APPEND l a"), Error::kWrongType);
+}
+
+TEST_F(ListCommandsTest, BlockingPopTest) {
+    Invoke("RPUSH l1 a b");
+    ExpectStrings(Invoke("BLPOP l0 l1 0"), {"l1", "a"});
+    ExpectStrings(Invoke("BRPOP l0 l1 0.5"), {"l1", "b"});
+    // Replies nil when it would block.
+    ExpectNull(Invoke("BLPOP l0 l1 1"));
+    ExpectError(Invoke("BLPOP l0 -1"), Error::kInvalidTimeout);
+    ExpectError(Invoke("BLPOP l0 x"), Error::kInvalidTimeout);
+
+    // Blocked clients are served in order once a list is pushed to.
+    std::vector<std::string_view> args0{"BLPOP", "l0", "l1", "0"};
+    std::vector<std::string_view> args1{"BRPOP", "l1", "0"};
+    std::vector<std::string_view> args2{"BLPOP", "l1", "10"};
+    Result results[3];
+    WakeReason reasons[3]{};
+    Block(&service_, Args(args0), &results[0], 0, &reasons[0]);
+    Block(&service_, Args(args1), &results[1], 1, &reasons[1]);
+    Block(&service_, Args(args2), &results[2], 2, &reasons[2]);
+    EXPECT_EQ(service_.NumBlockedClients(), 3);
+
+    // Serving the clients is part of the calls that blocked, it isn't counted again.
+    const auto processed = service_.Stats().commands_processed.load();
+    ExpectInt(Invoke("RPUSH l1 x y"), 2);
+    EXPECT_EQ(service_.Stats().commands_processed.load(), processed + 1);
+    EXPECT_EQ(service_.NumBlockedClients(), 1);
+    EXPECT_EQ(reasons[0], WakeReason::kReady);
+    ExpectStrings(results[0], {"l1", "x"});
+    EXPECT_EQ(reasons[1], WakeReason::kReady);
+    ExpectStrings(results[1], {"l1", "y"});
+    EXPECT_TRUE(ExpectNoKey("l1"));
+
+    EXPECT_TRUE(service_.Unblock(2));
+    EXPECT_FALSE(service_.Unblock(2));
+    EXPECT_EQ(service_.NumBlockedClients(), 0);
+    EXPECT_EQ(reasons[2], WakeReason::kUnblocked);
+    ExpectNull(results[2]);
+    ExpectInt(Invoke("RPUSH l1 z"), 1);
+}
+
+// A list pushed to after the blocking command replied nil, but before the client blocks, e.g. while
+// the client visits other shards, serves the client instead of blocking it.
+TEST_F(ListCommandsTest, PushBeforeBlockTest) {
+    std::vector<std::string_view> args{"BLPOP", "l", "0"};
+    Result result;
+    service_.Invoke(Args(args), result);
+    ExpectNull(result);
+    ExpectInt(Invoke("RPUSH l a"), 1);
+
+    WakeReason reason{WakeReason::kTimeout};
+    Block(&service_, Args(args), &result, 0, &reason);
+    EXPECT_EQ(service_.NumBlockedClients(), 0);
+    EXPECT_EQ(reason, WakeReason::kReady);
+    ExpectStrings(result, {"l", "a"});
+    EXPECT_TRUE(ExpectNoKey("l"));
+}
+
+} // namespace rdss::test
@@ -0,0 +1,92 @@
+#include "base/memory.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace rdss::test {
+
+using Category = MemoryTracker::Category;
+
+TEST(MemoryTrackerTest, sumOfThreads) {
+    auto& tracker = MemoryTracker::GetInstance();
+    const auto mallocator = tracker.GetAllocated<Category::kMallocator>();
+    const auto query_buffer = tracker.GetAllocated<Category::kQueryBuffer>();
+
+    constexpr size_t kThreads = 4;
+    constexpr size_t kAllocations = 1000;
+    constexpr size_t kSize = 100;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&tracker] {
+            for (size_t j = 0; j < kAllocations; ++j) {
+                tracker.Allocate<Category::kMallocator>(kSize);
+                tracker.Allocate<Category::kQueryBuffer>(1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Memory allocated by exited threads is still counted.
+    EXPECT_EQ(
+      tracker.GetAllocated<Category::kMallocator>() - mallocator, kThreads * kAllocations * kSize);
+    EXPECT_EQ(tracker.GetAllocated<Category::kQueryBuffer>() - query_buffer, kThreads * kAllocations);
+    EXPECT_EQ(
+      tracker.GetAllocated<Category::kAll>(),
+      tracker.GetAllocated<Category::kMallocator>()
+        + tracker.GetAllocated<Category::kQueryBuffer>());
+    EXPECT_GE(tracker.GetPeakAllocated(), tracker.GetAllocated<Category::kAll>());
+
+    // Memory can be freed by a thread other than the one allocating it.
+    tracker.Deallocate<Category::kMallocator>(kThreads * kAllocations * kSize);
+    tracker.Deallocate<Category::kQueryBuffer>(kThreads * kAllocations);
+    EXPECT_EQ(tracker.GetAllocated<Category::kMallocator>(), mallocator);
+    EXPECT_EQ(tracker.GetAllocated<Category::kQueryBuffer>(), query_buffer);
+}
+
+TEST(MemoryTrackerTest, peak) {
+    auto& tracker = MemoryTracker::GetInstance();
+    const auto allocated = tracker.GetAllocated<Category::kAll>();
+
+    // Peak is kept after the memory is freed, as long as it's published.
+    constexpr size_t kLargeSize = MemoryTracker::kPublishThreshold * 4;
+    std::thread([&tracker] {
+        tracker.Allocate<Category::kMallocator>(kLargeSize);
+        tracker.Deallocate<Category::kMallocator>(kLargeSize);
+    }).join();
+    EXPECT_GE(tracker.GetPeakAllocated(), kLargeSize);
+    EXPECT_EQ(tracker.GetAllocated<Category::kAll>(), allocated);
+}
+
+TEST(MemoryTrackerTest, threadAllocated) {
+    auto& tracker = MemoryTracker::GetInstance();
+    const auto allocated = tracker.GetThreadAllocated<Category::kMallocator>();
+    std::thread([&tracker] {
+        EXPECT_EQ(tracker.GetThreadAllocated<Category::kMallocator>(), 0);
+        tracker.Allocate<Category::kMallocator>(100);
+        EXPECT_EQ(tracker.GetThreadAllocated<Category::kMallocator>(), 100);
+    }).join();
+    // Other threads don't change it, and freeing what another thread allocated takes it down.
+    EXPECT_EQ(tracker.GetThreadAllocated<Category::kMallocator>(), allocated);
+    tracker.Deallocate<Category::kMallocator>(100);
+    EXPECT_EQ(tracker.GetThreadAllocated<Category::kMallocator>(), allocated - 100);
+}
+
+TEST(MemoryTrackerTest, published) {
+    auto& tracker = MemoryTracker::GetInstance();
+    // Large enough to outweigh what the other tests left unpublished.
+    constexpr size_t kLargeSize = MemoryTracker::kPublishThreshold * 64;
+    std::thread([&tracker] { tracker.Allocate<Category::kMallocator>(kLargeSize); }).join();
+    // Lags behind by less than kPublishThreshold bytes for each thread of the tests.
+    constexpr size_t kMaxLag = MemoryTracker::kPublishThreshold * 8;
+    const auto allocated = tracker.GetAllocated<Category::kAll>();
+    EXPECT_GE(tracker.GetPublishedAllocated() + kMaxLag, allocated);
+    EXPECT_LE(tracker.GetPublishedAllocated(), allocated + kMaxLag);
+
+    std::thread([&tracker] { tracker.Deallocate<Category::kMallocator>(kLargeSize); }).join();
+    EXPECT_LE(tracker.GetPublishedAllocated(), tracker.GetAllocated<Category::kAll>() + kMaxLag);
+}
+
+} // namespace rdss::test
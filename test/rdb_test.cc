@@ -0,0 +1,345 @@
+#include "base/crc64.h"
+#include "base/lzf.h"
+#include "data_structure/hash_value.h"
+#include "data_structure/list_value.h"
+#include "data_structure/set_value.h"
+#include "data_structure/zset_value.h"
+#include "service/rdb.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace rdss::test {
+
+using TimePoint = rdb::TimePoint;
+
+struct LoadedValue {
+    std::string value;
+    std::optional<TimePoint> expire_time;
+};
+
+std::string TempPath() { return testing::TempDir() + "rdb_test.rdb"; }
+
+void WriteFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+std::optional<std::map<std::string, LoadedValue>> LoadFile(const std::string& path) {
+    std::map<std::string, LoadedValue> loaded;
+    const auto ok = rdb::Load(
+      path,
+      [&loaded](std::string_view key, StringValue value, std::optional<TimePoint> expire_time) {
+          StringValue::IntChars chars;
+          loaded[std::string(key)] = {std::string(value.View(chars)), expire_time};
+      });
+    if (!ok) {
+        return std::nullopt;
+    }
+    return loaded;
+}
+
+TEST(RdbTest, crc64) {
+    EXPECT_EQ(Crc64(0, "123456789"), 0xe9c6d914c4b8d9caULL);
+    // Checksum can be computed incrementally.
+    EXPECT_EQ(Crc64(Crc64(0, "1234"), "56789"), Crc64(0, "123456789"));
+}
+
+TEST(RdbTest, lzf) {
+    // Literal run of "abc", followed by a back reference of 9 bytes at distance 3.
+    const std::string compressed{"\x02" "abc" "\xe0\x00\x02", 7};
+    std::string out(12, '\0');
+    EXPECT_EQ(LzfDecompress(compressed, out.data(), out.size()), 12);
+    EXPECT_EQ(out, "abcabcabcabc");
+
+    // Output is too small, or the reference is out of range.
+    EXPECT_EQ(LzfDecompress(compressed, out.data(), 11), 0);
+    EXPECT_EQ(LzfDecompress(std::string{"\xe0\x00\x02", 3}, out.data(), out.size()), 0);
+}
+
+TEST(RdbTest, saveAndLoad) {
+    const auto expire_time = std::chrono::time_point_cast<TimePoint::duration>(
+      std::chrono::system_clock::now() + std::chrono::hours{1});
+    const std::map<std::string, std::string> values = {
+      {"int8", "-12"},
+      {"int16", "1234"},
+      {"int32", "-12345678"},
+      {"int64", "1234567890123"},
+      {"embedded", "foo"},
+      {"empty", ""},
+      {"raw", std::string(100, 'r')},
+      {"long", std::string(20000, 'l')},
+    };
+
+    std::string file;
+    rdb::AppendHeader(file, values.size(), 1);
+    for (const auto& [key, value] : values) {
+        rdb::AppendKeyValue(
+          file,
+          key,
+          StringValue(std::string_view(value)),
+          (key == "raw" ? std::optional(expire_time) : std::nullopt));
+    }
+    file += rdb::Footer(Crc64(0, file));
+    ASSERT_TRUE(file.starts_with("REDIS0009"));
+    WriteFile(TempPath(), file);
+
+    const auto loaded = LoadFile(TempPath());
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(loaded->size(), values.size());
+    for (const auto& [key, value] : values) {
+        ASSERT_TRUE(loaded->contains(key));
+        EXPECT_EQ(loaded->at(key).value, value);
+        EXPECT_EQ(loaded->at(key).expire_time.has_value(), key == "raw");
+    }
+    EXPECT_EQ(loaded->at("raw").expire_time, expire_time);
+
+    // Corrupted file fails the checksum.
+    file[file.size() / 2] ^= 1;
+    WriteFile(TempPath(), file);
+    EXPECT_FALSE(LoadFile(TempPath()).has_value());
+
+    // Truncated file.
+    WriteFile(TempPath(), file.substr(0, file.size() - 4));
+    EXPECT_FALSE(LoadFile(TempPath()).has_value());
+}
+
+TEST(RdbTest, saveAndLoadHash) {
+    // One hash in each encoding.
+    const HashValue::Limits limits{.max_listpack_entries = 4, .max_listpack_value = 64};
+    std::map<std::string, std::map<std::string, std::string>> hashes;
+    std::string file;
+    rdb::AppendHeader(file, 2, 0);
+    for (const auto& [key, num_fields] : {std::pair{"small", 3}, std::pair{"big", 100}}) {
+        auto value = StringValue::CreateHash();
+        for (int i = 0; i < num_fields; ++i) {
+            const auto field = "f" + std::to_string(i);
+            const auto field_value = std::to_string(i * 10);
+            value.Hash().Set(field, field_value, limits);
+            hashes[key][field] = field_value;
+        }
+        rdb::AppendKeyValue(file, key, value, std::nullopt);
+    }
+    file += rdb::Footer(Crc64(0, file));
+    WriteFile(TempPath(), file);
+
+    std::map<std::string, std::map<std::string, std::string>> loaded;
+    ASSERT_TRUE(rdb::Load(
+      TempPath(), [&loaded](std::string_view key, StringValue value, std::optional<TimePoint>) {
+          ASSERT_TRUE(value.IsHash());
+          value.Hash().ForEach([&](std::string_view field, std::string_view field_value) {
+              loaded[std::string(key)][std::string(field)] = field_value;
+          });
+      }));
+    EXPECT_EQ(loaded, hashes);
+}
+
+TEST(RdbTest, saveAndLoadList) {
+    const ListValue::Limits limits{.max_listpack_size = 4};
+    std::vector<std::string> elements;
+    auto value = StringValue::CreateList();
+    for (int i = 0; i < 10; ++i) {
+        elements.push_back(std::to_string(i));
+        value.List().PushBack(elements.back(), limits);
+    }
+    std::string file;
+    rdb::AppendHeader(file, 1, 0);
+    rdb::AppendKeyValue(file, "list", value, std::nullopt);
+    file += rdb::Footer(Crc64(0, file));
+    WriteFile(TempPath(), file);
+
+    std::vector<std::string> loaded;
+    ASSERT_TRUE(rdb::Load(
+      TempPath(), [&loaded](std::string_view key, StringValue value, std::optional<TimePoint>) {
+          EXPECT_EQ(key, "list");
+          ASSERT_TRUE(value.IsList());
+          value.List().ForEach(
+            [&loaded](std::string_view element) { loaded.emplace_back(element); });
+      }));
+    EXPECT_EQ(loaded, elements);
+}
+
+TEST(RdbTest, saveAndLoadSet) {
+    // One set in each encoding.
+    std::map<std::string, std::set<std::string>> sets{
+      {"ints", {"-3", "7", "42"}}, {"strs", {"a", "1", "bc"}}};
+    std::string file;
+    rdb::AppendHeader(file, 2, 0);
+    for (const auto& [key, members] : sets) {
+        auto value = StringValue::CreateSet();
+        for (const auto& member : members) {
+            value.Set().Add(member, {});
+        }
+        rdb::AppendKeyValue(file, key, value, std::nullopt);
+    }
+    file += rdb::Footer(Crc64(0, file));
+    WriteFile(TempPath(), file);
+
+    std::map<std::string, std::set<std::string>> loaded;
+    ASSERT_TRUE(rdb::Load(
+      TempPath(), [&loaded](std::string_view key, StringValue value, std::optional<TimePoint>) {
+          ASSERT_TRUE(value.IsSet());
+          EXPECT_EQ(
+            value.Set().GetEncoding(),
+            key == "ints" ? SetValue::Encoding::kIntset : SetValue::Encoding::kTable);
+          value.Set().ForEach(
+            [&](std::string_view member) { loaded[std::string(key)].emplace(member); });
+      }));
+    EXPECT_EQ(loaded, sets);
+}
+
+TEST(RdbTest, saveAndLoadZSet) {
+    const std::map<std::string, double> scores{
+      {"a", -1.5},
+      {"b", 0},
+      {"c", 1e300},
+      {"d", std::numeric_limits<double>::infinity()},
+      {"e", 0.1}};
+    std::string file;
+    rdb::AppendHeader(file, 1, 0);
+    auto value = StringValue::CreateZSet();
+    for (const auto& [member, score] : scores) {
+        value.ZSet().Set(member, score);
+    }
+    rdb::AppendKeyValue(file, "z", value, std::nullopt);
+    file += rdb::Footer(Crc64(0, file));
+    WriteFile(TempPath(), file);
+
+    std::map<std::string, double> loaded;
+    ASSERT_TRUE(rdb::Load(
+      TempPath(), [&loaded](std::string_view, StringValue value, std::optional<TimePoint>) {
+          ASSERT_TRUE(value.IsZSet());
+          value.ZSet().ForEach(
+            [&](std::string_view member, double score) { loaded.emplace(member, score); });
+      }));
+    EXPECT_EQ(loaded, scores);
+}
+
+TEST(RdbTest, loadRedisEncodings) {
+    std::string file{"REDIS0011"};
+    // Aux field with int encoded value.
+    file += std::string{"\xfa\x0aredis-bits\xc0\x40", 14};
+    file += std::string{"\xfe\x00\xfb\x03\x01", 5};
+    // Expire time in seconds, key with 16 bits int value.
+    file += std::string{"\xfd\xff\xff\xff\x7f", 5};
+    file += std::string{"\x00\x03int\xc1\xd2\x04", 8};
+    // LZF compressed value, and key with idle time.
+    file += std::string{"\xf8\x05\x00\x03lzf\xc3\x07\x0c\x02" "abc" "\xe0\x00\x02", 17};
+    // Keys of db 1 are skipped.
+    file += std::string{"\xfe\x01\x00\x05other\x01v", 11};
+    // Checksum is disabled.
+    file += std::string{"\xff\x00\x00\x00\x00\x00\x00\x00\x00", 9};
+    WriteFile(TempPath(), file);
+
+    const auto loaded = LoadFile(TempPath());
+    ASSERT_TRUE(loaded.has_value());
+    ASSERT_EQ(loaded->size(), 2);
+    EXPECT_EQ(loaded->at("int").value, "1234");
+    EXPECT_EQ(
+      loaded->at("int").expire_time,
+      TimePoint{std::chrono::seconds{std::numeric_limits<int32_t>::max()}});
+    EXPECT_EQ(loaded->at("lzf").value, "abcabcabcabc");
+    EXPECT_FALSE(loaded->at("lzf").expire_time.has_value());
+
+    // Unsupported value type, i.e. a stream.
+    WriteFile(TempPath(), std::string{"REDIS0009\x0f\x01k", 12});
+    EXPECT_FALSE(LoadFile(TempPath()).has_value());
+}
+
+// The values of the compact encodings, laid out as Redis writes them. Each blob is a string of the
+// bytes of the encoding, preceded by its length.
+TEST(RdbTest, loadRedisCompactEncodings) {
+    std::string file{"REDIS0011"};
+    file += std::string{"\xfe\x00", 2};
+    // Quicklist 2 of a listpack node ["a", 1, "bcd"] and a plain node.
+    file += std::string{"\x12\x05qlist\x02", 8};
+    file += std::string{"\x02\x11\x11\x00\x00\x00\x03\x00", 8};
+    file += std::string{"\x81" "a\x02\x01\x01\x83" "bcd\x04\xff", 11};
+    file += std::string{"\x01\x05plain", 7};
+    // Quicklist of a ziplist node ["x"].
+    file += std::string{"\x0e\x06qlist1\x01", 9};
+    file += std::string{"\x0e\x0e\x00\x00\x00\x0a\x00\x00\x00\x01\x00\x00\x01x\xff", 15};
+    // Ziplist of "hello", 12 as an immediate, 300 as int16 and -70000 as int24.
+    file += std::string{"\x0a\x06zllist", 8};
+    file += std::string{"\x1d\x1d\x00\x00\x00\x17\x00\x00\x00\x04\x00", 11};
+    file += std::string{"\x00\x05hello\x07\xfd\x02\xc0\x2c\x01\x04\xf0\x90\xee\xfe\xff", 19};
+    // Intset of int16 members.
+    file += std::string{"\x0b\x06intset", 8};
+    file += std::string{"\x0e\x02\x00\x00\x00\x03\x00\x00\x00\xfd\xff\x07\x00\x2a\x00", 15};
+    // Listpack set of "x", -100 as int13 and 1000 as int16.
+    file += std::string{"\x14\x05lpset", 7};
+    file += std::string{"\x11\x11\x00\x00\x00\x03\x00", 7};
+    file += std::string{"\x81x\x02\xdf\x9c\x02\xf1\xe8\x03\x03\xff", 11};
+    // Listpack hash.
+    file += std::string{"\x10\x06lphash", 8};
+    file += std::string{"\x15\x15\x00\x00\x00\x04\x00", 7};
+    file += std::string{"\x82" "f1\x03\x82" "v1\x03\x82" "f2\x03\x05\x01\xff", 15};
+    // Listpack sorted set, scores are strings unless integers.
+    file += std::string{"\x11\x06lpzset", 8};
+    file += std::string{"\x14\x14\x00\x00\x00\x04\x00", 7};
+    file += std::string{"\x81" "a\x02\x83" "1.5\x04\x81" "b\x02\x02\x01\xff", 14};
+    // Ziplist sorted set and hash.
+    file += std::string{"\x0c\x06zlzset", 8};
+    file += std::string{"\x18\x18\x00\x00\x00\x15\x00\x00\x00\x04\x00", 11};
+    file += std::string{"\x00\x01m\x03\x03" "2.5\x05\x01n\x03\xf4\xff", 14};
+    file += std::string{"\x0d\x06zlhash", 8};
+    file += std::string{"\x11\x11\x00\x00\x00\x0d\x00\x00\x00\x02\x00\x00\x01k\x03\x01v\xff", 18};
+    // Zipmap hash, a value may be followed by free bytes.
+    file += std::string{"\x09\x06zmhash", 8};
+    file += std::string{"\x11\x02\x03" "foo\x03\x00" "bar\x01x\x01\x01" "9?\xff", 18};
+    file += std::string{"\xff\x00\x00\x00\x00\x00\x00\x00\x00", 9};
+    WriteFile(TempPath(), file);
+
+    std::map<std::string, std::vector<std::string>> lists;
+    std::map<std::string, std::set<std::string>> sets;
+    std::map<std::string, std::map<std::string, std::string>> hashes;
+    std::map<std::string, std::map<std::string, double>> zsets;
+    ASSERT_TRUE(rdb::Load(
+      TempPath(), [&](std::string_view key_view, StringValue value, std::optional<TimePoint>) {
+          const std::string key(key_view);
+          if (value.IsList()) {
+              value.List().ForEach([&](std::string_view e) { lists[key].emplace_back(e); });
+          } else if (value.IsSet()) {
+              value.Set().ForEach([&](std::string_view m) { sets[key].emplace(m); });
+          } else if (value.IsHash()) {
+              value.Hash().ForEach(
+                [&](std::string_view f, std::string_view v) { hashes[key][std::string(f)] = v; });
+          } else if (value.IsZSet()) {
+              value.ZSet().ForEach(
+                [&](std::string_view m, double score) { zsets[key].emplace(m, score); });
+          } else {
+              ADD_FAILURE() << key;
+          }
+      }));
+    const std::map<std::string, std::vector<std::string>> expected_lists{
+      {"qlist", {"a", "1", "bcd", "plain"}},
+      {"qlist1", {"x"}},
+      {"zllist", {"hello", "12", "300", "-70000"}}};
+    EXPECT_EQ(lists, expected_lists);
+    const std::map<std::string, std::set<std::string>> expected_sets{
+      {"intset", {"-3", "7", "42"}}, {"lpset", {"x", "-100", "1000"}}};
+    EXPECT_EQ(sets, expected_sets);
+    const std::map<std::string, std::map<std::string, std::string>> expected_hashes{
+      {"lphash", {{"f1", "v1"}, {"f2", "5"}}},
+      {"zlhash", {{"k", "v"}}},
+      {"zmhash", {{"foo", "bar"}, {"x", "9"}}}};
+    EXPECT_EQ(hashes, expected_hashes);
+    const std::map<std::string, std::map<std::string, double>> expected_zsets{
+      {"lpzset", {{"a", 1.5}, {"b", 2}}}, {"zlzset", {{"m", 2.5}, {"n", 3}}}};
+    EXPECT_EQ(zsets, expected_zsets);
+
+    // A listpack whose total bytes don't match the blob is corrupted.
+    const auto corrupted = file.find("\x15\x15\x00");
+    ASSERT_NE(corrupted, std::string::npos);
+    file[corrupted + 1] = '\x16';
+    WriteFile(TempPath(), file);
+    EXPECT_FALSE(rdb::Load(TempPath(), [](std::string_view, StringValue, auto) {}));
+}
+
+} // namespace rdss::test
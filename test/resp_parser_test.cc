@@ -186,6 +186,52 @@ TEST_F(RespParserTest, mbulkTwoPasses) {
     }
 }
 
+TEST_F(RespParserTest, mbulkPipelined) {
+    const std::string content = "*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$2\r\nK0\r\n";
+    const std::string tail = "*3\r\n$3\r\nSET\r\n$2\r\nK0\r\n$6\r\nFOOBAR\r\n";
+
+    for (const bool is_virtual : {false, true}) {
+        for (size_t i = 1; i < tail.size(); ++i) {
+            Buffer buffer(is_virtual ? 0 : 1024);
+            const std::string first = content + tail.substr(0, i);
+            if (is_virtual) {
+                buffer.Produce(first);
+            } else {
+                memcpy(buffer.Data(), first.data(), first.size());
+                buffer.Produce(first.size());
+            }
+
+            MultiBulkParser parser(&buffer);
+            StringViews result;
+            EXPECT_EQ(parser.Parse(result), ParserState::kDone);
+            ExpectEQ(result, {"PING"});
+            EXPECT_EQ(parser.Parse(result), ParserState::kDone);
+            ExpectEQ(result, {"GET", "K0"});
+
+            // Partial query is rewound, and parsed from its start after more data arrives.
+            const auto pending = buffer.NumWritten();
+            EXPECT_NE(parser.Parse(result), ParserState::kDone);
+            buffer.Rewind(pending - buffer.NumWritten());
+            parser.Reset();
+            EXPECT_EQ(buffer.Source(), tail.substr(0, i));
+
+            buffer.Compact();
+            EXPECT_EQ(buffer.Source(), tail.substr(0, i));
+            const std::string second = tail.substr(i);
+            if (is_virtual) {
+                buffer.Produce(second);
+            } else {
+                buffer.EnsureAvailable(second.size(), false);
+                memcpy(buffer.Data(), second.data(), second.size());
+                buffer.Produce(second.size());
+            }
+            EXPECT_EQ(parser.Parse(result), ParserState::kDone);
+            ExpectEQ(result, {"SET", "K0", "FOOBAR"});
+            EXPECT_EQ(buffer.NumWritten(), 0);
+        }
+    }
+}
+
 TEST_F(RespParserTest, bufferExpansion) {
     constexpr size_t num_argument = 100;
     constexpr size_t min_length = 512;
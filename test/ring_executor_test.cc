@@ -0,0 +1,146 @@
+#include "runtime/ring_executor.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rdss::test {
+
+using namespace std::chrono;
+
+// Producer executors transfer to one target executor, whose transfer queue has multiple producers
+// and a single consumer.
+class RingExecutorTest : public testing::Test {
+protected:
+    static constexpr size_t kNumProducers = 4;
+    static constexpr seconds kTimeout{10};
+
+    RingExecutorTest() {
+        const auto ret = io_uring_queue_init(64, &ring_, 0);
+        EXPECT_EQ(ret, 0) << strerror(-ret);
+        target_ = std::make_unique<RingExecutor>("target");
+        for (size_t i = 0; i < kNumProducers; ++i) {
+            producers_.push_back(std::make_unique<RingExecutor>("producer" + std::to_string(i)));
+        }
+    }
+
+    ~RingExecutorTest() override {
+        for (auto& producer : producers_) {
+            producer->Deactivate(&ring_);
+            producer->Shutdown();
+        }
+        target_->Deactivate(&ring_);
+        target_->Shutdown();
+        io_uring_queue_exit(&ring_);
+    }
+
+    // Waits for 'counter' to reach 'n'. Returns false if it doesn't in time, e.g. the transfers
+    // are left queued by a lost doorbell.
+    static bool WaitFor(const std::atomic<size_t>& counter, size_t n) {
+        const auto deadline = steady_clock::now() + kTimeout;
+        while (counter.load(std::memory_order_acquire) < n) {
+            if (steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // The ring of the test thread, for scheduling on the producers.
+    io_uring ring_;
+    std::unique_ptr<RingExecutor> target_;
+    std::vector<std::unique_ptr<RingExecutor>> producers_;
+};
+
+TEST_F(RingExecutorTest, TransferStressTest) {
+    constexpr size_t kTransfers = 20000;
+    // Written by the target only, and read after all of them are counted by 'resumed'.
+    std::vector<uint32_t> resumes(kNumProducers * kTransfers);
+    std::atomic<size_t> resumed{0};
+    for (size_t p = 0; p < kNumProducers; ++p) {
+        producers_[p]->Schedule(&ring_, [this, p, &resumes, &resumed]() {
+            for (size_t i = 0; i < kTransfers; ++i) {
+                target_->Schedule([&resumes, &resumed, id = p * kTransfers + i]() {
+                    ++resumes[id];
+                    resumed.fetch_add(1, std::memory_order_release);
+                });
+            }
+        });
+    }
+    ASSERT_TRUE(WaitFor(resumed, resumes.size()));
+
+    // Each is resumed exactly once, and only the ones finding the queue empty ring the doorbell.
+    EXPECT_EQ(std::count(resumes.begin(), resumes.end(), 1U), resumes.size());
+    EXPECT_EQ(target_->Load().transfers.load(), resumes.size());
+    const auto doorbells = target_->Load().doorbells.load();
+    EXPECT_GE(doorbells, 1U);
+    EXPECT_LE(doorbells, resumes.size());
+}
+
+// Every round starts with the queue empty, so it takes a doorbell to wake the target, and the
+// producers race to be the one finding it empty.
+TEST_F(RingExecutorTest, DoorbellTest) {
+    constexpr size_t kRounds = 2000;
+    std::atomic<size_t> resumed{0};
+    for (size_t round = 0; round < kRounds; ++round) {
+        for (auto& producer : producers_) {
+            producer->Schedule(&ring_, [this, &resumed]() {
+                target_->Schedule(
+                  [&resumed]() { resumed.fetch_add(1, std::memory_order_release); });
+            });
+        }
+        ASSERT_TRUE(WaitFor(resumed, (round + 1) * kNumProducers)) << "round " << round;
+    }
+    EXPECT_EQ(resumed.load(), kRounds * kNumProducers);
+    EXPECT_EQ(target_->Load().transfers.load(), kRounds * kNumProducers);
+    EXPECT_LE(target_->Load().doorbells.load(), kRounds * kNumProducers);
+}
+
+// The transfers queued while the target is busy running a callable are all behind the one that
+// found the queue empty, so they're resumed by a single doorbell.
+TEST_F(RingExecutorTest, ParkedDoorbellTest) {
+    constexpr size_t kTransfers = 1000;
+    std::latch parked{1};
+    std::latch release{1};
+    std::atomic<size_t> doorbells{0};
+    target_->Schedule(&ring_, [this, &parked, &release, &doorbells]() {
+        doorbells.store(target_->Load().doorbells.load(), std::memory_order_relaxed);
+        parked.count_down();
+        release.wait();
+    });
+    parked.wait();
+
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> resumed{0};
+    for (auto& producer : producers_) {
+        producer->Schedule(&ring_, [this, &queued, &resumed]() {
+            for (size_t i = 0; i < kTransfers; ++i) {
+                target_->Schedule(
+                  [&resumed]() { resumed.fetch_add(1, std::memory_order_release); });
+                queued.fetch_add(1, std::memory_order_release);
+            }
+        });
+    }
+    ASSERT_TRUE(WaitFor(queued, kNumProducers * kTransfers));
+    EXPECT_EQ(resumed.load(), 0U);
+    release.count_down();
+    ASSERT_TRUE(WaitFor(resumed, kNumProducers * kTransfers));
+
+    // The ring message might be reaped after its transfers are already drained.
+    const auto expected = doorbells.load(std::memory_order_relaxed) + 1;
+    const auto deadline = steady_clock::now() + kTimeout;
+    while (target_->Load().doorbells.load() < expected && steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(target_->Load().doorbells.load(), expected);
+}
+
+} // namespace rdss::test
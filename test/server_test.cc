@@ -0,0 +1,179 @@
+#include "base/config.h"
+#include "runtime/ring_executor.h"
+#include "server.h"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace rdss::test {
+
+using namespace std::chrono;
+
+// A blocking client connected to the server on the loopback.
+class TestClient {
+public:
+    static constexpr milliseconds kTimeout{10000};
+
+    // 'rcvbuf' sets the receive buffer of the socket if it isn't 0.
+    explicit TestClient(uint16_t port, int rcvbuf = 0)
+      : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+        if (rcvbuf != 0) {
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected_ = connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+
+    TestClient(const TestClient&) = delete;
+    TestClient& operator=(const TestClient&) = delete;
+
+    ~TestClient() { close(fd_); }
+
+    bool Connected() const { return connected_; }
+
+    bool Send(std::string_view data) {
+        while (!data.empty()) {
+            const auto n = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    // Reads 'n' bytes, or less if the connection is closed or nothing arrives in time.
+    std::string Read(size_t n) {
+        std::string data(n, '\0');
+        size_t read{0};
+        pollfd pfd{.fd = fd_, .events = POLLIN, .revents = 0};
+        while (read < n && poll(&pfd, 1, static_cast<int>(kTimeout.count())) == 1) {
+            const auto r = recv(fd_, data.data() + read, n - read, 0);
+            if (r <= 0) {
+                break;
+            }
+            read += static_cast<size_t>(r);
+        }
+        data.resize(read);
+        return data;
+    }
+
+private:
+    int fd_;
+    bool connected_{false};
+};
+
+class ServerTest : public testing::Test {
+protected:
+    static constexpr uint16_t kPort = 16379;
+
+    void SetUp() override {
+        std::string dir = (std::filesystem::temp_directory_path() / "rdss_server_test_XXXXXX");
+        ASSERT_NE(mkdtemp(dir.data()), nullptr);
+        config_.dir = dir;
+        config_.port = kPort;
+        config_.client_executors = 1;
+        config_.data_shards = 1;
+        // The buffer ring has 64 entries, which a client holding the buffers would run out of.
+        config_.max_direct_fds_per_exr = 16;
+        server_ = std::make_unique<Server>(config_);
+        server_->Setup();
+        thread_ = std::thread([this]() { server_->Run(); });
+    }
+
+    void TearDown() override {
+        if (!thread_.joinable()) {
+            return;
+        }
+        {
+            TestClient client(kPort);
+            client.Send("SHUTDOWN\r\n");
+        }
+        thread_.join();
+        server_.reset();
+        // Set by Setup() for the thread, which sets up the server of the next test.
+        tls_ring = nullptr;
+        std::filesystem::remove_all(config_.dir);
+    }
+
+    Config config_;
+    std::unique_ptr<Server> server_;
+    std::thread thread_;
+};
+
+// The replies of a pipelined batch are assembled into one run, which is larger than what the
+// socket of a slow reader takes at once, all of them still arrive.
+TEST_F(ServerTest, LargeReplyTest) {
+    TestClient client(kPort, 4096);
+    ASSERT_TRUE(client.Connected());
+    const std::string value(500, 'v');
+    ASSERT_TRUE(client.Send("SET k " + value + "\r\n"));
+    ASSERT_EQ(client.Read(5), "+OK\r\n");
+
+    constexpr size_t kGets = 64 * 50;
+    std::string gets;
+    for (size_t i = 0; i < kGets; ++i) {
+        gets += "GET k\r\n";
+    }
+    std::thread sender([&client, &gets]() { client.Send(gets); });
+    // The replies pile up while nothing is read.
+    std::this_thread::sleep_for(milliseconds(200));
+    const std::string reply = "$500\r\n" + value + "\r\n";
+    const auto replies = client.Read(reply.size() * kGets);
+    sender.join();
+    ASSERT_EQ(replies.size(), reply.size() * kGets);
+    for (size_t i = 0; i < kGets; ++i) {
+        ASSERT_EQ(replies.compare(i * reply.size(), reply.size(), reply), 0) << i;
+    }
+}
+
+// The queries pipelined after a blocking one wait in the socket once a few of them are received,
+// instead of taking the buffers shared by the other clients of the executor.
+TEST_F(ServerTest, BlockedClientFloodTest) {
+    TestClient blocked(kPort);
+    ASSERT_TRUE(blocked.Connected());
+    ASSERT_TRUE(blocked.Send("BLPOP list 0\r\n"));
+    // Several times what the buffer ring holds.
+    constexpr size_t kPings = 100000;
+    std::string pings;
+    for (size_t i = 0; i < kPings; ++i) {
+        pings += "PING\r\n";
+    }
+    std::thread flood([&blocked, &pings]() { blocked.Send(pings); });
+    std::this_thread::sleep_for(milliseconds(200));
+
+    TestClient other(kPort);
+    EXPECT_TRUE(other.Connected());
+    EXPECT_TRUE(other.Send("PING\r\n"));
+    EXPECT_EQ(other.Read(7), "+PONG\r\n");
+    EXPECT_TRUE(other.Send("RPUSH list a\r\n"));
+    EXPECT_EQ(other.Read(4), ":1\r\n");
+
+    // Once served, the blocked client gets the replies of all the pipelined queries.
+    const std::string popped = "*2\r\n$4\r\nlist\r\n$1\r\na\r\n";
+    EXPECT_EQ(blocked.Read(popped.size()), popped);
+    const std::string pong = "+PONG\r\n";
+    const auto pongs = blocked.Read(pong.size() * kPings);
+    flood.join();
+    ASSERT_EQ(pongs.size(), pong.size() * kPings);
+    for (size_t i = 0; i < kPings; ++i) {
+        ASSERT_EQ(pongs.compare(i * pong.size(), pong.size(), pong), 0) << i;
+    }
+}
+
+} // namespace rdss::test
@@ -0,0 +1,124 @@
+#include "commands_test_base.h"
+#include "data_structure/set_value.h"
+#include "service/commands/set_commands.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+
+namespace rdss::test {
+
+class SetCommandsTest : public CommandsTestBase {
+protected:
+    void SetUp() override {
+        CommandsTestBase::SetUp();
+        RegisterSetCommands(&service_);
+    }
+
+    SetValue::Encoding GetEncoding(std::string_view key) {
+        return GetTypedValue<&StringValue::IsSet>(key).Set().GetEncoding();
+    }
+
+    // Members of the array reply in any order.
+    void ExpectMembers(Result result, std::set<std::string> members) {
+        ASSERT_EQ(result.type, Result::Type::kStrings);
+        std::set<std::string> replied;
+        for (const auto& str : result.strings) {
+            StringValue::IntChars chars;
+            replied.emplace(str.View(chars));
+        }
+        EXPECT_EQ(replied, members);
+    }
+};
+
+TEST_F(SetCommandsTest, AddRemoveTest) {
+    ExpectInt(Invoke("SADD s 3 1 2 1"), 3);
+    EXPECT_EQ(GetEncoding("s"), SetValue::Encoding::kIntset);
+    // Intsets are replied in ascending order.
+    ExpectStrings(Invoke("SMEMBERS s"), {"1", "2", "3"});
+    ExpectInt(Invoke("SISMEMBER s 2"), 1);
+    ExpectInt(Invoke("SISMEMBER s 02"), 0);
+    ExpectInt(Invoke("SISMEMBER missing 2"), 0);
+    ExpectInt(Invoke("SCARD s"), 3);
+
+    ExpectInt(Invoke("SADD s a 2"), 1);
+    EXPECT_EQ(GetEncoding("s"), SetValue::Encoding::kTable);
+    ExpectMembers(Invoke("SMEMBERS s"), {"1", "2", "3", "a"});
+    ExpectInt(Invoke("SISMEMBER s a"), 1);
+    ExpectInt(Invoke("SISMEMBER s 3"), 1);
+
+    ExpectInt(Invoke("SREM s 1 a x"), 2);
+    ExpectInt(Invoke("SCARD s"), 2);
+    ExpectInt(Invoke("SREM s 2 3"), 2);
+    // The emptied set is removed.
+    EXPECT_TRUE(ExpectNoKey("s"));
+    ExpectStrings(Invoke("SMEMBERS s"), {});
+
+    ExpectError(Invoke("SADD s"), Error::kWrongArgNum);
+    Invoke("SET str v");
+    ExpectError(Invoke("SADD str 1"), Error::kWrongType);
+    ExpectError(Invoke("SINTER str"), Error::kWrongType);
+    Invoke("SADD s 1");
+    ExpectError(Invoke("GET s"), Error::kWrongType);
+}
+
+TEST_F(SetCommandsTest, IntsetLimitTest) {
+    config_.set_max_intset_entries = 4;
+    ExpectInt(Invoke("SADD s 1 2 3 4"), 4);
+    EXPECT_EQ(GetEncoding("s"), SetValue::Encoding::kIntset);
+    ExpectInt(Invoke("SADD s 4"), 0);
+    EXPECT_EQ(GetEncoding("s"), SetValue::Encoding::kIntset);
+    ExpectInt(Invoke("SADD s 5"), 1);
+    EXPECT_EQ(GetEncoding("s"), SetValue::Encoding::kTable);
+    ExpectInt(Invoke("SCARD s"), 5);
+}
+
+TEST_F(SetCommandsTest, AlgebraTest) {
+    Invoke("SADD a 1 2 3 4 5 6");
+    Invoke("SADD b 2 4 6 8");
+    Invoke("SADD c 4 6 x");
+    ExpectStrings(Invoke("SINTER a b"), {"2", "4", "6"});
+    ExpectMembers(Invoke("SINTER a b c"), {"4", "6"});
+    ExpectStrings(Invoke("SINTER a missing"), {});
+    ExpectMembers(Invoke("SUNION b c missing"), {"2", "4", "6", "8", "x"});
+    ExpectMembers(Invoke("SDIFF a b c"), {"1", "3", "5"});
+    ExpectMembers(Invoke("SDIFF c missing"), {"4", "6", "x"});
+    ExpectStrings(Invoke("SDIFF missing a"), {});
+
+    ExpectInt(Invoke("SINTERCARD 2 a b"), 3);
+    ExpectInt(Invoke("SINTERCARD 2 a b LIMIT 2"), 2);
+    ExpectInt(Invoke("SINTERCARD 2 a b limit 0"), 3);
+    ExpectInt(Invoke("SINTERCARD 3 a b c"), 2);
+    ExpectInt(Invoke("SINTERCARD 2 a missing"), 0);
+    ExpectError(Invoke("SINTERCARD 0 a"), Error::kNotAnInt);
+    ExpectError(Invoke("SINTERCARD 3 a b"), Error::kSyntaxError);
+    ExpectError(Invoke("SINTERCARD 1 a LIMIT"), Error::kSyntaxError);
+}
+
+TEST(IntersectSortedTest, MatchesMerge) {
+    std::mt19937_64 rng(42);
+    for (const auto [size_a, size_b, range] :
+         {std::tuple{0, 10, 10}, {7, 9, 20}, {100, 100, 150}, {1000, 900, 5000}, {10, 5000, 8000}}) {
+        std::set<int64_t> set_a;
+        std::set<int64_t> set_b;
+        while (set_a.size() < static_cast<size_t>(size_a)) {
+            set_a.insert(static_cast<int64_t>(rng() % range) - range / 2);
+        }
+        while (set_b.size() < static_cast<size_t>(size_b)) {
+            set_b.insert(static_cast<int64_t>(rng() % range) - range / 2);
+        }
+        const std::vector<int64_t> a(set_a.begin(), set_a.end());
+        const std::vector<int64_t> b(set_b.begin(), set_b.end());
+        std::vector<int64_t> expected;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+
+        std::vector<int64_t> out(std::min(a.size(), b.size()));
+        out.resize(IntersectSorted(a, b, out.data()));
+        EXPECT_EQ(out, expected);
+        out.assign(std::min(a.size(), b.size()), 0);
+        out.resize(IntersectSorted(b, a, out.data()));
+        EXPECT_EQ(out, expected);
+    }
+}
+
+} // namespace rdss::test
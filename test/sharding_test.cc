@@ -0,0 +1,177 @@
+#include "base/buffer.h"
+#include "base/config.h"
+#include "resp/resp_parser.h"
+#include "service/commands/key_commands.h"
+#include "service/commands/misc_commands.h"
+#include "service/commands/set_commands.h"
+#include "service/commands/string_commands.h"
+#include "service/data_structure_service.h"
+#include "service/sharding.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+
+namespace rdss::test {
+
+class ShardingTest : public testing::Test {
+protected:
+    static constexpr size_t kNumShards = 4;
+
+    ShardingTest()
+      : clock_(false)
+      , buffer_(1024 * 16) {
+        for (size_t i = 0; i < kNumShards; ++i) {
+            services_.push_back(std::make_unique<DataStructureService>(&config_, nullptr, &clock_));
+            RegisterKeyCommands(services_.back().get());
+            RegisterMiscCommands(services_.back().get());
+            RegisterSetCommands(services_.back().get());
+            RegisterStringCommands(services_.back().get());
+            shards_.push_back(DataShard{.executor = nullptr, .service = services_.back().get()});
+        }
+        batch_ = std::make_unique<ShardedBatch>(&shards_);
+    }
+
+    Result Invoke(std::string query) {
+        query += "\r\n";
+        buffer_.Reset();
+        std::memcpy(buffer_.Sink().data(), query.data(), query.size());
+        buffer_.Produce(query.size());
+        StringViews args;
+        size_t arg_size;
+        EXPECT_EQ(ParseInline(&buffer_, args, arg_size), ParserState::kDone);
+
+        Result result;
+        batch_->Add(std::span<StringView>{args.data(), arg_size}, &result);
+        for (const auto shard : batch_->InvolvedShards()) {
+            batch_->Execute(shard);
+        }
+        batch_->Finish();
+        return result;
+    }
+
+    bool KeyInShard(std::string_view key, size_t shard) {
+        return services_[shard]->DataTable()->Find(key) != nullptr;
+    }
+
+    Config config_;
+    Clock clock_;
+    std::vector<std::unique_ptr<DataStructureService>> services_;
+    DataShards shards_;
+    std::unique_ptr<ShardedBatch> batch_;
+    Buffer buffer_;
+};
+
+TEST_F(ShardingTest, KeyToShard) {
+    std::vector<size_t> keys_per_shard(kNumShards);
+    for (size_t i = 0; i < 1000; ++i) {
+        const auto shard = KeyToShard("key:" + std::to_string(i), kNumShards);
+        ASSERT_LT(shard, kNumShards);
+        ++keys_per_shard[shard];
+    }
+    for (const auto n : keys_per_shard) {
+        EXPECT_GT(n, 0);
+    }
+
+    EXPECT_EQ(KeyToShard("{user1000}.following", kNumShards), KeyToShard("user1000", kNumShards));
+    EXPECT_EQ(
+      KeyToShard("{user1000}.following", kNumShards),
+      KeyToShard("{user1000}.followers", kNumShards));
+    EXPECT_EQ(KeyToShard("key", 1), 0);
+}
+
+TEST_F(ShardingTest, SplitAndMerge) {
+    std::string mset = "MSET";
+    std::string mget = "MGET";
+    std::string del = "DEL";
+    for (size_t i = 0; i < 16; ++i) {
+        const auto key = "k" + std::to_string(i);
+        mset += ' ' + key + " v" + std::to_string(i);
+        mget += ' ' + key + " missing" + std::to_string(i);
+        del += ' ' + key;
+    }
+
+    EXPECT_EQ(Invoke(mset).type, Result::Type::kOk);
+    for (size_t i = 0; i < 16; ++i) {
+        const auto key = "k" + std::to_string(i);
+        const auto shard = KeyToShard(key, kNumShards);
+        for (size_t s = 0; s < kNumShards; ++s) {
+            EXPECT_EQ(KeyInShard(key, s), s == shard);
+        }
+    }
+
+    auto result = Invoke(mget);
+    ASSERT_EQ(result.type, Result::Type::kStrings);
+    ASSERT_EQ(result.strings.size(), 32);
+    for (size_t i = 0; i < 16; ++i) {
+        ASSERT_FALSE(result.strings[i * 2].IsNull());
+        StringValue::IntChars chars;
+        EXPECT_EQ(result.strings[i * 2].View(chars), "v" + std::to_string(i));
+        EXPECT_TRUE(result.strings[i * 2 + 1].IsNull());
+    }
+
+    result = Invoke("DBSIZE");
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 16);
+
+    result = Invoke("EXISTS k0 k1 k1 nokey");
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 3);
+
+    result = Invoke(del);
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 16);
+    EXPECT_EQ(Invoke("DBSIZE").int_value, 0);
+}
+
+TEST_F(ShardingTest, SingleShardCommands) {
+    // Keys of MSETNX are in different shards.
+    std::string msetnx = "MSETNX";
+    for (size_t i = 0; i < 16; ++i) {
+        msetnx += " k" + std::to_string(i) + " v";
+    }
+    auto result = Invoke(msetnx);
+    ASSERT_EQ(result.type, Result::Type::kError);
+    EXPECT_EQ(result.error, Error::kCrossShard);
+
+    // Keys sharing the same hash tag are in one shard.
+    result = Invoke("MSETNX {tag}k0 v0 {tag}k1 v1");
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 1);
+    const auto shard = KeyToShard("tag", kNumShards);
+    EXPECT_TRUE(KeyInShard("{tag}k0", shard));
+    EXPECT_TRUE(KeyInShard("{tag}k1", shard));
+
+    // Malformed query is not split.
+    result = Invoke(msetnx.substr(0, msetnx.size() - 2));
+    ASSERT_EQ(result.type, Result::Type::kError);
+    EXPECT_EQ(result.error, Error::kWrongArgNum);
+
+    result = Invoke("UNKNOWN k0");
+    ASSERT_EQ(result.type, Result::Type::kError);
+    EXPECT_EQ(result.error, Error::kUnknownCommand);
+}
+
+TEST_F(ShardingTest, NumKeys) {
+    EXPECT_EQ(Invoke("SADD {t}a 1 2 3").int_value, 3);
+    EXPECT_EQ(Invoke("SADD {t}b 2 3 4").int_value, 3);
+
+    // Only the keys given by numkeys are routed, not the LIMIT argument.
+    auto result = Invoke("SINTERCARD 2 {t}a {t}b LIMIT 1");
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 1);
+    result = Invoke("SINTERCARD 2 {t}a {t}b");
+    ASSERT_EQ(result.type, Result::Type::kInt);
+    EXPECT_EQ(result.int_value, 2);
+
+    std::string sintercard = "SINTERCARD 16";
+    for (size_t i = 0; i < 16; ++i) {
+        sintercard += " k" + std::to_string(i);
+    }
+    result = Invoke(sintercard);
+    ASSERT_EQ(result.type, Result::Type::kError);
+    EXPECT_EQ(result.error, Error::kCrossShard);
+}
+
+} // namespace rdss::test
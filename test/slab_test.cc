@@ -0,0 +1,109 @@
+#include "base/memory.h"
+#include "base/slab.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace rdss::test {
+
+TEST(SlabTest, sizeClass) {
+    size_t last_block_size{0};
+    for (size_t size = 1; size <= SlabArena::kMaxBlockSize; ++size) {
+        const auto size_class = SlabArena::SizeClass(size);
+        ASSERT_LT(size_class, SlabArena::kNumClasses);
+        const auto block_size = SlabArena::BlockSize(size_class);
+        EXPECT_GE(block_size, size);
+        EXPECT_EQ(block_size % 16, 0);
+        // 'size' fits in the block of the previous class otherwise.
+        if (size_class > 0) {
+            EXPECT_GT(size, SlabArena::BlockSize(size_class - 1));
+        }
+        EXPECT_GE(block_size, last_block_size);
+        last_block_size = block_size;
+    }
+    constexpr auto kLargeSize = SlabArena::kMaxBlockSize + 1;
+    EXPECT_EQ(SlabArena::AllocationSize(kLargeSize), kLargeSize);
+}
+
+TEST(SlabTest, allocateAndReuse) {
+    constexpr size_t kSize = 40;
+    constexpr size_t n = 1024 * 16;
+
+    const auto used_before = SlabArena::GetStats().used_bytes;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < n; ++i) {
+        auto* p = SlabArena::Allocate(kSize);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t), 0);
+        std::memset(p, static_cast<int>(i), kSize);
+        blocks.push_back(p);
+    }
+    EXPECT_EQ(std::set<void*>(blocks.begin(), blocks.end()).size(), n);
+    EXPECT_EQ(
+      SlabArena::GetStats().used_bytes - used_before, n * SlabArena::AllocationSize(kSize));
+
+    for (auto* p : blocks) {
+        SlabArena::Deallocate(p, kSize);
+    }
+    EXPECT_EQ(SlabArena::GetStats().used_bytes, used_before);
+
+    // Freed blocks are reused before new pages are added.
+    const auto committed = SlabArena::GetStats().committed_bytes;
+    for (size_t i = 0; i < n; ++i) {
+        blocks[i] = SlabArena::Allocate(kSize);
+    }
+    EXPECT_EQ(SlabArena::GetStats().committed_bytes, committed);
+    for (auto* p : blocks) {
+        SlabArena::Deallocate(p, kSize);
+    }
+}
+
+TEST(SlabTest, remoteFree) {
+    constexpr size_t kSize = 100;
+    constexpr size_t n = 1024;
+
+    const auto used_before = SlabArena::GetStats().used_bytes;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < n; ++i) {
+        blocks.push_back(SlabArena::Allocate(kSize));
+    }
+
+    // Blocks freed by another thread return to this thread's arena.
+    std::thread([&blocks] {
+        for (auto* p : blocks) {
+            SlabArena::Deallocate(p, kSize);
+        }
+    }).join();
+
+    const std::set<void*> freed(blocks.begin(), blocks.end());
+    for (size_t i = 0; i < n; ++i) {
+        blocks[i] = SlabArena::Allocate(kSize);
+        EXPECT_TRUE(freed.contains(blocks[i]));
+    }
+    for (auto* p : blocks) {
+        SlabArena::Deallocate(p, kSize);
+    }
+    EXPECT_EQ(SlabArena::GetStats().used_bytes, used_before);
+}
+
+TEST(SlabTest, mallocator) {
+    using String = std::basic_string<char, std::char_traits<char>, Mallocator<char>>;
+
+    const auto allocated
+      = MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>();
+    {
+        String str(50, 'x');
+        EXPECT_EQ(
+          MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>()
+            - allocated,
+          SlabArena::AllocationSize(str.capacity() + 1));
+    }
+    EXPECT_EQ(
+      MemoryTracker::GetInstance().GetAllocated<MemoryTracker::Category::kMallocator>(), allocated);
+}
+
+} // namespace rdss::test
@@ -5,13 +5,7 @@ namespace rdss::test {
 
 using namespace std::chrono;
 
-class StringCommandsTest : public CommandsTestBase {
-protected:
-    void SetUp() override {
-        CommandsTestBase::SetUp();
-        RegisterStringCommands(&service_);
-    }
-};
+class StringCommandsTest : public CommandsTestBase {};
 
 TEST_F(StringCommandsTest, SetTest) {
     // Insert, then update.
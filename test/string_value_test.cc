@@ -0,0 +1,160 @@
+#include "base/buffer.h"
+#include "data_structure/tracking_hash_table.h"
+#include "resp/replier.h"
+#include "resp/result.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace rdss::test {
+
+using Encoding = StringValue::Encoding;
+
+std::string ToString(const StringValue& value) {
+    StringValue::IntChars chars;
+    return std::string(value.View(chars));
+}
+
+TEST(StringValueTest, encoding) {
+    EXPECT_TRUE(StringValue().IsNull());
+    EXPECT_TRUE(StringValue(MTSPtr{nullptr}).IsNull());
+    EXPECT_FALSE(StringValue().IsString());
+    EXPECT_TRUE(StringValue(std::string_view("1")).IsString());
+    EXPECT_FALSE(StringValue::CreateHash().IsString());
+
+    for (const auto* str :
+         {"0", "1", "-1", "12345678", "9223372036854775807", "-9223372036854775808"}) {
+        StringValue value{std::string_view(str)};
+        EXPECT_EQ(value.GetEncoding(), Encoding::kInt) << str;
+        EXPECT_EQ(ToString(value), str);
+        EXPECT_EQ(value.Size(), std::string_view(str).size());
+    }
+
+    // Not canonical or out of range integers are kept as they are.
+    for (const auto* str : {"", "01", "-0", "+1", "-", "1a", " 1", "9223372036854775808"}) {
+        StringValue value{std::string_view(str)};
+        EXPECT_NE(value.GetEncoding(), Encoding::kInt) << str;
+        EXPECT_EQ(ToString(value), str);
+    }
+
+    const std::string embedded(StringValue::kEmbeddedCapacity, 'e');
+    EXPECT_EQ(StringValue(std::string_view(embedded)).GetEncoding(), Encoding::kEmbedded);
+    EXPECT_EQ(ToString(StringValue(std::string_view(embedded))), embedded);
+
+    const std::string raw(StringValue::kEmbeddedCapacity + 1, 'r');
+    StringValue raw_value{std::string_view(raw)};
+    EXPECT_EQ(raw_value.GetEncoding(), Encoding::kRaw);
+    EXPECT_EQ(ToString(raw_value), raw);
+    EXPECT_EQ(raw_value.Size(), raw.size());
+}
+
+TEST(StringValueTest, copyAndMove) {
+    const std::string raw(64, 'r');
+    StringValue raw_value{std::string_view(raw)};
+    StringValue copy = raw_value;
+    EXPECT_EQ(copy.Raw(), raw_value.Raw());
+    EXPECT_EQ(raw_value.Raw().use_count(), 2);
+
+    StringValue moved = std::move(copy);
+    EXPECT_TRUE(copy.IsNull());
+    EXPECT_EQ(raw_value.Raw().use_count(), 2);
+
+    moved = StringValue(std::string_view("42"));
+    EXPECT_EQ(moved.GetEncoding(), Encoding::kInt);
+    EXPECT_EQ(raw_value.Raw().use_count(), 1);
+
+    StringValue embedded{std::string_view("foo")};
+    StringValue embedded_copy = embedded;
+    EXPECT_EQ(ToString(embedded_copy), "foo");
+}
+
+TEST(StringValueTest, makeRaw) {
+    StringValue value{std::string_view("42")};
+    value.MakeRaw().append("foo");
+    EXPECT_EQ(value.GetEncoding(), Encoding::kRaw);
+    EXPECT_EQ(ToString(value), "42foo");
+
+    // Shared string is copied before being modified.
+    StringValue shared = value;
+    value.MakeRaw().append("bar");
+    EXPECT_EQ(ToString(value), "42foobar");
+    EXPECT_EQ(ToString(shared), "42foo");
+
+    StringValue null;
+    EXPECT_TRUE(null.MakeRaw().empty());
+}
+
+std::string ToString(std::span<const iovec> iovecs) {
+    std::string reply;
+    for (const auto& iov : iovecs) {
+        reply.append(static_cast<const char*>(iov.iov_base), iov.iov_len);
+    }
+    return reply;
+}
+
+TEST(StringValueTest, reply) {
+    const std::string raw(64, 'r');
+    const std::string large_raw(ReplyWriter::kCopyThreshold + 1, 'l');
+    std::vector<Result> results(4);
+    results[0].SetString(StringValue(std::string_view("foo")));
+    results[1].AddString(StringValue(std::string_view("-12")));
+    results[1].AddString(nullptr);
+    results[1].AddString(StringValue(std::string_view(raw)));
+    results[1].AddString(StringValue(std::string_view(large_raw)));
+    results[2].SetOk();
+    results[3].SetInt(-1);
+
+    ReplyWriter writer(64);
+    writer.Append(results);
+    EXPECT_EQ(
+      ToString(writer.Iovecs()),
+      "$3\r\nfoo\r\n*4\r\n$3\r\n-12\r\n$-1\r\n$64\r\n" + raw + "\r\n$513\r\n" + large_raw
+        + "\r\n+OK\r\n:-1\r\n");
+
+    // Only the large raw string is referenced instead of being copied, the rest are copied into
+    // the chunks, where adjacent replies are one iovec.
+    EXPECT_TRUE(std::any_of(writer.Iovecs().begin(), writer.Iovecs().end(), [&](const iovec& iov) {
+        return iov.iov_base == results[1].strings[3].Raw()->data();
+    }));
+    EXPECT_LT(writer.Iovecs().size(), 6);
+    EXPECT_GT(writer.Capacity(), 64);
+
+    // Chunks are reused after reset.
+    const auto capacity = writer.Capacity();
+    writer.Reset();
+    EXPECT_TRUE(writer.Iovecs().empty());
+    Result result;
+    result.SetString(StringValue(std::string_view("12345")));
+    writer.Append(result);
+    ASSERT_EQ(writer.Iovecs().size(), 1);
+    EXPECT_EQ(ToString(writer.Iovecs()), "$5\r\n12345\r\n");
+    EXPECT_EQ(writer.Capacity(), capacity);
+}
+
+TEST(StringValueTest, pinReply) {
+    const std::string large_raw(ReplyWriter::kCopyThreshold + 1, 'l');
+    std::vector<Result> results(2);
+    results[0].SetString(StringValue(std::string_view(large_raw)));
+    results[1].SetInt(42);
+
+    ReplyWriter writer(64);
+    writer.Append(results);
+    EXPECT_EQ(writer.ReferencedBytes(), large_raw.size());
+    const std::vector<iovec> iovecs(writer.Iovecs().begin(), writer.Iovecs().end());
+    const auto expected = ToString(writer.Iovecs());
+
+    // The pinned memory stays valid after the writer and the results are reused.
+    auto pinned = writer.Pin();
+    writer.Reset();
+    results[0].Reset();
+    results[1].Reset();
+    Result result;
+    result.SetInt(-1);
+    writer.Append(result);
+    EXPECT_EQ(ToString(writer.Iovecs()), ":-1\r\n");
+    EXPECT_EQ(ToString(iovecs), expected);
+    EXPECT_EQ(pinned->strings.size(), 1);
+}
+
+} // namespace rdss::test
@@ -0,0 +1,167 @@
+#include "commands_test_base.h"
+#include "data_structure/zset_value.h"
+#include "service/commands/zset_commands.h"
+
+#include <map>
+#include <random>
+#include <set>
+
+namespace rdss::test {
+
+class ZSetCommandsTest : public CommandsTestBase {
+protected:
+    void SetUp() override {
+        CommandsTestBase::SetUp();
+        RegisterZSetCommands(&service_);
+    }
+};
+
+TEST_F(ZSetCommandsTest, AddRemoveTest) {
+    ExpectInt(Invoke("ZADD z 3 c 1 a 2 b"), 3);
+    ExpectInt(Invoke("ZCARD z"), 3);
+    ExpectStrings(Invoke("ZRANGE z 0 -1 WITHSCORES"), {"a", "1", "b", "2", "c", "3"});
+    ExpectString(Invoke("ZSCORE z b"), "2");
+    ExpectNull(Invoke("ZSCORE z x"));
+
+    // Updating a score reorders the member, CH counts it.
+    ExpectInt(Invoke("ZADD z 0.5 c"), 0);
+    ExpectStrings(Invoke("ZRANGE z 0 -1"), {"c", "a", "b"});
+    ExpectInt(Invoke("ZADD z CH 4 c 5 d"), 2);
+    ExpectStrings(Invoke("ZRANGE z 0 -1"), {"a", "b", "c", "d"});
+
+    // Members of the same score are ordered by member.
+    ExpectInt(Invoke("ZADD z 2 ab"), 1);
+    ExpectStrings(Invoke("ZRANGE z 1 2"), {"ab", "b"});
+
+    ExpectInt(Invoke("ZREM z a x ab"), 2);
+    ExpectInt(Invoke("ZCARD z"), 3);
+    ExpectInt(Invoke("ZREM z b c d"), 3);
+    // The emptied sorted set is removed.
+    EXPECT_TRUE(ExpectNoKey("z"));
+    ExpectInt(Invoke("ZCARD z"), 0);
+
+    ExpectError(Invoke("ZADD z 1"), Error::kWrongArgNum);
+    ExpectError(Invoke("ZADD z 1 a 2"), Error::kSyntaxError);
+    ExpectError(Invoke("ZADD z x a"), Error::kNotAFloat);
+    ExpectError(Invoke("ZADD z nan a"), Error::kNotAFloat);
+    EXPECT_TRUE(ExpectNoKey("z"));
+    Invoke("SET str v");
+    ExpectError(Invoke("ZADD str 1 a"), Error::kWrongType);
+    ExpectError(Invoke("ZRANGE str 0 -1"), Error::kWrongType);
+    Invoke("ZADD z 1 a");
+    ExpectError(Invoke("GET z"), Error::kWrongType);
+}
+
+TEST_F(ZSetCommandsTest, AddOptionsTest) {
+    Invoke("ZADD z 1 a 2 b");
+    ExpectInt(Invoke("ZADD z NX 5 a 3 c"), 1);
+    ExpectString(Invoke("ZSCORE z a"), "1");
+    ExpectInt(Invoke("ZADD z XX 5 a 4 d"), 0);
+    ExpectString(Invoke("ZSCORE z a"), "5");
+    ExpectNull(Invoke("ZSCORE z d"));
+    ExpectInt(Invoke("ZADD z GT CH 4 a 3 b"), 1);
+    ExpectString(Invoke("ZSCORE z a"), "5");
+    ExpectString(Invoke("ZSCORE z b"), "3");
+    ExpectInt(Invoke("ZADD z LT CH 1 a 4 b"), 1);
+    ExpectString(Invoke("ZSCORE z a"), "1");
+
+    ExpectString(Invoke("ZADD z INCR 1.5 a"), "2.5");
+    ExpectNull(Invoke("ZADD z NX INCR 1 a"));
+    ExpectInt(Invoke("ZADD missing XX 1 a"), 0);
+    EXPECT_TRUE(ExpectNoKey("missing"));
+
+    ExpectError(Invoke("ZADD z NX XX 1 a"), Error::kSyntaxError);
+    ExpectError(Invoke("ZADD z GT LT 1 a"), Error::kSyntaxError);
+    ExpectError(Invoke("ZADD z INCR 1 a 2 b"), Error::kSyntaxError);
+}
+
+TEST_F(ZSetCommandsTest, IncrByTest) {
+    ExpectString(Invoke("ZINCRBY z 2 a"), "2");
+    ExpectString(Invoke("ZINCRBY z -0.5 a"), "1.5");
+    ExpectString(Invoke("ZINCRBY z +inf a"), "inf");
+    ExpectError(Invoke("ZINCRBY z -inf a"), Error::kScoreIsNaN);
+    ExpectError(Invoke("ZINCRBY z x a"), Error::kNotAFloat);
+    ExpectInt(Invoke("ZRANK z a"), 0);
+}
+
+TEST_F(ZSetCommandsTest, RangeTest) {
+    Invoke("ZADD z 1 a 2 b 3 c 4 d 5 e");
+    ExpectStrings(Invoke("ZRANGE z -2 10"), {"d", "e"});
+    ExpectStrings(Invoke("ZRANGE z 3 1"), {});
+    ExpectStrings(Invoke("ZRANGE z 0 1 REV"), {"e", "d"});
+    ExpectStrings(Invoke("ZRANGE missing 0 -1"), {});
+
+    ExpectStrings(Invoke("ZRANGEBYSCORE z 2 4"), {"b", "c", "d"});
+    ExpectStrings(Invoke("ZRANGEBYSCORE z (2 +inf"), {"c", "d", "e"});
+    ExpectStrings(Invoke("ZRANGEBYSCORE z -inf (3 WITHSCORES"), {"a", "1", "b", "2"});
+    ExpectStrings(Invoke("ZRANGEBYSCORE z 1 5 LIMIT 1 2"), {"b", "c"});
+    ExpectStrings(Invoke("ZRANGEBYSCORE z 1 5 LIMIT 3 -1"), {"d", "e"});
+    ExpectStrings(Invoke("ZRANGEBYSCORE z 6 7"), {});
+    ExpectStrings(Invoke("ZRANGE z 4 (2 BYSCORE REV"), {"d", "c"});
+    ExpectStrings(Invoke("ZRANGE z +inf -inf BYSCORE REV LIMIT 1 2"), {"d", "c"});
+
+    ExpectError(Invoke("ZRANGE z 0 -1 LIMIT 0 1"), Error::kSyntaxError);
+    ExpectError(Invoke("ZRANGE z a 1"), Error::kNotAnInt);
+    ExpectError(Invoke("ZRANGEBYSCORE z x 1"), Error::kMinMaxNotAFloat);
+}
+
+TEST_F(ZSetCommandsTest, RankPopTest) {
+    Invoke("ZADD z 5 e 1 a 3 c 2 b 4 d");
+    ExpectInt(Invoke("ZRANK z a"), 0);
+    ExpectInt(Invoke("ZRANK z d"), 3);
+    ExpectNull(Invoke("ZRANK z x"));
+    ExpectNull(Invoke("ZRANK missing a"));
+
+    ExpectStrings(Invoke("ZPOPMIN z"), {"a", "1"});
+    ExpectStrings(Invoke("ZPOPMIN z 2"), {"b", "2", "c", "3"});
+    ExpectInt(Invoke("ZRANK z e"), 1);
+    ExpectStrings(Invoke("ZPOPMIN z 5"), {"d", "4", "e", "5"});
+    EXPECT_TRUE(ExpectNoKey("z"));
+    ExpectStrings(Invoke("ZPOPMIN z"), {});
+    ExpectError(Invoke("ZPOPMIN z -1"), Error::kNotAnInt);
+}
+
+// Enough members for a tree of a few levels, checked against std::set.
+TEST_F(ZSetCommandsTest, LargeSetTest) {
+    std::mt19937_64 rng(42);
+    std::map<std::string, int64_t> scores;
+    std::set<std::pair<int64_t, std::string>> ordered;
+    for (size_t i = 0; i < 20000; ++i) {
+        const auto member = "m" + std::to_string(rng() % 5000);
+        const auto score = static_cast<int64_t>(rng() % 1000);
+        if (rng() % 4 == 0) {
+            const auto it = scores.find(member);
+            ExpectInt(Invoke("ZREM z " + member), it == scores.end() ? 0 : 1);
+            if (it != scores.end()) {
+                ordered.erase({it->second, member});
+                scores.erase(it);
+            }
+            continue;
+        }
+        if (auto it = scores.find(member); it != scores.end()) {
+            ordered.erase({it->second, member});
+        }
+        scores[member] = score;
+        ordered.emplace(score, member);
+        Invoke("ZADD z " + std::to_string(score) + " " + member);
+    }
+
+    ExpectInt(Invoke("ZCARD z"), static_cast<int64_t>(ordered.size()));
+    std::vector<std::string> expected;
+    for (const auto& [score, member] : ordered) {
+        expected.push_back(member);
+    }
+    ExpectStrings(Invoke("ZRANGE z 0 -1"), expected);
+    for (size_t rank = 0; rank < expected.size(); rank += 97) {
+        ExpectInt(Invoke("ZRANK z " + expected[rank]), static_cast<int64_t>(rank));
+    }
+    std::vector<std::string> between;
+    for (const auto& [score, member] : ordered) {
+        if (score > 100 && score <= 200) {
+            between.push_back(member);
+        }
+    }
+    ExpectStrings(Invoke("ZRANGEBYSCORE z (100 200"), between);
+}
+
+} // namespace rdss::test